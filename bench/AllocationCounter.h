@@ -0,0 +1,21 @@
+#ifndef BENCH_ALLOCATION_COUNTER_H
+#define BENCH_ALLOCATION_COUNTER_H
+
+#include <cstdint>
+
+//Global heap allocations made by the whole process so far.
+struct AllocationCount {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+/**
+ * @brief Reads the counters maintained by the benchmark's replacement `operator new`.
+ *
+ * Every form of the global `operator new` is replaced in the benchmark binary (only there) to count
+ * calls and bytes, so benchmarks can report heap allocations per operation and show that the arena
+ * backed extraction path does not reach the global allocator in steady state.
+ */
+AllocationCount allocationCount();
+
+#endif
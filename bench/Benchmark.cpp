@@ -0,0 +1,485 @@
+#include "AllocationCounter.h"
+#include "ContentHash.h"
+#include "Corpus.h"
+#include "Crc32.h"
+#include "DirectoryScanner.h"
+#include "MetadataArena.h"
+#include "TextReader.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <unistd.h>
+#include <poppler/cpp/poppler-document.h>
+#include <zlib.h>
+
+/**
+ * Benchmark driver behind `make bench`.
+ *
+ * Generates (or reuses) a synthetic corpus, then times type detection, every extractor, CustomMap
+ * operations and whole recursive scans with a cold and a warm page cache. Every result also reports
+ * the global heap allocations per operation (see AllocationCounter.h). Results are written as one
+ * JSON document so runs can be compared between releases.
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+//Result of one timed operation.
+struct BenchResult {
+    std::string name;
+    uint64_t operations = 0;
+    double seconds = 0;
+    uint64_t bytes = 0;     // bytes processed across all operations, when meaningful
+    uint64_t allocations = 0; // global heap allocations across all operations
+    uint64_t arenaBlocks = 0; // blocks taken by the scan workers' arenas (end-to-end runs only)
+};
+
+//Defeats dead-code elimination of benchmarked results.
+std::size_t sink = 0;
+
+/**
+ * @brief Runs `pass` (which performs `operationsPerPass` operations) until at least `minSeconds` have elapsed.
+ */
+template <typename Pass>
+BenchResult measure(std::string name, uint64_t operationsPerPass, uint64_t bytesPerPass, double minSeconds, Pass&& pass) {
+    BenchResult result{std::move(name)};
+    pass(); // warm-up
+    uint64_t allocationsBefore = allocationCount().allocations;
+    auto start = Clock::now();
+    do {
+        pass();
+        result.operations += operationsPerPass;
+        result.bytes += bytesPerPass;
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (result.seconds < minSeconds);
+    result.allocations = allocationCount().allocations - allocationsBefore;
+    return result;
+}
+
+/**
+ * @brief Best-effort eviction of the corpus from the page cache; returns the method that was used.
+ *
+ * Each file's clean pages are dropped with `posix_fadvise`. Only with `systemWide` is the whole page
+ * cache dropped through `/proc/sys/vm/drop_caches`, which needs root and slows every other process on
+ * the machine; the per-file method is the fallback when that write is refused.
+ */
+std::string dropPageCache(const CorpusInfo& corpus, bool systemWide) {
+    ::sync();
+    if (systemWide) {
+        int dropCaches = ::open("/proc/sys/vm/drop_caches", O_WRONLY | O_CLOEXEC);
+        if (dropCaches >= 0) {
+            bool dropped = ::write(dropCaches, "3", 1) == 1;
+            ::close(dropCaches);
+            if (dropped) {
+                return "drop_caches";
+            }
+        }
+    }
+    for (const auto& filePath : corpus.files) {
+        int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd);
+        }
+    }
+    return "fadvise";
+}
+
+BenchResult scanCorpus(const std::string& name, const std::filesystem::path& root, const CorpusInfo& corpus, std::size_t threads, IoBackend backend) {
+    ScanOptions options;
+    options.threadCount = threads;
+    options.ioBackend = backend;
+    std::atomic<std::size_t> fields{0};
+    DirectoryScanner scanner(
+        options,
+        [&](const std::filesystem::path&, FileType, const MetadataMap& metadata) {
+            fields.fetch_add(metadata.size(), std::memory_order_relaxed);
+        },
+        [](const std::filesystem::path& filePath, const std::string& message) {
+            std::cerr << filePath.string() << ": " << message << std::endl;
+        });
+
+    uint64_t allocationsBefore = allocationCount().allocations;
+    auto start = Clock::now();
+    ScanStats stats = scanner.scan(root);
+    BenchResult result{name, stats.filesAnalyzed, std::chrono::duration<double>(Clock::now() - start).count(), corpus.totalBytes,
+                       allocationCount().allocations - allocationsBefore, stats.arenaBlocks};
+    sink += fields;
+    return result;
+}
+
+//Times the `FileMetaDataAnalyzer<T>` specialization over every corpus file of the given type.
+template <typename T>
+void benchExtractor(std::vector<BenchResult>& results, const char* name, const std::vector<const FileContext*>& contexts, double minSeconds) {
+    if (contexts.empty()) {
+        return;
+    }
+    uint64_t bytes = 0;
+    for (const FileContext* context : contexts) {
+        bytes += context->size();
+    }
+    results.push_back(measure(std::string("analyzeMetadataHelper<") + name + ">", contexts.size(), bytes, minSeconds, [&] {
+        for (const FileContext* context : contexts) {
+            sink += FileMetaDataAnalyzer<T>::analyzeMetadata(*context).size();
+        }
+    }));
+}
+
+//Times the whole extraction of every file with its map on the global heap and in a reused arena.
+void benchAnalyzeFile(std::vector<BenchResult>& results, const std::vector<std::pair<const FileContext*, FileType>>& files, double minSeconds) {
+    uint64_t bytes = 0;
+    for (const auto& [context, fileType] : files) {
+        bytes += context->size();
+    }
+    results.push_back(measure("analyzeFileMetadata[heap]", files.size(), bytes, minSeconds, [&] {
+        for (const auto& [context, fileType] : files) {
+            sink += analyzeFileMetadata(*context, fileType, true, true).size();
+        }
+    }));
+
+    MetadataArena arena;
+    results.push_back(measure("analyzeFileMetadata[arena]", files.size(), bytes, minSeconds, [&] {
+        for (const auto& [context, fileType] : files) {
+            sink += analyzeFileMetadata(*context, fileType, true, true, &arena).size();
+            arena.reset();
+        }
+    }));
+}
+
+//Times the CRC-32 used by integrity checks against plain zlib, and PNG verification over the corpus.
+void benchCrc32(std::vector<BenchResult>& results, const std::vector<const FileContext*>& pngs, double minSeconds) {
+    std::vector<uint8_t> buffer(4 * 1024 * 1024);
+    for (std::size_t i = 0; i < buffer.size(); ++i) {
+        buffer[i] = static_cast<uint8_t>(i * 2654435761u >> 24);
+    }
+    results.push_back(measure(std::string("updateCrc32[") + crc32Implementation() + "]", 1, buffer.size(), minSeconds, [&] {
+        sink += updateCrc32(0, buffer);
+    }));
+    results.push_back(measure("crc32[zlib]", 1, buffer.size(), minSeconds, [&] {
+        sink += ::crc32_z(0, buffer.data(), buffer.size());
+    }));
+
+    if (pngs.empty()) {
+        return;
+    }
+    uint64_t bytes = 0;
+    for (const FileContext* context : pngs) {
+        bytes += context->size();
+    }
+    results.push_back(measure("verifyFileIntegrity<PNG>", pngs.size(), bytes, minSeconds, [&] {
+        for (const FileContext* context : pngs) {
+            sink += verifyFileIntegrity(*context, FileType::PNG).size();
+        }
+    }));
+}
+
+void benchContentHash(std::vector<BenchResult>& results, const std::vector<const FileContext*>& all, double minSeconds) {
+    std::vector<uint8_t> buffer(4 * 1024 * 1024);
+    for (std::size_t i = 0; i < buffer.size(); ++i) {
+        buffer[i] = static_cast<uint8_t>(i * 2654435761u >> 24);
+    }
+    results.push_back(measure(std::string("contentHash[") + contentHashImplementation() + "]", 1, buffer.size(), minSeconds, [&] {
+        sink += contentHash(buffer);
+    }));
+
+    uint64_t bytes = 0;
+    for (const FileContext* context : all) {
+        bytes += context->size();
+    }
+    results.push_back(measure("hashFileContents", all.size(), bytes, minSeconds, [&] {
+        for (const FileContext* context : all) {
+            sink += hashFileContents(*context).value_or(0);
+        }
+    }));
+    results.push_back(measure("DuplicateFinder", all.size(), 0, minSeconds, [&] {
+        DuplicateFinder finder;
+        for (const FileContext* context : all) {
+            finder.add(context->path(), context->status());
+        }
+        sink += finder.findDuplicates(0, [](const std::filesystem::path&, const std::string&) {}).size();
+    }));
+}
+
+//Times the text counters on log-like lines, and the TXT files of the corpus through `readTextFile`.
+void benchTextReader(std::vector<BenchResult>& results, const std::vector<const FileContext*>& texts, double minSeconds) {
+    std::string text;
+    for (std::size_t i = 0; text.size() < 4 * 1024 * 1024; ++i) {
+        text += "2024-01-31T12:00:00Z worker-" + std::to_string(i % 16) + " handled request " + std::to_string(i * 7919) + " in 3 ms\n";
+    }
+    std::span<const uint8_t> buffer(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+    results.push_back(measure(std::string("TextReader[") + textReaderImplementation() + "]", 1, buffer.size(), minSeconds, [&] {
+        TextReader reader(2, FileContext::DefaultPrefixSize);
+        reader.update(buffer);
+        sink += reader.finish().counts.words;
+    }));
+
+    if (texts.empty()) {
+        return;
+    }
+    uint64_t bytes = 0;
+    for (const FileContext* context : texts) {
+        bytes += context->size();
+    }
+    results.push_back(measure("readTextFile", texts.size(), bytes, minSeconds, [&] {
+        for (const FileContext* context : texts) {
+            sink += readTextFile(*context, 2).lines;
+        }
+    }));
+}
+
+void benchCustomMap(std::vector<BenchResult>& results, double minSeconds) {
+    constexpr std::size_t Keys = 64;
+    std::vector<std::string> keys;
+    std::vector<std::string> missing;
+    for (std::size_t i = 0; i < Keys; ++i) {
+        keys.push_back("Key" + std::to_string(i));
+        missing.push_back("Missing" + std::to_string(i));
+    }
+
+    for (std::size_t size : {std::size_t(8), Keys}) {
+        std::string suffix = "/" + std::to_string(size);
+        results.push_back(measure("CustomMap.insert" + suffix, size, 0, minSeconds, [&] {
+            CustomMap<std::string, std::string> map;
+            for (std::size_t i = 0; i < size; ++i) {
+                map[keys[i]] = keys[i];
+            }
+            sink += map.size();
+        }));
+
+        CustomMap<std::string, std::string> map;
+        for (std::size_t i = 0; i < size; ++i) {
+            map[keys[i]] = keys[i];
+        }
+        results.push_back(measure("CustomMap.findHit" + suffix, size, 0, minSeconds, [&] {
+            for (std::size_t i = 0; i < size; ++i) {
+                sink += map.find(keys[i]) != map.end();
+            }
+        }));
+        results.push_back(measure("CustomMap.findMiss" + suffix, size, 0, minSeconds, [&] {
+            for (std::size_t i = 0; i < size; ++i) {
+                sink += map.find(missing[i]) != map.end();
+            }
+        }));
+        results.push_back(measure("CustomMap.iterate" + suffix, size, 0, minSeconds, [&] {
+            for (const auto& [key, value] : map) {
+                sink += value.size();
+            }
+        }));
+        results.push_back(measure("CustomMap.copy" + suffix, 1, 0, minSeconds, [&] {
+            CustomMap<std::string, std::string> copy = map;
+            sink += copy.size();
+        }));
+
+        // What the extractors do: interned keys and integer values, no string conversions
+        std::vector<MetadataKey> interned(keys.begin(), keys.begin() + static_cast<std::ptrdiff_t>(size));
+        results.push_back(measure("MetadataMap.insert" + suffix, size, 0, minSeconds, [&] {
+            MetadataMap metadata;
+            for (std::size_t i = 0; i < size; ++i) {
+                metadata[interned[i]] = i;
+            }
+            sink += metadata.size();
+        }));
+    }
+}
+
+std::string jsonString(std::string_view text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+        }
+        out.push_back(c);
+    }
+    return out + "\"";
+}
+
+void writeResults(std::ostream& out, const std::vector<BenchResult>& results) {
+    out << "[";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& result = results[i];
+        out << (i ? ",\n    " : "\n    ") << "{\"name\": " << jsonString(result.name)
+            << ", \"operations\": " << result.operations
+            << ", \"seconds\": " << result.seconds
+            << ", \"nsPerOp\": " << result.seconds * 1e9 / static_cast<double>(result.operations)
+            << ", \"opsPerSec\": " << static_cast<double>(result.operations) / result.seconds;
+        if (result.bytes) {
+            out << ", \"mbPerSec\": " << static_cast<double>(result.bytes) / 1e6 / result.seconds;
+        }
+        out << ", \"allocationsPerOp\": " << static_cast<double>(result.allocations) / static_cast<double>(result.operations);
+        if (result.arenaBlocks) {
+            out << ", \"arenaBlocks\": " << result.arenaBlocks;
+        }
+        out << "}";
+    }
+    out << "\n  ]";
+}
+
+//Adds one batch's results to the totals, matching them by name; results new to the totals are appended.
+void accumulate(std::vector<BenchResult>& totals, std::vector<BenchResult>&& batch) {
+    for (BenchResult& result : batch) {
+        auto total = std::find_if(totals.begin(), totals.end(), [&](const BenchResult& r) { return r.name == result.name; });
+        if (total == totals.end()) {
+            totals.push_back(std::move(result));
+            continue;
+        }
+        total->operations += result.operations;
+        total->seconds += result.seconds;
+        total->bytes += result.bytes;
+        total->allocations += result.allocations;
+    }
+}
+
+/**
+ * @brief Times the extractors and the other per-file stages over the corpus.
+ *
+ * Files are opened in batches of at most `defaultMaxOpenFiles()`, so a corpus larger than the descriptor
+ * limit can still be measured; each batch gets its share of `minSeconds` and the batches' results are summed.
+ */
+void benchFiles(std::vector<BenchResult>& micro, const CorpusInfo& corpus, double minSeconds) {
+    std::size_t batchSize = defaultMaxOpenFiles();
+    std::size_t batches = std::max<std::size_t>((corpus.files.size() + batchSize - 1) / batchSize, 1);
+    double batchSeconds = minSeconds / static_cast<double>(batches);
+
+    for (std::size_t begin = 0; begin < corpus.files.size(); begin += batchSize) {
+        std::size_t end = std::min(begin + batchSize, corpus.files.size());
+        std::vector<std::unique_ptr<FileContext>> contexts;
+        std::map<FileType, std::vector<const FileContext*>> byType;
+        std::vector<const FileContext*> all;
+        std::vector<std::pair<const FileContext*, FileType>> typed;
+        for (std::size_t i = begin; i < end; ++i) {
+            contexts.push_back(std::make_unique<FileContext>(corpus.files[i]));
+            FileType fileType = determineFileType<poppler::document, std::ifstream, JPEGHeader, PNGHeader, BMPHeader, ZIPHeader, WAVHeader, GIFHeader>(*contexts.back());
+            byType[fileType].push_back(contexts.back().get());
+            all.push_back(contexts.back().get());
+            typed.emplace_back(contexts.back().get(), fileType);
+        }
+
+        std::vector<BenchResult> batch;
+        batch.push_back(measure("determineFileType", all.size(), 0, batchSeconds, [&] {
+            for (const FileContext* context : all) {
+                sink += static_cast<std::size_t>(determineFileType<poppler::document, std::ifstream, JPEGHeader, PNGHeader, BMPHeader, ZIPHeader, WAVHeader, GIFHeader>(*context));
+            }
+        }));
+        benchExtractor<BasicMetadata>(batch, "BasicMetadata", all, batchSeconds);
+        benchExtractor<poppler::document>(batch, "poppler::document", byType[FileType::PDF], batchSeconds);
+        benchExtractor<std::ifstream>(batch, "std::ifstream", byType[FileType::TXT], batchSeconds);
+        benchExtractor<JPEGHeader>(batch, "JPEGHeader", byType[FileType::JPEG], batchSeconds);
+        benchExtractor<PNGHeader>(batch, "PNGHeader", byType[FileType::PNG], batchSeconds);
+        benchExtractor<BMPHeader>(batch, "BMPHeader", byType[FileType::BMP], batchSeconds);
+        benchExtractor<ZIPHeader>(batch, "ZIPHeader", byType[FileType::ZIP], batchSeconds);
+        benchExtractor<WAVHeader>(batch, "WAVHeader", byType[FileType::WAV], batchSeconds);
+        benchExtractor<GIFHeader>(batch, "GIFHeader", byType[FileType::GIF], batchSeconds);
+        benchExtractor<LogicalScreenDescriptor>(batch, "LogicalScreenDescriptor", byType[FileType::GIF], batchSeconds);
+        benchAnalyzeFile(batch, typed, batchSeconds);
+        benchCrc32(batch, byType[FileType::PNG], batchSeconds);
+        benchContentHash(batch, all, batchSeconds);
+        benchTextReader(batch, byType[FileType::TXT], batchSeconds);
+        accumulate(micro, std::move(batch));
+    }
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--corpus <dir>] [--files N] [--mix jpeg=1,png=1,...] [--seed N]"
+              << " [--threads N] [--min-time seconds] [--drop-caches] [--output <file>]" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::filesystem::path corpusPath = "build/bench-corpus";
+    std::string outputPath;
+    CorpusSpec spec;
+    spec.mix = parseCorpusMix("jpeg=1,png=1,bmp=1,gif=1,wav=1,zip=1,pdf=1,txt=1");
+    std::size_t threads = 0;
+    double minSeconds = 0.2;
+    bool dropCaches = false;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--corpus" && i + 1 < argc) {
+                corpusPath = argv[++i];
+            } else if (arg == "--files" && i + 1 < argc) {
+                spec.fileCount = std::stoul(argv[++i]);
+            } else if (arg == "--mix" && i + 1 < argc) {
+                spec.mix = parseCorpusMix(argv[++i]);
+            } else if (arg == "--seed" && i + 1 < argc) {
+                spec.seed = std::stoull(argv[++i]);
+            } else if (arg == "--threads" && i + 1 < argc) {
+                threads = std::stoul(argv[++i]);
+            } else if (arg == "--min-time" && i + 1 < argc) {
+                minSeconds = std::stod(argv[++i]);
+            } else if (arg == "--drop-caches") {
+                dropCaches = true;
+            } else if (arg == "--output" && i + 1 < argc) {
+                outputPath = argv[++i];
+            } else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    try {
+        CorpusInfo corpus = generateCorpus(corpusPath, spec);
+        std::cerr << "Corpus: " << corpus.files.size() << " files, " << corpus.totalBytes << " bytes in " << corpusPath.string() << std::endl;
+
+        std::vector<BenchResult> micro;
+        micro.push_back(measure("FileContext", corpus.files.size(), corpus.totalBytes, minSeconds, [&] {
+            for (const auto& filePath : corpus.files) {
+                sink += FileContext(filePath).prefix().size();
+            }
+        }));
+        benchFiles(micro, corpus, minSeconds);
+        benchCustomMap(micro, minSeconds);
+
+        std::vector<BenchResult> endToEnd;
+        std::string coldMethod;
+        for (IoBackend backend : {IoBackend::Blocking, IoBackend::Threads, IoBackend::Uring}) {
+            std::string prefix = std::string("scan.") + ioBackendName(backend);
+            try {
+                coldMethod = dropPageCache(corpus, dropCaches);
+                endToEnd.push_back(scanCorpus(prefix + ".cold", corpusPath, corpus, threads, backend));
+                endToEnd.push_back(scanCorpus(prefix + ".warm", corpusPath, corpus, threads, backend));
+            } catch (const std::exception& e) {
+                // io_uring may be unavailable on this kernel
+                std::cerr << prefix << ": " << e.what() << std::endl;
+            }
+        }
+
+        std::ostringstream json;
+        json << "{\n  \"analyzerVersion\": " << MetadataAnalyzerVersion
+             << ",\n  \"timestamp\": " << std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count()
+             << ",\n  \"corpus\": {\"files\": " << corpus.files.size() << ", \"bytes\": " << corpus.totalBytes
+             << ", \"mix\": " << jsonString(formatCorpusMix(spec.mix)) << ", \"seed\": " << spec.seed << "}"
+             << ",\n  \"threads\": " << (threads ? threads : std::thread::hardware_concurrency())
+             << ",\n  \"coldCacheMethod\": " << jsonString(coldMethod)
+             << ",\n  \"checksum\": " << sink
+             << ",\n  \"micro\": ";
+        writeResults(json, micro);
+        json << ",\n  \"endToEnd\": ";
+        writeResults(json, endToEnd);
+        json << "\n}\n";
+
+        if (outputPath.empty()) {
+            std::cout << json.str();
+        } else {
+            std::ofstream(outputPath) << json.str();
+            std::cerr << "Results written to " << outputPath << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,590 @@
+#include "Corpus.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace {
+
+constexpr FileType CorpusTypes[] = {
+    FileType::JPEG, FileType::PNG, FileType::BMP, FileType::GIF,
+    FileType::WAV, FileType::ZIP, FileType::PDF, FileType::TXT,
+};
+
+constexpr std::string_view Words[] = {
+    "metadata", "file", "analyzer", "header", "signature", "archive", "image", "sample",
+    "stream", "index", "version", "format", "scan", "record", "value", "key",
+};
+
+std::string lowerName(FileType fileType) {
+    std::string name = fileTypeName(fileType);
+    for (char& c : name) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return name;
+}
+
+const char* extensionFor(FileType fileType) {
+    switch (fileType) {
+        case FileType::JPEG: return ".jpg";
+        case FileType::PNG:  return ".png";
+        case FileType::BMP:  return ".bmp";
+        case FileType::GIF:  return ".gif";
+        case FileType::WAV:  return ".wav";
+        case FileType::ZIP:  return ".zip";
+        case FileType::PDF:  return ".pdf";
+        default:             return ".txt";
+    }
+}
+
+//Little helpers for building files byte by byte.
+class Builder {
+public:
+    explicit Builder(std::mt19937_64& random) : random(random) {}
+
+    void u8(uint32_t value) {
+        data.push_back(static_cast<char>(value));
+    }
+    void u16le(uint32_t value) {
+        u8(value);
+        u8(value >> 8);
+    }
+    void u16be(uint32_t value) {
+        u8(value >> 8);
+        u8(value);
+    }
+    void u32le(uint32_t value) {
+        u16le(value);
+        u16le(value >> 16);
+    }
+    void u32be(uint32_t value) {
+        u16be(value >> 16);
+        u16be(value);
+    }
+    void text(std::string_view value) {
+        data.append(value);
+    }
+    void noise(std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            u8(static_cast<uint32_t>(random()));
+        }
+    }
+    std::string words(std::size_t count) {
+        std::string out;
+        for (std::size_t i = 0; i < count; ++i) {
+            if (i) {
+                out.push_back(' ');
+            }
+            out.append(Words[random() % std::size(Words)]);
+        }
+        return out;
+    }
+    uint32_t between(uint32_t low, uint32_t high) {
+        return low + static_cast<uint32_t>(random() % (high - low + 1));
+    }
+
+    std::string data;
+    std::mt19937_64& random;
+};
+
+uint32_t crcOf(std::string_view bytes) {
+    return static_cast<uint32_t>(::crc32(0, reinterpret_cast<const Bytef*>(bytes.data()), static_cast<uInt>(bytes.size())));
+}
+
+void pngChunk(Builder& out, std::string_view type, std::string_view payload) {
+    out.u32be(static_cast<uint32_t>(payload.size()));
+    std::string body = std::string(type) + std::string(payload);
+    out.text(body);
+    out.u32be(crcOf(body));
+}
+
+//A big-endian TIFF block with a camera make, an orientation and the original time in an Exif IFD.
+std::string makeExif(std::mt19937_64& random) {
+    Builder tiff(random);
+    std::string make = std::string(Words[random() % std::size(Words)]) + '\0';
+    make.resize((make.size() + 1) & ~std::size_t{1});
+    char original[20];
+    std::snprintf(original, sizeof(original), "%04u:%02u:%02u %02u:%02u:%02u", tiff.between(2000, 2024), tiff.between(1, 12),
+                  tiff.between(1, 28), tiff.between(0, 23), tiff.between(0, 59), tiff.between(0, 59));
+    uint32_t makeOffset = 8 + 2 + 3 * 12 + 4;
+    uint32_t exifOffset = makeOffset + static_cast<uint32_t>(make.size());
+
+    tiff.text("MM");
+    tiff.u16be(42);
+    tiff.u32be(8);
+    tiff.u16be(3);                       // IFD0
+    tiff.u16be(0x010F);                  // Make
+    tiff.u16be(2);
+    tiff.u32be(static_cast<uint32_t>(make.size()));
+    tiff.u32be(makeOffset);
+    tiff.u16be(0x0112);                  // Orientation
+    tiff.u16be(3);
+    tiff.u32be(1);
+    tiff.u16be(tiff.between(1, 8));
+    tiff.u16be(0);
+    tiff.u16be(0x8769);                  // Exif IFD pointer
+    tiff.u16be(4);
+    tiff.u32be(1);
+    tiff.u32be(exifOffset);
+    tiff.u32be(0);
+    tiff.text(make);
+    tiff.u16be(1);                       // Exif IFD
+    tiff.u16be(0x9003);                  // DateTimeOriginal
+    tiff.u16be(2);
+    tiff.u32be(sizeof(original));
+    tiff.u32be(exifOffset + 2 + 12 + 4);
+    tiff.u32be(0);
+    tiff.text(std::string_view(original, sizeof(original)));
+    return std::move(tiff.data);
+}
+
+std::string makeJpeg(Builder& out) {
+    out.u16be(0xFFD8);
+    out.u16be(0xFFE0);                   // APP0 JFIF
+    out.u16be(16);
+    out.text(std::string_view("JFIF\0", 5));
+    out.u16be(0x0101);
+    out.u8(1);
+    out.u16be(out.between(72, 300));
+    out.u16be(out.between(72, 300));
+    out.u8(0);
+    out.u8(0);
+
+    std::string exif = makeExif(out.random);
+    out.u16be(0xFFE1);                   // APP1 EXIF
+    out.u16be(static_cast<uint32_t>(exif.size() + 8));
+    out.text(std::string_view("Exif\0\0", 6));
+    out.text(exif);
+
+    std::size_t comment = out.between(64, 16384);
+    out.u16be(0xFFFE);                   // COM carrying the random payload
+    out.u16be(static_cast<uint32_t>(comment + 2));
+    out.noise(comment);
+
+    out.u16be(0xFFC0);                   // SOF0, three components
+    out.u16be(17);
+    out.u8(8);
+    out.u16be(out.between(16, 4000));
+    out.u16be(out.between(16, 6000));
+    out.u8(3);
+    for (uint32_t component = 1; component <= 3; ++component) {
+        out.u8(component);
+        out.u8(0x11);
+        out.u8(0);
+    }
+    out.u16be(0xFFDA);                   // SOS, then entropy-coded data the extractor never reads
+    out.u16be(12);
+    out.u8(3);
+    for (uint32_t component = 1; component <= 3; ++component) {
+        out.u8(component);
+        out.u8(0);
+    }
+    out.u8(0);
+    out.u8(63);
+    out.u8(0);
+    out.noise(out.between(1024, 65536));
+    out.u16be(0xFFD9);
+    return std::move(out.data);
+}
+
+std::string makePng(Builder& out) {
+    out.text("\x89PNG\r\n\x1a\n");
+    Builder header(out.random);
+    header.u32be(out.between(1, 8000));
+    header.u32be(out.between(1, 8000));
+    header.u8(8);
+    header.u8(6);
+    header.u8(0);
+    header.u8(0);
+    header.u8(0);
+    pngChunk(out, "IHDR", header.data);
+
+    Builder text(out.random);
+    text.text("Comment");
+    text.u8(0);
+    text.text(out.words(out.between(2, 20)));
+    pngChunk(out, "tEXt", text.data);
+
+    Builder density(out.random);
+    uint32_t pixelsPerMeter = out.between(2835, 11811);
+    density.u32be(pixelsPerMeter);
+    density.u32be(pixelsPerMeter);
+    density.u8(1);
+    pngChunk(out, "pHYs", density.data);
+
+    Builder time(out.random);
+    time.u16be(out.between(1996, 2024));
+    time.u8(out.between(1, 12));
+    time.u8(out.between(1, 28));
+    time.u8(out.between(0, 23));
+    time.u8(out.between(0, 59));
+    time.u8(out.between(0, 59));
+    pngChunk(out, "tIME", time.data);
+
+    Builder pixels(out.random);
+    pixels.noise(out.between(256, 32768));
+    pngChunk(out, "IDAT", pixels.data);
+    pngChunk(out, "IEND", "");
+    return std::move(out.data);
+}
+
+std::string makeBmp(Builder& out) {
+    uint32_t width = out.between(1, 200);
+    uint32_t height = out.between(1, 200);
+    uint32_t rowSize = (width * 3 + 3) & ~3u;
+    uint32_t imageSize = rowSize * height;
+
+    out.text("BM");
+    out.u32le(54 + imageSize);
+    out.u32le(0);
+    out.u32le(54);
+    out.u32le(40);
+    out.u32le(width);
+    out.u32le(height);
+    out.u16le(1);
+    out.u16le(24);
+    out.u32le(0);
+    out.u32le(imageSize);
+    out.u32le(2835);
+    out.u32le(2835);
+    out.u32le(0);
+    out.u32le(0);
+    out.noise(imageSize);
+    return std::move(out.data);
+}
+
+std::string makeGif(Builder& out) {
+    uint32_t width = out.between(1, 2000);
+    uint32_t height = out.between(1, 2000);
+    out.text("GIF89a");
+    out.u16le(width);
+    out.u16le(height);
+    out.u8(0xF0);                        // global color table of 2 entries
+    out.u8(0);
+    out.u8(0);
+    out.noise(6);
+
+    for (uint32_t comments = out.between(0, 8); comments > 0; --comments) {
+        out.u8(0x21);
+        out.u8(0xFE);
+        std::string text = out.words(out.between(1, 40)).substr(0, 255);
+        out.u8(static_cast<uint32_t>(text.size()));
+        out.text(text);
+        out.u8(0);
+    }
+
+    out.text(std::string_view("\x21\xFF\x0BNETSCAPE2.0\x03\x01", 16)); // loop count
+    out.u16le(out.between(0, 3));
+    out.u8(0);
+
+    for (uint32_t frames = out.between(1, 24); frames > 0; --frames) {
+        out.text(std::string_view("\x21\xF9\x04\x04", 4)); // graphic control: delay
+        out.u16le(out.between(2, 50));
+        out.u8(0);
+        out.u8(0);
+
+        out.u8(0x2C);                    // full-screen frame with random "LZW" sub-blocks
+        out.u16le(0);
+        out.u16le(0);
+        out.u16le(width);
+        out.u16le(height);
+        out.u8(0);
+        out.u8(2);
+        for (std::size_t remaining = out.between(64, 16384); remaining > 0;) {
+            std::size_t length = std::min<std::size_t>(remaining, 255);
+            out.u8(static_cast<uint32_t>(length));
+            out.noise(length);
+            remaining -= length;
+        }
+        out.u8(0);
+    }
+    out.u8(0x3B);
+    return std::move(out.data);
+}
+
+//A RIFF chunk: id, little-endian size, body and a pad byte for odd sizes.
+std::string riffChunk(Builder& out, std::string_view id, std::string_view payload) {
+    Builder chunk(out.random);
+    chunk.text(id);
+    chunk.u32le(static_cast<uint32_t>(payload.size()));
+    chunk.text(payload);
+    if (payload.size() & 1) {
+        chunk.u8(0);
+    }
+    return std::move(chunk.data);
+}
+
+std::string makeWav(Builder& out) {
+    uint32_t channels = out.between(1, 2);
+    uint32_t sampleRate = out.between(0, 1) ? 44100 : 48000;
+    uint32_t dataSize = out.between(1, 16384) * 2 * channels;
+
+    Builder format(out.random);
+    format.u16le(1);
+    format.u16le(channels);
+    format.u32le(sampleRate);
+    format.u32le(sampleRate * channels * 2);
+    format.u16le(channels * 2);
+    format.u16le(16);
+
+    Builder data(out.random);
+    data.noise(dataSize);
+
+    Builder info(out.random);
+    info.text("INFO");
+    info.text(riffChunk(out, "INAM", out.words(out.between(1, 6)) + '\0'));
+    info.text(riffChunk(out, "IART", out.words(out.between(1, 3)) + '\0'));
+    info.text(riffChunk(out, "ISFT", "corpus\0"));
+
+    // JUNK before fmt and LIST after data, so the chunks are not at the canonical offsets
+    std::string body = "WAVE";
+    body += riffChunk(out, "JUNK", std::string(out.between(0, 1) ? 28 : 0, '\0'));
+    body += riffChunk(out, "fmt ", format.data);
+    body += riffChunk(out, "data", data.data);
+    body += riffChunk(out, "LIST", info.data);
+
+    out.text("RIFF");
+    out.u32le(static_cast<uint32_t>(body.size()));
+    out.text(body);
+    return std::move(out.data);
+}
+
+std::string makeZip(Builder& out) {
+    struct Entry {
+        std::string name;
+        uint32_t crc;
+        uint32_t size;
+        uint32_t offset;
+    };
+    std::vector<Entry> entries;
+
+    for (uint32_t count = out.between(1, 32), i = 0; i < count; ++i) {
+        std::string name = "entry" + std::to_string(i) + ".txt";
+        std::string content = out.words(out.between(1, 400));
+        Entry entry{name, crcOf(content), static_cast<uint32_t>(content.size()), static_cast<uint32_t>(out.data.size())};
+
+        out.u32le(0x04034b50);           // local file header, stored
+        out.u16le(10);
+        out.u16le(0);
+        out.u16le(0);
+        out.u16le(0x6000);
+        out.u16le(0x5821);
+        out.u32le(entry.crc);
+        out.u32le(entry.size);
+        out.u32le(entry.size);
+        out.u16le(static_cast<uint32_t>(name.size()));
+        out.u16le(0);
+        out.text(name);
+        out.text(content);
+        entries.push_back(std::move(entry));
+    }
+
+    uint32_t directoryOffset = static_cast<uint32_t>(out.data.size());
+    for (const Entry& entry : entries) {
+        out.u32le(0x02014b50);
+        out.u16le(0x031E);
+        out.u16le(10);
+        out.u16le(0);
+        out.u16le(0);
+        out.u16le(0x6000);
+        out.u16le(0x5821);
+        out.u32le(entry.crc);
+        out.u32le(entry.size);
+        out.u32le(entry.size);
+        out.u16le(static_cast<uint32_t>(entry.name.size()));
+        out.u16le(0);
+        out.u16le(0);
+        out.u16le(0);
+        out.u16le(0);
+        out.u32le(0);
+        out.u32le(entry.offset);
+        out.text(entry.name);
+    }
+    uint32_t directorySize = static_cast<uint32_t>(out.data.size()) - directoryOffset;
+
+    out.u32le(0x06054b50);
+    out.u16le(0);
+    out.u16le(0);
+    out.u16le(static_cast<uint32_t>(entries.size()));
+    out.u16le(static_cast<uint32_t>(entries.size()));
+    out.u32le(directorySize);
+    out.u32le(directoryOffset);
+    out.u16le(0);
+    return std::move(out.data);
+}
+
+std::string makePdf(Builder& out) {
+    std::vector<std::size_t> offsets;
+    auto object = [&](const std::string& body) {
+        offsets.push_back(out.data.size());
+        out.text(std::to_string(offsets.size()) + " 0 obj\n" + body + "\nendobj\n");
+    };
+
+    std::string payload = out.words(out.between(10, 2000));
+    out.text("%PDF-1.4\n");
+    object("<< /Type /Catalog /Pages 2 0 R >>");
+    object("<< /Type /Pages /Kids [] /Count 0 >>");
+    object("<< /Title (" + out.words(out.between(1, 6)) + ") /Author (" + out.words(2) +
+           ") /Producer (corpus generator) /CreationDate (D:20240102030405Z) >>");
+    object("<< /Length " + std::to_string(payload.size()) + " >>\nstream\n" + payload + "\nendstream");
+
+    std::size_t xref = out.data.size();
+    out.text("xref\n0 " + std::to_string(offsets.size() + 1) + "\n0000000000 65535 f \n");
+    for (std::size_t offset : offsets) {
+        char line[21];
+        std::snprintf(line, sizeof(line), "%010zu 00000 n \n", offset);
+        out.text(line);
+    }
+    out.text("trailer\n<< /Size " + std::to_string(offsets.size() + 1) + " /Root 1 0 R /Info 3 0 R >>\nstartxref\n" +
+             std::to_string(xref) + "\n%%EOF\n");
+    return std::move(out.data);
+}
+
+std::string makeTxt(Builder& out) {
+    out.text(out.words(out.between(1, 8)) + "\n");
+    out.text(out.words(2) + "\n");
+    for (uint32_t lines = out.between(1, 400); lines > 0; --lines) {
+        out.text(out.words(out.between(1, 16)) + "\n");
+    }
+    return std::move(out.data);
+}
+
+std::string makeFile(FileType fileType, std::mt19937_64& random) {
+    Builder out(random);
+    switch (fileType) {
+        case FileType::JPEG: return makeJpeg(out);
+        case FileType::PNG:  return makePng(out);
+        case FileType::BMP:  return makeBmp(out);
+        case FileType::GIF:  return makeGif(out);
+        case FileType::WAV:  return makeWav(out);
+        case FileType::ZIP:  return makeZip(out);
+        case FileType::PDF:  return makePdf(out);
+        default:             return makeTxt(out);
+    }
+}
+
+std::string stampFor(const CorpusSpec& spec) {
+    std::ostringstream stamp;
+    stamp << "files=" << spec.fileCount << " mix=" << formatCorpusMix(spec.mix) << " seed=" << spec.seed
+          << " perDirectory=" << spec.filesPerDirectory << " version=" << MetadataAnalyzerVersion << '\n';
+    return stamp.str();
+}
+
+void collectCorpus(const std::filesystem::path& directory, CorpusInfo& info) {
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(directory)) {
+        if (entry.is_regular_file()) {
+            info.files.push_back(entry.path());
+            info.totalBytes += entry.file_size();
+        }
+    }
+    std::sort(info.files.begin(), info.files.end());
+}
+
+}
+
+std::vector<CorpusShare> parseCorpusMix(std::string_view mix) {
+    std::vector<CorpusShare> shares;
+    while (!mix.empty()) {
+        std::string_view item = mix.substr(0, mix.find(','));
+        mix.remove_prefix(std::min(mix.size(), item.size() + 1));
+
+        std::size_t equals = item.find('=');
+        std::string_view name = item.substr(0, equals);
+        unsigned weight = 1;
+        if (equals != std::string_view::npos) {
+            try {
+                weight = static_cast<unsigned>(std::stoul(std::string(item.substr(equals + 1))));
+            } catch (const std::exception&) {
+                throw std::invalid_argument("Bad corpus mix entry: " + std::string(item));
+            }
+        }
+
+        auto type = std::find_if(std::begin(CorpusTypes), std::end(CorpusTypes),
+                                 [&](FileType fileType) { return lowerName(fileType) == name; });
+        if (type == std::end(CorpusTypes)) {
+            throw std::invalid_argument("Unknown corpus format: " + std::string(name));
+        }
+        if (weight > 0) {
+            shares.push_back({*type, weight});
+        }
+    }
+    if (shares.empty()) {
+        throw std::invalid_argument("Corpus mix selects no format");
+    }
+    return shares;
+}
+
+std::string formatCorpusMix(const std::vector<CorpusShare>& mix) {
+    std::string text;
+    for (const CorpusShare& share : mix) {
+        if (!text.empty()) {
+            text.push_back(',');
+        }
+        text += lowerName(share.fileType) + "=" + std::to_string(share.weight);
+    }
+    return text;
+}
+
+CorpusInfo generateCorpus(const std::filesystem::path& directory, const CorpusSpec& spec) {
+    CorpusInfo info;
+    std::string stamp = stampFor(spec);
+    // The stamp lives next to the corpus so that scanning the corpus never sees it
+    std::filesystem::path stampPath = directory.lexically_normal();
+    if (!stampPath.has_filename()) {
+        stampPath = stampPath.parent_path();
+    }
+    stampPath += ".stamp";
+
+    if (std::filesystem::exists(directory)) {
+        std::ifstream existing(stampPath);
+        std::string previous((std::istreambuf_iterator<char>(existing)), std::istreambuf_iterator<char>());
+        if (previous == stamp) {
+            collectCorpus(directory, info);
+            return info;
+        }
+        if (!existing.is_open() && !std::filesystem::is_empty(directory)) {
+            throw std::runtime_error(directory.string() + " is not empty and is not a generated corpus");
+        }
+        std::filesystem::remove_all(directory);
+    }
+
+    unsigned totalWeight = 0;
+    for (const CorpusShare& share : spec.mix) {
+        totalWeight += share.weight;
+    }
+
+    std::mt19937_64 random(spec.seed);
+    for (std::size_t i = 0; i < spec.fileCount; ++i) {
+        // Weighted pick of the format for this file
+        unsigned pick = static_cast<unsigned>(random() % totalWeight);
+        FileType fileType = spec.mix.back().fileType;
+        for (const CorpusShare& share : spec.mix) {
+            if (pick < share.weight) {
+                fileType = share.fileType;
+                break;
+            }
+            pick -= share.weight;
+        }
+
+        std::filesystem::path subdirectory = directory / ("d" + std::to_string(i / spec.filesPerDirectory));
+        std::filesystem::create_directories(subdirectory);
+        std::filesystem::path filePath = subdirectory / ("f" + std::to_string(i) + extensionFor(fileType));
+
+        std::string content = makeFile(fileType, random);
+        std::ofstream file(filePath, std::ios::binary);
+        file.write(content.data(), static_cast<std::streamsize>(content.size()));
+        if (!file) {
+            throw std::runtime_error("Failed to write " + filePath.string());
+        }
+        info.files.push_back(filePath);
+        info.totalBytes += content.size();
+    }
+
+    std::ofstream(stampPath) << stamp;
+    std::sort(info.files.begin(), info.files.end());
+    return info;
+}
@@ -0,0 +1,53 @@
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "FileMetaDataAnalyzer.h"
+
+//Relative weight of one format in a generated corpus.
+struct CorpusShare {
+    FileType fileType;
+    unsigned weight;
+};
+
+//What to generate: `fileCount` files drawn from `mix`, spread over subdirectories of `filesPerDirectory`.
+struct CorpusSpec {
+    std::size_t fileCount = 2000;
+    std::vector<CorpusShare> mix;
+    uint64_t seed = 1;
+    std::size_t filesPerDirectory = 256;
+};
+
+//Summary of a generated (or reused) corpus.
+struct CorpusInfo {
+    std::vector<std::filesystem::path> files;
+    uint64_t totalBytes = 0;
+};
+
+/**
+ * @brief Parses a `--mix` list such as "jpeg=2,png=1,pdf=1". Formats left out get no files.
+ *
+ * @throws std::invalid_argument On an unknown format name or a malformed entry.
+ */
+std::vector<CorpusShare> parseCorpusMix(std::string_view mix);
+
+//Formats a mix back into the "name=weight,..." form.
+std::string formatCorpusMix(const std::vector<CorpusShare>& mix);
+
+/**
+ * @brief Generates a deterministic synthetic corpus of small but well-formed files.
+ *
+ * Every file carries the structures the extractors read (JFIF APP0 and SOF0, PNG IHDR with valid CRCs,
+ * BMP info header, GIF screen descriptor and image data, WAV fmt/data, ZIP central directory, PDF xref
+ * and Info dictionary, TXT title and author lines), with randomized dimensions and payload sizes.
+ * A `<directory>.stamp` file records the spec, so a corpus generated with the same spec is reused as is.
+ *
+ * @throws std::runtime_error If `directory` is non-empty and was not generated by this function.
+ */
+CorpusInfo generateCorpus(const std::filesystem::path& directory, const CorpusSpec& spec);
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef ANALYZER_CONTEXT_H
+#define ANALYZER_CONTEXT_H
+
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+#include "DirectoryScanner.h"
+#include "MetadataCache.h"
+
+//Options of an `AnalyzerContext`.
+struct AnalyzerOptions {
+    ScanOptions scan;                   // threads, I/O backend, extractors; `scan.cache` is replaced when `cachePath` is set
+    std::filesystem::path cachePath;    // a `MetadataCache` the context owns, loaded now and saved by `saveCache`
+};
+
+//One analyzed file (or failure) as delivered through a `ResultQueue`; owns its metadata.
+struct AnalysisResult {
+    std::filesystem::path path;
+    FileType fileType = FileType::UNKNOWN;
+    MetadataMap metadata;               // empty on failure
+    std::string error;                  // empty on success
+};
+
+/**
+ * @brief Bounded multi-producer, multi-consumer queue of results that never takes a lock.
+ *
+ * A ring of cells, each with a sequence number that says whose turn it is (Vyukov's bounded queue):
+ * a producer claims a slot with one compare-and-swap on the tail and publishes it by bumping the cell's
+ * sequence, and consumers do the same on the head. `push` and `pop` wait on an atomic counter (a futex)
+ * when the ring is full or empty, so a slow consumer applies back-pressure to the workers without
+ * spinning; uncontended, neither makes a system call.
+ */
+class ResultQueue {
+public:
+    //@param capacity Results the ring holds, rounded up to a power of two.
+    explicit ResultQueue(std::size_t capacity = 4096);
+
+    ResultQueue(const ResultQueue&) = delete;
+    ResultQueue& operator=(const ResultQueue&) = delete;
+
+    //Appends a result unless the ring is full; `result` is left alone on failure.
+    bool tryPush(AnalysisResult& result);
+
+    //Appends a result, waiting while the ring is full.
+    void push(AnalysisResult&& result);
+
+    //Takes the oldest result if there is one.
+    bool tryPop(AnalysisResult& result);
+
+    /**
+     * @brief Takes the oldest result, waiting for one.
+     *
+     * @return False once the queue is closed and drained.
+     */
+    bool pop(AnalysisResult& result);
+
+    //Marks the end of the stream: `pop` returns false once the remaining results are taken.
+    void close();
+
+    //Reopens a closed queue for another stream.
+    void reopen();
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        AnalysisResult result;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask;
+    alignas(64) std::atomic<std::size_t> tail{0};
+    alignas(64) std::atomic<std::size_t> head{0};
+    alignas(64) std::atomic<uint32_t> pushes{0};    // bumped after every push and by close, for waiting consumers
+    alignas(64) std::atomic<uint32_t> pops{0};      // bumped after every pop, for waiting producers
+    std::atomic<bool> closed{false};
+};
+
+/**
+ * @brief Reusable, in-process entry point of the analyzer, as shipped in libfilemeta.
+ *
+ * The context keeps one `DirectoryScanner` for its whole life, so the worker pool, the I/O engine and
+ * the workers' `MetadataArena`s are set up once and reused by every batch, and so is the optional
+ * `MetadataCache`. Each `analyze` call takes files and directories (walked recursively), streams every
+ * result as it completes and returns once the batch is done. Calls from several threads are served
+ * one after the other.
+ *
+ * Callbacks run on the worker threads, concurrently; the map they receive lives in the worker's arena
+ * and must be copied to be kept. The `ResultQueue` overload does that copy, so the results can be
+ * consumed on any thread while the batch runs:
+ *
+ *     ResultQueue queue;
+ *     std::jthread producer([&] { context.analyze(paths, queue); });
+ *     for (AnalysisResult result; queue.pop(result);) { ... }
+ */
+class AnalyzerContext {
+public:
+    using ResultCallback = DirectoryScanner::ResultCallback;
+    using ErrorCallback = DirectoryScanner::ErrorCallback;
+
+    //Starts the worker pool and the I/O engine, and maps the cache file if one is configured.
+    explicit AnalyzerContext(AnalyzerOptions options = {});
+
+    // Saves the cache if one is owned; errors are dropped, call `saveCache` to see them
+    ~AnalyzerContext();
+
+    AnalyzerContext(const AnalyzerContext&) = delete;
+    AnalyzerContext& operator=(const AnalyzerContext&) = delete;
+
+    /**
+     * @brief Analyzes a batch, handing every result to `onResult` and every failure to `onError` as they happen.
+     *
+     * @param paths Files and directories; directories are walked recursively.
+     * @param onResult Called on worker threads, concurrently.
+     * @param onError Called on worker threads, concurrently; failures are only counted when empty.
+     * @return Counters for this batch.
+     */
+    ScanStats analyze(std::span<const std::filesystem::path> paths, const ResultCallback& onResult,
+                      const ErrorCallback& onError = nullptr);
+
+    /**
+     * @brief Analyzes a batch, pushing owned results (failures included) to `queue`, and closes it at the end.
+     *
+     * Blocks until the batch is done, and while `queue` is full; run it on its own thread and pop meanwhile.
+     *
+     * @return Counters for this batch.
+     */
+    ScanStats analyze(std::span<const std::filesystem::path> paths, ResultQueue& queue);
+
+    //Analyzes a batch given as an iterator range of anything convertible to a path.
+    template <std::input_iterator Iterator, std::sentinel_for<Iterator> Sentinel, typename... Sink>
+    ScanStats analyze(Iterator first, Sentinel last, Sink&&... sink) {
+        std::vector<std::filesystem::path> paths(first, last);
+        return analyze(std::span<const std::filesystem::path>(paths), std::forward<Sink>(sink)...);
+    }
+
+    /**
+     * @brief Writes the owned cache back, with every result recorded since it was loaded.
+     *
+     * @throws std::runtime_error If the cache file cannot be written.
+     */
+    void saveCache();
+
+private:
+    std::mutex batchMutex;                  // one batch at a time; held across `analyze`
+    const ResultCallback* onResult = nullptr; // the running batch's callbacks
+    const ErrorCallback* onError = nullptr;
+    std::unique_ptr<MetadataCache> cache;
+    std::unique_ptr<DirectoryScanner> scanner; // declared last: its workers are joined before the rest goes
+};
+
+#endif
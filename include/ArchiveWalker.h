@@ -0,0 +1,59 @@
+#ifndef ARCHIVE_WALKER_H
+#define ARCHIVE_WALKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include "FileMetaDataAnalyzer.h"
+
+//Options of `walkArchiveMembers`.
+struct ArchiveOptions {
+    unsigned maxDepth = 1;                  // 1 = members of the archive itself, 2 = also members of ZIPs inside it, ...
+    uint64_t maxInflatedBytes = 256 << 20;  // bytes decompressed per archive, nested archives included
+    uint64_t maxMemberBytes = 64 << 20;     // bytes decompressed per member, so one member cannot drain the archive's budget
+    bool includeBasic = true;               // BasicMetadata fields (name, uncompressed size, member time)
+    bool includeSpecialized = true;         // format specific fields
+    bool hashContents = false;              // add the ContentHash of members available in full
+};
+
+//Counters of one `walkArchiveMembers` call.
+struct ArchiveStats {
+    std::size_t members = 0;        // members analyzed, nested ones included
+    std::size_t errors = 0;         // members that could not be analyzed
+    uint64_t inflatedBytes = 0;     // bytes decompressed
+};
+
+/**
+ * @brief Analyzes the members of a ZIP archive in memory, recursing into nested ZIPs.
+ *
+ * Every file member is dispatched through `determineFileType` and `analyzeFileMetadata` as if it were a
+ * file of its own, called "<archive>/<member name>", with the uncompressed size and the member's
+ * modification time (local time, as ZIP stores it) standing in for its `stat`. Nothing is extracted to
+ * disk. Stored members are parsed in place from the archive bytes. Deflated members are inflated, but
+ * only kept in memory as far as their extractors need: the first `FileContext::DefaultPrefixSize` bytes
+ * for formats that read just their header (JPEG, BMP); text streamed through a `TextReader` in windows;
+ * PNG and WAV chunk headers at their offsets, with the pixel and sample data inflated but not kept; GIF
+ * without its image data; the whole member otherwise (PDF, ZIP, and any member when hashing). Every
+ * member inflates at most `ArchiveOptions::maxMemberBytes`, and all of them together at most
+ * `maxInflatedBytes`. When either runs out part way, a member is analyzed from the bytes inflated so far
+ * and its record gets `AnalyzedBytes`. Encrypted members and compression methods other than Store and
+ * Deflate are reported as errors.
+ *
+ * Members that are ZIPs themselves get a record and, while the nesting is at most
+ * `ArchiveOptions::maxDepth` deep, their members are walked too, drawing on the same budget.
+ *
+ * @param archive The opened archive; it must be complete (see `FileContext::isComplete`).
+ * @param options Depth, budget and which metadata to extract.
+ * @param onMember Called with each member's path, type and metadata. The map is allocated from an arena
+ *                 that is rewound after the call, so it must be copied to be kept.
+ * @param onError Called with the path of each member that failed and the reason.
+ * @return Counters of the walk.
+ * @throws std::runtime_error If the archive itself cannot be read.
+ */
+ArchiveStats walkArchiveMembers(const FileContext& archive, const ArchiveOptions& options,
+                                const std::function<void(const std::filesystem::path&, FileType, const MetadataMap&)>& onMember,
+                                const std::function<void(const std::filesystem::path&, const std::string&)>& onError);
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef BYTE_READER_H
+#define BYTE_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept> // For std::out_of_range
+#include <string>
+#include <string_view>
+
+/**
+ * @brief A bounds-checked, endian-aware reader over a span of bytes.
+ *
+ * The span normally points straight into a `FileContext` mapping, so headers are decoded from the page
+ * cache without copying them into structs first; fields are assembled byte by byte, which makes the result
+ * independent of struct padding and host byte order. Every accessor comes in two flavours: an absolute one
+ * taking an offset (`u32be(16)`) and a cursor one that advances `position()` (`readU32BE()`). Reading past
+ * the end throws `std::out_of_range`.
+ */
+class ByteReader {
+public:
+    ByteReader() = default;
+
+    explicit ByteReader(std::span<const uint8_t> data) : data(data) {}
+
+    //Number of bytes in the underlying span.
+    std::size_t size() const {
+        return data.size();
+    }
+
+    //Checks whether `length` bytes starting at `offset` are available.
+    bool has(std::size_t offset, std::size_t length) const {
+        return offset <= data.size() && length <= data.size() - offset;
+    }
+
+    // Absolute accessors
+
+    uint8_t u8(std::size_t offset) const {
+        return at(offset, 1)[0];
+    }
+
+    uint16_t u16le(std::size_t offset) const {
+        const uint8_t* p = at(offset, 2);
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    uint16_t u16be(std::size_t offset) const {
+        const uint8_t* p = at(offset, 2);
+        return static_cast<uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    uint32_t u32le(std::size_t offset) const {
+        const uint8_t* p = at(offset, 4);
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    uint32_t u32be(std::size_t offset) const {
+        const uint8_t* p = at(offset, 4);
+        return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+               (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+    }
+
+    uint64_t u64le(std::size_t offset) const {
+        return static_cast<uint64_t>(u32le(offset)) | (static_cast<uint64_t>(u32le(offset + 4)) << 32);
+    }
+
+    uint64_t u64be(std::size_t offset) const {
+        return (static_cast<uint64_t>(u32be(offset)) << 32) | static_cast<uint64_t>(u32be(offset + 4));
+    }
+
+    int32_t i32le(std::size_t offset) const {
+        return static_cast<int32_t>(u32le(offset));
+    }
+
+    //A view of `length` bytes starting at `offset`.
+    std::span<const uint8_t> bytes(std::size_t offset, std::size_t length) const {
+        return {at(offset, length), length};
+    }
+
+    //The bytes at `offset` viewed as characters.
+    std::string_view chars(std::size_t offset, std::size_t length) const {
+        return {reinterpret_cast<const char*>(at(offset, length)), length};
+    }
+
+    //Checks whether the bytes at `offset` equal `expected`.
+    bool matches(std::size_t offset, std::string_view expected) const {
+        return has(offset, expected.size()) && chars(offset, expected.size()) == expected;
+    }
+
+    // Cursor accessors
+
+    std::size_t position() const {
+        return cursor;
+    }
+
+    std::size_t remaining() const {
+        return cursor <= data.size() ? data.size() - cursor : 0;
+    }
+
+    void seek(std::size_t offset) {
+        cursor = offset;
+    }
+
+    void skip(std::size_t length) {
+        cursor += length;
+    }
+
+    uint8_t readU8() { return advance(u8(cursor), 1); }
+    uint16_t readU16LE() { return advance(u16le(cursor), 2); }
+    uint16_t readU16BE() { return advance(u16be(cursor), 2); }
+    uint32_t readU32LE() { return advance(u32le(cursor), 4); }
+    uint32_t readU32BE() { return advance(u32be(cursor), 4); }
+    uint64_t readU64LE() { return advance(u64le(cursor), 8); }
+
+    std::span<const uint8_t> readBytes(std::size_t length) {
+        return advance(bytes(cursor, length), length);
+    }
+
+    std::string_view readChars(std::size_t length) {
+        return advance(chars(cursor, length), length);
+    }
+
+private:
+    const uint8_t* at(std::size_t offset, std::size_t length) const {
+        if (!has(offset, length)) {
+            throw std::out_of_range("ByteReader: read of " + std::to_string(length) + " bytes at offset " +
+                                    std::to_string(offset) + " past end of " + std::to_string(data.size()));
+        }
+        return data.data() + offset;
+    }
+
+    template <typename V>
+    V advance(V value, std::size_t length) {
+        cursor += length;
+        return value;
+    }
+
+    std::span<const uint8_t> data;
+    std::size_t cursor = 0;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include "FileContext.h"
+
+/**
+ * @brief Streaming XXH3-64 (seed 0, default secret) of a byte stream.
+ *
+ * Produces the same values as the reference `XXH3_64bits()`, however the input is split. Inputs longer
+ * than 240 bytes are hashed 64-byte stripe by stripe on eight 64-bit lanes; the stripe loop runs on AVX2
+ * or SSE2 when the CPU has them, which hashes faster than NVMe storage reads. Inputs are consumed in
+ * place: only the final partial stripe is copied into the hasher.
+ */
+class ContentHasher {
+public:
+    ContentHasher();
+
+    //Feeds the next bytes of the stream.
+    void update(std::span<const uint8_t> data);
+
+    //The hash of everything fed so far; the hasher can keep going afterwards.
+    uint64_t digest() const;
+
+private:
+    static constexpr std::size_t StripeLength = 64;
+    static constexpr std::size_t BufferSize = 256;      // 4 stripes; shorter streams are hashed from here in one go
+
+    //Accumulates `stripes` whole stripes, scrambling the lanes at the end of every block.
+    static void consumeStripes(std::array<uint64_t, 8>& lanes, std::size_t& stripesInBlock, const uint8_t* data, std::size_t stripes);
+
+    alignas(32) std::array<uint64_t, 8> acc;
+    std::size_t stripesInBlock = 0;     // stripes accumulated since the last scramble
+    uint64_t totalLength = 0;
+    std::size_t buffered = 0;
+    std::array<uint8_t, BufferSize> buffer;
+    std::array<uint8_t, StripeLength> lastStripe;   // the 64 bytes consumed just before `buffer`
+};
+
+//XXH3-64 of a buffer.
+uint64_t contentHash(std::span<const uint8_t> data);
+
+/**
+ * @brief Hashes every byte of a file with `ContentHasher`.
+ *
+ * Mapped files are hashed straight out of the mapping, advised for sequential access. Otherwise the file
+ * is streamed through one aligned 1 MiB buffer with large `pread` calls.
+ *
+ * @param context The opened file.
+ * @return The hash, or nothing when the file is not open or shrank while being read.
+ */
+std::optional<uint64_t> hashFileContents(const FileContext& context);
+
+//Name of the stripe loop `ContentHasher` selected for this CPU ("avx2", "sse2" or "scalar").
+const char* contentHashImplementation();
+
+#endif
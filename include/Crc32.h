@@ -0,0 +1,23 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <cstdint>
+#include <span>
+
+/**
+ * @brief Continues the CRC-32 (ISO-HDLC, as used by PNG, ZIP and gzip) of a byte stream.
+ *
+ * Same contract as zlib's `crc32()`: start from 0 and feed the data in any number of pieces. Long runs
+ * are folded with carry-less multiplication (PCLMULQDQ on x86-64) or the ARMv8 CRC32 instructions when
+ * the CPU has them, which checksums faster than storage can deliver; everything else goes through zlib.
+ *
+ * @param crc The CRC of the preceding bytes (0 to start).
+ * @param data The next bytes.
+ * @return The CRC of the preceding bytes followed by `data`.
+ */
+uint32_t updateCrc32(uint32_t crc, std::span<const uint8_t> data);
+
+//Name of the implementation `updateCrc32` selected for this CPU ("pclmul", "armv8-crc" or "zlib").
+const char* crc32Implementation();
+
+#endif
@@ -1,9 +1,48 @@
+#ifndef CUSTOM_MAP_H
+#define CUSTOM_MAP_H
+
 #include <vector>
 #include <stdexcept> // For std::out_of_range
 #include <algorithm> // For std::find_if
+#include <cstdint>
+#include <functional> // For std::hash
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * @brief Hash used by `CustomMap`.
+ *
+ * Keys convertible to `std::string_view` are hashed through their view, so that a `std::string` key and a
+ * `std::string_view` / `const char*` probe produce the same hash.
+ */
+template<typename KeyType>
+struct CustomMapHash {
+    template<typename K>
+    std::size_t operator()(const K& key) const {
+        if constexpr (std::is_convertible_v<const K&, std::string_view>) {
+            return std::hash<std::string_view>{}(std::string_view(key));
+        } else {
+            return std::hash<KeyType>{}(key);
+        }
+    }
+};
 
 /**
  * @brief A custom implementation of a key-value map data structure.
+ *
+ * Pairs are stored densely in insertion order, which is also the iteration order. Small maps are searched
+ * linearly; once a map grows past `IndexThreshold` pairs an open-addressing (linear probing) index of
+ * pair positions is built on top of the vector, so lookups and inserts become O(1) on average.
+ *
+ * Storage comes from a `std::pmr::memory_resource`, the global heap unless one is passed to the
+ * constructor (e.g. a per-file `MetadataArena`). The usual pmr rules apply: a copy-constructed map
+ * allocates from the default resource, so copying is how a map leaves an arena; a move-constructed map
+ * keeps the source's resource; assignment keeps the destination's resource, and moves the source's
+ * storage over only when both maps use the same one, copying otherwise. Values that take a polymorphic
+ * allocator (`MetadataValue`, `std::pmr::string`) are constructed with the map's resource too.
+ *
  * @tparam KeyType The type of the keys stored in the map.
  * @tparam ValueType The type of the values stored in the map.
  */
@@ -13,92 +52,249 @@ private:
     struct Pair {
         KeyType key;
         ValueType value;
+
+        bool operator==(const Pair& other) const = default;
+    };
+
+    // One slot of the open-addressing index. `index` is the position in `pairs` plus one; 0 marks an empty slot.
+    struct Slot {
+        uint32_t index = 0;
+        uint32_t hash = 0;
     };
 
-    std::vector<Pair> pairs; //storage for the key-value pairs
+    static constexpr std::size_t IndexThreshold = 8;
+
+    std::pmr::vector<Pair> pairs; //storage for the key-value pairs
+    std::pmr::vector<Slot> slots; //hash index over `pairs`, empty while the map is small
+
+    // Probe keys: the key type itself, or anything viewable as a string when the key is string-like
+    template<typename K>
+    static constexpr bool isLookupKey = std::is_convertible_v<const K&, const KeyType&> ||
+                                        (std::is_convertible_v<const KeyType&, std::string_view> &&
+                                         std::is_convertible_v<const K&, std::string_view>);
+
+    template<typename K>
+    static bool keyEquals(const KeyType& stored, const K& key) {
+        if constexpr (std::is_convertible_v<const KeyType&, std::string_view> &&
+                      std::is_convertible_v<const K&, std::string_view>) {
+            return std::string_view(stored) == std::string_view(key);
+        } else {
+            return stored == key;
+        }
+    }
+
+    template<typename K>
+    static uint32_t hashOf(const K& key) {
+        std::size_t h = CustomMapHash<KeyType>{}(key);
+        return static_cast<uint32_t>(h ^ (h >> 32));
+    }
+
+    // Returns the position of the key in `pairs`, or pairs.size() if it is absent
+    template<typename K>
+    std::size_t locate(const K& key) const {
+        if (slots.empty()) {
+            for (std::size_t i = 0; i < pairs.size(); ++i) {
+                if (keyEquals(pairs[i].key, key)) {
+                    return i;
+                }
+            }
+            return pairs.size();
+        }
+
+        uint32_t hash = hashOf(key);
+        std::size_t mask = slots.size() - 1;
+        for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+            const Slot& slot = slots[i];
+            if (slot.index == 0) {
+                return pairs.size();
+            }
+            if (slot.hash == hash && keyEquals(pairs[slot.index - 1].key, key)) {
+                return slot.index - 1;
+            }
+        }
+    }
+
+    void indexPair(std::size_t position, uint32_t hash) {
+        std::size_t mask = slots.size() - 1;
+        std::size_t i = hash & mask;
+        while (slots[i].index != 0) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = Slot{static_cast<uint32_t>(position + 1), hash};
+    }
+
+    // Rebuilds the index so that `expected` pairs keep the load factor at or below 1/2
+    void rebuildIndex(std::size_t expected) {
+        if (expected <= IndexThreshold) {
+            slots.clear();
+            return;
+        }
+        std::size_t capacity = 16;
+        while (capacity < expected * 2) {
+            capacity *= 2;
+        }
+        slots.assign(capacity, Slot{});
+        for (std::size_t i = 0; i < pairs.size(); ++i) {
+            indexPair(i, hashOf(pairs[i].key));
+        }
+    }
+
+    static constexpr bool valueUsesAllocator = std::uses_allocator_v<ValueType, std::pmr::polymorphic_allocator<>>;
+
+    // Constructs a value for this map: in the map's resource when the value type takes a polymorphic allocator
+    template<typename... Args>
+    ValueType makeValue(Args&&... args) const {
+        if constexpr (valueUsesAllocator) {
+            return ValueType(std::forward<Args>(args)..., std::pmr::polymorphic_allocator<>(memory()));
+        } else {
+            return ValueType(std::forward<Args>(args)...);
+        }
+    }
+
+    // Replaces the pairs with copies of `other`'s, allocated from this map's resource
+    template<typename Source>
+    void assignPairs(Source&& other) {
+        pairs.clear();
+        pairs.reserve(other.pairs.size());
+        for (auto& pair : other.pairs) {
+            if constexpr (std::is_lvalue_reference_v<Source>) {
+                pairs.push_back({pair.key, makeValue(pair.value)});
+            } else {
+                pairs.push_back({pair.key, makeValue(std::move(pair.value))});
+            }
+        }
+        slots = other.slots;
+    }
+
+    template<typename K, typename... V>
+    Pair& append(K&& key, V&&... value) {
+        std::size_t position = pairs.size();
+        pairs.push_back({KeyType(std::forward<K>(key)), makeValue(std::forward<V>(value)...)});
+        if (!slots.empty() && (position + 1) * 2 <= slots.size()) {
+            indexPair(position, hashOf(pairs[position].key));
+        } else if (position + 1 > IndexThreshold) {
+            rebuildIndex(position + 1);
+        }
+        return pairs[position];
+    }
 
 public:
+    using iterator = typename std::pmr::vector<Pair>::iterator;
+    using const_iterator = typename std::pmr::vector<Pair>::const_iterator;
+
     // Default constructor
     CustomMap() = default;
 
+    //Allocates pairs and index from `memory`, which must outlive the map
+    explicit CustomMap(std::pmr::memory_resource* memory) : pairs(memory), slots(memory) {}
+
+    //The resource the map allocates from
+    std::pmr::memory_resource* memory() const {
+        return pairs.get_allocator().resource();
+    }
+
     //Inserts a new key-value pair into the map
     void insert(const KeyType& key, const ValueType& value) {
-        auto it = std::find_if(pairs.begin(), pairs.end(), [&](const Pair& pair) {
-            return pair.key == key;
-        });
-
-        if (it != pairs.end()) {
-            it->value = value;
+        std::size_t position = locate(key);
+        if (position != pairs.size()) {
+            pairs[position].value = value;
         } else {
-            pairs.push_back({key, value});
+            append(key, value);
         }
     }
 
-    ValueType& operator[](const KeyType& key) {
-    auto it = std::find_if(pairs.begin(), pairs.end(), [&](const Pair& pair) {
-        return pair.key == key;
-    });
-
-    if (it != pairs.end()) {
-        return it->value;
-    } else {
-        pairs.push_back({key, ValueType{}});
-        return pairs.back().value;
+    template<typename K>
+        requires isLookupKey<K>
+    ValueType& operator[](const K& key) {
+        std::size_t position = locate(key);
+        if (position != pairs.size()) {
+            return pairs[position].value;
+        }
+        return append(key).value;
     }
+
+    ValueType& operator[](KeyType&& key) {
+        std::size_t position = locate(key);
+        if (position != pairs.size()) {
+            return pairs[position].value;
+        }
+        return append(std::move(key)).value;
     }
 
     //Iterators for accessing the key-value pairs
-    typename std::vector<Pair>::iterator begin() {
+    iterator begin() {
         return pairs.begin();
     }
 
-    typename std::vector<Pair>::iterator end() {
+    iterator end() {
         return pairs.end();
     }
 
-    typename std::vector<Pair>::const_iterator begin() const {
+    const_iterator begin() const {
         return pairs.begin();
     }
 
-    typename std::vector<Pair>::const_iterator end() const {
+    const_iterator end() const {
         return pairs.end();
     }
 
     /**
      * @brief Finds the iterator pointing to the key-value pair with the given key.
      *
-     * @param key The key to be searched for.
+     * @param key The key to be searched for. String-keyed maps also accept `std::string_view` and C strings.
      * @return An iterator pointing to the key-value pair, or the end iterator if the key is not found.
      */
-    typename std::vector<Pair>::iterator find(const KeyType& key) {
-        return std::find_if(pairs.begin(), pairs.end(), [&](const Pair& pair) {
-            return pair.key == key;
-        });
+    template<typename K>
+        requires isLookupKey<K>
+    iterator find(const K& key) {
+        return pairs.begin() + static_cast<std::ptrdiff_t>(locate(key));
     }
 
     /**
      * @brief Finds the const_iterator pointing to the key-value pair with the given key.
      *
-     * @param key The key to be searched for.
+     * @param key The key to be searched for. String-keyed maps also accept `std::string_view` and C strings.
      * @return A const_iterator pointing to the key-value pair, or the end iterator if the key is not found.
      */
-    typename std::vector<Pair>::const_iterator find(const KeyType& key) const {
-        return std::find_if(pairs.begin(), pairs.end(), [&](const Pair& pair) {
-            return pair.key == key;
-        });
+    template<typename K>
+        requires isLookupKey<K>
+    const_iterator find(const K& key) const {
+        return pairs.begin() + static_cast<std::ptrdiff_t>(locate(key));
     }
 
-    //Removes the key-value pair with the given key
-    void erase(const KeyType& key) {
-        auto it = std::find_if(pairs.begin(), pairs.end(), [&](const Pair& pair) {
-            return pair.key == key;
-        });
+    //Checks whether the key is present
+    template<typename K>
+        requires isLookupKey<K>
+    bool contains(const K& key) const {
+        return locate(key) != pairs.size();
+    }
 
-        if (it != pairs.end()) {
-            pairs.erase(it);
+    //Removes the key-value pair with the given key, keeping the insertion order of the rest
+    template<typename K>
+        requires isLookupKey<K>
+    void erase(const K& key) {
+        std::size_t position = locate(key);
+        if (position != pairs.size()) {
+            pairs.erase(pairs.begin() + static_cast<std::ptrdiff_t>(position));
+            if (!slots.empty()) {
+                rebuildIndex(pairs.size());
+            }
         }
     }
 
+    //Reserves room for `count` pairs without rehashing
+    void reserve(std::size_t count) {
+        pairs.reserve(count);
+        if (count > IndexThreshold && count * 2 > slots.size()) {
+            rebuildIndex(count);
+        }
+    }
+
+    //Returns how many pairs fit before the pair storage reallocates.
+    std::size_t capacity() const {
+        return pairs.capacity();
+    }
+
     //Returns the number of key-value pairs stored in the map.
     std::size_t size() const {
         return pairs.size();
@@ -112,26 +308,34 @@ public:
     // Removes all key-value pairs from the map
     void clear() {
         pairs.clear();
+        slots.clear();
     }
 
     // Copy constructor
-    CustomMap(const CustomMap& other) : pairs(other.pairs) {}
+    CustomMap(const CustomMap& other) : pairs(other.pairs), slots(other.slots) {}
 
     // Move constructor
-    CustomMap(CustomMap&& other) noexcept : pairs(std::move(other.pairs)) {}
+    CustomMap(CustomMap&& other) noexcept : pairs(std::move(other.pairs)), slots(std::move(other.slots)) {}
 
-    // Copy assignment operator
+    // Copy assignment operator; the copies live in this map's resource
     CustomMap& operator=(const CustomMap& other) {
         if (this != &other) {
-            pairs = other.pairs;
+            assignPairs(other);
         }
         return *this;
     }
 
-    // Move assignment operator
-    CustomMap& operator=(CustomMap&& other) noexcept {
-        if (this != &other) {
+    // Move assignment operator; takes the storage over only when both maps use the same resource
+    CustomMap& operator=(CustomMap&& other) {
+        if (this == &other) {
+            return *this;
+        }
+        if (memory()->is_equal(*other.memory())) {
             pairs = std::move(other.pairs);
+            slots = std::move(other.slots);
+        } else {
+            assignPairs(std::move(other));
+            other.clear();
         }
         return *this;
     }
@@ -146,3 +350,5 @@ public:
         return !(*this == other);
     }
 };
+
+#endif
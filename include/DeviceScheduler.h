@@ -0,0 +1,197 @@
+#ifndef DEVICE_SCHEDULER_H
+#define DEVICE_SCHEDULER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <optional>
+#include <vector>
+#include <sys/types.h>
+
+//Whether the block device behind `device` spins, per /sys/dev/block; false when unknown (tmpfs, NFS, btrfs, ...).
+bool isRotationalDevice(dev_t device);
+
+/**
+ * @brief Concurrency limit of one device, adapted AIMD-style from the latency of its reads.
+ *
+ * Latencies are smoothed over about eight reads, and the lowest smoothed latency seen stands for the
+ * device's unloaded service time. While the smoothed latency stays within twice that, the device serves
+ * reads in parallel and a limit that is actually reached grows: by one per read until the first
+ * congestion signal (slow start, doubling per round trip), then by one per round trip. Past twice the
+ * baseline reads are queueing in the device instead, and the limit is cut by a third, at most once per
+ * round trip. When even a lone read stays that slow, the device itself got slower (the files stopped
+ * coming from the page cache, say) and its latency becomes the new baseline. Latencies under a
+ * millisecond never count as congestion: they are page cache hits or flash reads, which only look
+ * slower at depth because more of them complete per batch.
+ */
+class AdaptiveLimit {
+public:
+    /**
+     * @param initial The starting limit.
+     * @param maximum The limit never grows past this.
+     */
+    AdaptiveLimit(std::size_t initial, std::size_t maximum);
+
+    //Reads the device may have outstanding, at least 1.
+    std::size_t current() const {
+        return static_cast<std::size_t>(limit);
+    }
+
+    /**
+     * @brief Adjusts the limit after a read.
+     *
+     * @param nanoseconds How long the read took.
+     * @param inFlight Reads outstanding on the device when it finished, itself included.
+     */
+    void record(uint64_t nanoseconds, std::size_t inFlight);
+
+private:
+    static constexpr double Tolerance = 2.0;       // smoothed latency over baseline that counts as congestion
+    static constexpr double CongestionFloor = 1e6; // nanoseconds
+    static constexpr std::size_t SettleReads = 8;  // about the reach of the smoothing
+
+    double limit;
+    double maximum;
+    double smoothed = 0;
+    double baseline = 0;
+    std::size_t sinceDecrease = 0;
+    bool slowStart = true;
+};
+
+/**
+ * @brief Per-device queues of files waiting to be opened and read.
+ *
+ * Files are parked under the device their stat reported and released as that device has room under its
+ * `AdaptiveLimit`, round robin across devices, so a slow disk only holds back its own files. Rotational
+ * devices release in ascending inode order, one sweep after another (C-SCAN): file systems allocate data
+ * near its inode, so the head mostly moves forward. Other devices release in arrival order.
+ * Not thread safe.
+ */
+template <typename T>
+class DeviceScheduler {
+public:
+    //A released file, and the device to report its completion to.
+    struct Release {
+        T item;
+        dev_t device;
+    };
+
+    //@param maxConcurrency Upper bound of every device's limit.
+    explicit DeviceScheduler(std::size_t maxConcurrency) : maxConcurrency(std::max<std::size_t>(maxConcurrency, 1)) {}
+
+    //Parks a stat'ed file on its device's queue.
+    void push(dev_t device, ino_t inode, T item) {
+        Queue& queue = queueOf(device);
+        if (queue.rotational) {
+            queue.byInode.emplace(inode, std::move(item));
+        } else {
+            queue.arrivals.push_back(std::move(item));
+        }
+        ++parkedCount;
+    }
+
+    //Takes the next parked file whose device has room and counts it as in flight; nothing when none may start.
+    std::optional<Release> pop() {
+        for (std::size_t tried = 0; tried < queues.size(); ++tried) {
+            Queue& queue = queues[nextQueue];
+            nextQueue = (nextQueue + 1) % queues.size();
+            if (queue.inFlight < queue.limit.current()) {
+                if (std::optional<T> item = queue.take()) {
+                    ++queue.inFlight;
+                    --parkedCount;
+                    return Release{std::move(*item), queue.device};
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Marks a released file as done.
+     *
+     * @param device The device it was released from.
+     * @param latency How long its read took; nothing when it failed or read nothing, which leaves the limit alone.
+     */
+    void complete(dev_t device, std::optional<uint64_t> latency) {
+        Queue& queue = queueOf(device);
+        if (latency) {
+            queue.limit.record(*latency, queue.inFlight);
+        }
+        --queue.inFlight;
+    }
+
+    //Files parked and not yet released.
+    std::size_t parked() const {
+        return parkedCount;
+    }
+
+    //Whether `device` was detected as rotational; it must have had a file pushed.
+    bool rotational(dev_t device) {
+        return queueOf(device).rotational;
+    }
+
+    //The current limit of `device`; it must have had a file pushed.
+    std::size_t limit(dev_t device) {
+        return queueOf(device).limit.current();
+    }
+
+private:
+    // Spinning disks start shallow, flash starts at a depth that keeps an SSD busy; both adapt from there
+    static constexpr std::size_t RotationalInitialLimit = 2;
+    static constexpr std::size_t FlashInitialLimit = 16;
+
+    struct Queue {
+        Queue(dev_t device, bool rotational, AdaptiveLimit limit) : device(device), rotational(rotational), limit(limit) {}
+
+        dev_t device;
+        bool rotational;
+        AdaptiveLimit limit;
+        std::size_t inFlight = 0;
+        std::deque<T> arrivals;             // non-rotational devices
+        std::multimap<ino_t, T> byInode;    // rotational devices
+        ino_t cursor = 0;                   // inode of the last release of the current sweep
+
+        std::optional<T> take() {
+            if (!rotational) {
+                if (arrivals.empty()) {
+                    return std::nullopt;
+                }
+                T item = std::move(arrivals.front());
+                arrivals.pop_front();
+                return item;
+            }
+            auto next = byInode.lower_bound(cursor);
+            if (next == byInode.end()) {
+                next = byInode.begin(); // start the next sweep
+                if (next == byInode.end()) {
+                    return std::nullopt;
+                }
+            }
+            cursor = next->first;
+            T item = std::move(next->second);
+            byInode.erase(next);
+            return item;
+        }
+    };
+
+    // A scan touches a handful of devices, so a linear search beats hashing
+    Queue& queueOf(dev_t device) {
+        auto found = std::find_if(queues.begin(), queues.end(), [device](const Queue& queue) { return queue.device == device; });
+        if (found != queues.end()) {
+            return *found;
+        }
+        bool spinning = isRotationalDevice(device);
+        std::size_t initial = std::min(maxConcurrency, spinning ? RotationalInitialLimit : FlashInitialLimit);
+        queues.emplace_back(device, spinning, AdaptiveLimit(initial, maxConcurrency));
+        return queues.back();
+    }
+
+    std::size_t maxConcurrency;
+    std::vector<Queue> queues;
+    std::size_t nextQueue = 0;
+    std::size_t parkedCount = 0;
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef DIRECTORY_SCANNER_H
+#define DIRECTORY_SCANNER_H
+
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ArchiveWalker.h"
+#include "DuplicateFinder.h"
+#include "FileMetaDataAnalyzer.h"
+#include "IoEngine.h"
+#include "MetadataArena.h"
+#include "MetadataCache.h"
+#include "ThreadPool.h"
+
+//Options controlling a recursive scan.
+struct ScanOptions {
+    std::size_t threadCount = 0;   // 0 = one worker per hardware thread
+    bool includeBasic = true;      // BasicMetadata fields
+    bool includeSpecialized = true; // format specific fields
+    bool followSymlinks = false;   // descend into symlinked directories
+    MetadataCache* cache = nullptr; // serve unchanged files from here and record new results in it
+    IoBackend ioBackend = IoBackend::Auto; // how files are stat'ed, opened and read before parsing
+    bool verifyIntegrity = false;  // read whole files to check embedded checksums (bypasses cache lookups)
+    bool hashContents = false;     // add a ContentHash of every file's bytes (bypasses cache lookups)
+    DuplicateFinder* duplicates = nullptr; // hand every analyzed file to this finder
+    unsigned archiveDepth = 0;     // analyze ZIP members nested up to this deep (0 = only the archive itself)
+    uint64_t archiveBudget = ArchiveOptions{}.maxInflatedBytes; // bytes decompressed per archive
+    uint64_t archiveMemberBudget = ArchiveOptions{}.maxMemberBytes; // bytes decompressed per archive member
+};
+
+//Counters reported once a scan has finished.
+struct ScanStats {
+    std::size_t filesAnalyzed = 0;
+    std::size_t errors = 0;
+    std::size_t cacheHits = 0;
+    std::size_t arenaBlocks = 0;   // blocks the workers' metadata arenas took from the global allocator
+    std::size_t archiveMembers = 0; // members analyzed inside archives (see `ScanOptions::archiveDepth`)
+};
+
+/**
+ * @brief Walks directory trees in parallel and analyzes every regular file found.
+ *
+ * Every directory is listed by its own pool task, and every file becomes a task that runs
+ * `determineFileType` followed by the matching `FileMetaDataAnalyzer` specialization. Results are
+ * handed to the callbacks straight from the worker threads, in completion order, so the callbacks
+ * must be thread-safe. With a `MetadataCache`, a file whose `CacheKey` is cached costs a single `stat`.
+ *
+ * Each file's metadata is allocated from the worker's `MetadataArena`, which is rewound for the next
+ * file once the result callback has returned. The callback therefore receives the map by reference
+ * and must copy it (copies are allocated from the global heap) to keep it.
+ *
+ * Unless `ScanOptions::ioBackend` is `Blocking`, listing tasks hand files to an `IoEngine` in batches;
+ * the engine keeps many stat/open/read operations in flight and each completed file becomes a parsing
+ * task on the pool, so workers never block on storage. Completed files wait for a worker with their
+ * descriptor open, so the engine stops opening files once `IoEngineOptions::maxOpenFiles` are held.
+ *
+ * With `ScanOptions::duplicates`, every analyzed file (cache hits included) is also recorded in that
+ * `DuplicateFinder`, whose hashing stage runs once the scans are over.
+ *
+ * With `ScanOptions::archiveDepth`, the members of every ZIP archive are analyzed by `walkArchiveMembers`
+ * on the worker that analyzed the archive, and reported through the same callbacks as files. Archives
+ * are then never answered from the cache, since it holds no member results.
+ */
+class DirectoryScanner {
+public:
+    using ResultCallback = std::function<void(const std::filesystem::path&, FileType, const MetadataMap&)>;
+    using ErrorCallback = std::function<void(const std::filesystem::path&, const std::string&)>;
+
+    DirectoryScanner(ScanOptions options, ResultCallback onResult, ErrorCallback onError);
+
+    /**
+     * @brief Scans a directory tree (or a single file) and blocks until every file has been analyzed.
+     *
+     * @param root The directory to walk.
+     * @return Counters for this scan.
+     * @throws std::exception When the I/O engine failed (see `IoEngine::wait`).
+     */
+    ScanStats scan(const std::filesystem::path& root);
+
+    /**
+     * @brief Scans several directory trees and files together, e.g. a batch of changed paths.
+     *
+     * @param roots The directories and files to analyze; all of them are in flight at once.
+     * @return Counters for this scan.
+     * @throws std::exception When the I/O engine failed (see `IoEngine::wait`).
+     */
+    ScanStats scan(const std::vector<std::filesystem::path>& roots);
+
+private:
+    void scanDirectory(const std::filesystem::path& directory);
+    void analyzeFile(const std::filesystem::path& filePath);
+    void analyzePrefetched(PrefetchedFile& file);
+    void analyzeContext(const FileContext& context);
+    bool analyzeFromCache(const std::filesystem::path& filePath);
+    bool analyzeFromCache(const std::filesystem::path& filePath, const struct stat& fileStat);
+
+    //Whether files may be answered from the cache; integrity checks and hashing have to read every file.
+    bool servesFromCache() const {
+        return options.cache && !options.verifyIntegrity && !options.hashContents;
+    }
+
+    //Whether a cached result is all there is to report; archives whose members are wanted must be opened.
+    bool isCompleteResult(const CachedRecord& cached) const {
+        return options.archiveDepth == 0 || cached.fileType() != FileType::ZIP;
+    }
+
+    //Files handed to the I/O engine per submission.
+    static constexpr std::size_t IoBatchSize = 256;
+
+    ScanOptions options;
+    ResultCallback onResult;
+    ErrorCallback onError;
+    ThreadPool pool;
+    std::unique_ptr<IoEngine> io; // declared after the pool: completions are still submitted to it while the engine drains
+
+    std::atomic<std::size_t> filesAnalyzed{0};
+    std::atomic<std::size_t> errors{0};
+    std::atomic<std::size_t> cacheHits{0};
+    std::atomic<std::size_t> arenaBlocks{0};
+    std::atomic<std::size_t> archiveMembers{0};
+};
+
+#endif
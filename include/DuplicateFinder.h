@@ -0,0 +1,82 @@
+#ifndef DUPLICATE_FINDER_H
+#define DUPLICATE_FINDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+//Files whose contents are identical: same size and same `ContentHasher` hash.
+struct DuplicateGroup {
+    uint64_t size = 0;                          // of each file
+    uint64_t hash = 0;
+    std::vector<std::filesystem::path> paths;   // sorted; hard links to one inode are all listed
+    uint64_t reclaimableBytes = 0;              // size times the number of distinct inodes beyond the first
+};
+
+//Counters of the hashing stage.
+struct DuplicateStats {
+    std::size_t filesSeen = 0;
+    std::size_t filesHashed = 0;    // distinct inodes whose size collided with another file's
+    uint64_t bytesHashed = 0;
+    std::size_t hashesReused = 0;   // hashes handed in by the scan instead of being recomputed
+};
+
+/**
+ * @brief Finds files with identical contents among the files of one or more scans.
+ *
+ * The scan hands over every file it analyzes with `add`, which only records the path and `stat`
+ * result. `findDuplicates` then buckets the files by size: a file whose size no other file has cannot
+ * have a duplicate and is never read, and hard links are read once per inode. Only the remaining
+ * candidates are hashed in full with `hashFileContents`, on a pool of threads so several files stream
+ * from storage at once. Empty files are ignored.
+ *
+ * Groups are formed on a 64-bit hash, so files should be compared byte for byte before any is deleted.
+ */
+class DuplicateFinder {
+public:
+    using ErrorCallback = std::function<void(const std::filesystem::path&, const std::string&)>;
+
+    /**
+     * @brief Records a file; safe to call from any thread.
+     *
+     * @param filePath The path to the file.
+     * @param fileStat The file's status at the time of the scan.
+     * @param hash The file's content hash when the scan already computed it.
+     */
+    void add(const std::filesystem::path& filePath, const struct stat& fileStat, std::optional<uint64_t> hash = std::nullopt);
+
+    /**
+     * @brief Hashes the candidates and groups the duplicates. Blocks until every candidate is hashed.
+     *
+     * @param threadCount Hashing threads, or 0 for one per hardware thread.
+     * @param onError Called for files that can no longer be read or have changed size since the scan.
+     * @return The groups, largest `reclaimableBytes` first.
+     */
+    std::vector<DuplicateGroup> findDuplicates(std::size_t threadCount, const ErrorCallback& onError);
+
+    //Counters of the last `findDuplicates` call.
+    const DuplicateStats& stats() const {
+        return lastStats;
+    }
+
+private:
+    struct Candidate {
+        std::filesystem::path path;
+        uint64_t size = 0;
+        dev_t device = 0;
+        ino_t inode = 0;
+        std::optional<uint64_t> hash;
+    };
+
+    std::vector<Candidate> candidates;
+    std::mutex candidatesMutex;
+    DuplicateStats lastStats;
+};
+
+#endif
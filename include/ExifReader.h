@@ -0,0 +1,110 @@
+#ifndef EXIF_READER_H
+#define EXIF_READER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include "ByteReader.h"
+
+//One entry of a TIFF image file directory. `value` points into the TIFF bytes.
+struct ExifEntry {
+    uint16_t tag = 0;
+    uint16_t type = 0;
+    uint32_t count = 0;
+    std::span<const uint8_t> value;     // empty when the value lies outside the TIFF block
+};
+
+/**
+ * @brief Reads the TIFF structure inside an EXIF block (the APP1 payload after "Exif\0\0").
+ *
+ * Offsets in the block are relative to its TIFF header and are read from the file, so every one of
+ * them is checked against the block before it is followed: an entry pointing outside the block gets an
+ * empty value rather than a read past it, and directories are capped at `MaxEntries` entries. Only
+ * the header is validated up front; a bad byte order mark or magic number throws `std::runtime_error`.
+ */
+class ExifReader {
+public:
+    explicit ExifReader(std::span<const uint8_t> tiff);
+
+    //Offset of IFD0, the primary image's directory.
+    uint32_t firstDirectory() const {
+        return first;
+    }
+
+    /**
+     * @brief Visits the entries of the directory at `directory`.
+     *
+     * @param directory Offset of the directory within the TIFF block, e.g. from a `SubIfd` pointer.
+     * @param visit Called as `bool visit(const ExifEntry&)` for each entry; returning false stops the walk.
+     * @return The number of entries visited.
+     */
+    template <typename Visitor>
+    uint32_t forEachEntry(uint32_t directory, Visitor&& visit) const {
+        if (!reader.has(directory, 2)) {
+            return 0;
+        }
+        uint32_t count = std::min<uint32_t>(u16(directory), MaxEntries);
+        uint32_t visited = 0;
+        ExifEntry entry;
+        while (visited < count && readEntry(directory + 2 + 12 * visited, entry)) {
+            ++visited;
+            if (!visit(static_cast<const ExifEntry&>(entry))) {
+                break;
+            }
+        }
+        return visited;
+    }
+
+    //The `index`th value of a BYTE, SHORT or LONG entry.
+    std::optional<uint32_t> integer(const ExifEntry& entry, uint32_t index = 0) const;
+
+    //The `index`th value of a RATIONAL or SRATIONAL entry.
+    std::optional<double> rational(const ExifEntry& entry, uint32_t index = 0) const;
+
+    //The text of an ASCII entry, without its terminating NUL and trailing spaces.
+    std::string_view text(const ExifEntry& entry) const;
+
+    //Directories are capped at this many entries.
+    static constexpr uint32_t MaxEntries = 512;
+
+    // Tags used by the extractors
+    static constexpr uint16_t Make = 0x010F;
+    static constexpr uint16_t Model = 0x0110;
+    static constexpr uint16_t Orientation = 0x0112;
+    static constexpr uint16_t Software = 0x0131;
+    static constexpr uint16_t DateTime = 0x0132;
+    static constexpr uint16_t ExifIfd = 0x8769;
+    static constexpr uint16_t GpsIfd = 0x8825;
+    static constexpr uint16_t ExposureTime = 0x829A;
+    static constexpr uint16_t FNumber = 0x829D;
+    static constexpr uint16_t IsoSpeed = 0x8827;
+    static constexpr uint16_t DateTimeOriginal = 0x9003;
+    static constexpr uint16_t OffsetTimeOriginal = 0x9011;
+    static constexpr uint16_t FocalLength = 0x920A;
+    static constexpr uint16_t GpsLatitudeRef = 0x0001;
+    static constexpr uint16_t GpsLatitude = 0x0002;
+    static constexpr uint16_t GpsLongitudeRef = 0x0003;
+    static constexpr uint16_t GpsLongitude = 0x0004;
+    static constexpr uint16_t GpsAltitudeRef = 0x0005;
+    static constexpr uint16_t GpsAltitude = 0x0006;
+
+private:
+    //Decodes the 12-byte entry at `offset`; false when it does not fit in the block.
+    bool readEntry(uint32_t offset, ExifEntry& entry) const;
+
+    uint16_t u16(std::size_t offset) const {
+        return bigEndian ? reader.u16be(offset) : reader.u16le(offset);
+    }
+
+    uint32_t u32(std::size_t offset) const {
+        return bigEndian ? reader.u32be(offset) : reader.u32le(offset);
+    }
+
+    ByteReader reader;
+    bool bigEndian = false;
+    uint32_t first = 0;
+};
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef FILE_CONTEXT_H
+#define FILE_CONTEXT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+#include <sys/stat.h>
+#include "ByteReader.h"
+
+/**
+ * @brief An opened file shared by type detection and every metadata extractor.
+ *
+ * The constructor opens the file once and issues a single `fstat`. Non-empty regular files are then
+ * memory-mapped read-only, so extractors parse straight out of the page cache and only the pages they
+ * touch are faulted in; anything that cannot be mapped falls back to a single prefix read. Either way,
+ * analyzing one file costs one open and one fstat no matter how many extractors run.
+ *
+ * Truncating a mapped file while it is being analyzed would raise SIGBUS on access to the vanished pages.
+ * A process-wide handler catches faults inside live mappings instead, backs the missing pages with zeros
+ * and marks the context, so callers check `wasTruncated()` once parsing is done and report the file as
+ * an error rather than losing the process. Faults anywhere else go to the previously installed handler.
+ */
+class FileContext {
+public:
+    //Bytes exposed by `prefix()`; large enough for every fixed header and the usual JPEG APP segments
+    static constexpr std::size_t DefaultPrefixSize = 64 * 1024;
+
+    /**
+     * @brief Opens, stats and maps the file. Failures are reported through `isOpen()`.
+     *
+     * @param filePath The path to the file.
+     * @param prefixSize How many leading bytes `prefix()` covers (and to read when mapping is impossible).
+     */
+    explicit FileContext(const std::filesystem::path& filePath, std::size_t prefixSize = DefaultPrefixSize);
+
+    /**
+     * @brief Adopts a file that an `IoEngine` already opened, stat'ed and started reading.
+     *
+     * Files that fit in `prefix` are used straight from it; larger ones are mapped so extractors can
+     * reach past the prefix (whose pages the read has just brought into the page cache).
+     *
+     * @param filePath The path to the file.
+     * @param descriptor An open descriptor, owned by the context from now on.
+     * @param fileStat The file's status.
+     * @param prefix The first bytes of the file.
+     * @param prefixSize How many leading bytes `prefix()` covers.
+     */
+    FileContext(const std::filesystem::path& filePath, int descriptor, const struct stat& fileStat,
+                std::vector<std::uint8_t> prefix, std::size_t prefixSize = DefaultPrefixSize);
+
+    /**
+     * @brief Wraps bytes that are already in memory, e.g. a member of an archive, without opening anything.
+     *
+     * `isOpen()` is true and `descriptor()` is -1. `bytes()` views `contents`, which must outlive the
+     * context; it may be shorter than `fileStat.st_size`, in which case `isComplete()` is false.
+     *
+     * @param filePath The path reported for the contents.
+     * @param fileStat The status reported for the contents.
+     * @param contents The contents (or their leading part).
+     * @param prefixSize How many leading bytes `prefix()` covers.
+     */
+    FileContext(const std::filesystem::path& filePath, const struct stat& fileStat, std::span<const std::uint8_t> contents,
+                std::size_t prefixSize = DefaultPrefixSize);
+
+    // Unmaps the file and closes the file descriptor
+    ~FileContext();
+
+    FileContext(const FileContext&) = delete;
+    FileContext& operator=(const FileContext&) = delete;
+
+    //The path the context was opened with.
+    const std::filesystem::path& path() const {
+        return filePath;
+    }
+
+    //Checks whether the file was opened and stat'ed successfully.
+    bool isOpen() const {
+        return fd >= 0 || inMemory;
+    }
+
+    //The open file descriptor, or -1.
+    int descriptor() const {
+        return fd;
+    }
+
+    //Result of the single fstat call.
+    const struct stat& status() const {
+        return fileStat;
+    }
+
+    //Size of the file in bytes.
+    std::uint64_t size() const {
+        return static_cast<std::uint64_t>(fileStat.st_size);
+    }
+
+    //Checks whether the whole file is memory-mapped.
+    bool isMapped() const {
+        return mapping != nullptr;
+    }
+
+    //Checks whether `bytes()` covers the whole file, either mapped or read in full.
+    bool isComplete() const {
+        return mapping || (S_ISREG(fileStat.st_mode) && bytes().size() == size());
+    }
+
+    //The whole file when mapped (or the contents given), otherwise the prefix that was read.
+    std::span<const std::uint8_t> bytes() const {
+        if (mapping) {
+            return {mapping, static_cast<std::size_t>(size())};
+        }
+        if (inMemory) {
+            return contents;
+        }
+        return {prefixBuffer.data(), prefixBuffer.size()};
+    }
+
+    //The leading bytes of the file (shorter than requested if the file is).
+    std::span<const std::uint8_t> prefix() const {
+        return bytes().first(std::min<std::size_t>(bytes().size(), prefixLength));
+    }
+
+    //A bounds-checked reader over `bytes()`.
+    ByteReader reader() const {
+        return ByteReader(bytes());
+    }
+
+    /**
+     * @brief Copies bytes at an absolute offset out of the mapping (or the prefix, then `pread`).
+     *
+     * @param offset Offset from the start of the file.
+     * @param buffer Destination buffer.
+     * @param length Number of bytes wanted.
+     * @return The number of bytes copied, which is less than `length` at end of file or on error.
+     */
+    std::size_t readAt(std::uint64_t offset, void* buffer, std::size_t length) const;
+
+    //Checks whether the file shrank under the mapping; the vanished pages have read as zeros since.
+    bool wasTruncated() const {
+        return truncated.load(std::memory_order_relaxed);
+    }
+
+    //Tells the kernel the mapping is about to be read front to back, so readahead fetches it in large chunks.
+    void adviseSequential() const;
+
+private:
+    //Maps the whole file and registers the mapping with the SIGBUS handler; false if either is impossible.
+    bool map();
+
+    std::filesystem::path filePath;
+    int fd = -1;
+    struct stat fileStat {};
+    const std::uint8_t* mapping = nullptr;
+    std::size_t prefixLength = 0;
+    std::vector<std::uint8_t> prefixBuffer; // only used when the file is not mapped
+    std::span<const std::uint8_t> contents; // only used for contents already in memory
+    bool inMemory = false;
+    std::size_t guardSlot = 0; // this mapping's slot in the SIGBUS handler's table
+    std::atomic<bool> truncated{false}; // set from the SIGBUS handler
+};
+
+#endif
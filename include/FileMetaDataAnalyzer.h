@@ -7,7 +7,16 @@
 #include <cstring>
 #include <type_traits>
 #include <concepts>
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <memory_resource>
+#include <span>
 #include "CustomMap.h"
+#include "MetadataValue.h"
+#include "FileContext.h"
+
+struct TextSummary;
 
 //Enumeration representing the supported file types.
 enum class FileType {
@@ -24,12 +33,13 @@ enum class FileType {
 
 
 struct BasicMetadata {
-    std::string fileName;
-    std::string fileSize;
-    std::string fileType;
-    std::string creationTime;
-    std::string lastModified;
-    std::string lastAccess;
+    std::pmr::string fileName;  // allocated from the resource passed to extractBasicMetadata
+    std::pmr::string fileType;
+    bool hasStatus = false;     // the fields below are only known when the file could be stat'ed
+    uint64_t fileSize = 0;
+    Timestamp creationTime;     // status change time (st_ctime)
+    Timestamp lastModified;
+    Timestamp lastAccess;
 };
 
 //Structure representing the header of a JPEG file.
@@ -125,10 +135,183 @@ inline constexpr uint8_t PNGSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A
 inline constexpr uint8_t BMPSignature[] = {'B', 'M'};
 inline constexpr uint8_t PDFSignature[] = {'%', 'P', 'D', 'F'};
 inline constexpr uint8_t ZIPSignature[] = {0x50, 0x4B, 0x03, 0x04};
-inline constexpr char WAVSignature[] = {'R', 'I', 'F', 'F'};
+inline constexpr uint8_t WAVSignature[] = {'R', 'I', 'F', 'F'};
+inline constexpr uint8_t RF64Signature[] = {'R', 'F', '6', '4'};
+inline constexpr uint8_t BW64Signature[] = {'B', 'W', '6', '4'};
+inline constexpr std::span<const uint8_t> WAVAlternativeSignatures[] = {RF64Signature, BW64Signature};
 inline constexpr uint8_t GIFSignature[] = {0x47, 0x49, 0x46}; // "GIF" in ASCII
 
+/**
+ * @brief Magic bytes and `FileType` declared by a file header type.
+ *
+ * Specializations provide `type` and `magic`, plus optionally `alternatives` (further signatures of the
+ * same type). An empty `magic` marks the fallback type reported when no other signature in a
+ * `determineFileType` pack matches. Types without a specialization (such as `LogicalScreenDescriptor`)
+ * take no part in detection. Adding a format means adding a specialization;
+ * the dispatch table below is rebuilt from the pack at compile time.
+ */
+template <typename T>
+struct FileSignatureTraits;
+
+template <> struct FileSignatureTraits<JPEGHeader> {
+    static constexpr FileType type = FileType::JPEG;
+    static constexpr std::span<const uint8_t> magic = JPEGSignature;
+};
+
+template <> struct FileSignatureTraits<PNGHeader> {
+    static constexpr FileType type = FileType::PNG;
+    static constexpr std::span<const uint8_t> magic = PNGSignature;
+};
+
+template <> struct FileSignatureTraits<BMPHeader> {
+    static constexpr FileType type = FileType::BMP;
+    static constexpr std::span<const uint8_t> magic = BMPSignature;
+};
+
+template <> struct FileSignatureTraits<poppler::document> {
+    static constexpr FileType type = FileType::PDF;
+    static constexpr std::span<const uint8_t> magic = PDFSignature;
+};
+
+template <> struct FileSignatureTraits<ZIPHeader> {
+    static constexpr FileType type = FileType::ZIP;
+    static constexpr std::span<const uint8_t> magic = ZIPSignature;
+};
+
+template <> struct FileSignatureTraits<WAVHeader> {
+    static constexpr FileType type = FileType::WAV;
+    static constexpr std::span<const uint8_t> magic = WAVSignature;
+    // RF64 and BW64 are the 64-bit variants of RIFF
+    static constexpr std::span<const std::span<const uint8_t>> alternatives = WAVAlternativeSignatures;
+};
+
+template <> struct FileSignatureTraits<GIFHeader> {
+    static constexpr FileType type = FileType::GIF;
+    static constexpr std::span<const uint8_t> magic = GIFSignature;
+};
+
+// Anything unrecognized is treated as text
+template <> struct FileSignatureTraits<std::ifstream> {
+    static constexpr FileType type = FileType::TXT;
+    static constexpr std::span<const uint8_t> magic = {};
+};
+
+template <typename T>
+concept HasFileSignature = requires {
+    { FileSignatureTraits<T>::type } -> std::convertible_to<FileType>;
+    { FileSignatureTraits<T>::magic } -> std::convertible_to<std::span<const uint8_t>>;
+};
+
+/**
+ * @brief Signature dispatch table built at compile time from a pack of header types.
+ *
+ * Each signature (at most 8 bytes) is stored as a little-endian value and mask over the first 8 bytes of
+ * the file. Entries are grouped by their first byte and indexed by a 256-entry jump table, so detection is
+ * one table lookup followed by a masked 64-bit compare per signature sharing that first byte (one compare
+ * for every built-in format).
+ */
+template <typename... T>
+struct SignatureDispatch {
+    struct Entry {
+        uint64_t value = 0;
+        uint64_t mask = 0;
+        FileType type = FileType::UNKNOWN;
+    };
+
+    //Number of table entries a header type contributes: its magic and any alternatives.
+    template <typename U>
+    static consteval std::size_t signatureCount() {
+        if constexpr (!HasFileSignature<U>) {
+            return 0;
+        } else if constexpr (FileSignatureTraits<U>::magic.empty()) {
+            return 0;
+        } else if constexpr (requires { FileSignatureTraits<U>::alternatives; }) {
+            return 1 + FileSignatureTraits<U>::alternatives.size();
+        } else {
+            return 1;
+        }
+    }
+
+    static constexpr std::size_t entryCount = (signatureCount<T>() + ... + 0);
+
+    struct Table {
+        std::array<Entry, entryCount> entries{};
+        std::array<uint8_t, 256> first{};
+        std::array<uint8_t, 256> count{};
+        FileType fallback = FileType::UNKNOWN;
+    };
+
+    static consteval Table build() {
+        static_assert(entryCount < 256, "Too many signatures for the jump table");
+        Table table;
+        std::array<Entry, entryCount> unsorted{};
+        std::size_t n = 0;
+
+        auto addEntry = [&](std::span<const uint8_t> magic, FileType type) {
+            Entry entry;
+            for (std::size_t i = 0; i < magic.size(); ++i) {
+                entry.value |= static_cast<uint64_t>(magic[i]) << (8 * i);
+                entry.mask |= uint64_t{0xFF} << (8 * i);
+            }
+            entry.type = type;
+            unsorted[n++] = entry;
+        };
+        auto add = [&]<typename U>() {
+            if constexpr (HasFileSignature<U>) {
+                constexpr std::span<const uint8_t> magic = FileSignatureTraits<U>::magic;
+                static_assert(magic.size() <= 8, "Signatures longer than 8 bytes are not supported");
+                if constexpr (magic.empty()) {
+                    table.fallback = FileSignatureTraits<U>::type;
+                } else {
+                    addEntry(magic, FileSignatureTraits<U>::type);
+                    if constexpr (requires { FileSignatureTraits<U>::alternatives; }) {
+                        for (std::span<const uint8_t> alternative : FileSignatureTraits<U>::alternatives) {
+                            addEntry(alternative, FileSignatureTraits<U>::type);
+                        }
+                    }
+                }
+            }
+        };
+        (add.template operator()<T>(), ...);
+
+        // Group by first byte (stable, so pack order decides between signatures sharing a first byte)
+        std::size_t out = 0;
+        for (std::size_t byte = 0; byte < 256; ++byte) {
+            table.first[byte] = static_cast<uint8_t>(out);
+            for (std::size_t i = 0; i < entryCount; ++i) {
+                if ((unsorted[i].value & 0xFF) == byte) {
+                    table.entries[out++] = unsorted[i];
+                    ++table.count[byte];
+                }
+            }
+        }
+        return table;
+    }
+
+    static constexpr Table table = build();
+
+    /**
+     * @brief Matches the first bytes of a file against every signature in the pack.
+     *
+     * @param prefix The leading bytes of the file; missing bytes are treated as zero.
+     * @return The matching type, or the pack's fallback type (UNKNOWN if it has none).
+     */
+    static FileType match(std::span<const uint8_t> prefix) {
+        uint64_t head = 0;
+        for (std::size_t i = 0; i < std::min<std::size_t>(prefix.size(), 8); ++i) {
+            head |= static_cast<uint64_t>(prefix[i]) << (8 * i);
+        }
 
+        uint8_t byte = static_cast<uint8_t>(head);
+        const Entry* entry = table.entries.data() + table.first[byte];
+        for (uint8_t i = 0; i < table.count[byte]; ++i, ++entry) {
+            if ((head & entry->mask) == entry->value) {
+                return entry->type;
+            }
+        }
+        return table.fallback;
+    }
+};
 
 /**
  * @brief Concept to ensure the template parameter T is a valid file header type.
@@ -150,10 +333,11 @@ concept FileHeader = std::is_same_v<T, poppler::document> ||
 /**
  * @brief Determines the file type of the given file path.
  *
- * This function uses a fold expression to check the file signature and return the corresponding `FileType`.
+ * Only the types in the pack are detected: their `FileSignatureTraits` are folded into a compile-time
+ * `SignatureDispatch` table and the file's first 8 bytes are looked up in it.
  *
  * @tparam T The supported file header types.
- * @param filePath The path to the file.
+ * @param context The opened file; only its prefix buffer is inspected.
  * @return The determined file type.
  * *
  * This class demonstrates the use of several C++ features, including:
@@ -164,7 +348,14 @@ concept FileHeader = std::is_same_v<T, poppler::document> ||
  */
 template <typename... T>
     requires (sizeof...(T) > 0)
-FileType determineFileType(const std::filesystem::path& filePath);
+FileType determineFileType(const FileContext& context);
+
+//Convenience overload that opens a `FileContext` for a single call.
+template <typename... T>
+    requires (sizeof...(T) > 0)
+FileType determineFileType(const std::filesystem::path& filePath) {
+    return determineFileType<T...>(FileContext(filePath));
+}
 
 
 /**
@@ -173,11 +364,12 @@ FileType determineFileType(const std::filesystem::path& filePath);
  * This is a helper function that is called by the `FileMetaDataAnalyzer` class. It extracts the metadata based on the file type.
  *
  * @tparam T The file header type.
- * @param filePath The path to the file.
+ * @param context The opened file shared by every extractor.
+ * @param memory Where the map and its text values are allocated.
  * @return A `CustomMap` containing the extracted metadata.
  */
 template <typename T>
-CustomMap<std::string, std::string> analyzeMetadataHelper(const std::filesystem::path& filePath);
+MetadataMap analyzeMetadataHelper(const FileContext& context, std::pmr::memory_resource* memory);
 
 /**
  * @brief A class that analyzes the metadata of files.
@@ -190,30 +382,113 @@ template <FileHeader... T>
 class FileMetaDataAnalyzer {
 public:
     /**
-     * @brief Analyzes the metadata of the file at the given path.
+     * @brief Analyzes the metadata of an already opened file.
      *
-     * @param filePath The path to the file.
+     * @param context The opened file, shared by every extractor in `T...`.
+     * @param memory Where the map and its text values are allocated, e.g. a per-file `MetadataArena`.
      * @return A `CustomMap` containing the extracted metadata.
-     */  
-    static CustomMap<std::string, std::string> analyzeMetadata(const std::filesystem::path& filePath) {
-        CustomMap<std::string, std::string> metadata;
+     */
+    static MetadataMap analyzeMetadata(const FileContext& context, std::pmr::memory_resource* memory = std::pmr::get_default_resource()) {
+        MetadataMap metadata(memory);
 
-        ((void)mergeMap(metadata, analyzeMetadataHelper<T>(filePath)), ...);
+        ((void)mergeMap(metadata, analyzeMetadataHelper<T>(context, memory)), ...);
         return metadata;
     }
 
+    /**
+     * @brief Analyzes the metadata of the file at the given path.
+     *
+     * @param filePath The path to the file.
+     * @return A `CustomMap` containing the extracted metadata.
+     */
+    static MetadataMap analyzeMetadata(const std::filesystem::path& filePath) {
+        return analyzeMetadata(FileContext(filePath));
+    }
+
 private:
-    CustomMap<std::string, std::string> metadata;
+    MetadataMap metadata;
 
-    static void mergeMap(CustomMap<std::string, std::string>& dest, const CustomMap<std::string, std::string>& src) {
-        for (const auto& [key, value] : src) {
-            dest[key] = value;
+    static void mergeMap(MetadataMap& dest, MetadataMap&& src) {
+        // Grow geometrically: an exact reserve per merge would reallocate and rebuild the index every time
+        std::size_t needed = dest.size() + src.size();
+        if (needed > dest.capacity()) {
+            dest.reserve(std::max(needed, dest.capacity() * 2));
+        }
+        for (auto& [key, value] : src) {
+            dest[key] = std::move(value);
         }
     }
 
     template <typename U>
-    friend CustomMap<std::string, std::string> analyzeMetadataHelper(const std::filesystem::path& filePath);
-    
+    friend MetadataMap analyzeMetadataHelper(const FileContext& context, std::pmr::memory_resource* memory);
+
 };
 
+/**
+ * @brief Version of the extractors' output. Bump whenever an `analyzeMetadataHelper` specialization changes
+ * what it reports, so that persisted results (see `MetadataCache`) are recomputed.
+ */
+inline constexpr uint32_t MetadataAnalyzerVersion = 11;
+
+/**
+ * @brief Builds the `BasicMetadata` fields from an existing `stat` result without opening the file.
+ *
+ * @param filePath The path to the file.
+ * @param fileStat The file's status.
+ * @param memory Where the map and its text values are allocated.
+ * @return A `CustomMap` containing the basic metadata.
+ */
+MetadataMap analyzeBasicMetadata(const std::filesystem::path& filePath, const struct stat& fileStat,
+                                 std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+/**
+ * @brief Returns a printable name for a `FileType` ("PDF", "JPEG", ...).
+ */
+const char* fileTypeName(FileType fileType);
+
+/**
+ * @brief Runs the `FileMetaDataAnalyzer` specialization that matches an already determined file type.
+ *
+ * @param context The opened file.
+ * @param fileType The type returned by `determineFileType`.
+ * @param includeBasic Whether to include the `BasicMetadata` fields.
+ * @param includeSpecialized Whether to include the format specific fields.
+ * @param memory Where the map and its text values are allocated, e.g. a per-file `MetadataArena`.
+ * @return A `CustomMap` containing the extracted metadata.
+ * @throws std::runtime_error If the file type is unsupported or the extractor rejects the file.
+ */
+MetadataMap analyzeFileMetadata(const FileContext& context, FileType fileType, bool includeBasic, bool includeSpecialized,
+                                std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+//Leading lines a text's `TextReader` has to keep: they become its Title and Author.
+inline constexpr std::size_t TextHeadLines = 2;
+
+/**
+ * @brief Adds the TXT fields of a text already run through a `TextReader`, for callers that stream the
+ * text themselves (the TXT extractor does the same with `readTextFile`).
+ *
+ * @param metadata The map to add to.
+ * @param text What the reader found; `AnalyzedBytes` is added when it saw less than `context.size()` bytes.
+ * @param context The file the text came from; only its path and size are used.
+ * @param memory Where text values are allocated.
+ */
+void addTextMetadata(MetadataMap& metadata, const TextSummary& text, const FileContext& context,
+                     std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+/**
+ * @brief Verifies the checksums a file carries for its own contents.
+ *
+ * Unlike the extractors, which only read headers, this reads every byte of the file: for PNG, the CRC of
+ * each chunk is recomputed with `updateCrc32`. File types without embedded checksums yield an empty map.
+ *
+ * @param context The opened file; it must be mapped or read in full.
+ * @param fileType The type returned by `determineFileType`.
+ * @param memory Where the map is allocated.
+ * @return "Integrity" ("corrupt" on a CRC mismatch or a stream cut short, "ok" otherwise) and "CRCErrors",
+ *         the number of chunks whose CRC does not match.
+ * @throws std::runtime_error If the extractor's reader rejects the file.
+ */
+MetadataMap verifyFileIntegrity(const FileContext& context, FileType fileType,
+                                std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
 #endif
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+//One change reported by a `FileWatcher`.
+struct WatchEvent {
+    enum class Kind {
+        Changed,            // a file was written, created or moved in
+        AttributesChanged,  // permissions, owner or times of a file changed, not its contents
+        Removed,            // a file was deleted or moved out
+        DirectoryAdded,     // a directory was created or moved in (and is now watched)
+        DirectoryRemoved,   // a directory was deleted or moved out
+        Overflow            // the kernel queue overflowed: events were lost and the trees need a rescan
+    };
+
+    Kind kind = Kind::Changed;
+    std::filesystem::path path;     // empty for Overflow
+};
+
+/**
+ * @brief Watches directory trees for changes with inotify.
+ *
+ * inotify watches single directories, so `watchTree` adds one watch per directory of the tree, and
+ * directories created later are added as their creation is reported. Events are read without blocking
+ * from `descriptor()` once `poll` says it is readable. Watches count against the per-user
+ * `fs.inotify.max_user_watches` limit.
+ */
+class FileWatcher {
+public:
+    //Creates the inotify instance; throws `std::system_error` when the kernel refuses.
+    FileWatcher();
+
+    // Closes the inotify descriptor, dropping every watch
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    /**
+     * @brief Watches a directory and every directory below it. Unreadable directories are skipped.
+     *
+     * @param root The top of the tree.
+     * @param followSymlinks Whether to descend into symlinked directories.
+     * @throws std::system_error When the watch limit is reached.
+     */
+    void watchTree(const std::filesystem::path& root, bool followSymlinks = false);
+
+    /**
+     * @brief Reads every queued event without blocking.
+     *
+     * @param events Receives the events, in kernel order.
+     * @return The number of events appended.
+     */
+    std::size_t readEvents(std::vector<WatchEvent>& events);
+
+    //The inotify descriptor, to poll for readability.
+    int descriptor() const {
+        return fd;
+    }
+
+    //Directories currently watched.
+    std::size_t watchCount() const {
+        return directories.size();
+    }
+
+private:
+    //Removes the watches of a directory and its subdirectories, e.g. once it has moved away.
+    void unwatchTree(const std::filesystem::path& root);
+
+    int fd = -1;
+    bool followSymlinks = false;
+    std::unordered_map<int, std::filesystem::path> directories; // watch descriptor -> directory
+    std::map<std::filesystem::path, int> watches;               // directory -> watch descriptor, ordered so subtrees are adjacent
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef GIF_READER_H
+#define GIF_READER_H
+
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include "ByteReader.h"
+
+//The Logical Screen Descriptor that follows the 6-byte header.
+struct GifScreen {
+    uint16_t width = 0;
+    uint16_t height = 0;
+    uint8_t packedFields = 0;
+    uint8_t backgroundColorIndex = 0;
+    uint8_t pixelAspectRatio = 0;
+
+    //Size in bytes of the global color table that follows the descriptor (0 when there is none).
+    uint32_t globalColorTableSize() const {
+        return packedFields & 0x80 ? 3u << ((packedFields & 0x07) + 1) : 0;
+    }
+};
+
+//One top-level block of a GIF stream: an image, an extension or the trailer.
+struct GifBlock {
+    uint8_t introducer = 0;     // 0x2C image, 0x21 extension, 0x3B trailer
+    uint8_t label = 0;          // extension label (0xF9 graphic control, 0xFE comment, 0xFF application)
+    std::span<const uint8_t> header; // image descriptor after the introducer, or an extension's first sub-block
+    uint64_t offset = 0;        // of the introducer
+    uint64_t subBlocks = 0;     // of the first sub-block length byte
+
+    bool isImage() const {
+        return introducer == ImageIntroducer;
+    }
+
+    bool isExtension(uint8_t extensionLabel) const {
+        return introducer == ExtensionIntroducer && label == extensionLabel;
+    }
+
+    static constexpr uint8_t ImageIntroducer = 0x2C;
+    static constexpr uint8_t ExtensionIntroducer = 0x21;
+    static constexpr uint8_t Trailer = 0x3B;
+    static constexpr uint8_t GraphicControl = 0xF9;
+    static constexpr uint8_t Comment = 0xFE;
+    static constexpr uint8_t Application = 0xFF;
+};
+
+/**
+ * @brief Walks the blocks of a GIF stream without decoding any image data.
+ *
+ * Color tables are skipped by the size their flags announce and LZW data by the length byte of each
+ * sub-block, so a frame costs one step per 255 bytes of compressed data. The chain of sub-blocks is
+ * followed on the raw bytes with a single bounds check per sub-block. The walk ends after the trailer,
+ * or early when a block runs past the available bytes. A bad signature or a short Logical Screen
+ * Descriptor throws `std::runtime_error`.
+ */
+class GifReader {
+public:
+    explicit GifReader(std::span<const uint8_t> file);
+
+    //"87a" or "89a".
+    std::string_view version() const {
+        return reader.chars(3, 3);
+    }
+
+    const GifScreen& screen() const {
+        return logicalScreen;
+    }
+
+    /**
+     * @brief Visits every block in order, the trailer included.
+     *
+     * @param visit Called as `bool visit(const GifBlock&)` for each block; returning false stops the walk.
+     * @return The number of blocks visited.
+     */
+    template <typename Visitor>
+    uint64_t forEachBlock(Visitor&& visit) const {
+        uint64_t offset = ScreenEnd + logicalScreen.globalColorTableSize();
+        uint64_t visited = 0;
+        GifBlock block;
+        while (readBlock(offset, block)) {
+            ++visited;
+            if (!visit(static_cast<const GifBlock&>(block)) || block.introducer == GifBlock::Trailer) {
+                break;
+            }
+        }
+        return visited;
+    }
+
+    //The delay of a graphic control extension, in hundredths of a second.
+    static std::optional<uint16_t> decodeDelay(const GifBlock& block);
+
+    //The loop count of a NETSCAPE2.0 (or ANIMEXTS1.0) application extension; 0 means forever.
+    std::optional<uint16_t> decodeLoopCount(const GifBlock& block) const;
+
+    //Appends the data sub-blocks of an extension (e.g. a comment's text) to `out`, up to `limit` bytes in total.
+    void appendData(const GifBlock& block, std::pmr::string& out, std::size_t limit) const;
+
+private:
+    //Decodes the block at `offset` and advances past it; false when it does not fit or is not a block.
+    bool readBlock(uint64_t& offset, GifBlock& block) const;
+
+    //The offset just past the sub-block chain starting at `offset`, or nothing when it runs past the end.
+    std::optional<uint64_t> skipSubBlocks(uint64_t offset) const;
+
+    static constexpr std::size_t ScreenEnd = 13;    // header and Logical Screen Descriptor
+
+    std::span<const uint8_t> data;
+    ByteReader reader;
+    GifScreen logicalScreen;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef INDEX_FILE_H
+#define INDEX_FILE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "OutputSink.h"
+
+//Fields `IndexSink` builds sorted indexes for. Every other field is stored too, and queried by scanning.
+inline constexpr std::array<std::string_view, 8> IndexedFields = {
+    "FileSize", "LastModified", "CreationTime", "Width", "Height", "Duration", "Author", "Title"};
+
+/**
+ * @brief Writes records to a queryable on-disk index (`--format index`), read back by `IndexFile`.
+ *
+ * Records are streamed to the file as they arrive; the indexes are kept in memory and appended by
+ * `finish`. All integers are little-endian and every section starts 8-byte aligned. The file is the
+ * magic "FMDIDX1\0", u32 version, u32 reserved, then:
+ *
+ *     records  : per record u32 path length, path, the metadata in the `CachedRecord` layout (zero key)
+ *     offsets  : u64 offset of every record
+ *     types    : per `FileType` value a bitmap of the records of that type, u64 words[(records + 63) / 64]
+ *     fields   : per indexed field u64 byte length of the rest of the field, u32 name length, name,
+ *                numbers: u64 distinct, u64 entries, f64 values[distinct] (ascending),
+ *                         u32 runStart[distinct + 1], u32 records[entries]
+ *                texts  : u64 distinct, u64 entries, u64 offsets[distinct + 1], bytes (ascending),
+ *                         u32 runStart[distinct + 1], u32 records[entries]
+ *     footer   : u64 records, u64 offsets offset, u64 types offset, u64 fields offset, u64 field count,
+ *                "FIDXEND\0"
+ *
+ * The records holding the i-th distinct value are `records[runStart[i]..runStart[i + 1])`. Integers
+ * and reals are indexed as numbers, times as seconds since the epoch, text as bytes. Record numbers
+ * are 32-bit, so one index holds at most 2^32 - 1 records.
+ */
+class IndexSink : public OutputSink {
+public:
+    explicit IndexSink(std::FILE* out);
+    void write(const OutputRecord& record) override;
+    void finish() override;
+
+private:
+    struct FieldEntries {
+        std::vector<std::pair<double, uint32_t>> numbers;
+        std::vector<std::pair<std::string, uint32_t>> texts;
+    };
+
+    //Byte offset in the file of the end of the buffer.
+    uint64_t position() const {
+        return flushedBytes + buffer.size();
+    }
+
+    void pad();
+    void spill();
+    void writeField(std::string_view name, FieldEntries& entries);
+
+    uint64_t flushedBytes = 0;
+    std::vector<uint64_t> recordOffsets;
+    std::vector<uint8_t> fileTypes;
+    std::array<FieldEntries, IndexedFields.size()> fields;
+};
+
+/**
+ * @brief A memory-mapped index written by `IndexSink`, answering queries without touching the scanned files.
+ *
+ * A query is a boolean expression of field predicates:
+ *
+ *     FileType=PNG && Width>4000
+ *     (Author="Jane Doe" || Title=Report) && LastModified>=2024-01-01
+ *     Duration && !(FileSize<10M)
+ *
+ * A predicate is `<field> <op> <value>` with `=`, `!=`, `<`, `<=`, `>` or `>=`, or a bare field name,
+ * which matches the records having that field. `&&` binds tighter than `||`; `!` negates. Values
+ * containing spaces or operator characters are double-quoted. A value that reads as a number (with an
+ * optional binary K, M, G or T suffix) or as a UTC date ("2024-01-31", "2024-01-31T12:00:00Z")
+ * compares numerically with numbers and times; `=` and `!=` also compare it as text with text values,
+ * and `<`-style comparisons with any other value compare text lexicographically. A record lacking the
+ * field never matches a comparison, `!=` included.
+ *
+ * `FileType` is the type `determineFileType` reported and compares case-insensitively by name;
+ * `Path` is the record's path. Predicates on `FileType` and the `IndexedFields` are answered from the
+ * indexes with binary searches and bitmaps; predicates on other fields scan the stored records.
+ */
+class IndexFile {
+public:
+    /**
+     * @brief Maps an index file.
+     *
+     * @throws std::runtime_error If the file cannot be read or is not a complete index.
+     */
+    explicit IndexFile(const std::filesystem::path& indexPath);
+
+    ~IndexFile();
+
+    IndexFile(const IndexFile&) = delete;
+    IndexFile& operator=(const IndexFile&) = delete;
+
+    //Number of records.
+    std::size_t size() const {
+        return recordCount;
+    }
+
+    /**
+     * @brief Evaluates a query.
+     *
+     * @param expression The query, in the syntax described above.
+     * @return The numbers of the matching records, in the order they were written.
+     * @throws std::invalid_argument If the expression is malformed.
+     */
+    std::vector<uint32_t> query(std::string_view expression) const;
+
+    //Copies a record out of the mapping.
+    OutputRecord record(uint32_t number) const;
+
+private:
+    //One indexed field, as pointers into the mapping (see `IndexSink` for the layout).
+    struct FieldIndex {
+        struct Part {
+            uint64_t distinct = 0;
+            uint64_t entries = 0;
+            const uint8_t* values = nullptr;    // f64 values, or u64 text offsets
+            const uint8_t* text = nullptr;      // text bytes (texts only)
+            uint64_t textSize = 0;
+            const uint8_t* runStart = nullptr;
+            const uint8_t* records = nullptr;
+        };
+        std::string_view name;
+        Part numbers;
+        Part texts;
+    };
+
+    class Evaluator;
+
+    const uint8_t* mapping = nullptr;
+    std::size_t mappingSize = 0;
+    std::size_t recordCount = 0;
+    uint64_t offsetsOffset = 0;
+    uint64_t typesOffset = 0;
+    std::vector<FieldIndex> fieldIndexes;
+};
+
+#endif
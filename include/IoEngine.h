@@ -0,0 +1,148 @@
+#ifndef IO_ENGINE_H
+#define IO_ENGINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include <sys/stat.h>
+#include "FileContext.h"
+
+//Which engine performs the stat/open/read of files before they are parsed.
+enum class IoBackend {
+    Auto,       // io_uring when the kernel allows it, otherwise Threads
+    Uring,      // batched statx/openat/read through one io_uring
+    Threads,    // blocking calls on a dedicated pool of I/O threads
+    Blocking    // no engine: every scan worker opens and reads its own files
+};
+
+/**
+ * @brief Parses a `--io` name: "auto", "uring", "threads" or "blocking".
+ *
+ * @throws std::invalid_argument For any other name.
+ */
+IoBackend parseIoBackend(std::string_view name);
+
+//Returns the `--io` name of a backend.
+const char* ioBackendName(IoBackend backend);
+
+/**
+ * @brief How many descriptors an engine may hold open by default: half of the RLIMIT_NOFILE soft limit.
+ *
+ * The other half is left to the rest of the process: scan workers listing directories or opening
+ * files themselves, the output, the cache and the libraries the extractors use.
+ */
+std::size_t defaultMaxOpenFiles();
+
+//Tuning for an I/O engine.
+struct IoEngineOptions {
+    std::size_t prefixSize = FileContext::DefaultPrefixSize; // bytes read from the start of each file
+    std::size_t queueDepth = 256;       // files in flight at once
+    std::size_t fallbackThreads = 16;   // I/O threads of the Threads backend
+    std::size_t maxOpenFiles = defaultMaxOpenFiles(); // descriptors opened and not yet released, in flight or completed
+};
+
+//Outcome of prefetching one file.
+struct PrefetchedFile {
+    std::filesystem::path path;
+    int error = 0;                      // errno of the step that failed, 0 on success
+    struct stat status {};
+    int fd = -1;                        // open descriptor when the contents were read; the handler owns it
+    std::vector<std::uint8_t> prefix;   // the first min(prefixSize, size) bytes
+};
+
+/**
+ * @brief Asynchronous batch prefetcher: stat, open and read the first bytes of many files at once.
+ *
+ * Paths are queued with `submit` and complete in any order. Each completion is handed to the
+ * `Completion` callback on an engine thread, which should only pass it on to the parsing stage (see
+ * `FileContext`'s adopting constructor). The optional `NeedContents` predicate is asked after the stat;
+ * when it returns false the file is completed without being opened, e.g. for metadata cache hits.
+ *
+ * A completed file's descriptor still counts against `IoEngineOptions::maxOpenFiles` until the handler
+ * calls `releaseDescriptor`. At the cap no further files are opened, so completions waiting for a parsing
+ * worker cannot exhaust the process's descriptors however many files are queued.
+ */
+class IoEngine {
+public:
+    using Completion = std::function<void(PrefetchedFile&&)>;
+    using NeedContents = std::function<bool(const std::filesystem::path&, const struct stat&)>;
+
+    IoEngine(IoEngineOptions options, Completion onComplete, NeedContents needContents);
+    virtual ~IoEngine() = default;
+
+    IoEngine(const IoEngine&) = delete;
+    IoEngine& operator=(const IoEngine&) = delete;
+
+    //Queues a batch of paths; safe to call from any thread.
+    virtual void submit(std::vector<std::filesystem::path> paths) = 0;
+
+    /**
+     * @brief Blocks until every submitted path has been completed.
+     *
+     * @return Whether anything was still outstanding when called.
+     * @throws std::exception What stopped the engine thread, if it failed; every later call throws it again.
+     */
+    bool wait();
+
+    //The backend actually in use.
+    virtual IoBackend backend() const = 0;
+
+    //Tells the engine that a completed file's descriptor has been closed, so another file may be opened.
+    void releaseDescriptor();
+
+protected:
+    //Counts paths as outstanding before they are queued.
+    void begin(std::size_t count);
+
+    //Hands a finished file to the completion callback and marks it done.
+    void finish(PrefetchedFile&& file);
+
+    //Records why the engine stopped completing files, waking `wait` to rethrow it.
+    void fail(std::exception_ptr error);
+
+    //Counts a descriptor about to be opened; false when `maxOpenFiles` are already open.
+    bool acquireDescriptor();
+
+    //Gives back the count of an open that failed or whose descriptor was closed before completion.
+    void dropDescriptor() {
+        --openDescriptors;
+    }
+
+    //Called after `releaseDescriptor`, from the releasing thread, to open files held back at the cap.
+    virtual void descriptorReleased() = 0;
+
+    //Asks the `NeedContents` predicate, if any.
+    bool needsContents(const PrefetchedFile& file) const {
+        return !needContents || needContents(file.path, file.status);
+    }
+
+    IoEngineOptions options;
+
+private:
+    Completion onComplete;
+    NeedContents needContents;
+    std::atomic<std::size_t> openDescriptors{0};
+    std::size_t outstanding = 0;
+    std::exception_ptr failure;         // guarded by `outstandingMutex`
+    std::mutex outstandingMutex;
+    std::condition_variable drained;
+};
+
+/**
+ * @brief Creates the engine for a backend. `Auto` falls back to `Threads` when io_uring is unavailable.
+ *
+ * @throws std::runtime_error When `Uring` is requested explicitly and the ring cannot be set up.
+ * @throws std::invalid_argument For `IoBackend::Blocking`, which has no engine.
+ */
+std::unique_ptr<IoEngine> makeIoEngine(IoBackend backend, IoEngineOptions options,
+                                       IoEngine::Completion onComplete, IoEngine::NeedContents needContents = nullptr);
+
+#endif
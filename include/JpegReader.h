@@ -0,0 +1,85 @@
+#ifndef JPEG_READER_H
+#define JPEG_READER_H
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include "ByteReader.h"
+
+//One marker segment of a JPEG stream. `data` follows the length field and points into the file bytes.
+struct JpegSegment {
+    uint8_t marker = 0;     // second byte of the marker, e.g. 0xE1 for APP1
+    std::span<const uint8_t> data;
+    uint64_t offset = 0;    // of the 0xFF that starts the marker
+
+    //Checks whether the segment is an APPn segment whose payload starts with `identifier` (e.g. "Exif\0\0").
+    bool isApp(uint8_t n, std::string_view identifier) const {
+        return marker == 0xE0 + n && data.size() >= identifier.size() &&
+               std::string_view(reinterpret_cast<const char*>(data.data()), identifier.size()) == identifier;
+    }
+};
+
+//The fields of a start-of-frame (SOFn) segment.
+struct JpegFrame {
+    uint8_t marker = 0;     // 0xC0 baseline, 0xC2 progressive, ...
+    uint8_t precision = 0;  // bits per sample
+    uint16_t height = 0;
+    uint16_t width = 0;
+    uint8_t components = 0;
+};
+
+/**
+ * @brief Walks the marker segments of a JPEG stream up to the start of the image data.
+ *
+ * Segments are found through their length fields and the walk stops at SOS (start of scan), the last
+ * segment before the entropy-coded data, so only the header area of a file is read however large its
+ * image is: for camera files that is the EXIF block and a few small tables, usually a few kilobytes.
+ * The walk also ends early when a segment runs past the available bytes. A missing SOI marker throws
+ * `std::runtime_error`.
+ */
+class JpegReader {
+public:
+    explicit JpegReader(std::span<const uint8_t> file);
+
+    /**
+     * @brief Visits every segment from the one after SOI through SOS, in order.
+     *
+     * @param visit Called as `bool visit(const JpegSegment&)` for each segment; returning false stops the walk.
+     * @return The number of segments visited.
+     */
+    template <typename Visitor>
+    uint64_t forEachSegment(Visitor&& visit) const {
+        uint64_t offset = 2;
+        uint64_t visited = 0;
+        JpegSegment segment;
+        while (readSegment(offset, segment)) {
+            ++visited;
+            if (!visit(static_cast<const JpegSegment&>(segment)) || segment.marker == StartOfScan) {
+                break;
+            }
+        }
+        return visited;
+    }
+
+    /**
+     * @brief Decodes a SOFn segment.
+     *
+     * @return The frame header, or nothing for other segments and malformed frames.
+     */
+    static std::optional<JpegFrame> decodeFrame(const JpegSegment& segment);
+
+    //Returns the coding process of a SOFn marker ("Baseline", "Progressive", ...).
+    static const char* frameProcessName(uint8_t marker);
+
+    static constexpr uint8_t StartOfScan = 0xDA;
+    static constexpr uint8_t EndOfImage = 0xD9;
+
+private:
+    //Decodes the segment at `offset` and advances past it; false at EOI or when it does not fit.
+    bool readSegment(uint64_t& offset, JpegSegment& segment) const;
+
+    ByteReader reader;
+};
+
+#endif
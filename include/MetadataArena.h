@@ -0,0 +1,77 @@
+#ifndef METADATA_ARENA_H
+#define METADATA_ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+/**
+ * @brief Monotonic memory resource for everything produced while analyzing one file.
+ *
+ * The keys, values and `CustomMap` storage of a file's metadata all die together once its record has
+ * been handed on, so they are bump-allocated from this arena and released at once by `reset()`. Unlike
+ * `std::pmr::monotonic_buffer_resource::release()`, `reset()` keeps the blocks it already obtained, so
+ * after the first few files a worker analyzes files without touching the global allocator. Blocks
+ * beyond `RetainLimit` bytes (left over from an unusually large file) are returned on reset.
+ *
+ * Not thread-safe: every worker thread owns its own arena (see `MetadataArena::forThisThread`).
+ */
+class MetadataArena : public std::pmr::memory_resource {
+public:
+    static constexpr std::size_t DefaultBlockSize = 64 * 1024;
+    static constexpr std::size_t RetainLimit = 4 * 1024 * 1024;
+
+    explicit MetadataArena(std::size_t blockSize = DefaultBlockSize);
+    ~MetadataArena() override;
+
+    MetadataArena(const MetadataArena&) = delete;
+    MetadataArena& operator=(const MetadataArena&) = delete;
+
+    //Makes every block available again. All memory handed out since the last reset must be dead.
+    void reset();
+
+    //The calling thread's arena, created on first use and destroyed with the thread.
+    static MetadataArena& forThisThread();
+
+    //Blocks obtained from the global allocator over the arena's lifetime.
+    std::size_t upstreamAllocations() const {
+        return blocksAllocated;
+    }
+
+    //Bytes currently held in blocks.
+    std::size_t reservedBytes() const {
+        return reserved;
+    }
+
+    //Most bytes handed out between two resets.
+    std::size_t highWater() const {
+        return peak;
+    }
+
+protected:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+
+    // Individual deallocations are no-ops; memory comes back with reset()
+    void do_deallocate(void*, std::size_t, std::size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+private:
+    struct Block {
+        std::byte* data;
+        std::size_t size;
+    };
+
+    std::size_t blockSize;
+    std::vector<Block> blocks;
+    std::size_t current = 0;    // block being bumped
+    std::size_t offset = 0;     // first free byte in that block
+    std::size_t used = 0;       // bytes handed out since the last reset
+    std::size_t reserved = 0;
+    std::size_t peak = 0;
+    std::size_t blocksAllocated = 0;
+};
+
+#endif
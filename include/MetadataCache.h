@@ -0,0 +1,154 @@
+#ifndef METADATA_CACHE_H
+#define METADATA_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/stat.h>
+#include "ByteReader.h"
+#include "FileMetaDataAnalyzer.h"
+
+//Identity of one version of one file. Any change to the file or to the extractors changes the key.
+struct CacheKey {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    uint64_t size = 0;
+    int64_t mtimeNs = 0;
+    uint32_t analyzerVersion = MetadataAnalyzerVersion;
+
+    static CacheKey fromStat(const struct stat& fileStat);
+
+    bool operator==(const CacheKey& other) const = default;
+};
+
+/**
+ * @brief A cached analysis result, viewed in place inside the cache mapping.
+ *
+ * Keys and text values are views into the mapped file, so a hit costs no string copies. The views stay
+ * valid for the lifetime of the `MetadataCache` they came from.
+ */
+class CachedRecord {
+public:
+    explicit CachedRecord(std::span<const uint8_t> record) : reader(record) {}
+
+    FileType fileType() const;
+
+    //Calls `visit(key, value)` with a `std::string_view` key and a `MetadataValue` for every cached pair, in stored order.
+    template <typename Visitor>
+    void forEach(Visitor&& visit) const {
+        std::size_t offset = HeaderSize;
+        for (uint32_t i = 0, n = reader.u32le(PairCountOffset); i < n; ++i) {
+            uint32_t keyLength = reader.u32le(offset);
+            std::string_view key = reader.chars(offset + 4, keyLength);
+            offset += 4 + keyLength;
+            visit(key, readValue(offset));
+        }
+    }
+
+    //Copies the cached pairs into a map that owns its values (e.g. for printing).
+    MetadataMap toMap() const;
+
+    // Record layout: key (36 bytes), file type, pair count, payload size, then the pairs
+    static constexpr std::size_t FileTypeOffset = 36;
+    static constexpr std::size_t PairCountOffset = 40;
+    static constexpr std::size_t PayloadSizeOffset = 44;
+    static constexpr std::size_t HeaderSize = 48;
+
+private:
+    //Decodes the value at `offset` and advances past it.
+    MetadataValue readValue(std::size_t& offset) const;
+
+    ByteReader reader;
+};
+
+/**
+ * @brief Appends one result in the `CachedRecord` layout, as `MetadataCache` stores it.
+ *
+ * @param out The string to append to.
+ * @param key The file's identity.
+ * @param fileType The type reported by `determineFileType`.
+ * @param metadata The metadata to store.
+ */
+void appendCachedRecord(std::string& out, const CacheKey& key, FileType fileType, const MetadataMap& metadata);
+
+/**
+ * @brief Persistent, memory-mapped cache of `FileMetaDataAnalyzer` results keyed by `CacheKey`.
+ *
+ * The cache file is an immutable snapshot: a header, the records, and an open-addressing table of
+ * (key hash, record offset) slots. Lookups probe the mapped table directly. New results are kept in
+ * memory until `save()`, which writes a fresh snapshot to a temporary file, fsyncs it and renames it over
+ * the old one, so a crash at any point leaves either the old or the new snapshot intact. Records whose
+ * file (device and inode) was re-analyzed, that were produced by another analyzer version, or that no
+ * `lookup` hit since the cache was loaded (their file was deleted, or not scanned this time), are
+ * dropped when saving. Integers are stored little-endian.
+ *
+ * `lookup` and `insert` may be called concurrently; `save` must not race with them.
+ */
+class MetadataCache {
+public:
+    /**
+     * @brief Maps an existing cache file. A missing, foreign or truncated file yields an empty cache.
+     *
+     * @param cachePath Where the cache lives; `save()` writes it back to the same path.
+     */
+    explicit MetadataCache(std::filesystem::path cachePath);
+
+    ~MetadataCache();
+
+    MetadataCache(const MetadataCache&) = delete;
+    MetadataCache& operator=(const MetadataCache&) = delete;
+
+    /**
+     * @brief Looks a file version up in the saved snapshot, and marks a hit to be kept by `save()`.
+     *
+     * @param key The file's identity.
+     * @return A view of the cached result, or `std::nullopt` on a miss. A record that does not decode within
+     *         its bounds is a miss, so a damaged cache costs re-analysis, never an exception.
+     */
+    std::optional<CachedRecord> lookup(const CacheKey& key) const;
+
+    /**
+     * @brief Records a freshly computed result. It becomes visible to `lookup` after the next `save()`.
+     *
+     * @param key The file's identity.
+     * @param fileType The type reported by `determineFileType`.
+     * @param metadata The format specific metadata (basic metadata is always recomputed from `stat`).
+     */
+    void insert(const CacheKey& key, FileType fileType, const MetadataMap& metadata);
+
+    /**
+     * @brief Atomically replaces the cache file with the records hit since loading plus the inserted ones.
+     *
+     * @throws std::runtime_error If the new snapshot cannot be written.
+     */
+    void save();
+
+    //Number of records in the mapped snapshot.
+    std::size_t size() const {
+        return entryCount;
+    }
+
+private:
+    void map();
+    void unmap();
+
+    std::filesystem::path cachePath;
+    const uint8_t* mapping = nullptr;
+    std::size_t mappingSize = 0;
+    std::size_t entryCount = 0;
+    std::size_t slotCount = 0;
+    std::size_t slotsOffset = 0;
+    std::unique_ptr<std::atomic<bool>[]> seen; // per slot: hit by `lookup`, so its record survives `save()`
+
+    std::mutex pendingMutex;
+    std::vector<std::pair<CacheKey, std::string>> pending; // serialized records awaiting save()
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef METADATA_DAEMON_H
+#define METADATA_DAEMON_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "DirectoryScanner.h"
+#include "FileWatcher.h"
+#include "MetadataIndex.h"
+
+//Options of a `MetadataDaemon`.
+struct DaemonOptions {
+    std::vector<std::filesystem::path> roots;   // directory trees to index and watch
+    std::filesystem::path socketPath;           // Unix socket the queries arrive on
+    ScanOptions scan;                           // used for the initial scan and every update
+    std::chrono::milliseconds coalesceDelay{100};   // quiet time that ends a burst of changes
+    std::chrono::milliseconds maxCoalesceDelay{1000}; // longest a change waits while a burst goes on
+};
+
+/**
+ * @brief Keeps a `MetadataIndex` of directory trees up to date and answers queries about it.
+ *
+ * `run` watches the roots with a `FileWatcher`, scans them in parallel with a `DirectoryScanner`, and
+ * then applies changes as they are reported. Changes are coalesced per path until the trees have been
+ * quiet for `coalesceDelay` (or for at most `maxCoalesceDelay`), so a file written in many pieces is
+ * analyzed once. Changed files go through `determineFileType` and only their type's specialization;
+ * attribute-only changes (chmod, touch) refresh only the `BasicMetadata` fields. A lost event queue
+ * triggers a full rescan that also drops vanished files.
+ *
+ * Queries are served by a separate thread, so they are answered while an update is running. The
+ * protocol is one request per line on the Unix socket, answered with NDJSON lines:
+ *
+ *     GET <path>        the file's record, or {"error":"not found","path":...}
+ *     LIST <directory>  the records of every file below the directory, then {"count":N}
+ *     STATS             {"files":N,"watches":N,"updates":N,"rescans":N}
+ */
+class MetadataDaemon {
+public:
+    //Creates the watcher and the scanner; throws `std::system_error` when inotify is unavailable.
+    explicit MetadataDaemon(DaemonOptions options);
+
+    // Releases the stop descriptor; run() must have returned
+    ~MetadataDaemon();
+
+    MetadataDaemon(const MetadataDaemon&) = delete;
+    MetadataDaemon& operator=(const MetadataDaemon&) = delete;
+
+    /**
+     * @brief Indexes the roots, then serves queries and applies changes until `stop` is called.
+     *
+     * @throws std::system_error When the socket cannot be bound, or when waiting for events or
+     *         queries fails; the daemon is shut down first.
+     */
+    void run();
+
+    //Makes `run` return; safe to call from any thread or after `run` has returned.
+    void stop();
+
+    const MetadataIndex& index() const {
+        return metadataIndex;
+    }
+
+private:
+    //What happened to a path during the current burst, latest event winning.
+    enum class Change {
+        Contents,
+        Attributes,
+        Removed,
+        DirectoryAdded,
+        DirectoryRemoved
+    };
+
+    void watchLoop();
+    void serveLoop(int listener);
+    void applyChanges();
+    void rescan();
+    void answer(std::string_view request, std::string& response) const;
+    void recordChange(WatchEvent&& event);
+
+    DaemonOptions options;
+    MetadataIndex metadataIndex;
+    FileWatcher watcher;
+    DirectoryScanner scanner;
+    int stopFd = -1;    // eventfd that wakes both loops on stop()
+    std::exception_ptr serveError; // why the query thread gave up, rethrown by run()
+
+    std::map<std::filesystem::path, Change> pending;
+    std::chrono::steady_clock::time_point burstStart;
+    std::chrono::steady_clock::time_point lastEvent;
+    bool overflowed = false;
+
+    std::atomic<std::size_t> updates{0};
+    std::atomic<std::size_t> rescans{0};
+    std::atomic<std::size_t> watchCount{0};
+};
+
+#endif
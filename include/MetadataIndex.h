@@ -0,0 +1,76 @@
+#ifndef METADATA_INDEX_H
+#define METADATA_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include "FileMetaDataAnalyzer.h"
+
+/**
+ * @brief In-memory results of a long-running scan, keyed by path.
+ *
+ * Records are kept sorted by path, so one file is found in logarithmic time and the records of a
+ * directory tree are adjacent. Queries take a shared lock and format straight from the stored maps;
+ * updates take an exclusive lock only for the insertion itself. All members are thread-safe.
+ *
+ * Every record remembers the generation it was stored in. A full rescan starts a new generation and
+ * then drops the records it did not refresh, which removes files whose deletion went unnoticed.
+ */
+class MetadataIndex {
+public:
+    //Stores a copy of a file's metadata (allocated from the global heap), replacing any previous record.
+    void put(std::string_view path, FileType fileType, const MetadataMap& metadata);
+
+    /**
+     * @brief Overwrites some fields of a stored record, e.g. the `BasicMetadata` fields after a `chmod`.
+     *
+     * @return False when the path has no record.
+     */
+    bool update(std::string_view path, const MetadataMap& fields);
+
+    //Removes the record of a file; false when there was none.
+    bool erase(std::string_view path);
+
+    //Removes the records of every file below a directory and returns how many there were.
+    std::size_t eraseUnder(std::string_view directory);
+
+    //Starts a new generation and returns its number.
+    uint64_t beginGeneration();
+
+    //Removes the records last stored before `generation` began and returns how many there were.
+    std::size_t eraseStale(uint64_t generation);
+
+    /**
+     * @brief Appends a file's record as one NDJSON line (see `appendNdjsonRecord`).
+     *
+     * @return False, with nothing appended, when the path has no record.
+     */
+    bool appendRecord(std::string& out, std::string_view path) const;
+
+    //Appends the records of every file below a directory as NDJSON lines and returns how many there were.
+    std::size_t appendRecordsUnder(std::string& out, std::string_view directory) const;
+
+    //Number of records.
+    std::size_t size() const;
+
+private:
+    struct Entry {
+        FileType fileType = FileType::UNKNOWN;
+        MetadataMap metadata;
+        uint64_t generation = 0;
+    };
+    using EntryMap = std::map<std::string, Entry, std::less<>>;
+
+    //The records below `directory`, as an iterator range.
+    static std::pair<EntryMap::const_iterator, EntryMap::const_iterator> subtree(const EntryMap& entries, std::string_view directory);
+
+    EntryMap entries;
+    uint64_t currentGeneration = 0;
+    mutable std::shared_mutex mutex;
+};
+
+#endif
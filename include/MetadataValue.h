@@ -0,0 +1,245 @@
+#ifndef METADATA_VALUE_H
+#define METADATA_VALUE_H
+
+#include <bit>
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "CustomMap.h"
+
+//A point in time as seconds and nanoseconds since the Unix epoch (UTC).
+struct Timestamp {
+    int64_t seconds = 0;
+    uint32_t nanoseconds = 0;
+
+    auto operator<=>(const Timestamp& other) const = default;
+};
+
+/**
+ * @brief An interned metadata field name.
+ *
+ * A key is a view of a string that lives for the rest of the program: either a string literal (through
+ * the `_key` literal, which costs nothing at run time) or a copy kept by the global intern table
+ * (through `MetadataKey(std::string_view)`, used for names built at run time such as "Entry7.Name").
+ * Copying a key never allocates. Keys compare and hash by content, so both kinds of key are interchangeable.
+ */
+class MetadataKey {
+public:
+    MetadataKey() = default;
+
+    //Interns a name built at run time.
+    explicit MetadataKey(std::string_view name);
+
+    //Wraps a name with static storage duration without interning it.
+    static constexpr MetadataKey fromStatic(std::string_view name) {
+        MetadataKey key;
+        key.name = name;
+        return key;
+    }
+
+    constexpr std::string_view view() const {
+        return name;
+    }
+
+    constexpr operator std::string_view() const {
+        return name;
+    }
+
+    constexpr bool operator==(const MetadataKey& other) const {
+        return name == other.name;
+    }
+
+private:
+    std::string_view name;
+};
+
+//`"Width"_key` is a `MetadataKey` resolved at compile time.
+consteval MetadataKey operator""_key(const char* name, std::size_t length) {
+    return MetadataKey::fromStatic(std::string_view(name, length));
+}
+
+/**
+ * @brief One typed metadata value.
+ *
+ * Extractors store numbers, times and text as they are; turning them into text is left to the output
+ * sinks (`format` gives the human-readable form). Integer values carry a display style, so a size can
+ * print as "1024 bytes" and a checksum as zero-padded hexadecimal while staying numbers for filters.
+ * Short text fits in the string's small buffer and literals are kept as views, so most values do not
+ * allocate; longer text can be placed in the file's `MetadataArena`. Owned text follows the pmr rules:
+ * copies allocate from the default resource, moves keep the source's, and assignment keeps the
+ * destination's, copying the text over when the source's lives elsewhere. There is no implicit
+ * conversion from `std::string`, which would copy the text into the default resource first: extractors
+ * write `MetadataValue(text, memory)`.
+ */
+class MetadataValue {
+public:
+    enum class Kind : uint8_t { Empty, Integer, Real, Time, Text, Bytes, Boolean };
+
+    //How an integer is printed.
+    enum class Style : uint8_t { Plain, ByteCount, Hex };
+
+    //Allocator of owned text; containers that know it (`CustomMap`) construct their values with theirs.
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    MetadataValue() = default;
+    MetadataValue(const MetadataValue&) = default;
+    MetadataValue(MetadataValue&&) noexcept = default;
+    MetadataValue& operator=(const MetadataValue&) = default;
+    MetadataValue& operator=(MetadataValue&&) = default;
+
+    //An empty value whose text, once assigned, is allocated with `allocator`.
+    explicit MetadataValue(const allocator_type& allocator) : ownedText(allocator) {}
+
+    //Copies `other` with its text allocated with `allocator`.
+    MetadataValue(const MetadataValue& other, const allocator_type& allocator)
+        : valueKind(other.valueKind), displayStyle(other.displayStyle), hexDigits(other.hexDigits), isOwned(other.isOwned),
+          nanoseconds(other.nanoseconds), numberBits(other.numberBits), viewedText(other.viewedText),
+          ownedText(other.ownedText, allocator) {}
+
+    //Moves `other`, copying its text when it was allocated with anything other than `allocator`.
+    MetadataValue(MetadataValue&& other, const allocator_type& allocator)
+        : valueKind(other.valueKind), displayStyle(other.displayStyle), hexDigits(other.hexDigits), isOwned(other.isOwned),
+          nanoseconds(other.nanoseconds), numberBits(other.numberBits), viewedText(other.viewedText),
+          ownedText(std::move(other.ownedText), allocator) {}
+
+    template <typename T>
+        requires(std::is_integral_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, char>)
+    MetadataValue(T value) : valueKind(Kind::Integer), numberBits(static_cast<int64_t>(value)) {}
+
+    MetadataValue(bool value) : valueKind(Kind::Boolean), numberBits(value ? 1 : 0) {}
+    MetadataValue(double value) : valueKind(Kind::Real), numberBits(std::bit_cast<int64_t>(value)) {}
+    MetadataValue(Timestamp value) : valueKind(Kind::Time), nanoseconds(value.nanoseconds), numberBits(value.seconds) {}
+    MetadataValue(const char* text) : MetadataValue(std::string_view(text)) {}
+
+    //Adopts the string together with its allocator.
+    MetadataValue(std::pmr::string&& text) : valueKind(Kind::Text), isOwned(true), ownedText(std::move(text)) {}
+
+    //Text copied into `memory` (e.g. the file's `MetadataArena`).
+    explicit MetadataValue(std::string_view text, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : valueKind(Kind::Text), isOwned(true), ownedText(text, memory) {}
+
+    //Text kept as a view: a literal, or bytes that outlive the value (e.g. a mapped cache file).
+    static MetadataValue literal(std::string_view text) {
+        MetadataValue value;
+        value.valueKind = Kind::Text;
+        value.viewedText = text;
+        return value;
+    }
+
+    //Raw bytes (signatures, tags) that need not be valid text.
+    static MetadataValue bytes(std::string_view raw, std::pmr::memory_resource* memory = std::pmr::get_default_resource()) {
+        MetadataValue value(raw, memory);
+        value.valueKind = Kind::Bytes;
+        return value;
+    }
+
+    //A size in bytes, printed as "N bytes".
+    static MetadataValue byteCount(uint64_t count) {
+        MetadataValue value(count);
+        value.displayStyle = Style::ByteCount;
+        return value;
+    }
+
+    //An integer printed as `digits` zero-padded lowercase hex digits.
+    static MetadataValue hex(uint64_t number, int digits) {
+        MetadataValue value(number);
+        value.displayStyle = Style::Hex;
+        value.hexDigits = static_cast<uint8_t>(digits);
+        return value;
+    }
+
+    Kind kind() const {
+        return valueKind;
+    }
+
+    Style style() const {
+        return displayStyle;
+    }
+
+    uint8_t digits() const {
+        return hexDigits;
+    }
+
+    //The value of an Integer (0 otherwise).
+    int64_t integer() const {
+        return valueKind == Kind::Integer ? numberBits : 0;
+    }
+
+    //The value of a Boolean (false otherwise).
+    bool boolean() const {
+        return valueKind == Kind::Boolean && numberBits != 0;
+    }
+
+    //The value of a Real (0 otherwise).
+    double real() const {
+        return valueKind == Kind::Real ? std::bit_cast<double>(numberBits) : 0;
+    }
+
+    //The value of a Time (the epoch otherwise).
+    Timestamp time() const {
+        return valueKind == Kind::Time ? Timestamp{numberBits, nanoseconds} : Timestamp{};
+    }
+
+    //The contents of a Text or Bytes value (empty otherwise).
+    std::string_view text() const {
+        return isOwned ? std::string_view(ownedText) : viewedText;
+    }
+
+    //A copy whose text lives in `memory`, for values viewing or allocated from storage that may go away.
+    MetadataValue owned(std::pmr::memory_resource* memory = std::pmr::get_default_resource()) const {
+        MetadataValue copy = valueKind == Kind::Text || valueKind == Kind::Bytes ? MetadataValue(text(), memory) : MetadataValue();
+        copy.valueKind = valueKind;
+        copy.displayStyle = displayStyle;
+        copy.hexDigits = hexDigits;
+        copy.nanoseconds = nanoseconds;
+        copy.numberBits = numberBits;
+        return copy;
+    }
+
+    //Integer and Real values as a double, for numeric comparisons.
+    std::optional<double> number() const;
+
+    //Appends the human-readable form (the text the analyzer has always printed).
+    void format(std::string& out) const;
+
+    std::string toString() const {
+        std::string out;
+        format(out);
+        return out;
+    }
+
+    bool operator==(const MetadataValue& other) const;
+
+private:
+    // Integers, booleans, the bits of reals and the seconds of times share `numberBits`; text is either viewed or owned
+    Kind valueKind = Kind::Empty;
+    Style displayStyle = Style::Plain;
+    uint8_t hexDigits = 0;
+    bool isOwned = false;
+    uint32_t nanoseconds = 0;
+    int64_t numberBits = 0;
+    std::string_view viewedText;
+    std::pmr::string ownedText;
+};
+
+std::ostream& operator<<(std::ostream& out, const MetadataValue& value);
+
+std::ostream& operator<<(std::ostream& out, const MetadataKey& key);
+
+//Formats a timestamp in local time, in the layout of ctime() without its trailing newline.
+void formatLocalTime(std::string& out, Timestamp time);
+
+//Formats a timestamp as ISO 8601 UTC ("2024-01-02T03:04:05Z", with fractional seconds when present).
+void formatIsoTime(std::string& out, Timestamp time);
+
+//The metadata of one file: typed values under interned keys, in insertion order.
+using MetadataMap = CustomMap<MetadataKey, MetadataValue>;
+
+#endif
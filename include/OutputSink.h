@@ -0,0 +1,202 @@
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <condition_variable>
+#include <cstdio>
+#include <exception>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "FileMetaDataAnalyzer.h"
+
+/**
+ * @brief Prints the metadata key-value pairs in a formatted way.
+ *
+ * @tparam KeyType The type of the keys.
+ * @tparam ValueType The type of the values.
+ * @param out The stream to print to.
+ * @param metadata The metadata to be printed.
+ */
+template <typename KeyType, typename ValueType>
+void printMetadata(std::ostream& out, const CustomMap<KeyType, ValueType>& metadata) {
+    for (const auto& [key, value] : metadata) {
+        out << std::left << std::setw(20) << key << ": " << value << '\n';
+    }
+    out << std::endl;
+}
+
+//One analyzed file on its way to an output sink.
+struct OutputRecord {
+    std::string path;
+    FileType fileType = FileType::UNKNOWN;
+    MetadataMap metadata;
+};
+
+/**
+ * @brief Destination for analyzed records.
+ *
+ * Sinks format into an internal buffer and write it to their `FILE*` in large blocks, never flushing per
+ * line. They are not thread-safe; concurrent producers go through an `AsyncRecordWriter`.
+ */
+class OutputSink {
+public:
+    explicit OutputSink(std::FILE* out) : out(out) {}
+    virtual ~OutputSink() = default;
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    //Formats one record.
+    virtual void write(const OutputRecord& record) = 0;
+
+    /**
+     * @brief Writes any trailer and flushes everything buffered. Called once, after the last record.
+     *
+     * @throws std::runtime_error If the output could not be written (`write` throws the same way).
+     */
+    virtual void finish() {
+        flush();
+    }
+
+protected:
+    static constexpr std::size_t FlushThreshold = 1 << 20;
+
+    //Hands the buffer to the FILE* once it is large enough (or always, and flushes it, when `force` is set).
+    //Throws std::runtime_error on a short write or a failed flush.
+    void flush(bool force = true);
+
+    std::FILE* out;
+    std::string buffer;
+};
+
+//The human-readable layout printed by the interactive mode.
+class TextSink : public OutputSink {
+public:
+    using OutputSink::OutputSink;
+    void write(const OutputRecord& record) override;
+};
+
+/**
+ * @brief Appends one record in the `NdjsonSink` layout, newline included.
+ *
+ * @param out The string to append to.
+ * @param path The file's path.
+ * @param fileType The file's type.
+ * @param metadata The file's metadata.
+ */
+void appendNdjsonRecord(std::string& out, std::string_view path, FileType fileType, const MetadataMap& metadata);
+
+//Appends `text` as a quoted JSON string, escaped as in `NdjsonSink`.
+void appendJson(std::string& out, std::string_view text);
+
+/**
+ * @brief One JSON object per line: {"path":...,"type":...,"metadata":{...}}.
+ *
+ * Integers (sizes included) and reals are JSON numbers, times are ISO 8601 UTC strings, hexadecimal
+ * integers are strings of their digits and raw bytes are hex strings. Invalid UTF-8 bytes in text are
+ * escaped as \u00XX.
+ */
+class NdjsonSink : public OutputSink {
+public:
+    using OutputSink::OutputSink;
+    void write(const OutputRecord& record) override;
+};
+
+//RFC 4180 CSV in long form: one `path,type,key,value` row per metadata field, after a header row. Values are in their text form.
+class CsvSink : public OutputSink {
+public:
+    explicit CsvSink(std::FILE* out);
+    void write(const OutputRecord& record) override;
+};
+
+/**
+ * @brief Dependency-free columnar binary format.
+ *
+ * All integers are little-endian. The file is the magic "FMDCOL2\0" followed by batches of up to
+ * `BatchSize` records and a footer. Each batch is:
+ *
+ *     "BTCH", u64 byte length of the rest of the batch, u32 records, u32 fields,
+ *     path     : u32 offsets[records + 1], bytes          (string column)
+ *     type     : u8 fileType[records]                     (FileType values)
+ *     fieldEnd : u32[records]                             (exclusive end of each record's fields)
+ *     key      : u32 dictionary size, dictionary as a string column, u32 ids[fields]
+ *     value    : u8 kind[fields], u8 style[fields],      (MetadataValue::Kind and ::Style values)
+ *                i64 number[fields],                     (integer, 1/0 for a boolean, IEEE bits of a real,
+ *                                                         or ns since the epoch)
+ *                u32 offsets[fields + 1], bytes          (string column: text and raw bytes, else empty)
+ *
+ * The footer is "FEND", u64 batch count, u64 record count. Readers can skip whole batches using the
+ * byte length, and read a single column of a batch without touching the others.
+ */
+class ColumnarSink : public OutputSink {
+public:
+    static constexpr std::size_t BatchSize = 4096;
+
+    explicit ColumnarSink(std::FILE* out);
+    void write(const OutputRecord& record) override;
+    void finish() override;
+
+private:
+    void writeBatch();
+
+    std::vector<OutputRecord> pending;
+    uint64_t batches = 0;
+    uint64_t records = 0;
+};
+
+/**
+ * @brief Creates the sink for a `--format` name: "text", "ndjson", "csv", "columnar" or "index" (see `IndexSink`).
+ *
+ * @throws std::invalid_argument For any other name.
+ */
+std::unique_ptr<OutputSink> makeOutputSink(std::string_view format, std::FILE* out);
+
+/**
+ * @brief Feeds records from many producer threads to one sink on a dedicated writer thread.
+ *
+ * Producers only move their record into a shared batch under a short lock; the writer thread swaps the
+ * whole batch out and formats it without holding the lock. Producers block only when `maxPending`
+ * records are already waiting, which bounds memory when the output is slower than the scan.
+ */
+class AsyncRecordWriter {
+public:
+    explicit AsyncRecordWriter(OutputSink& sink, std::size_t maxPending = 65536);
+
+    // Drains every pushed record and finishes the sink; a write error is dropped, call `close` to see it
+    ~AsyncRecordWriter();
+
+    AsyncRecordWriter(const AsyncRecordWriter&) = delete;
+    AsyncRecordWriter& operator=(const AsyncRecordWriter&) = delete;
+
+    //Queues a record; safe to call from any thread.
+    void push(OutputRecord&& record);
+
+    /**
+     * @brief Writes everything queued so far, finishes the sink and stops the writer thread.
+     *
+     * Once a write fails, the remaining records are discarded and the error is rethrown here.
+     *
+     * @throws std::runtime_error If the sink failed to write.
+     */
+    void close();
+
+private:
+    void run();
+
+    OutputSink& sink;
+    std::size_t maxPending;
+    std::vector<OutputRecord> queue;
+    std::mutex mutex;
+    std::condition_variable hasRecords;
+    std::condition_variable hasRoom;
+    bool closing = false;
+    std::exception_ptr failure;     // the sink's first error, owned by the writer thread until it is joined
+    std::thread writer;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef PDF_INFO_READER_H
+#define PDF_INFO_READER_H
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include "MetadataValue.h"
+
+//Fields of a PDF document Info dictionary, decoded to UTF-8.
+struct PdfInfo {
+    std::string version; // from the %PDF-x.y header
+    std::string title;
+    std::string author;
+    std::string subject;
+    std::string keywords;
+    std::string creator;
+    std::string producer;
+    std::optional<Timestamp> creationDate;     // parsed by parsePdfDate
+    std::optional<Timestamp> modificationDate; // parsed by parsePdfDate
+};
+
+/**
+ * @brief Reads the Info dictionary of a PDF without building the document.
+ *
+ * Starting from `startxref`, this follows the cross-reference chain (classic tables, xref streams and
+ * hybrid `/XRefStm` files, newest section first), resolves `/Info` (directly or inside an object stream)
+ * and decodes its text strings from PDFDocEncoding or UTF-16BE. Only the trailer, the xref data and the
+ * Info object are touched, so on a mapped file just those pages are read.
+ *
+ * @param data The whole file, typically `FileContext::bytes()` of a mapped file.
+ * @return The decoded fields, or `std::nullopt` if the file is encrypted or its structure cannot be
+ *         followed; callers then fall back to poppler, which can repair broken files.
+ */
+std::optional<PdfInfo> readPdfInfo(std::span<const uint8_t> data);
+
+/**
+ * @brief Parses a PDF date string ("D:YYYYMMDDHHmmSSOHH'mm'") into a UTC timestamp.
+ *
+ * Missing trailing components default to the start of their period and a missing offset means UTC,
+ * as in poppler's `dateStringToTime`, so both PDF paths report the same instant.
+ *
+ * @param date The raw date string.
+ * @return The point in time, or `std::nullopt` if the year is missing or a component is out of range.
+ */
+std::optional<Timestamp> parsePdfDate(std::string_view date);
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef PNG_READER_H
+#define PNG_READER_H
+
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include "ByteReader.h"
+#include "MetadataValue.h"
+
+//One chunk of a PNG stream. `type` and `data` point into the file bytes.
+struct PngChunk {
+    std::string_view type;
+    std::span<const uint8_t> data;
+    uint32_t crc = 0;       // as stored after the data
+    uint64_t offset = 0;    // of the length field
+
+    //Critical chunks have an uppercase first letter; decoders may skip the others.
+    bool isCritical() const {
+        return !type.empty() && !(type[0] & 0x20);
+    }
+};
+
+//The fields of the IHDR chunk.
+struct PngImageHeader {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t bitDepth = 0;
+    uint8_t colorType = 0;
+    uint8_t compression = 0;
+    uint8_t filter = 0;
+    uint8_t interlace = 0;
+};
+
+//A decoded tEXt, zTXt or iTXt chunk.
+struct PngText {
+    std::string_view keyword;
+    std::pmr::string text;      // UTF-8
+};
+
+/**
+ * @brief Walks the chunks of a PNG stream.
+ *
+ * The constructor checks the signature and decodes IHDR, which the format requires to come first.
+ * `forEachChunk` then steps from one length field to the next, so image data is skipped without being
+ * touched; only `hasValidCrc` reads the chunk bodies. The walk ends after IEND, or early when a chunk
+ * runs past the available bytes (a truncated file, or a prefix of a larger one). A missing signature or
+ * IHDR throws `std::runtime_error`.
+ */
+class PngReader {
+public:
+    explicit PngReader(std::span<const uint8_t> file);
+
+    const PngImageHeader& header() const {
+        return imageHeader;
+    }
+
+    /**
+     * @brief Visits every chunk in order, IHDR and IEND included.
+     *
+     * @param visit Called as `bool visit(const PngChunk&)` for each chunk; returning false stops the walk.
+     * @return The number of chunks visited.
+     */
+    template <typename Visitor>
+    uint64_t forEachChunk(Visitor&& visit) const {
+        uint64_t offset = Signature.size();
+        uint64_t visited = 0;
+        PngChunk chunk;
+        while (readChunk(offset, chunk)) {
+            ++visited;
+            if (!visit(static_cast<const PngChunk&>(chunk)) || chunk.type == "IEND") {
+                break;
+            }
+        }
+        return visited;
+    }
+
+    //Recomputes the CRC over the chunk's type and data and compares it with the stored one.
+    static bool hasValidCrc(const PngChunk& chunk);
+
+    /**
+     * @brief Decodes a tEXt, zTXt or iTXt chunk, inflating compressed text.
+     *
+     * @param chunk A chunk of one of the three text types.
+     * @param memory Where the text is allocated.
+     * @return The keyword and its text, or nothing if the chunk is malformed or not a text chunk.
+     */
+    static std::optional<PngText> decodeText(const PngChunk& chunk, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+    /**
+     * @brief Decodes a tIME chunk (the last modification, in UTC).
+     *
+     * @return The time, or nothing if the chunk is malformed.
+     */
+    static std::optional<Timestamp> decodeTime(const PngChunk& chunk);
+
+    //Compressed text is inflated up to this many bytes; the rest is dropped.
+    static constexpr std::size_t MaxTextLength = 64 * 1024;
+
+    static constexpr std::string_view Signature{"\x89PNG\r\n\x1a\n", 8};
+
+private:
+    //Decodes the chunk header at `offset` and advances past the chunk; false when it does not fit.
+    bool readChunk(uint64_t& offset, PngChunk& chunk) const;
+
+    ByteReader reader;
+    PngImageHeader imageHeader;
+};
+
+#endif
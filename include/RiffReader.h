@@ -0,0 +1,131 @@
+#ifndef RIFF_READER_H
+#define RIFF_READER_H
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include "ByteReader.h"
+
+//One chunk of a RIFF stream. `id` and `data` point into the file bytes.
+struct RiffChunk {
+    std::string_view id;
+    uint64_t size = 0;              // declared size, resolved through ds64 in RF64 files
+    uint64_t offset = 0;            // of the chunk id
+    std::span<const uint8_t> data;  // the part of the chunk body that is available (shorter when truncated)
+
+    //Checks whether the whole declared body is available.
+    bool isComplete() const {
+        return data.size() == size;
+    }
+};
+
+/**
+ * @brief Walks the chunks of a RIFF (or 64-bit RF64/BW64) file.
+ *
+ * Chunks are stepped over by their declared sizes, so only their 8-byte headers are read: a multi-gigabyte
+ * `data` chunk costs nothing, and the walk goes on after it whenever the bytes are available. In RF64
+ * files the 32-bit sizes are saturated and the real ones come from the leading `ds64` chunk. A bad
+ * signature throws `std::runtime_error`.
+ */
+class RiffReader {
+public:
+    explicit RiffReader(std::span<const uint8_t> file);
+
+    //"RIFF", "RF64" or "BW64".
+    std::string_view signature() const {
+        return reader.chars(0, 4);
+    }
+
+    //The form type, e.g. "WAVE".
+    std::string_view formType() const {
+        return reader.chars(8, 4);
+    }
+
+    //Size of the RIFF body, from ds64 in 64-bit files.
+    uint64_t riffSize() const {
+        return bodySize;
+    }
+
+    //Checks whether the file uses 64-bit sizes (RF64 or BW64).
+    bool is64Bit() const {
+        return sizes64;
+    }
+
+    //Sample count from the ds64 chunk (0 when absent).
+    uint64_t ds64SampleCount() const {
+        return sampleCount;
+    }
+
+    /**
+     * @brief Visits every top-level chunk in order.
+     *
+     * @param visit Called as `bool visit(const RiffChunk&)` for each chunk; returning false stops the walk.
+     * @return The number of chunks visited.
+     */
+    template <typename Visitor>
+    uint64_t forEachChunk(Visitor&& visit) const {
+        uint64_t offset = 12;
+        uint64_t visited = 0;
+        RiffChunk chunk;
+        while (readChunk(reader, offset, chunk, this)) {
+            ++visited;
+            if (!visit(static_cast<const RiffChunk&>(chunk))) {
+                break;
+            }
+        }
+        return visited;
+    }
+
+    /**
+     * @brief Visits the sub-chunks of a LIST chunk, e.g. the INAM/IART/... items of a LIST "INFO".
+     *
+     * @param list A complete LIST chunk.
+     * @param visit Called as `bool visit(const RiffChunk&)` for each item; returning false stops the walk.
+     * @return The number of items visited.
+     */
+    template <typename Visitor>
+    static uint64_t forEachListItem(const RiffChunk& list, Visitor&& visit) {
+        ByteReader items(list.data);
+        uint64_t offset = 4;
+        uint64_t visited = 0;
+        RiffChunk item;
+        while (readChunk(items, offset, item, nullptr)) {
+            ++visited;
+            if (!visit(static_cast<const RiffChunk&>(item))) {
+                break;
+            }
+        }
+        return visited;
+    }
+
+    //The list type of a LIST chunk ("INFO", "adtl", ...), empty for other chunks.
+    static std::string_view listType(const RiffChunk& chunk);
+
+    //Text of an INFO item or a fixed-size text field, without NUL padding and trailing spaces.
+    static std::string_view text(std::span<const uint8_t> field);
+
+private:
+    /**
+     * @brief Decodes the chunk header at `offset` and advances past the chunk and its pad byte.
+     *
+     * @param sizes The reader whose ds64 sizes replace saturated 32-bit sizes; null inside LIST chunks.
+     * @return False when the header does not fit.
+     */
+    static bool readChunk(const ByteReader& bytes, uint64_t& offset, RiffChunk& chunk, const RiffReader* sizes);
+
+    //Sizes of the chunks ds64 lists by id ("data" always, others through its table).
+    struct Size64 {
+        std::string_view id;
+        uint64_t size = 0;
+    };
+
+    ByteReader reader;
+    uint64_t bodySize = 0;
+    uint64_t sampleCount = 0;
+    bool sizes64 = false;
+    std::array<Size64, 4> ds64Sizes{};  // "data" first; larger tables are cut short
+    std::size_t ds64Count = 0;
+};
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef STAGE_STATS_H
+#define STAGE_STATS_H
+
+// Stage instrumentation is compiled in unless the build passes -DFILEMETA_STATS=0 (make STATS=0)
+#ifndef FILEMETA_STATS
+#define FILEMETA_STATS 1
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include <sys/types.h>
+#include "FileMetaDataAnalyzer.h"
+
+//Pipeline stages timed for `--stats`, in pipeline order.
+enum class Stage : uint8_t {
+    Open,               // opening, stat'ing and mapping (or reading the prefix of) a file
+    DetermineFileType,
+    BasicMetadata,      // the BasicMetadata extractor
+    AnalyzeHelper,      // the format specific `analyzeMetadataHelper`
+    MergeMap,           // merging the format specific fields into the record
+    Output,             // `OutputSink::write`
+};
+
+inline constexpr std::size_t StageCount = 6;
+
+//Type slots per stage: one per `FileType`, and a last one for stages that run before the type is known.
+inline constexpr std::size_t StageTypeSlots = static_cast<std::size_t>(FileType::UNKNOWN) + 2;
+inline constexpr std::size_t AnyTypeSlot = StageTypeSlots - 1;
+
+//Name of a stage as printed in reports.
+const char* stageName(Stage stage);
+
+/**
+ * @brief A log-linear latency histogram in the style of HdrHistogram.
+ *
+ * Values are nanoseconds. Below 16 every value has its own bucket; above, every power of two is split
+ * into 16 equal buckets, so a reported percentile is within 1/16 (6.25%) of the true value. Values past
+ * 2^36 ns (about 69 s) land in the last bucket. Recording is an index computation and an increment.
+ */
+class LatencyHistogram {
+public:
+    void record(uint64_t nanoseconds) {
+        ++counts[bucketOf(nanoseconds)];
+        ++samples;
+        sum += nanoseconds;
+        minimum = std::min(minimum, nanoseconds);
+        maximum = std::max(maximum, nanoseconds);
+    }
+
+    void merge(const LatencyHistogram& other);
+
+    uint64_t count() const {
+        return samples;
+    }
+
+    uint64_t total() const {
+        return sum;
+    }
+
+    uint64_t min() const {
+        return samples ? minimum : 0;
+    }
+
+    uint64_t max() const {
+        return maximum;
+    }
+
+    //The smallest recorded bucket bound that at least `fraction` of the samples do not exceed.
+    uint64_t percentile(double fraction) const;
+
+private:
+    static constexpr unsigned SubBucketBits = 4;
+    static constexpr unsigned SubBuckets = 1u << SubBucketBits;
+    static constexpr unsigned MaxShift = 31;
+    static constexpr std::size_t BucketCount = SubBuckets + (MaxShift + 1) * SubBuckets;
+
+    static std::size_t bucketOf(uint64_t value) {
+        if (value < SubBuckets) {
+            return static_cast<std::size_t>(value);
+        }
+        unsigned shift = static_cast<unsigned>(std::bit_width(value)) - SubBucketBits - 1;
+        if (shift > MaxShift) {
+            return BucketCount - 1;
+        }
+        return SubBuckets + shift * SubBuckets + static_cast<std::size_t>((value >> shift) - SubBuckets);
+    }
+
+    //Largest value that falls in `bucket`.
+    static uint64_t upperBound(std::size_t bucket);
+
+    std::array<uint64_t, BucketCount> counts{};
+    uint64_t samples = 0;
+    uint64_t sum = 0;
+    uint64_t minimum = UINT64_MAX;
+    uint64_t maximum = 0;
+};
+
+/**
+ * @brief Heap allocations made by the current thread.
+ *
+ * Only the command line program counts them, with its replacement `operator new` (src/main.cpp); the
+ * library does not replace the global allocator, which would clash with the benchmark's own counter, with
+ * sanitizer builds and with every program loading the shared library. Anywhere else this stays 0, and so
+ * do the allocation columns of a stage report.
+ */
+inline thread_local uint64_t threadAllocations = 0;
+
+//Reads of one device, timed by the I/O engine's `DeviceScheduler`.
+struct DeviceReadStats {
+    dev_t device = 0;
+    bool rotational = false;
+    LatencyHistogram latency;       // open and read of each file's prefix
+    uint64_t limitSum = 0;          // the device's concurrency limit after each read, summed for the mean
+};
+
+//Counters of one thread. Each thread fills its own, so recording takes no lock; they outlive the thread.
+struct StageThreadStats {
+    std::array<std::array<std::unique_ptr<LatencyHistogram>, StageTypeSlots>, StageCount> latency; // allocated on first use
+    std::array<std::array<uint64_t, StageTypeSlots>, StageCount> allocations{};
+    uint64_t syscalls = 0;
+    uint64_t bytesRead = 0;
+    std::vector<std::unique_ptr<DeviceReadStats>> devices;
+};
+
+//Whether `enableStageStats` was called; timers do nothing but this check until then.
+inline std::atomic<bool> stageStatsEnabled{false};
+
+//Starts recording, and the report's wall clock.
+void enableStageStats();
+
+//The calling thread's counters, registered on first use.
+StageThreadStats& threadStageStats();
+
+//Adds one stage run to the calling thread's counters.
+void recordStage(Stage stage, std::size_t typeSlot, uint64_t nanoseconds, uint64_t allocations);
+
+//Adds file I/O system calls, and the bytes they read, to the calling thread's counters.
+inline void countStageIo(uint64_t syscalls, uint64_t bytesRead = 0) {
+    if (stageStatsEnabled.load(std::memory_order_relaxed)) {
+        StageThreadStats& stats = threadStageStats();
+        stats.syscalls += syscalls;
+        stats.bytesRead += bytesRead;
+    }
+}
+
+//Adds one timed read of `device`, and the concurrency limit it left the device with.
+void recordDeviceRead(dev_t device, bool rotational, std::size_t limit, uint64_t nanoseconds);
+
+/**
+ * @brief Times one run of a stage, and the heap allocations the thread made meanwhile.
+ *
+ * Costs two clock reads while stats are enabled and one relaxed load otherwise. Use it through
+ * `FILEMETA_STAGE_TIMER` so builds without FILEMETA_STATS drop it entirely.
+ */
+class StageTimer {
+public:
+    explicit StageTimer(Stage stage, std::size_t typeSlot = AnyTypeSlot)
+        : stage(stage), typeSlot(typeSlot), active(stageStatsEnabled.load(std::memory_order_relaxed)) {
+        if (active) {
+            allocationsBefore = threadAllocations;
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    StageTimer(Stage stage, FileType fileType) : StageTimer(stage, static_cast<std::size_t>(fileType)) {}
+
+    ~StageTimer() {
+        if (active) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            recordStage(stage, typeSlot, static_cast<uint64_t>(elapsed.count()), threadAllocations - allocationsBefore);
+        }
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    //Files the run under a type found while it ran (e.g. by `determineFileType`).
+    void setFileType(FileType fileType) {
+        typeSlot = static_cast<std::size_t>(fileType);
+    }
+
+private:
+    Stage stage;
+    std::size_t typeSlot;
+    bool active;
+    uint64_t allocationsBefore = 0;
+    std::chrono::steady_clock::time_point start;
+};
+
+//One stage and type of a merged report.
+struct StageReportRow {
+    Stage stage;
+    std::size_t typeSlot;
+    LatencyHistogram latency;
+    uint64_t allocations = 0;
+};
+
+//The counters of every thread, merged.
+struct StageReport {
+    std::vector<StageReportRow> rows;   // stages in pipeline order, types in `FileType` order; unused ones left out
+    uint64_t syscalls = 0;
+    uint64_t bytesRead = 0;
+    std::vector<DeviceReadStats> devices; // in the order they were first read
+    double wallSeconds = 0;             // since `enableStageStats`
+};
+
+//Merges the counters of every thread that recorded anything, exited ones included.
+StageReport collectStageStats();
+
+//Writes the report as an aligned table: count, mean, p50, p90, p99, max, total time and allocations per
+//run, then one line per device read by the I/O engine.
+void writeStageStatsText(std::FILE* out, const StageReport& report);
+
+//Writes the report as one JSON object, times in nanoseconds.
+void writeStageStatsJson(std::FILE* out, const StageReport& report);
+
+#if FILEMETA_STATS
+#define FILEMETA_STAGE_TIMER(name, ...) StageTimer name(__VA_ARGS__)
+#define FILEMETA_STAGE_FILE_TYPE(name, fileType) name.setFileType(fileType)
+#define FILEMETA_COUNT_IO(...) countStageIo(__VA_ARGS__)
+#define FILEMETA_DEVICE_READ(...) recordDeviceRead(__VA_ARGS__)
+#else
+#define FILEMETA_STAGE_TIMER(name, ...)
+#define FILEMETA_STAGE_FILE_TYPE(name, fileType) ((void)0)
+#define FILEMETA_COUNT_IO(...) ((void)0)
+#define FILEMETA_DEVICE_READ(...) ((void)0)
+#endif
+
+#endif
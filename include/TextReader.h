@@ -0,0 +1,107 @@
+#ifndef TEXT_READER_H
+#define TEXT_READER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "FileContext.h"
+
+//Running totals of a `TextReader`, updated 64 bytes at a time.
+struct TextCounters {
+    uint64_t bytes = 0;
+    uint64_t lineFeeds = 0;
+    uint64_t carriageReturns = 0;
+    uint64_t crlfPairs = 0;         // CR immediately followed by LF
+    uint64_t words = 0;             // maximal runs of bytes other than space, \t, \n, \v, \f and \r
+    uint64_t nonAscii = 0;          // bytes >= 0x80
+    std::optional<uint64_t> invalidUtf8Offset; // of the first byte that breaks UTF-8 (the end for a cut sequence)
+
+    uint64_t spaceCarry = 1;        // whether the byte before the block was whitespace (the start of the text is)
+    uint64_t carriageReturnCarry = 0; // whether the byte before the block was CR
+    uint8_t utf8Pending = 0;        // continuation bytes the current UTF-8 sequence still needs
+    uint8_t utf8Lower = 0x80;       // range of the next continuation byte
+    uint8_t utf8Upper = 0xBF;
+};
+
+//What `TextReader` found in a text.
+struct TextSummary {
+    TextCounters counts;
+    uint64_t lines = 0;             // line breaks, plus one for a final line without one
+    std::string_view byteOrderMark; // encoding named by a leading BOM ("UTF-8", "UTF-16LE", ...), empty if none
+    std::pmr::vector<std::pmr::string> headLines; // the first lines, without their line break
+
+    //"UTF-16LE" and the like when a BOM says so, otherwise "ASCII", "UTF-8" or "Unknown" (not valid UTF-8).
+    std::string_view encoding() const;
+
+    //"LF", "CRLF", "CR", "Mixed", or "None" when the text has no line breaks.
+    std::string_view lineEndings() const;
+};
+
+/**
+ * @brief Counts lines, words and non-ASCII bytes of a text stream, validates it as UTF-8 and keeps its
+ * first lines, in constant memory.
+ *
+ * Input is consumed in place 64 bytes at a time: AVX2 or SSE2 compares (scalar elsewhere) turn each
+ * block into bitmasks of line feeds, carriage returns, whitespace and high bytes, which are counted with
+ * popcounts, carrying the last bit of each mask into the next block so words and CRLF pairs straddling
+ * blocks count once. UTF-8 is validated with a byte-at-a-time state machine, but only over blocks that
+ * contain a high byte or continue a sequence, so ASCII text never leaves the vector path. Only a trailing
+ * partial block is copied into the reader.
+ */
+class TextReader {
+public:
+    /**
+     * @param headLines How many leading lines to keep.
+     * @param headBytes Only lines within this many leading bytes are kept; a line crossing the limit is cut there.
+     * @param memory Where the kept lines are allocated (e.g. the file's `MetadataArena`).
+     */
+    TextReader(std::size_t headLines, std::size_t headBytes, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+    //Feeds the next bytes of the text.
+    void update(std::span<const uint8_t> data);
+
+    //Counts the final partial block and returns the results; the reader must not be fed afterwards.
+    TextSummary finish();
+
+private:
+    static constexpr std::size_t BlockLength = 64;
+
+    void captureHead(std::span<const uint8_t> data);
+
+    TextCounters counters;
+    std::size_t buffered = 0;
+    std::array<uint8_t, BlockLength> buffer;
+    std::array<uint8_t, 4> leading{};   // the first bytes, for the BOM
+    uint8_t lastByte = '\n';
+
+    std::size_t headLineLimit;
+    std::size_t headBytesLeft;
+    std::pmr::string currentLine;
+    std::pmr::vector<std::pmr::string> lines;
+};
+
+/**
+ * @brief Runs a file through `TextReader`.
+ *
+ * Complete contexts are read straight out of the mapping (or memory), advised for sequential access
+ * when they extend past the prefix.
+ * Otherwise the file is streamed through one 1 MiB buffer with `pread`.
+ *
+ * @param context The opened file.
+ * @param headLines How many leading lines to keep; only lines within `context.prefix()` are kept.
+ * @param memory Where the kept lines are allocated.
+ * @return The summary; `counts.bytes` is short of the file size when it could not be read in full.
+ */
+TextSummary readTextFile(const FileContext& context, std::size_t headLines,
+                         std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+//Name of the block loop `TextReader` selected for this CPU ("avx2", "sse2" or "scalar").
+const char* textReaderImplementation();
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A work-stealing thread pool.
+ *
+ * Every worker owns a deque of tasks. A worker pops its own newest task first (depth-first, which keeps
+ * the queues short while walking deep trees) and, once its deque is empty, steals the oldest task of
+ * another worker. Tasks submitted from inside a worker go to that worker's own deque; tasks submitted
+ * from outside the pool are distributed round-robin.
+ */
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    /**
+     * @brief Starts the worker threads.
+     *
+     * @param threadCount Number of workers, or 0 to use `std::thread::hardware_concurrency()`.
+     */
+    explicit ThreadPool(std::size_t threadCount = 0);
+
+    // Waits for all submitted tasks and joins the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Queues a task for execution. Tasks must not throw.
+     *
+     * @param task The task to run.
+     */
+    void submit(Task task);
+
+    //Blocks until every submitted task, including tasks submitted by tasks, has finished
+    void wait();
+
+    //Returns the number of worker threads.
+    std::size_t size() const {
+        return workers.size();
+    }
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(std::size_t index);
+    bool popLocal(std::size_t index, Task& task);
+    bool steal(std::size_t index, Task& task);
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+
+    std::atomic<std::size_t> pending{0}; // submitted but not yet finished
+    std::atomic<std::size_t> queued{0};  // sitting in a deque
+    std::atomic<std::size_t> sleepers{0};
+    std::atomic<std::size_t> nextQueue{0};
+
+    std::mutex sleepMutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable idleCondition;
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef ZIP_READER_H
+#define ZIP_READER_H
+
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include "ByteReader.h"
+
+//One central directory record. `name` points into the archive bytes.
+struct ZipEntry {
+    std::string_view name;
+    uint16_t versionMadeBy = 0;
+    uint16_t flags = 0;
+    uint16_t method = 0;
+    uint16_t dosTime = 0;
+    uint16_t dosDate = 0;
+    uint32_t crc32 = 0;
+    uint64_t compressedSize = 0;
+    uint64_t uncompressedSize = 0;
+    uint64_t localHeaderOffset = 0;
+
+    //Checks bit 0 of the general purpose flags.
+    bool isEncrypted() const {
+        return flags & 0x0001;
+    }
+
+    //Directories are stored as empty entries whose name ends in '/'.
+    bool isDirectory() const {
+        return !name.empty() && name.back() == '/';
+    }
+};
+
+/**
+ * @brief Reads a ZIP archive's central directory without decompressing anything.
+ *
+ * The constructor locates the End of Central Directory record (and the ZIP64 EOCD through its locator
+ * when the classic fields are saturated). `forEachEntry` then streams the central directory records one
+ * at a time, applying ZIP64 extra fields, so memory stays constant however many entries the archive has.
+ * Malformed archives throw `std::runtime_error`.
+ */
+class ZipReader {
+public:
+    explicit ZipReader(std::span<const uint8_t> archive);
+
+    //Number of entries announced by the EOCD record.
+    uint64_t entryCount() const {
+        return totalEntries;
+    }
+
+    //The archive comment (raw bytes).
+    std::string_view comment() const {
+        return archiveComment;
+    }
+
+    //Checks whether the archive uses a ZIP64 End of Central Directory.
+    bool isZip64() const {
+        return zip64;
+    }
+
+    /**
+     * @brief Visits every central directory entry in order.
+     *
+     * @param visit Called as `bool visit(const ZipEntry&)` for each entry; returning false stops the walk.
+     * @return The number of entries visited.
+     */
+    template <typename Visitor>
+    uint64_t forEachEntry(Visitor&& visit) const {
+        uint64_t offset = directoryOffset;
+        uint64_t visited = 0;
+        ZipEntry entry;
+        while (visited < totalEntries && readEntry(offset, entry)) {
+            ++visited;
+            if (!visit(static_cast<const ZipEntry&>(entry))) {
+                break;
+            }
+        }
+        return visited;
+    }
+
+    /**
+     * @brief Locates an entry's (possibly compressed) data through its local file header.
+     *
+     * @param entry An entry produced by `forEachEntry`.
+     * @return A view of the entry's stored bytes inside the archive.
+     */
+    std::span<const uint8_t> entryData(const ZipEntry& entry) const;
+
+private:
+    //Decodes the central directory record at `offset` and advances past it; false at the end of the directory.
+    bool readEntry(uint64_t& offset, ZipEntry& entry) const;
+
+    ByteReader reader;
+    uint64_t totalEntries = 0;
+    uint64_t directoryOffset = 0;
+    uint64_t directorySize = 0;
+    std::string_view archiveComment;
+    bool zip64 = false;
+};
+
+//Returns a readable name for a ZIP compression method ("Store", "Deflate", ...).
+std::string zipMethodName(uint16_t method);
+
+//Formats an MS-DOS date and time pair as "YYYY-MM-DD HH:MM:SS", allocated from `memory`.
+std::pmr::string formatDosDateTime(uint16_t dosDate, uint16_t dosTime, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+#endif
@@ -0,0 +1,165 @@
+#include "AnalyzerContext.h"
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+ResultQueue::ResultQueue(std::size_t capacity) {
+    std::size_t size = std::bit_ceil(std::max<std::size_t>(capacity, 2));
+    cells = std::make_unique<Cell[]>(size);
+    mask = size - 1;
+    for (std::size_t i = 0; i < size; ++i) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool ResultQueue::tryPush(AnalysisResult& result) {
+    std::size_t position = tail.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[position & mask];
+        std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        auto lag = static_cast<std::ptrdiff_t>(sequence - position);
+        if (lag == 0) {
+            if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (lag < 0) {
+            return false; // the consumers have not taken this cell's last result yet
+        } else {
+            position = tail.load(std::memory_order_relaxed);
+        }
+    }
+    cell->result = std::move(result);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+void ResultQueue::push(AnalysisResult&& result) {
+    while (true) {
+        uint32_t seen = pops.load(std::memory_order_acquire);
+        if (tryPush(result)) {
+            break;
+        }
+        pops.wait(seen, std::memory_order_acquire);
+    }
+    pushes.fetch_add(1, std::memory_order_release);
+    pushes.notify_all();
+}
+
+bool ResultQueue::tryPop(AnalysisResult& result) {
+    std::size_t position = head.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells[position & mask];
+        std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        auto lag = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+        if (lag == 0) {
+            if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (lag < 0) {
+            return false; // not published yet
+        } else {
+            position = head.load(std::memory_order_relaxed);
+        }
+    }
+    result = std::move(cell->result);
+    cell->sequence.store(position + mask + 1, std::memory_order_release);
+    return true;
+}
+
+bool ResultQueue::pop(AnalysisResult& result) {
+    while (true) {
+        uint32_t seen = pushes.load(std::memory_order_acquire);
+        if (tryPop(result)) {
+            pops.fetch_add(1, std::memory_order_release);
+            pops.notify_all();
+            return true;
+        }
+        if (closed.load(std::memory_order_acquire)) {
+            // Everything was pushed before the close, so this look is final
+            if (!tryPop(result)) {
+                return false;
+            }
+            pops.fetch_add(1, std::memory_order_release);
+            pops.notify_all();
+            return true;
+        }
+        pushes.wait(seen, std::memory_order_acquire);
+    }
+}
+
+void ResultQueue::close() {
+    closed.store(true, std::memory_order_release);
+    pushes.fetch_add(1, std::memory_order_release);
+    pushes.notify_all();
+}
+
+void ResultQueue::reopen() {
+    closed.store(false, std::memory_order_release);
+}
+
+AnalyzerContext::AnalyzerContext(AnalyzerOptions options) {
+    if (!options.cachePath.empty()) {
+        cache = std::make_unique<MetadataCache>(options.cachePath);
+        options.scan.cache = cache.get();
+    }
+    // The scanner outlives every batch, so it reaches the batch's callbacks through the members
+    scanner = std::make_unique<DirectoryScanner>(
+        options.scan,
+        [this](const std::filesystem::path& filePath, FileType fileType, const MetadataMap& metadata) {
+            (*onResult)(filePath, fileType, metadata);
+        },
+        [this](const std::filesystem::path& filePath, const std::string& message) {
+            if (*onError) {
+                (*onError)(filePath, message);
+            }
+        });
+}
+
+AnalyzerContext::~AnalyzerContext() {
+    scanner.reset();
+    if (cache) {
+        try {
+            cache->save();
+        } catch (const std::exception&) {
+        }
+    }
+}
+
+ScanStats AnalyzerContext::analyze(std::span<const std::filesystem::path> paths, const ResultCallback& onResult,
+                                   const ErrorCallback& onError) {
+    std::lock_guard<std::mutex> lock(batchMutex);
+    this->onResult = &onResult;
+    this->onError = &onError;
+    ScanStats stats = scanner->scan(std::vector<std::filesystem::path>(paths.begin(), paths.end()));
+    this->onResult = nullptr;
+    this->onError = nullptr;
+    return stats;
+}
+
+ScanStats AnalyzerContext::analyze(std::span<const std::filesystem::path> paths, ResultQueue& queue) {
+    ScanStats stats;
+    try {
+        stats = analyze(
+            paths,
+            [&queue](const std::filesystem::path& filePath, FileType fileType, const MetadataMap& metadata) {
+                queue.push(AnalysisResult{filePath, fileType, metadata, {}}); // copied out of the worker's arena
+            },
+            [&queue](const std::filesystem::path& filePath, const std::string& message) {
+                queue.push(AnalysisResult{filePath, FileType::UNKNOWN, {}, message});
+            });
+    } catch (...) {
+        queue.close();
+        throw;
+    }
+    queue.close();
+    return stats;
+}
+
+void AnalyzerContext::saveCache() {
+    if (cache) {
+        std::lock_guard<std::mutex> lock(batchMutex);
+        cache->save();
+    }
+}
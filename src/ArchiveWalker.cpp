@@ -0,0 +1,453 @@
+#include "ArchiveWalker.h"
+#include "ContentHash.h"
+#include "MetadataArena.h"
+#include "TextReader.h"
+#include "ZipReader.h"
+#include <algorithm>
+#include <ctime>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+namespace {
+
+constexpr uint16_t StoreMethod = 0;
+constexpr uint16_t DeflateMethod = 8;
+
+constexpr std::size_t StreamWindow = 256 << 10; // bytes inflated at a time for members read front to back
+
+// Formats whose extractors read no further than the header in the default prefix
+bool needsWholeMember(FileType fileType) {
+    return fileType != FileType::JPEG && fileType != FileType::BMP;
+}
+
+// MS-DOS dates and times are local time with two-second resolution
+Timestamp dosTimestamp(uint16_t dosDate, uint16_t dosTime) {
+    struct tm parts {};
+    parts.tm_year = ((dosDate >> 9) & 0x7F) + 80;
+    parts.tm_mon = ((dosDate >> 5) & 0x0F) - 1;
+    parts.tm_mday = dosDate & 0x1F;
+    parts.tm_hour = (dosTime >> 11) & 0x1F;
+    parts.tm_min = (dosTime >> 5) & 0x3F;
+    parts.tm_sec = (dosTime & 0x1F) * 2;
+    parts.tm_isdst = -1;
+    time_t seconds = std::mktime(&parts);
+    return {seconds == -1 ? 0 : static_cast<int64_t>(seconds), 0};
+}
+
+/**
+ * Inflates a raw deflate stream step by step, drawing on the archive's shared budget and stopping at the
+ * member's own limit. Bytes can be kept at their offset in a buffer the size of the limit, or skipped:
+ * the buffer is an anonymous mapping, so the pages of skipped ranges read as zeros and are never backed
+ * by memory. Bytes can also be handed out through a caller's window without being kept at all.
+ */
+class MemberInflater {
+public:
+    //@param size The member's uncompressed size. @param maxBytes Bytes the member may inflate at most.
+    MemberInflater(std::span<const uint8_t> compressed, uint64_t& budget, uint64_t size, uint64_t maxBytes)
+        : input(compressed), budget(budget), size(size), limit(std::min(size, maxBytes)) {
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+            throw std::runtime_error("ZIP: cannot initialize inflate");
+        }
+    }
+
+    ~MemberInflater() {
+        inflateEnd(&stream);
+        if (buffer) {
+            ::munmap(buffer, static_cast<std::size_t>(limit));
+        }
+    }
+
+    MemberInflater(const MemberInflater&) = delete;
+    MemberInflater& operator=(const MemberInflater&) = delete;
+
+    //Keeps the bytes up to `target`, as far as the stream, the budget and the limit allow; returns the buffer up to the position.
+    std::span<const uint8_t> inflateTo(uint64_t target) {
+        target = std::min(target, limit);
+        if (target > produced) {
+            if (!buffer) {
+                void* address = ::mmap(nullptr, static_cast<std::size_t>(limit), PROT_READ | PROT_WRITE,
+                                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+                if (address == MAP_FAILED) {
+                    throw std::runtime_error("ZIP: cannot allocate the member buffer");
+                }
+                buffer = static_cast<uint8_t*>(address);
+            }
+            produce(buffer + produced, static_cast<std::size_t>(target - produced));
+        }
+        return {buffer, static_cast<std::size_t>(produced)};
+    }
+
+    //Inflates up to `target` without keeping the bytes; their part of the buffer stays zero.
+    void skipTo(uint64_t target) {
+        std::vector<uint8_t> scratch(static_cast<std::size_t>(std::min<uint64_t>(StreamWindow, target - std::min(target, produced))));
+        while (produced < target && produce(scratch.data(), static_cast<std::size_t>(std::min<uint64_t>(scratch.size(), target - produced))) > 0) {
+        }
+    }
+
+    //Inflates up to `length` bytes into `out` without keeping them; returns how many, 0 at the end.
+    std::size_t read(uint8_t* out, std::size_t length) {
+        return produce(out, length);
+    }
+
+    //The buffer after a mix of kept and skipped ranges: up to the size once the walk is through (what
+    //follows the last kept range was skipped), otherwise up to the position.
+    std::span<const uint8_t> sparse() const {
+        return {buffer, static_cast<std::size_t>(exhausted() ? produced : limit)};
+    }
+
+    //Bytes inflated so far, kept or not.
+    uint64_t position() const {
+        return produced;
+    }
+
+    //Whether the budget or the limit stopped the stream short of the member's size.
+    bool exhausted() const {
+        return !ended && produced < size && (produced == limit || budget == 0);
+    }
+
+private:
+    std::size_t produce(uint8_t* out, std::size_t length) {
+        length = static_cast<std::size_t>(std::min<uint64_t>({length, limit - produced, budget}));
+        std::size_t done = 0;
+        while (!ended && done < length) {
+            if (stream.avail_in == 0 && !input.empty()) {
+                // avail_in is 32 bits wide, so members over 4 GiB are fed in slices
+                std::size_t slice = std::min<std::size_t>(input.size(), 1u << 30);
+                stream.next_in = const_cast<Bytef*>(input.data());
+                stream.avail_in = static_cast<uInt>(slice);
+                input = input.subspan(slice);
+            }
+            stream.next_out = out + done;
+            stream.avail_out = static_cast<uInt>(std::min<std::size_t>(length - done, 1u << 30));
+            int status = inflate(&stream, Z_NO_FLUSH);
+            done += static_cast<std::size_t>(stream.next_out - (out + done));
+            if (status == Z_STREAM_END || (status == Z_BUF_ERROR && stream.avail_in == 0 && input.empty())) {
+                ended = true; // complete, or cut short by a truncated archive
+            } else if (status != Z_OK) {
+                throw std::runtime_error("ZIP: corrupt deflate stream");
+            }
+        }
+        produced += done;
+        budget -= done;
+        return done;
+    }
+
+    z_stream stream{};
+    std::span<const uint8_t> input;    // compressed bytes not yet handed to zlib
+    uint8_t* buffer = nullptr;         // `limit` bytes, mapped on the first kept byte
+    uint64_t produced = 0;
+    uint64_t& budget;
+    uint64_t size;
+    uint64_t limit;
+    bool ended = false;
+};
+
+//Reads a member front to back through a window: first the bytes already inflated, then fresh ones.
+class MemberReader {
+public:
+    MemberReader(std::span<const uint8_t> inflated, MemberInflater& inflater) : pending(inflated), inflater(inflater) {}
+
+    //Takes whatever is available next, up to `length` bytes; empty at the end of the member.
+    std::span<const uint8_t> next(std::size_t length = StreamWindow) {
+        if (pending.empty()) {
+            window.resize(StreamWindow);
+            pending = std::span<const uint8_t>(window.data(), inflater.read(window.data(), window.size()));
+        }
+        std::span<const uint8_t> taken = pending.first(std::min(length, pending.size()));
+        pending = pending.subspan(taken.size());
+        return taken;
+    }
+
+    //Appends the next `length` bytes to `out`; false when the member ends first.
+    bool copy(std::size_t length, std::vector<uint8_t>& out) {
+        while (length > 0) {
+            std::span<const uint8_t> taken = next(length);
+            if (taken.empty()) {
+                return false;
+            }
+            out.insert(out.end(), taken.begin(), taken.end());
+            length -= taken.size();
+        }
+        return true;
+    }
+
+    //Steps over the next `length` bytes; false when the member ends first.
+    bool skip(std::size_t length) {
+        while (length > 0) {
+            std::size_t taken = next(length).size();
+            if (taken == 0) {
+                return false;
+            }
+            length -= taken;
+        }
+        return true;
+    }
+
+private:
+    std::span<const uint8_t> pending;
+    MemberInflater& inflater;
+    std::vector<uint8_t> window;
+};
+
+// Keeps every PNG chunk but the image data, which the PNG walker steps over by its length field
+void inflatePng(MemberInflater& inflater, uint64_t size) {
+    for (uint64_t offset = 8;;) {
+        std::span<const uint8_t> bytes = inflater.inflateTo(offset + 8);
+        if (bytes.size() < offset + 8) {
+            return;
+        }
+        ByteReader reader(bytes);
+        uint64_t dataEnd = offset + 8 + reader.u32be(offset);
+        std::string_view type = reader.chars(offset + 4, 4);
+        if (type == "IDAT" || type == "fdAT") {
+            inflater.skipTo(dataEnd);
+        }
+        if (inflater.inflateTo(dataEnd + 4).size() < dataEnd + 4 || type == "IEND") {
+            return;
+        }
+        offset = dataEnd + 4;
+        if (offset >= size) {
+            return;
+        }
+    }
+}
+
+// Keeps every RIFF chunk but the samples, which the WAV walker steps over by their size field
+void inflateWav(MemberInflater& inflater, uint64_t size) {
+    for (uint64_t offset = 12;;) {
+        std::span<const uint8_t> bytes = inflater.inflateTo(offset + 8);
+        if (bytes.size() < offset + 8) {
+            return;
+        }
+        ByteReader reader(bytes);
+        uint32_t chunkSize = reader.u32le(offset + 4);
+        if (chunkSize == 0xFFFFFFFF) {
+            inflater.inflateTo(size); // RF64: the real sizes are in ds64
+            return;
+        }
+        uint64_t end = offset + 8 + chunkSize + (chunkSize & 1);
+        if (reader.chars(offset, 4) == "data") {
+            inflater.skipTo(offset + 8 + chunkSize);
+        }
+        if (inflater.inflateTo(end).size() < end || end >= size) {
+            return;
+        }
+        offset = end;
+    }
+}
+
+/**
+ * Copies a GIF with its image data left out: every image keeps its descriptor, color table and LZW code
+ * size, followed by an empty sub-block chain. The GIF walker steps through sub-blocks one length byte at
+ * a time, so skipping them in place would still touch every page; the copy is what it needs.
+ */
+std::vector<uint8_t> compactGif(MemberReader& reader) {
+    std::vector<uint8_t> out;
+    auto colorTable = [](uint8_t packed) -> std::size_t { return packed & 0x80 ? 3u << ((packed & 0x07) + 1) : 0; };
+    auto subBlocks = [&reader, &out](bool keep) {
+        while (true) {
+            std::span<const uint8_t> length = reader.next(1);
+            if (length.empty()) {
+                return false;
+            }
+            if (keep || length[0] == 0) {
+                out.push_back(length[0]);
+            }
+            if (length[0] == 0) {
+                return true;
+            }
+            if (!(keep ? reader.copy(length[0], out) : reader.skip(length[0]))) {
+                return false;
+            }
+        }
+    };
+    if (!reader.copy(13, out) || !reader.copy(colorTable(out[10]), out)) {
+        return out;
+    }
+    while (true) {
+        std::span<const uint8_t> introducer = reader.next(1);
+        if (introducer.empty()) {
+            return out;
+        }
+        out.push_back(introducer[0]);
+        if (introducer[0] == 0x21) {
+            if (!reader.copy(1, out) || !subBlocks(true)) {
+                return out;
+            }
+        } else if (introducer[0] == 0x2C) {
+            if (!reader.copy(9, out) || !reader.copy(colorTable(out.back()), out) || !reader.copy(1, out) || !subBlocks(false)) {
+                return out;
+            }
+        } else {
+            return out; // the trailer, or something the walker stops at too
+        }
+    }
+}
+
+//State of one `walkArchiveMembers` call.
+class ArchiveWalk {
+public:
+    ArchiveWalk(const ArchiveOptions& options,
+                const std::function<void(const std::filesystem::path&, FileType, const MetadataMap&)>& onMember,
+                const std::function<void(const std::filesystem::path&, const std::string&)>& onError)
+        : options(options), onMember(onMember), onError(onError), budget(options.maxInflatedBytes) {}
+
+    //Analyzes every member of the archive in `bytes`, found at nesting level `depth`.
+    void walk(const std::filesystem::path& archivePath, std::span<const uint8_t> bytes, unsigned depth) {
+        ZipReader zip(bytes);
+        zip.forEachEntry([&](const ZipEntry& entry) {
+            if (entry.isDirectory()) {
+                return true;
+            }
+            // Member names are relative; a leading '/' must not make the path absolute
+            std::string_view name = entry.name;
+            name.remove_prefix(std::min(name.size(), name.find_first_not_of('/')));
+            std::filesystem::path memberPath = archivePath.native() + "/" + std::string(name);
+            try {
+                analyzeMember(zip, entry, memberPath, depth);
+            } catch (const std::exception& e) {
+                ++stats.errors;
+                onError(memberPath, e.what());
+            }
+            return true;
+        });
+    }
+
+    ArchiveStats finish() {
+        stats.inflatedBytes = options.maxInflatedBytes - budget;
+        return stats;
+    }
+
+private:
+    void analyzeMember(const ZipReader& zip, const ZipEntry& entry, const std::filesystem::path& memberPath, unsigned depth) {
+        if (entry.isEncrypted()) {
+            throw std::runtime_error("ZIP: member is encrypted");
+        }
+        if (entry.method != StoreMethod && entry.method != DeflateMethod) {
+            throw std::runtime_error("ZIP: unsupported compression method " + zipMethodName(entry.method));
+        }
+        std::span<const uint8_t> data = zip.entryData(entry);
+
+        struct stat status {};
+        status.st_mode = S_IFREG | 0444;
+        status.st_nlink = 1;
+        status.st_size = static_cast<off_t>(entry.uncompressedSize);
+        Timestamp modified = dosTimestamp(entry.dosDate, entry.dosTime);
+        status.st_mtim.tv_sec = static_cast<time_t>(modified.seconds);
+        status.st_atim = status.st_ctim = status.st_mtim;
+
+        // Stored members are used in place; deflated ones are inflated far enough to detect their type first
+        std::optional<MemberInflater> inflater;
+        std::span<const uint8_t> contents;
+        if (entry.method == StoreMethod) {
+            contents = data.first(static_cast<std::size_t>(std::min<uint64_t>(data.size(), entry.uncompressedSize)));
+        } else {
+            if (budget == 0 && entry.uncompressedSize > 0) {
+                throw std::runtime_error("ZIP: decompression budget exhausted");
+            }
+            inflater.emplace(data, budget, entry.uncompressedSize, options.maxMemberBytes);
+            contents = inflater->inflateTo(std::min<uint64_t>(entry.uncompressedSize, FileContext::DefaultPrefixSize));
+        }
+
+        FileType fileType = determineFileType<poppler::document, std::ifstream, JPEGHeader, PNGHeader, BMPHeader, ZIPHeader, WAVHeader, GIFHeader>(
+            FileContext(memberPath, status, contents));
+        bool wantsAll = needsWholeMember(fileType);
+        bool partial = inflater && wantsAll && contents.size() < entry.uncompressedSize;
+
+        // Everything allocated from the arena dies with this block, before a nested walk rewinds the arena again
+        {
+            arena.reset();
+            FileContext context(memberPath, status, contents);
+            MetadataMap metadata(&arena);
+            if (partial && fileType == FileType::TXT) {
+                // Text is streamed through the reader; only the prefix (for the head lines) stays in memory
+                MemberReader reader(contents, *inflater);
+                TextReader text(TextHeadLines, contents.size(), &arena);
+                ContentHasher hasher;
+                for (std::span<const uint8_t> window; !(window = reader.next()).empty();) {
+                    text.update(window);
+                    if (options.hashContents) {
+                        hasher.update(window);
+                    }
+                }
+                metadata = analyzeFileMetadata(context, fileType, options.includeBasic, false, &arena);
+                if (options.includeSpecialized) {
+                    addTextMetadata(metadata, text.finish(), context, &arena);
+                }
+                if (options.hashContents && inflater->position() == entry.uncompressedSize) {
+                    metadata["ContentHash"_key] = MetadataValue::hex(hasher.digest(), 16);
+                }
+            } else if (partial && fileType == FileType::GIF && !options.hashContents) {
+                // The walker sees the GIF without its image data, complete unless the budget or the limit cut it short
+                MemberReader reader(contents, *inflater);
+                std::vector<uint8_t> compacted = compactGif(reader);
+                struct stat compactedStatus = status;
+                if (!inflater->exhausted()) {
+                    compactedStatus.st_size = static_cast<off_t>(compacted.size());
+                }
+                FileContext analyzed(memberPath, compactedStatus, compacted);
+                metadata = analyzeFileMetadata(context, fileType, options.includeBasic, false, &arena);
+                for (auto& [key, value] : analyzeFileMetadata(analyzed, fileType, false, options.includeSpecialized, &arena)) {
+                    metadata[key] = std::move(value);
+                }
+                if (inflater->exhausted()) {
+                    metadata["AnalyzedBytes"_key] = MetadataValue::byteCount(inflater->position());
+                }
+            } else {
+                if (partial) {
+                    // PNG and WAV keep their chunk headers at their offsets, without the pixels and samples between them
+                    if (fileType == FileType::PNG && !options.hashContents) {
+                        inflatePng(*inflater, entry.uncompressedSize);
+                        contents = inflater->sparse();
+                    } else if (fileType == FileType::WAV && !options.hashContents) {
+                        inflateWav(*inflater, entry.uncompressedSize);
+                        contents = inflater->sparse();
+                    } else {
+                        contents = inflater->inflateTo(entry.uncompressedSize);
+                    }
+                }
+                FileContext analyzed(memberPath, status, contents);
+                metadata = analyzeFileMetadata(analyzed, fileType, options.includeBasic, options.includeSpecialized, &arena);
+                if (wantsAll && !analyzed.isComplete()) {
+                    metadata["AnalyzedBytes"_key] = MetadataValue::byteCount(inflater ? inflater->position() : contents.size());
+                }
+                if (options.hashContents && analyzed.isComplete()) {
+                    metadata["ContentHash"_key] = MetadataValue::hex(contentHash(contents), 16);
+                }
+            }
+            onMember(memberPath, fileType, metadata);
+        }
+        ++stats.members;
+
+        if (fileType == FileType::ZIP && depth < options.maxDepth) {
+            if (contents.size() < entry.uncompressedSize) {
+                throw std::runtime_error("ZIP: nested archive exceeds the decompression budget");
+            }
+            walk(memberPath, contents, depth + 1);
+        }
+    }
+
+    const ArchiveOptions& options;
+    const std::function<void(const std::filesystem::path&, FileType, const MetadataMap&)>& onMember;
+    const std::function<void(const std::filesystem::path&, const std::string&)>& onError;
+    uint64_t budget;
+    MetadataArena arena;    // holds one member's metadata at a time
+    ArchiveStats stats;
+};
+
+}
+
+ArchiveStats walkArchiveMembers(const FileContext& archive, const ArchiveOptions& options,
+                                const std::function<void(const std::filesystem::path&, FileType, const MetadataMap&)>& onMember,
+                                const std::function<void(const std::filesystem::path&, const std::string&)>& onError) {
+    if (!archive.isComplete()) {
+        throw std::runtime_error("ZIP: archive is not available in full");
+    }
+    ArchiveWalk walk(options, onMember, onError);
+    walk.walk(archive.path(), archive.bytes(), 1);
+    return walk.finish();
+}
@@ -0,0 +1,383 @@
+#include "ContentHash.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <fcntl.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr uint32_t Prime32_1 = 0x9E3779B1U;
+constexpr uint32_t Prime32_2 = 0x85EBCA77U;
+constexpr uint32_t Prime32_3 = 0xC2B2AE3DU;
+constexpr uint64_t Prime64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t Prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t Prime64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t Prime64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t Prime64_5 = 0x27D4EB2F165667C5ULL;
+constexpr uint64_t PrimeMx1 = 0x165667919E3779F9ULL;
+constexpr uint64_t PrimeMx2 = 0x9FB21C651E98DF25ULL;
+
+// XXH3's default secret; every long-input step reads a sliding 64-byte window of it
+alignas(64) constexpr uint8_t Secret[192] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+constexpr std::size_t StripesPerBlock = (sizeof(Secret) - 64) / 8;
+constexpr std::size_t ScrambleSecret = sizeof(Secret) - 64;
+constexpr std::size_t LastStripeSecret = sizeof(Secret) - 64 - 7;
+constexpr std::size_t MergeSecret = 11;
+
+uint64_t read64(const uint8_t* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return std::endian::native == std::endian::little ? value : __builtin_bswap64(value);
+}
+
+uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return std::endian::native == std::endian::little ? value : __builtin_bswap32(value);
+}
+
+__extension__ typedef unsigned __int128 Uint128;
+
+uint64_t mulFold64(uint64_t a, uint64_t b) {
+    Uint128 product = static_cast<Uint128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+uint64_t xxh64Avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= Prime64_2;
+    h ^= h >> 29;
+    h *= Prime64_3;
+    return h ^ (h >> 32);
+}
+
+uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= PrimeMx1;
+    return h ^ (h >> 32);
+}
+
+uint64_t rrmxmx(uint64_t h, uint64_t length) {
+    h ^= std::rotl(h, 49) ^ std::rotl(h, 24);
+    h *= PrimeMx2;
+    h ^= (h >> 35) + length;
+    h *= PrimeMx2;
+    return h ^ (h >> 28);
+}
+
+uint64_t mix16(const uint8_t* data, const uint8_t* secret) {
+    return mulFold64(read64(data) ^ read64(secret), read64(data + 8) ^ read64(secret + 8));
+}
+
+// The short-input paths of XXH3: 0-16, 17-128 and 129-240 bytes, each with its own mixing
+uint64_t hashShort(const uint8_t* data, std::size_t length) {
+    if (length == 0) {
+        return xxh64Avalanche(read64(Secret + 56) ^ read64(Secret + 64));
+    }
+    if (length <= 3) {
+        uint32_t combined = (uint32_t{data[0]} << 16) | (uint32_t{data[length >> 1]} << 24) | data[length - 1] |
+                            static_cast<uint32_t>(length << 8);
+        return xxh64Avalanche(combined ^ (read32(Secret) ^ read32(Secret + 4)));
+    }
+    if (length <= 8) {
+        uint64_t input = read32(data + length - 4) + (uint64_t{read32(data)} << 32);
+        return rrmxmx(input ^ (read64(Secret + 8) ^ read64(Secret + 16)), length);
+    }
+    if (length <= 16) {
+        uint64_t low = read64(data) ^ (read64(Secret + 24) ^ read64(Secret + 32));
+        uint64_t high = read64(data + length - 8) ^ (read64(Secret + 40) ^ read64(Secret + 48));
+        return avalanche(length + __builtin_bswap64(low) + high + mulFold64(low, high));
+    }
+
+    uint64_t acc = length * Prime64_1;
+    if (length <= 128) {
+        if (length > 32) {
+            if (length > 64) {
+                if (length > 96) {
+                    acc += mix16(data + 48, Secret + 96);
+                    acc += mix16(data + length - 64, Secret + 112);
+                }
+                acc += mix16(data + 32, Secret + 64);
+                acc += mix16(data + length - 48, Secret + 80);
+            }
+            acc += mix16(data + 16, Secret + 32);
+            acc += mix16(data + length - 32, Secret + 48);
+        }
+        acc += mix16(data, Secret);
+        acc += mix16(data + length - 16, Secret + 16);
+        return avalanche(acc);
+    }
+
+    for (std::size_t i = 0; i < 8; ++i) {
+        acc += mix16(data + 16 * i, Secret + 16 * i);
+    }
+    acc = avalanche(acc);
+    for (std::size_t i = 8; i < length / 16; ++i) {
+        acc += mix16(data + 16 * i, Secret + 16 * (i - 8) + 3);
+    }
+    acc += mix16(data + length - 16, Secret + 136 - 17);
+    return avalanche(acc);
+}
+
+using AccumulateFunction = void (*)(uint64_t* acc, const uint8_t* data, const uint8_t* secret, std::size_t stripes);
+using ScrambleFunction = void (*)(uint64_t* acc, const uint8_t* secret);
+
+#if defined(__x86_64__)
+
+// For each 64-bit lane i: acc[i] += lo32(k) * hi32(k) with k = data[i] ^ secret[i], and acc[i ^ 1] += data[i].
+// SSE2 updates two lanes per instruction and AVX2 four: the 32x32->64 multiply is PMULUDQ and the
+// swapped-pair add is a 32-bit shuffle
+__attribute__((target("avx2")))
+void accumulateAvx2(uint64_t* acc, const uint8_t* data, const uint8_t* secret, std::size_t stripes) {
+    __m256i* lanes = reinterpret_cast<__m256i*>(acc);
+    __m256i a0 = _mm256_load_si256(lanes);
+    __m256i a1 = _mm256_load_si256(lanes + 1);
+    for (std::size_t n = 0; n < stripes; ++n, data += 64, secret += 8) {
+        __m256i d0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+        __m256i d1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32));
+        __m256i k0 = _mm256_xor_si256(d0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret)));
+        __m256i k1 = _mm256_xor_si256(d1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret + 32)));
+        a0 = _mm256_add_epi64(a0, _mm256_mul_epu32(k0, _mm256_srli_epi64(k0, 32)));
+        a1 = _mm256_add_epi64(a1, _mm256_mul_epu32(k1, _mm256_srli_epi64(k1, 32)));
+        a0 = _mm256_add_epi64(a0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2)));
+        a1 = _mm256_add_epi64(a1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+    _mm256_store_si256(lanes, a0);
+    _mm256_store_si256(lanes + 1, a1);
+}
+
+__attribute__((target("avx2")))
+void scrambleAvx2(uint64_t* acc, const uint8_t* secret) {
+    __m256i* lanes = reinterpret_cast<__m256i*>(acc);
+    const __m256i prime = _mm256_set1_epi32(static_cast<int>(Prime32_1));
+    for (std::size_t i = 0; i < 2; ++i) {
+        __m256i lane = _mm256_load_si256(lanes + i);
+        lane = _mm256_xor_si256(lane, _mm256_srli_epi64(lane, 47));
+        lane = _mm256_xor_si256(lane, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret + 32 * i)));
+        __m256i low = _mm256_mul_epu32(lane, prime);
+        __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(lane, 32), prime);
+        _mm256_store_si256(lanes + i, _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+    }
+}
+
+void accumulateSse2(uint64_t* acc, const uint8_t* data, const uint8_t* secret, std::size_t stripes) {
+    __m128i* lanes = reinterpret_cast<__m128i*>(acc);
+    __m128i a[4] = {_mm_load_si128(lanes), _mm_load_si128(lanes + 1), _mm_load_si128(lanes + 2), _mm_load_si128(lanes + 3)};
+    for (std::size_t n = 0; n < stripes; ++n, data += 64, secret += 8) {
+        for (std::size_t i = 0; i < 4; ++i) {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i));
+            __m128i k = _mm_xor_si128(d, _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret + 16 * i)));
+            a[i] = _mm_add_epi64(a[i], _mm_mul_epu32(k, _mm_srli_epi64(k, 32)));
+            a[i] = _mm_add_epi64(a[i], _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+        }
+    }
+    for (std::size_t i = 0; i < 4; ++i) {
+        _mm_store_si128(lanes + i, a[i]);
+    }
+}
+
+void scrambleSse2(uint64_t* acc, const uint8_t* secret) {
+    __m128i* lanes = reinterpret_cast<__m128i*>(acc);
+    const __m128i prime = _mm_set1_epi32(static_cast<int>(Prime32_1));
+    for (std::size_t i = 0; i < 4; ++i) {
+        __m128i lane = _mm_load_si128(lanes + i);
+        lane = _mm_xor_si128(lane, _mm_srli_epi64(lane, 47));
+        lane = _mm_xor_si128(lane, _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret + 16 * i)));
+        __m128i low = _mm_mul_epu32(lane, prime);
+        __m128i high = _mm_mul_epu32(_mm_srli_epi64(lane, 32), prime);
+        _mm_store_si128(lanes + i, _mm_add_epi64(low, _mm_slli_epi64(high, 32)));
+    }
+}
+
+#else
+
+// Stripe n of a block is keyed with the secret shifted by 8n bytes
+void accumulateScalar(uint64_t* acc, const uint8_t* data, const uint8_t* secret, std::size_t stripes) {
+    for (std::size_t n = 0; n < stripes; ++n, data += 64, secret += 8) {
+        for (std::size_t i = 0; i < 8; ++i) {
+            uint64_t value = read64(data + 8 * i);
+            uint64_t keyed = value ^ read64(secret + 8 * i);
+            acc[i ^ 1] += value;
+            acc[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+        }
+    }
+}
+
+void scrambleScalar(uint64_t* acc, const uint8_t* secret) {
+    for (std::size_t i = 0; i < 8; ++i) {
+        uint64_t lane = acc[i];
+        lane ^= lane >> 47;
+        lane ^= read64(secret + 8 * i);
+        acc[i] = lane * Prime32_1;
+    }
+}
+
+#endif
+
+struct Implementation {
+    AccumulateFunction accumulate;
+    ScrambleFunction scramble;
+    const char* name;
+};
+
+Implementation selectImplementation() {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2")) {
+        return {accumulateAvx2, scrambleAvx2, "avx2"};
+    }
+    return {accumulateSse2, scrambleSse2, "sse2"};
+#else
+    return {accumulateScalar, scrambleScalar, "scalar"};
+#endif
+}
+
+const Implementation& implementation() {
+    static const Implementation selected = selectImplementation();
+    return selected;
+}
+
+// Reads of the unmapped path; large enough that per-call overhead vanishes next to the transfer
+constexpr std::size_t ReadSize = 1 << 20;
+constexpr std::size_t ReadAlignment = 4096;
+
+struct AlignedDelete {
+    void operator()(uint8_t* p) const {
+        ::operator delete[](p, std::align_val_t{ReadAlignment});
+    }
+};
+
+}
+
+ContentHasher::ContentHasher()
+    : acc{Prime32_3, Prime64_1, Prime64_2, Prime64_3, Prime64_4, Prime32_2, Prime64_5, Prime32_1} {}
+
+void ContentHasher::consumeStripes(std::array<uint64_t, 8>& lanes, std::size_t& stripesInBlock, const uint8_t* data, std::size_t stripes) {
+    const Implementation& simd = implementation();
+    while (stripes > 0) {
+        std::size_t count = std::min(stripes, StripesPerBlock - stripesInBlock);
+        simd.accumulate(lanes.data(), data, Secret + 8 * stripesInBlock, count);
+        stripesInBlock += count;
+        if (stripesInBlock == StripesPerBlock) {
+            simd.scramble(lanes.data(), Secret + ScrambleSecret);
+            stripesInBlock = 0;
+        }
+        data += count * StripeLength;
+        stripes -= count;
+    }
+}
+
+void ContentHasher::update(std::span<const uint8_t> data) {
+    const uint8_t* input = data.data();
+    std::size_t length = data.size();
+    totalLength += length;
+    if (buffered + length <= BufferSize) {
+        // Nothing is consumed before more bytes follow it: the last stripe is always hashed in digest()
+        std::memcpy(buffer.data() + buffered, input, length);
+        buffered += length;
+        return;
+    }
+
+    if (buffered > 0) {
+        std::size_t fill = BufferSize - buffered;
+        std::memcpy(buffer.data() + buffered, input, fill);
+        input += fill;
+        length -= fill;
+        consumeStripes(acc, stripesInBlock, buffer.data(), BufferSize / StripeLength);
+        std::memcpy(lastStripe.data(), buffer.data() + BufferSize - StripeLength, StripeLength);
+        buffered = 0;
+    }
+    if (length > StripeLength) {
+        // Hash the bulk in place, keeping back at least one byte
+        std::size_t stripes = (length - 1) / StripeLength;
+        consumeStripes(acc, stripesInBlock, input, stripes);
+        input += stripes * StripeLength;
+        length -= stripes * StripeLength;
+        std::memcpy(lastStripe.data(), input - StripeLength, StripeLength);
+    }
+    std::memcpy(buffer.data(), input, length);
+    buffered = length;
+}
+
+uint64_t ContentHasher::digest() const {
+    if (totalLength <= 240) {
+        return hashShort(buffer.data(), buffered);
+    }
+
+    alignas(32) std::array<uint64_t, 8> lanes = acc;
+    std::size_t blockStripes = stripesInBlock;
+    consumeStripes(lanes, blockStripes, buffer.data(), (buffered - 1) / StripeLength);
+
+    // The final stripe ends at the last byte and may reach back into bytes consumed earlier
+    std::array<uint8_t, StripeLength> last;
+    if (buffered >= StripeLength) {
+        std::memcpy(last.data(), buffer.data() + buffered - StripeLength, StripeLength);
+    } else {
+        std::size_t earlier = StripeLength - buffered;
+        std::memcpy(last.data(), lastStripe.data() + StripeLength - earlier, earlier);
+        std::memcpy(last.data() + earlier, buffer.data(), buffered);
+    }
+    implementation().accumulate(lanes.data(), last.data(), Secret + LastStripeSecret, 1);
+
+    uint64_t result = totalLength * Prime64_1;
+    for (std::size_t i = 0; i < 4; ++i) {
+        result += mulFold64(lanes[2 * i] ^ read64(Secret + MergeSecret + 16 * i), lanes[2 * i + 1] ^ read64(Secret + MergeSecret + 16 * i + 8));
+    }
+    return avalanche(result);
+}
+
+uint64_t contentHash(std::span<const uint8_t> data) {
+    ContentHasher hasher;
+    hasher.update(data);
+    return hasher.digest();
+}
+
+std::optional<uint64_t> hashFileContents(const FileContext& context) {
+    if (!context.isOpen()) {
+        return std::nullopt;
+    }
+    if (context.isComplete()) {
+        context.adviseSequential();
+        return contentHash(context.bytes());
+    }
+
+    // One buffer per thread, kept for the next file
+    thread_local std::unique_ptr<uint8_t[], AlignedDelete> readBuffer(
+        static_cast<uint8_t*>(::operator new[](ReadSize, std::align_val_t{ReadAlignment})));
+    ::posix_fadvise(context.descriptor(), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    ContentHasher hasher;
+    for (uint64_t offset = 0; offset < context.size();) {
+        std::size_t wanted = static_cast<std::size_t>(std::min<uint64_t>(ReadSize, context.size() - offset));
+        std::size_t read = context.readAt(offset, readBuffer.get(), wanted);
+        if (read == 0) {
+            return std::nullopt;
+        }
+        hasher.update(std::span<const uint8_t>(readBuffer.get(), read));
+        offset += read;
+    }
+    return hasher.digest();
+}
+
+const char* contentHashImplementation() {
+    return implementation().name;
+}
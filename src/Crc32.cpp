@@ -0,0 +1,147 @@
+#include "Crc32.h"
+#include <cstring>
+#include <zlib.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#endif
+
+namespace {
+
+using CrcFunction = uint32_t (*)(uint32_t, const uint8_t*, std::size_t);
+
+uint32_t crc32Zlib(uint32_t crc, const uint8_t* data, std::size_t length) {
+    return static_cast<uint32_t>(::crc32_z(crc, data, length));
+}
+
+#if defined(__x86_64__)
+
+// Shorter runs are not worth the setup of the folding loop
+constexpr std::size_t FoldMinimum = 64;
+
+// x * k folded onto `next`: the low and high halves of x are multiplied by their own constant
+__attribute__((target("pclmul,sse4.1")))
+inline __m128i fold(__m128i x, __m128i k, __m128i next) {
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x11), _mm_clmulepi64_si128(x, k, 0x00)), next);
+}
+
+__attribute__((target("pclmul,sse4.1")))
+inline __m128i load(const uint8_t* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+/**
+ * Folds a multiple of 16 bytes (at least 64) into the CRC with PCLMULQDQ, following Intel's "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction": four 128-bit lanes are folded 64
+ * bytes at a time, merged into one, folded 16 bytes at a time and finally Barrett-reduced to 32 bits.
+ * Takes and returns the CRC register without zlib's pre- and post-inversion.
+ */
+__attribute__((target("pclmul,sse4.1")))
+uint32_t foldPclmul(uint32_t crc, const uint8_t* data, std::size_t length) {
+    alignas(16) static constexpr uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+    alignas(16) static constexpr uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+    alignas(16) static constexpr uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+    alignas(16) static constexpr uint64_t poly[] = {0x01db710641, 0x01f7011641};
+
+    __m128i x1 = _mm_xor_si128(load(data), _mm_cvtsi32_si128(static_cast<int>(crc)));
+    __m128i x2 = load(data + 16);
+    __m128i x3 = load(data + 32);
+    __m128i x4 = load(data + 48);
+    data += 64;
+    length -= 64;
+
+    __m128i k = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+    for (; length >= 64; data += 64, length -= 64) {
+        x1 = fold(x1, k, load(data));
+        x2 = fold(x2, k, load(data + 16));
+        x3 = fold(x3, k, load(data + 32));
+        x4 = fold(x4, k, load(data + 48));
+    }
+
+    k = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+    x1 = fold(x1, k, x2);
+    x1 = fold(x1, k, x3);
+    x1 = fold(x1, k, x4);
+    for (; length >= 16; data += 16, length -= 16) {
+        x1 = fold(x1, k, load(data));
+    }
+
+    // 128 bits down to 64
+    __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+    x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    k = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask), k, 0x00), x2);
+
+    // Barrett reduction to 32 bits
+    k = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k, 0x10);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask), k, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+uint32_t crc32Pclmul(uint32_t crc, const uint8_t* data, std::size_t length) {
+    if (length >= FoldMinimum) {
+        std::size_t folded = length & ~std::size_t{15};
+        crc = ~foldPclmul(~crc, data, folded);
+        data += folded;
+        length -= folded;
+    }
+    return length ? crc32Zlib(crc, data, length) : crc;
+}
+
+#elif defined(__aarch64__) && defined(HWCAP_CRC32)
+
+__attribute__((target("+crc")))
+uint32_t crc32Armv8(uint32_t crc, const uint8_t* data, std::size_t length) {
+    crc = ~crc;
+    for (; length >= 8; data += 8, length -= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc = __crc32d(crc, word);
+    }
+    for (; length > 0; ++data, --length) {
+        crc = __crc32b(crc, *data);
+    }
+    return ~crc;
+}
+
+#endif
+
+struct Implementation {
+    CrcFunction function;
+    const char* name;
+};
+
+Implementation selectImplementation() {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+        return {crc32Pclmul, "pclmul"};
+    }
+#elif defined(__aarch64__) && defined(HWCAP_CRC32)
+    if (::getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        return {crc32Armv8, "armv8-crc"};
+    }
+#endif
+    return {crc32Zlib, "zlib"};
+}
+
+const Implementation& implementation() {
+    static const Implementation selected = selectImplementation();
+    return selected;
+}
+
+}
+
+uint32_t updateCrc32(uint32_t crc, std::span<const uint8_t> data) {
+    return implementation().function(crc, data.data(), data.size());
+}
+
+const char* crc32Implementation() {
+    return implementation().name;
+}
@@ -0,0 +1,62 @@
+#include "DeviceScheduler.h"
+#include <cstdio>
+#include <sys/sysmacros.h>
+
+namespace {
+
+// Reads a 0/1 sysfs flag; nothing when the file is missing
+std::optional<bool> readFlag(const char* path) {
+    std::FILE* file = std::fopen(path, "re");
+    if (!file) {
+        return std::nullopt;
+    }
+    int value = 0;
+    bool parsed = std::fscanf(file, "%d", &value) == 1;
+    std::fclose(file);
+    return parsed ? std::optional<bool>(value != 0) : std::nullopt;
+}
+
+}
+
+bool isRotationalDevice(dev_t device) {
+    // Major 0 is the anonymous devices of tmpfs, overlayfs, NFS, btrfs subvolumes and the like
+    if (major(device) == 0) {
+        return false;
+    }
+    char path[96];
+    std::snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/queue/rotational", major(device), minor(device));
+    if (std::optional<bool> rotational = readFlag(path)) {
+        return *rotational;
+    }
+    // A partition has no queue of its own; its directory sits inside the whole disk's
+    std::snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/../queue/rotational", major(device), minor(device));
+    return readFlag(path).value_or(false);
+}
+
+AdaptiveLimit::AdaptiveLimit(std::size_t initial, std::size_t maximum)
+    : limit(static_cast<double>(std::clamp<std::size_t>(initial, 1, std::max<std::size_t>(maximum, 1)))),
+      maximum(static_cast<double>(std::max<std::size_t>(maximum, 1))) {}
+
+void AdaptiveLimit::record(uint64_t nanoseconds, std::size_t inFlight) {
+    double latency = static_cast<double>(std::max<uint64_t>(nanoseconds, 1));
+    // A lone outlier (the reaping thread was descheduled, say) moves the average by an eighth at most;
+    // congestion keeps every read slow and still doubles it within six reads
+    smoothed = smoothed == 0 ? latency : smoothed + (std::min(latency, 2 * smoothed) - smoothed) / 8;
+
+    baseline = baseline == 0 ? smoothed : std::min(baseline, smoothed);
+
+    ++sinceDecrease;
+    if (smoothed > std::max(Tolerance * baseline, CongestionFloor)) {
+        // Once per round trip, and not before the smoothed latency has caught up with the last cut
+        if (sinceDecrease >= std::max<std::size_t>(current(), SettleReads)) {
+            if (limit < 2) {
+                baseline = smoothed; // nothing queues behind a lone read, so this is the device's own pace
+            }
+            limit = std::max(1.0, limit * 2 / 3);
+            sinceDecrease = 0;
+            slowStart = false;
+        }
+    } else if (inFlight >= current()) {
+        limit = std::min(maximum, limit + (slowStart ? 1.0 : 1.0 / limit));
+    }
+}
@@ -0,0 +1,247 @@
+#include "DirectoryScanner.h"
+#include "ContentHash.h"
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <sys/stat.h>
+
+namespace {
+
+// Rewinds the worker's arena once a file's result has been handed on, counting the blocks it had to add
+class ArenaScope {
+public:
+    explicit ArenaScope(std::atomic<std::size_t>& blocks)
+        : arena(MetadataArena::forThisThread()), blocks(blocks), before(arena.upstreamAllocations()) {}
+
+    ~ArenaScope() {
+        blocks += arena.upstreamAllocations() - before;
+        arena.reset();
+    }
+
+private:
+    MetadataArena& arena;
+    std::atomic<std::size_t>& blocks;
+    std::size_t before;
+};
+
+// Whatever was parsed after the file shrank read zeros, so none of it may be reported or cached
+void throwIfTruncated(const FileContext& context) {
+    if (context.wasTruncated()) {
+        throw std::runtime_error("File was truncated while being read");
+    }
+}
+
+}
+
+DirectoryScanner::DirectoryScanner(ScanOptions options, ResultCallback onResult, ErrorCallback onError)
+    : options(options), onResult(std::move(onResult)), onError(std::move(onError)), pool(options.threadCount) {
+    if (options.ioBackend == IoBackend::Blocking) {
+        return;
+    }
+
+    IoEngine::NeedContents needContents;
+    if (servesFromCache()) {
+        // Cache hits are answered from the statx result without opening the file
+        needContents = [this](const std::filesystem::path&, const struct stat& fileStat) {
+            std::optional<CachedRecord> cached = this->options.cache->lookup(CacheKey::fromStat(fileStat));
+            return !cached || !isCompleteResult(*cached);
+        };
+    }
+    io = makeIoEngine(options.ioBackend, IoEngineOptions{},
+                      [this](PrefetchedFile&& file) {
+                          pool.submit([this, file = std::move(file)]() mutable { analyzePrefetched(file); });
+                      },
+                      std::move(needContents));
+}
+
+ScanStats DirectoryScanner::scan(const std::filesystem::path& root) {
+    return scan(std::vector<std::filesystem::path>{root});
+}
+
+ScanStats DirectoryScanner::scan(const std::vector<std::filesystem::path>& roots) {
+    filesAnalyzed = 0;
+    errors = 0;
+    cacheHits = 0;
+    arenaBlocks = 0;
+    archiveMembers = 0;
+
+    std::vector<std::filesystem::path> files;
+    for (const auto& root : roots) {
+        std::error_code ec;
+        if (std::filesystem::is_directory(root, ec)) {
+            pool.submit([this, root] { scanDirectory(root); });
+        } else if (std::filesystem::is_regular_file(root, ec) && io) {
+            files.push_back(root);
+        } else if (std::filesystem::is_regular_file(root, ec)) {
+            pool.submit([this, root] { analyzeFile(root); });
+        } else {
+            ++errors;
+            onError(root, ec ? ec.message() : "Not a regular file or directory");
+        }
+    }
+    if (!files.empty()) {
+        io->submit(std::move(files));
+    }
+    // Completions become pool tasks and listing tasks submit more I/O, so wait until both are idle together
+    do {
+        pool.wait();
+    } while (io && io->wait());
+
+    return ScanStats{filesAnalyzed.load(), errors.load(), cacheHits.load(), arenaBlocks.load(), archiveMembers.load()};
+}
+
+void DirectoryScanner::scanDirectory(const std::filesystem::path& directory) {
+    std::error_code ec;
+    std::filesystem::directory_iterator it(directory, std::filesystem::directory_options::skip_permission_denied, ec);
+    if (ec) {
+        ++errors;
+        onError(directory, ec.message());
+        return;
+    }
+
+    std::vector<std::filesystem::path> batch;
+    for (; it != std::filesystem::directory_iterator(); it.increment(ec)) {
+        const std::filesystem::directory_entry& entry = *it;
+        std::error_code statusEc;
+        bool isSymlink = entry.is_symlink(statusEc);
+
+        if (entry.is_directory(statusEc) && (!isSymlink || options.followSymlinks)) {
+            pool.submit([this, path = entry.path()] { scanDirectory(path); });
+        } else if (entry.is_regular_file(statusEc) && (!isSymlink || options.followSymlinks)) {
+            if (!io) {
+                pool.submit([this, path = entry.path()] { analyzeFile(path); });
+                continue;
+            }
+            batch.push_back(entry.path());
+            if (batch.size() == IoBatchSize) {
+                io->submit(std::move(batch));
+                batch.clear();
+            }
+        }
+    }
+    if (!batch.empty()) {
+        io->submit(std::move(batch));
+    }
+    if (ec) {
+        ++errors;
+        onError(directory, ec.message());
+    }
+}
+
+bool DirectoryScanner::analyzeFromCache(const std::filesystem::path& filePath) {
+    struct stat fileStat;
+    return ::stat(filePath.c_str(), &fileStat) == 0 && analyzeFromCache(filePath, fileStat);
+}
+
+bool DirectoryScanner::analyzeFromCache(const std::filesystem::path& filePath, const struct stat& fileStat) {
+    std::optional<CachedRecord> cached = options.cache->lookup(CacheKey::fromStat(fileStat));
+    if (!cached || !isCompleteResult(*cached)) {
+        return false;
+    }
+
+    MetadataArena& arena = MetadataArena::forThisThread();
+    MetadataMap metadata(&arena);
+    if (options.includeBasic) {
+        metadata = analyzeBasicMetadata(filePath, fileStat, &arena);
+    }
+    if (options.includeSpecialized) {
+        cached->forEach([&metadata, &arena](std::string_view key, const MetadataValue& value) {
+            metadata[MetadataKey(key)] = value.owned(&arena);
+        });
+    }
+    onResult(filePath, cached->fileType(), metadata);
+    if (options.duplicates) {
+        options.duplicates->add(filePath, fileStat);
+    }
+    ++cacheHits;
+    return true;
+}
+
+void DirectoryScanner::analyzeFile(const std::filesystem::path& filePath) {
+    ArenaScope scope(arenaBlocks);
+    try {
+        if (servesFromCache() && analyzeFromCache(filePath)) {
+            ++filesAnalyzed;
+            return;
+        }
+        analyzeContext(FileContext(filePath));
+    } catch (const std::exception& e) {
+        ++errors;
+        onError(filePath, e.what());
+    }
+}
+
+void DirectoryScanner::analyzePrefetched(PrefetchedFile& file) {
+    ArenaScope scope(arenaBlocks);
+    bool holdsDescriptor = file.fd >= 0;
+    try {
+        if (file.error != 0) {
+            throw std::system_error(file.error, std::generic_category());
+        }
+        if (file.fd < 0 && servesFromCache() && analyzeFromCache(file.path, file.status)) {
+            ++filesAnalyzed;
+            return;
+        }
+        analyzeContext(FileContext(file.path, std::exchange(file.fd, -1), file.status, std::move(file.prefix)));
+    } catch (const std::exception& e) {
+        ++errors;
+        onError(file.path, e.what());
+    }
+    // The context has closed the descriptor by now, so the engine may open another file
+    if (holdsDescriptor) {
+        io->releaseDescriptor();
+    }
+}
+
+void DirectoryScanner::analyzeContext(const FileContext& context) {
+    // Recorded before parsing, so files the extractors reject still take part in duplicate detection
+    std::optional<uint64_t> hash;
+    if (options.hashContents) {
+        hash = hashFileContents(context);
+        throwIfTruncated(context);
+    }
+    if (options.duplicates && context.isOpen()) {
+        options.duplicates->add(context.path(), context.status(), hash);
+    }
+
+    FileType fileType = determineFileType<poppler::document, std::ifstream, JPEGHeader, PNGHeader, BMPHeader, ZIPHeader, WAVHeader, GIFHeader>(context);
+
+    MetadataArena& arena = MetadataArena::forThisThread();
+    MetadataMap metadata(&arena);
+    if (options.cache && options.includeSpecialized && context.isOpen()) {
+        // Keep the specialized part separate so it can be cached; basic metadata is never cached
+        MetadataMap specialized = analyzeFileMetadata(context, fileType, false, true, &arena);
+        throwIfTruncated(context);
+        options.cache->insert(CacheKey::fromStat(context.status()), fileType, specialized);
+        if (options.includeBasic) {
+            metadata = analyzeFileMetadata(context, fileType, true, false, &arena);
+        }
+        metadata.reserve(metadata.size() + specialized.size());
+        for (auto& [key, value] : specialized) {
+            metadata[key] = std::move(value);
+        }
+    } else {
+        metadata = analyzeFileMetadata(context, fileType, options.includeBasic, options.includeSpecialized, &arena);
+    }
+    if (options.verifyIntegrity) {
+        for (auto& [key, value] : verifyFileIntegrity(context, fileType, &arena)) {
+            metadata[key] = std::move(value);
+        }
+    }
+    if (hash) {
+        metadata["ContentHash"_key] = MetadataValue::hex(*hash, 16);
+    }
+    throwIfTruncated(context);
+    onResult(context.path(), fileType, metadata);
+    ++filesAnalyzed;
+
+    if (options.archiveDepth > 0 && fileType == FileType::ZIP && context.isComplete()) {
+        ArchiveOptions archiveOptions{options.archiveDepth, options.archiveBudget, options.archiveMemberBudget,
+                                      options.includeBasic, options.includeSpecialized, options.hashContents};
+        ArchiveStats stats = walkArchiveMembers(context, archiveOptions, onResult, onError);
+        archiveMembers += stats.members;
+        errors += stats.errors;
+        throwIfTruncated(context);
+    }
+}
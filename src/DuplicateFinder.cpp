@@ -0,0 +1,132 @@
+#include "DuplicateFinder.h"
+#include "ContentHash.h"
+#include "FileContext.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <tuple>
+#include <utility>
+
+void DuplicateFinder::add(const std::filesystem::path& filePath, const struct stat& fileStat, std::optional<uint64_t> hash) {
+    if (!S_ISREG(fileStat.st_mode) || fileStat.st_size <= 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(candidatesMutex);
+    candidates.push_back(Candidate{filePath, static_cast<uint64_t>(fileStat.st_size), fileStat.st_dev, fileStat.st_ino, hash});
+}
+
+std::vector<DuplicateGroup> DuplicateFinder::findDuplicates(std::size_t threadCount, const ErrorCallback& onError) {
+    std::lock_guard<std::mutex> lock(candidatesMutex);
+    lastStats = DuplicateStats{};
+    lastStats.filesSeen = candidates.size();
+
+    // Equal sizes end up adjacent, and within a size the links to one inode
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return std::tie(a.size, a.device, a.inode, a.path) < std::tie(b.size, b.device, b.inode, b.path);
+    });
+    auto sameInode = [](const Candidate& a, const Candidate& b) {
+        return a.device == b.device && a.inode == b.inode;
+    };
+
+    // [begin, end) of each size bucket holding at least two distinct inodes, and the first link of every inode in them
+    std::vector<std::pair<std::size_t, std::size_t>> buckets;
+    std::vector<std::size_t> inodes;
+    for (std::size_t begin = 0, end = 0; begin < candidates.size(); begin = end) {
+        std::size_t firstInodes = inodes.size();
+        for (end = begin; end < candidates.size() && candidates[end].size == candidates[begin].size; ++end) {
+            if (end == begin || !sameInode(candidates[end], candidates[end - 1])) {
+                inodes.push_back(end);
+            }
+        }
+        if (inodes.size() - firstInodes < 2) {
+            inodes.resize(firstInodes);
+            continue;
+        }
+        buckets.emplace_back(begin, end);
+    }
+
+    // Hash each inode once, unless the scan already did it for one of its links
+    std::vector<std::size_t> toHash;
+    for (std::size_t first : inodes) {
+        std::size_t link = first;
+        while (link < candidates.size() && sameInode(candidates[link], candidates[first]) && !candidates[link].hash) {
+            ++link;
+        }
+        if (link < candidates.size() && sameInode(candidates[link], candidates[first])) {
+            candidates[first].hash = candidates[link].hash;
+            ++lastStats.hashesReused;
+        } else {
+            toHash.push_back(first);
+        }
+    }
+
+    std::vector<std::string> failures(candidates.size());
+    std::atomic<uint64_t> bytesHashed{0};
+    {
+        ThreadPool pool(threadCount);
+        for (std::size_t index : toHash) {
+            pool.submit([this, index, &failures, &bytesHashed] {
+                Candidate& candidate = candidates[index];
+                FileContext context(candidate.path);
+                if (!context.isOpen()) {
+                    failures[index] = "Cannot be opened for hashing";
+                } else if (context.size() != candidate.size) {
+                    failures[index] = "Changed size since the scan";
+                } else if (!(candidate.hash = hashFileContents(context))) {
+                    failures[index] = "Could not be read in full";
+                } else {
+                    bytesHashed += candidate.size;
+                }
+            });
+        }
+        pool.wait();
+    }
+    lastStats.filesHashed = toHash.size();
+    lastStats.bytesHashed = bytesHashed.load();
+    for (std::size_t index : toHash) {
+        if (!failures[index].empty()) {
+            onError(candidates[index].path, failures[index]);
+        }
+    }
+
+    std::vector<DuplicateGroup> groups;
+    for (auto [begin, end] : buckets) {
+        // Every link takes the hash of its inode's first link; links that failed to hash drop out
+        for (std::size_t i = begin + 1; i < end; ++i) {
+            if (sameInode(candidates[i], candidates[i - 1])) {
+                candidates[i].hash = candidates[i - 1].hash;
+            }
+        }
+        std::vector<const Candidate*> bucket;
+        for (std::size_t i = begin; i < end; ++i) {
+            if (candidates[i].hash) {
+                bucket.push_back(&candidates[i]);
+            }
+        }
+        std::sort(bucket.begin(), bucket.end(), [](const Candidate* a, const Candidate* b) {
+            return std::tie(*a->hash, a->device, a->inode, a->path) < std::tie(*b->hash, b->device, b->inode, b->path);
+        });
+
+        for (std::size_t first = 0, last = 0; first < bucket.size(); first = last) {
+            std::size_t distinct = 0;
+            for (last = first; last < bucket.size() && *bucket[last]->hash == *bucket[first]->hash; ++last) {
+                distinct += last == first || !sameInode(*bucket[last], *bucket[last - 1]);
+            }
+            if (distinct < 2) {
+                continue;
+            }
+            DuplicateGroup group{bucket[first]->size, *bucket[first]->hash, {}, bucket[first]->size * (distinct - 1)};
+            for (std::size_t i = first; i < last; ++i) {
+                group.paths.push_back(bucket[i]->path);
+            }
+            std::sort(group.paths.begin(), group.paths.end());
+            groups.push_back(std::move(group));
+        }
+    }
+    std::sort(groups.begin(), groups.end(), [](const DuplicateGroup& a, const DuplicateGroup& b) {
+        return a.reclaimableBytes != b.reclaimableBytes ? a.reclaimableBytes > b.reclaimableBytes : a.paths.front() < b.paths.front();
+    });
+
+    candidates.clear();
+    return groups;
+}
@@ -0,0 +1,92 @@
+#include "ExifReader.h"
+#include <stdexcept>
+
+namespace {
+
+enum FieldType : uint16_t {
+    Byte = 1, Ascii = 2, Short = 3, Long = 4, Rational = 5, SignedByte = 6, Undefined = 7,
+    SignedShort = 8, SignedLong = 9, SignedRational = 10, Float = 11, Double = 12,
+};
+
+//Size in bytes of one value of a field type, 0 for unknown types.
+uint32_t fieldSize(uint16_t type) {
+    switch (type) {
+        case Byte: case Ascii: case SignedByte: case Undefined: return 1;
+        case Short: case SignedShort:                          return 2;
+        case Long: case SignedLong: case Float:                return 4;
+        case Rational: case SignedRational: case Double:       return 8;
+        default:                                               return 0;
+    }
+}
+
+}
+
+ExifReader::ExifReader(std::span<const uint8_t> tiff) : reader(tiff) {
+    if (!reader.has(0, 8) || !(reader.matches(0, "II") || reader.matches(0, "MM"))) {
+        throw std::runtime_error("EXIF: bad TIFF byte order mark");
+    }
+    bigEndian = reader.matches(0, "MM");
+    if (u16(2) != 42) {
+        throw std::runtime_error("EXIF: bad TIFF magic number");
+    }
+    first = u32(4);
+}
+
+bool ExifReader::readEntry(uint32_t offset, ExifEntry& entry) const {
+    if (!reader.has(offset, 12)) {
+        return false;
+    }
+    entry.tag = u16(offset);
+    entry.type = u16(offset + 2);
+    entry.count = u32(offset + 4);
+
+    // Values of up to four bytes are stored in the entry itself, larger ones at an offset
+    uint64_t size = static_cast<uint64_t>(fieldSize(entry.type)) * entry.count;
+    uint64_t at = size <= 4 ? offset + 8 : u32(offset + 8);
+    entry.value = size > 0 && reader.has(at, size) ? reader.bytes(at, size) : std::span<const uint8_t>();
+    return true;
+}
+
+std::optional<uint32_t> ExifReader::integer(const ExifEntry& entry, uint32_t index) const {
+    uint32_t size = fieldSize(entry.type);
+    if (index >= entry.count || entry.value.empty()) {
+        return std::nullopt;
+    }
+    ByteReader value(entry.value);
+    std::size_t at = static_cast<std::size_t>(index) * size;
+    switch (entry.type) {
+        case Byte:  return value.u8(at);
+        case Short: return bigEndian ? value.u16be(at) : value.u16le(at);
+        case Long:  return bigEndian ? value.u32be(at) : value.u32le(at);
+        default:    return std::nullopt;
+    }
+}
+
+std::optional<double> ExifReader::rational(const ExifEntry& entry, uint32_t index) const {
+    if ((entry.type != Rational && entry.type != SignedRational) || index >= entry.count || entry.value.empty()) {
+        return std::nullopt;
+    }
+    ByteReader value(entry.value);
+    std::size_t at = static_cast<std::size_t>(index) * 8;
+    uint32_t numerator = bigEndian ? value.u32be(at) : value.u32le(at);
+    uint32_t denominator = bigEndian ? value.u32be(at + 4) : value.u32le(at + 4);
+    if (denominator == 0) {
+        return std::nullopt;
+    }
+    if (entry.type == SignedRational) {
+        return static_cast<double>(static_cast<int32_t>(numerator)) / static_cast<int32_t>(denominator);
+    }
+    return static_cast<double>(numerator) / denominator;
+}
+
+std::string_view ExifReader::text(const ExifEntry& entry) const {
+    if (entry.type != Ascii) {
+        return {};
+    }
+    std::string_view value(reinterpret_cast<const char*>(entry.value.data()), entry.value.size());
+    value = value.substr(0, value.find('\0'));
+    while (!value.empty() && value.back() == ' ') {
+        value.remove_suffix(1);
+    }
+    return value;
+}
@@ -0,0 +1,201 @@
+#include "FileContext.h"
+#include "StageStats.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+//A live mapping the SIGBUS handler may patch. `start` is published last and cleared first.
+struct GuardedMapping {
+    std::atomic<bool> busy{false};
+    std::atomic<std::uintptr_t> start{0};
+    std::atomic<std::uintptr_t> end{0};
+    std::atomic<std::atomic<bool>*> truncated{nullptr};
+};
+
+//More than the number of files the scanner ever keeps open at once; files beyond it are read, not mapped
+constexpr std::size_t MaxGuardedMappings = 16384;
+
+GuardedMapping guardedMappings[MaxGuardedMappings];
+std::atomic<std::size_t> nextGuardedSlot{0};
+std::uintptr_t pageSize = 0;
+struct sigaction previousBusAction {};
+std::once_flag busHandlerInstalled;
+
+void onBusError(int, siginfo_t* info, void*) {
+    auto address = reinterpret_cast<std::uintptr_t>(info->si_addr);
+    for (GuardedMapping& slot : guardedMappings) {
+        std::uintptr_t start = slot.start.load(std::memory_order_acquire);
+        std::uintptr_t end = slot.end.load(std::memory_order_relaxed);
+        if (start == 0 || address < start || address >= end) {
+            continue;
+        }
+        // Back the rest of the mapping with zeros so the faulting access completes; the owner sees the flag
+        std::uintptr_t page = address & ~(pageSize - 1);
+        void* zeros = ::mmap(reinterpret_cast<void*>(page), end - page, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+        if (zeros != MAP_FAILED) {
+            slot.truncated.load(std::memory_order_relaxed)->store(true, std::memory_order_relaxed);
+            return;
+        }
+        break;
+    }
+    // Not ours: restore whatever handled SIGBUS before, and the retried access faults into it
+    ::sigaction(SIGBUS, &previousBusAction, nullptr);
+}
+
+void installBusHandler() {
+    pageSize = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+    struct sigaction action {};
+    action.sa_sigaction = onBusError;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGBUS, &action, &previousBusAction);
+}
+
+//Claims a free slot for [address, address + length), or returns MaxGuardedMappings when the table is full
+std::size_t guardMapping(const void* address, std::size_t length, std::atomic<bool>* truncated) {
+    std::call_once(busHandlerInstalled, installBusHandler);
+    std::size_t first = nextGuardedSlot.fetch_add(1, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < MaxGuardedMappings; ++i) {
+        std::size_t index = (first + i) % MaxGuardedMappings;
+        GuardedMapping& slot = guardedMappings[index];
+        bool expected = false;
+        if (!slot.busy.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            continue;
+        }
+        auto start = reinterpret_cast<std::uintptr_t>(address);
+        slot.end.store(start + length, std::memory_order_relaxed);
+        slot.truncated.store(truncated, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_release);
+        return index;
+    }
+    return MaxGuardedMappings;
+}
+
+void unguardMapping(std::size_t index) {
+    guardedMappings[index].start.store(0, std::memory_order_release);
+    guardedMappings[index].busy.store(false, std::memory_order_release);
+}
+
+} // namespace
+
+FileContext::FileContext(const std::filesystem::path& filePath, std::size_t prefixSize)
+    : filePath(filePath), prefixLength(prefixSize) {
+    FILEMETA_STAGE_TIMER(timer, Stage::Open);
+    FILEMETA_COUNT_IO(1);
+    fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    FILEMETA_COUNT_IO(1);
+    if (::fstat(fd, &fileStat) != 0) {
+        ::close(fd);
+        fd = -1;
+        return;
+    }
+
+    if (S_ISREG(fileStat.st_mode) && fileStat.st_size > 0 && map()) {
+        return;
+    }
+
+    // Not mappable (empty, special file, or mmap refused): read the prefix instead
+    std::size_t wanted = S_ISREG(fileStat.st_mode) ? std::min<std::uint64_t>(prefixSize, size()) : prefixSize;
+    prefixBuffer.resize(wanted);
+    std::size_t filled = 0;
+    while (filled < wanted) {
+        ssize_t n = ::pread(fd, prefixBuffer.data() + filled, wanted - filled, static_cast<off_t>(filled));
+        FILEMETA_COUNT_IO(1, n > 0 ? static_cast<uint64_t>(n) : 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        filled += static_cast<std::size_t>(n);
+    }
+    prefixBuffer.resize(filled);
+}
+
+FileContext::FileContext(const std::filesystem::path& filePath, int descriptor, const struct stat& fileStat,
+                         std::vector<std::uint8_t> prefix, std::size_t prefixSize)
+    : filePath(filePath), fd(descriptor), fileStat(fileStat), prefixLength(prefixSize), prefixBuffer(std::move(prefix)) {
+    FILEMETA_STAGE_TIMER(timer, Stage::Open);
+    if (fd >= 0 && S_ISREG(fileStat.st_mode) && size() > prefixBuffer.size() && map()) {
+        // Extractors read through `bytes()`, one span over the whole file, so the copy is not kept
+        // alongside the mapping: for these files the read's job was to bring the leading pages into the
+        // page cache on the engine's queue, which makes faulting them in here cheap
+        prefixBuffer = {};
+    }
+}
+
+FileContext::FileContext(const std::filesystem::path& filePath, const struct stat& fileStat, std::span<const std::uint8_t> contents,
+                         std::size_t prefixSize)
+    : filePath(filePath), fileStat(fileStat), prefixLength(prefixSize), contents(contents), inMemory(true) {}
+
+FileContext::~FileContext() {
+    FILEMETA_COUNT_IO((mapping != nullptr) + (fd >= 0));
+    if (mapping) {
+        unguardMapping(guardSlot);
+        ::munmap(const_cast<std::uint8_t*>(mapping), static_cast<std::size_t>(size()));
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+bool FileContext::map() {
+    FILEMETA_COUNT_IO(1);
+    void* address = ::mmap(nullptr, static_cast<std::size_t>(size()), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    guardSlot = guardMapping(address, static_cast<std::size_t>(size()), &truncated);
+    if (guardSlot == MaxGuardedMappings) {
+        // An unguarded mapping could take the process down, so read the prefix instead
+        FILEMETA_COUNT_IO(1);
+        ::munmap(address, static_cast<std::size_t>(size()));
+        return false;
+    }
+    mapping = static_cast<const std::uint8_t*>(address);
+    return true;
+}
+
+void FileContext::adviseSequential() const {
+    if (mapping) {
+        FILEMETA_COUNT_IO(1);
+        ::madvise(const_cast<std::uint8_t*>(mapping), static_cast<std::size_t>(size()), MADV_SEQUENTIAL);
+    }
+}
+
+std::size_t FileContext::readAt(std::uint64_t offset, void* buffer, std::size_t length) const {
+    auto* out = static_cast<std::uint8_t*>(buffer);
+    std::span<const std::uint8_t> available = bytes();
+    std::size_t copied = 0;
+
+    if (offset < available.size()) {
+        copied = std::min<std::size_t>(length, available.size() - offset);
+        std::memcpy(out, available.data() + offset, copied);
+    }
+    if (copied == length || mapping || fd < 0) {
+        return copied;
+    }
+
+    while (copied < length) {
+        ssize_t n = ::pread(fd, out + copied, length - copied, static_cast<off_t>(offset + copied));
+        FILEMETA_COUNT_IO(1, n > 0 ? static_cast<uint64_t>(n) : 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        copied += static_cast<std::size_t>(n);
+    }
+    return copied;
+}
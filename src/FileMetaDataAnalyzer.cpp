@@ -1,4 +1,13 @@
 #include "FileMetaDataAnalyzer.h"
+#include "ExifReader.h"
+#include "GifReader.h"
+#include "JpegReader.h"
+#include "PdfInfoReader.h"
+#include "PngReader.h"
+#include "RiffReader.h"
+#include "StageStats.h"
+#include "TextReader.h"
+#include "ZipReader.h"
 #include <poppler/cpp/poppler-document.h>
 #include <poppler/cpp/poppler-page.h>
 #include <type_traits>
@@ -6,66 +15,362 @@
 #include <sstream>
 #include <iostream>
 #include <cstring>
-#include <zip.h>
+#include <cstdio>
 #include <type_traits>
 #include <sys/stat.h>
 #include <string>
 #include <ctime>
 #include <cassert>
+#include <climits>
+#include <span>
+#include <string_view>
+#include <algorithm>
+#include <optional>
+#include <charconv>
+#include <chrono>
+
+static Timestamp toTimestamp(const struct timespec& time) {
+    return Timestamp{static_cast<int64_t>(time.tv_sec), static_cast<uint32_t>(time.tv_nsec)};
+}
+
+// The final path component, without building intermediate path objects
+static std::string_view fileNameOf(const std::filesystem::path& filePath) {
+    std::string_view native = filePath.native();
+    std::size_t slash = native.find_last_of('/');
+    return slash == std::string_view::npos ? native : native.substr(slash + 1);
+}
+
+// The extension of a file name, as std::filesystem::path::extension() defines it
+static std::string_view extensionOf(std::string_view fileName) {
+    std::size_t dot = fileName.find_last_of('.');
+    if (dot == std::string_view::npos || dot == 0 || fileName == "..") {
+        return {};
+    }
+    return fileName.substr(dot);
+}
+
+BasicMetadata extractBasicMetadata(const std::filesystem::path& filePath, const struct stat& fileStat, bool haveStat,
+                                   std::pmr::memory_resource* memory) {
+    std::string_view fileName = fileNameOf(filePath);
+    // Size and times are only known when the file could be stat'ed
+    return BasicMetadata{
+        .fileName = std::pmr::string(fileName, memory),
+        .fileType = std::pmr::string(extensionOf(fileName), memory),
+        .hasStatus = haveStat,
+        .fileSize = haveStat ? static_cast<uint64_t>(fileStat.st_size) : 0,
+        .creationTime = haveStat ? toTimestamp(fileStat.st_ctim) : Timestamp{},
+        .lastModified = haveStat ? toTimestamp(fileStat.st_mtim) : Timestamp{},
+        .lastAccess = haveStat ? toTimestamp(fileStat.st_atim) : Timestamp{},
+    };
+}
+
+// Basic metadata comes from the context's single fstat
+BasicMetadata extractBasicMetadata(const FileContext& context, std::pmr::memory_resource* memory) {
+    return extractBasicMetadata(context.path(), context.status(), context.isOpen(), memory);
+}
+
+MetadataMap basicMetadataToMap(BasicMetadata&& basicMetadata, std::pmr::memory_resource* memory) {
+    MetadataMap metadata(memory);
+    metadata.reserve(6);
+    metadata["FileName"_key] = std::move(basicMetadata.fileName);
+    if (basicMetadata.hasStatus) {
+        metadata["FileSize"_key] = MetadataValue::byteCount(basicMetadata.fileSize);
+    }
+    metadata["FileType"_key] = std::move(basicMetadata.fileType);
+    if (basicMetadata.hasStatus) {
+        metadata["CreationTime"_key] = basicMetadata.creationTime;
+        metadata["LastModified"_key] = basicMetadata.lastModified;
+        metadata["LastAccess"_key] = basicMetadata.lastAccess;
+    }
+    return metadata;
+}
 
-BasicMetadata extractBasicMetadata(const std::filesystem::path& filePath) {
-    BasicMetadata basicMetadata;
+MetadataMap analyzeBasicMetadata(const std::filesystem::path& filePath, const struct stat& fileStat, std::pmr::memory_resource* memory) {
+    FILEMETA_STAGE_TIMER(timer, Stage::BasicMetadata);
+    return basicMetadataToMap(extractBasicMetadata(filePath, fileStat, true, memory), memory);
+}
+
+// Per-entry fields are reported for this many ZIP entries; totals always cover the whole archive
+static constexpr uint64_t MaxListedZipEntries = 100;
 
-    // File name
-    std::string fileName = filePath.filename().string();
-    basicMetadata.fileName = fileName;
+// GIF comments are concatenated up to this many bytes
+static constexpr std::size_t MaxGifCommentLength = 64 * 1024;
+
+// Adds a PDF date as a Timestamp, leaving the field out when the document has none (or it did not parse)
+static void addPdfDate(MetadataMap& metadata, const MetadataKey& key, std::optional<Timestamp> time) {
+    if (time) {
+        metadata[key] = *time;
+    }
+}
 
-    // File size
-    struct stat fileStat;
-    if (stat(filePath.c_str(), &fileStat) == 0) {
-        basicMetadata.fileSize = std::to_string(fileStat.st_size) + " bytes";
+// poppler applies the date's offset itself and reports seconds since the epoch, or -1
+static std::optional<Timestamp> popplerTimestamp(poppler::time_type time) {
+    if (time == static_cast<poppler::time_type>(-1)) {
+        return std::nullopt;
     }
+    return Timestamp{static_cast<int64_t>(time), 0};
+}
 
-    // File type/format
-    std::string fileType = filePath.extension().string();
-    basicMetadata.fileType = fileType;
+// poppler's UTF-16 strings, converted to UTF-8 text in `memory`
+static MetadataValue popplerText(const poppler::ustring& text, std::pmr::memory_resource* memory) {
+    poppler::byte_array utf8 = text.to_utf8();
+    return MetadataValue(std::string_view(utf8.data(), utf8.size()), memory);
+}
 
-    // Creation time
-    std::string creationTime = std::ctime(&fileStat.st_ctime);
-    basicMetadata.creationTime = creationTime;
+// Parses an EXIF "YYYY:MM:DD HH:MM:SS" time; `offset` ("+HH:MM", from the OffsetTime tags) defaults to UTC
+static std::optional<Timestamp> parseExifDateTime(std::string_view text, std::string_view offset) {
+    auto number = [&text](std::size_t at, std::size_t length) {
+        int value = -1;
+        auto [end, error] = std::from_chars(text.data() + at, text.data() + at + length, value);
+        return error == std::errc() && end == text.data() + at + length ? value : -1;
+    };
+    if (text.size() < 19 || text[4] != ':' || text[7] != ':' || text[10] != ' ' || text[13] != ':' || text[16] != ':') {
+        return std::nullopt;
+    }
+    std::chrono::year_month_day date{std::chrono::year(number(0, 4)), std::chrono::month(static_cast<unsigned>(number(5, 2))),
+                                     std::chrono::day(static_cast<unsigned>(number(8, 2)))};
+    int hour = number(11, 2);
+    int minute = number(14, 2);
+    int second = number(17, 2);
+    if (!date.ok() || hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60) {
+        return std::nullopt;
+    }
+    int64_t seconds = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::sys_days(date).time_since_epoch()).count() +
+                      hour * 3600 + minute * 60 + second;
+    if (offset.size() >= 6 && (offset[0] == '+' || offset[0] == '-') && offset[3] == ':') {
+        text = offset;
+        int offsetHours = number(1, 2);
+        int offsetMinutes = number(4, 2);
+        if (offsetHours >= 0 && offsetMinutes >= 0) {
+            seconds -= (offset[0] == '-' ? -1 : 1) * (offsetHours * 3600 + offsetMinutes * 60);
+        }
+    }
+    return Timestamp{seconds, 0};
+}
+
+// Degrees, minutes and seconds as three rationals, signed by the reference ("S" and "W" are negative)
+static std::optional<double> gpsCoordinate(const ExifReader& exif, const ExifEntry& entry, std::string_view reference) {
+    std::optional<double> degrees = exif.rational(entry, 0);
+    std::optional<double> minutes = exif.rational(entry, 1);
+    std::optional<double> seconds = exif.rational(entry, 2);
+    if (!degrees || !minutes || !seconds) {
+        return std::nullopt;
+    }
+    double value = *degrees + *minutes / 60 + *seconds / 3600;
+    return reference == "S" || reference == "W" ? -value : value;
+}
 
-    // Last modified time
-    std::string lastModified = std::ctime(&fileStat.st_mtime);
-    basicMetadata.lastModified = lastModified;
+/**
+ * @brief Adds the camera, time and location fields of an EXIF block to `metadata`.
+ *
+ * IFD0 holds the camera and orientation; it points to the Exif IFD (exposure and original time) and the
+ * GPS IFD. The thumbnail's IFD1 and maker notes are not followed.
+ *
+ * @param tiff The APP1 payload after "Exif\0\0".
+ * @throws std::runtime_error If the TIFF header is malformed.
+ */
+static void extractExifMetadata(std::span<const uint8_t> tiff, MetadataMap& metadata, std::pmr::memory_resource* memory) {
+    ExifReader exif(tiff);
+    uint32_t exifDirectory = 0;
+    uint32_t gpsDirectory = 0;
+    std::string_view dateTime;
+    exif.forEachEntry(exif.firstDirectory(), [&](const ExifEntry& entry) {
+        switch (entry.tag) {
+            case ExifReader::Make:
+            case ExifReader::Model:
+            case ExifReader::Software:
+                if (std::string_view text = exif.text(entry); !text.empty()) {
+                    MetadataKey key = entry.tag == ExifReader::Make ? "Make"_key : entry.tag == ExifReader::Model ? "Model"_key : "Software"_key;
+                    metadata[key] = MetadataValue(text, memory);
+                }
+                break;
+            case ExifReader::Orientation:
+                if (std::optional<uint32_t> orientation = exif.integer(entry)) {
+                    metadata["Orientation"_key] = *orientation;
+                }
+                break;
+            case ExifReader::DateTime:
+                dateTime = exif.text(entry);
+                break;
+            case ExifReader::ExifIfd:
+                exifDirectory = exif.integer(entry).value_or(0);
+                break;
+            case ExifReader::GpsIfd:
+                gpsDirectory = exif.integer(entry).value_or(0);
+                break;
+        }
+        return true;
+    });
+    if (std::optional<Timestamp> time = parseExifDateTime(dateTime, {})) {
+        metadata["DateTime"_key] = *time;
+    }
 
-    // Last access time
-    std::string lastAccess = std::ctime(&fileStat.st_atime);
-    basicMetadata.lastAccess = lastAccess;
+    if (exifDirectory != 0) {
+        std::string_view original;
+        std::string_view originalOffset;
+        exif.forEachEntry(exifDirectory, [&](const ExifEntry& entry) {
+            switch (entry.tag) {
+                case ExifReader::DateTimeOriginal:
+                    original = exif.text(entry);
+                    break;
+                case ExifReader::OffsetTimeOriginal:
+                    originalOffset = exif.text(entry);
+                    break;
+                case ExifReader::ExposureTime:
+                    if (std::optional<double> seconds = exif.rational(entry)) {
+                        metadata["ExposureTime"_key] = *seconds;
+                    }
+                    break;
+                case ExifReader::FNumber:
+                    if (std::optional<double> aperture = exif.rational(entry)) {
+                        metadata["FNumber"_key] = *aperture;
+                    }
+                    break;
+                case ExifReader::IsoSpeed:
+                    if (std::optional<uint32_t> iso = exif.integer(entry)) {
+                        metadata["ISO"_key] = *iso;
+                    }
+                    break;
+                case ExifReader::FocalLength:
+                    if (std::optional<double> millimetres = exif.rational(entry)) {
+                        metadata["FocalLength"_key] = *millimetres;
+                    }
+                    break;
+            }
+            return true;
+        });
+        if (std::optional<Timestamp> time = parseExifDateTime(original, originalOffset)) {
+            metadata["DateTimeOriginal"_key] = *time;
+        }
+    }
 
-    return basicMetadata;
+    if (gpsDirectory != 0) {
+        std::optional<ExifEntry> latitude;
+        std::optional<ExifEntry> longitude;
+        std::string_view latitudeRef;
+        std::string_view longitudeRef;
+        bool belowSeaLevel = false;
+        exif.forEachEntry(gpsDirectory, [&](const ExifEntry& entry) {
+            switch (entry.tag) {
+                case ExifReader::GpsLatitudeRef:  latitudeRef = exif.text(entry); break;
+                case ExifReader::GpsLatitude:     latitude = entry; break;
+                case ExifReader::GpsLongitudeRef: longitudeRef = exif.text(entry); break;
+                case ExifReader::GpsLongitude:    longitude = entry; break;
+                case ExifReader::GpsAltitudeRef:  belowSeaLevel = exif.integer(entry).value_or(0) == 1; break;
+                case ExifReader::GpsAltitude:
+                    if (std::optional<double> metres = exif.rational(entry)) {
+                        metadata["GPSAltitude"_key] = belowSeaLevel ? -*metres : *metres;
+                    }
+                    break;
+            }
+            return true;
+        });
+        std::optional<double> latitudeDegrees = latitude ? gpsCoordinate(exif, *latitude, latitudeRef) : std::nullopt;
+        std::optional<double> longitudeDegrees = longitude ? gpsCoordinate(exif, *longitude, longitudeRef) : std::nullopt;
+        if (latitudeDegrees && longitudeDegrees) {
+            metadata["GPSLatitude"_key] = *latitudeDegrees;
+            metadata["GPSLongitude"_key] = *longitudeDegrees;
+        }
+    }
 }
 
-bool readGifLogicalScreenDescriptor(const std::filesystem::path& filePath, LogicalScreenDescriptor& lsd) {
-    std::ifstream file(filePath, std::ios::binary);
-    if (!file.is_open()) {
-        return false;
+static constexpr uint16_t WaveFormatExtensible = 0xFFFE;
+
+// Returns a readable name for a WAVE format tag
+static const char* wavFormatName(uint16_t format) {
+    switch (format) {
+        case 0x0001: return "PCM";
+        case 0x0002: return "MS ADPCM";
+        case 0x0003: return "IEEE float";
+        case 0x0006: return "A-law";
+        case 0x0007: return "mu-law";
+        case 0x0011: return "IMA ADPCM";
+        case 0x0050: return "MPEG";
+        case 0x0055: return "MPEG Layer III";
+        case 0x00FF: return "AAC";
+        case 0x2000: return "AC-3";
+        case WaveFormatExtensible: return "Extensible";
+        default:     return "Unknown";
     }
+}
 
-    // Read Logical Screen Descriptor
-    file.read(reinterpret_cast<char*>(&lsd), sizeof(LogicalScreenDescriptor));
-    file.close();
+// Returns the name of a LIST "INFO" item id, or nullptr for ids without one
+static const char* wavInfoFieldName(std::string_view id) {
+    static constexpr std::pair<std::string_view, const char*> names[] = {
+        {"INAM", "Title"}, {"IART", "Artist"}, {"IPRD", "Album"}, {"ICMT", "Comment"}, {"IGNR", "Genre"},
+        {"ICRD", "CreationDate"}, {"ICOP", "Copyright"}, {"ISFT", "Software"}, {"IENG", "Engineer"},
+        {"ITRK", "Track"}, {"IKEY", "Keywords"}, {"ISBJ", "Subject"}, {"ISRC", "Source"},
+    };
+    for (const auto& [itemId, name] : names) {
+        if (itemId == id) {
+            return name;
+        }
+    }
+    return nullptr;
+}
 
-    return true;
+/**
+ * @brief Adds the fields of a Broadcast Wave Format "bext" chunk to `metadata`.
+ *
+ * @param bext The chunk body: fixed-size text fields, the time reference and, from byte 602, the coding history.
+ */
+static void extractBroadcastMetadata(std::span<const uint8_t> bext, MetadataMap& metadata, std::pmr::memory_resource* memory) {
+    ByteReader reader(bext);
+    auto field = [&reader](std::size_t offset, std::size_t length) {
+        return RiffReader::text(reader.bytes(offset, length));
+    };
+    auto add = [&](MetadataKey key, std::string_view text) {
+        if (!text.empty()) {
+            metadata[key] = MetadataValue(text, memory);
+        }
+    };
+    add("Broadcast.Description"_key, field(0, 256));
+    add("Broadcast.Originator"_key, field(256, 32));
+    add("Broadcast.OriginatorReference"_key, field(288, 32));
+
+    // "yyyy-mm-dd" and "hh-mm-ss" (any separators), rearranged into EXIF's layout
+    std::string_view date = reader.chars(320, 10);
+    std::string_view time = reader.chars(330, 8);
+    char combined[20];
+    std::snprintf(combined, sizeof(combined), "%.4s:%.2s:%.2s %.2s:%.2s:%.2s", date.data(), date.data() + 5, date.data() + 8,
+                  time.data(), time.data() + 3, time.data() + 6);
+    if (std::optional<Timestamp> origination = parseExifDateTime(std::string_view(combined, 19), {})) {
+        metadata["Broadcast.OriginationTime"_key] = *origination;
+    }
+    metadata["Broadcast.TimeReference"_key] = reader.u64le(338);
+    add("Broadcast.CodingHistory"_key, RiffReader::text(bext.subspan(602)));
 }
 
-void custom_assert(bool condition, const char* message) {
-    if (!condition) {
-        std::cerr << "Assertion failed: " << message << std::endl;
-        // Additional error handling code here, like logging, reporting, etc.
-        // You can also throw an exception or terminate the program if necessary
-        // For demonstration, let's terminate the program
-        throw std::runtime_error("Assertion failed");
+void addTextMetadata(MetadataMap& metadata, const TextSummary& text, const FileContext& context,
+                     std::pmr::memory_resource* memory) {
+    if (!text.byteOrderMark.empty()) {
+        metadata["ByteOrderMark"_key] = MetadataValue::literal(text.byteOrderMark);
     }
+    metadata["Encoding"_key] = MetadataValue::literal(text.encoding());
+
+    // Byte-wise counts and lines mean nothing in UTF-16 and UTF-32
+    if (text.byteOrderMark.empty() || text.byteOrderMark == "UTF-8") {
+        if (text.headLines.size() > 0 && !text.headLines[0].empty()) {
+            metadata["Title"_key] = MetadataValue(text.headLines[0], memory);
+        }
+        if (text.headLines.size() > 1 && !text.headLines[1].empty()) {
+            metadata["Author"_key] = MetadataValue(text.headLines[1], memory);
+        }
+        metadata["LineCount"_key] = text.lines;
+        metadata["WordCount"_key] = text.counts.words;
+        metadata["NonASCIIBytes"_key] = text.counts.nonAscii;
+        metadata["LineEndings"_key] = MetadataValue::literal(text.lineEndings());
+        if (text.counts.invalidUtf8Offset) {
+            metadata["InvalidUTF8Offset"_key] = *text.counts.invalidUtf8Offset;
+        }
+    }
+    if (text.counts.bytes < context.size()) {
+        metadata["AnalyzedBytes"_key] = MetadataValue::byteCount(text.counts.bytes);
+    }
+
+    metadata["FileName"_key] = MetadataValue(fileNameOf(context.path()), memory);
+    metadata["FileSize"_key] = MetadataValue::byteCount(context.size());
+    metadata["FileType"_key] = "TXT";
 }
 
 /**
@@ -74,246 +379,365 @@ void custom_assert(bool condition, const char* message) {
  * This function uses template specialization to handle the metadata extraction for each supported file type.
  *
  * @tparam T The file header type.
- * @param filePath The path to the file.
+ * @param context The opened file shared by every extractor.
+ * @param memory Where the map and its text values are allocated.
  * @return A `CustomMap` containing the extracted metadata.
  */
 template <typename T>
-CustomMap<std::string, std::string> analyzeMetadataHelper(const std::filesystem::path& filePath) {
-    CustomMap<std::string, std::string> metadata ;
-    std::string extension = filePath.extension().string();
+MetadataMap analyzeMetadataHelper(const FileContext& context, std::pmr::memory_resource* memory) {
+    MetadataMap metadata(memory);
+    const std::filesystem::path& filePath = context.path();
 
     if constexpr (std::is_same_v<T, BasicMetadata>)
     {
-        BasicMetadata basicMetadata = extractBasicMetadata(filePath);
-
-        // return custom map of basic metadata;
-        // store bsic metadata in custom map
-        metadata["FileName"] = basicMetadata.fileName;
-        metadata["FileSize"] = basicMetadata.fileSize;
-        metadata["FileType"] = basicMetadata.fileType;
-        metadata["CreationTime"] = basicMetadata.creationTime;
-        metadata["LastModified"] = basicMetadata.lastModified;
-        metadata["LastAccess"] = basicMetadata.lastAccess;
-        
-        return metadata;
+        // return custom map of basic metadata
+        return basicMetadataToMap(extractBasicMetadata(context, memory), memory);
 
     }
     else if constexpr (std::is_same_v<T, poppler::document>) {
+        // Fast path: read the Info dictionary straight from the trailer and xref, without building the document
+        if (context.isComplete()) {
+            if (std::optional<PdfInfo> info = readPdfInfo(context.bytes())) {
+                metadata["Title"_key] = MetadataValue(info->title, memory);
+                metadata["Author"_key] = MetadataValue(info->author, memory);
+                metadata["Subject"_key] = MetadataValue(info->subject, memory);
+                metadata["Keywords"_key] = MetadataValue(info->keywords, memory);
+                metadata["Creator"_key] = MetadataValue(info->creator, memory);
+                metadata["Producer"_key] = MetadataValue(info->producer, memory);
+                addPdfDate(metadata, "CreationDate"_key, info->creationDate);
+                addPdfDate(metadata, "ModificationDate"_key, info->modificationDate);
+                metadata["PDFVersion"_key] = MetadataValue(info->version, memory);
+                metadata["FileType"_key] = "PDF";
+                return metadata;
+            }
+        }
 
-        custom_assert(extension == ".pdf" , "Unexpected file extension for PDF metadata");
-        // PDF metadata extraction logic
-        poppler::document* doc = poppler::document::load_from_file(filePath.string());
+        // Encrypted or malformed: let poppler handle it. poppler reads the mapping in place (it does not
+        // copy raw data); files too large for its int length go through the path instead.
+        std::span<const uint8_t> bytes = context.bytes();
+        poppler::document* doc = context.isComplete() && bytes.size() <= static_cast<std::size_t>(INT_MAX)
+            ? poppler::document::load_from_raw_data(reinterpret_cast<const char*>(bytes.data()), static_cast<int>(bytes.size()))
+            : poppler::document::load_from_file(filePath.string());
         if (!doc || doc->is_locked()) {
             delete doc;
             return metadata;
         }
 
-        metadata["Title"] = std::string(doc->get_title().begin(), doc->get_title().end());
-        metadata["Author"] = std::string(doc->get_author().begin(), doc->get_author().end());
-        metadata["Subject"] = std::string(doc->get_subject().begin(), doc->get_subject().end());
-        metadata["Keywords"] = std::string(doc->get_keywords().begin(), doc->get_keywords().end());
-        metadata["Creator"] = std::string(doc->get_creator().begin(), doc->get_creator().end());
-        metadata["Producer"] = std::string(doc->get_producer().begin(), doc->get_producer().end());
-        metadata["CreationDate"] = doc->get_creation_date();
-        metadata["ModificationDate"] = doc->get_modification_date();
-        metadata["FileType"] = "PDF";
+        metadata["Title"_key] = popplerText(doc->get_title(), memory);
+        metadata["Author"_key] = popplerText(doc->get_author(), memory);
+        metadata["Subject"_key] = popplerText(doc->get_subject(), memory);
+        metadata["Keywords"_key] = popplerText(doc->get_keywords(), memory);
+        metadata["Creator"_key] = popplerText(doc->get_creator(), memory);
+        metadata["Producer"_key] = popplerText(doc->get_producer(), memory);
+        addPdfDate(metadata, "CreationDate"_key, popplerTimestamp(doc->get_creation_date()));
+        addPdfDate(metadata, "ModificationDate"_key, popplerTimestamp(doc->get_modification_date()));
+        metadata["FileType"_key] = "PDF";
         delete doc;
     } else if constexpr (std::is_same_v<T, std::ifstream>) {
-
-        custom_assert(extension == ".txt" , "Unexpected file extension for TXT metadata");
-
         // TXT metadata extraction logic
-        std::ifstream file(filePath);
-        if (!file.is_open()) {
+        if (!context.isOpen()) {
             return metadata;
         }
 
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        std::string fileContent = buffer.str();
-
-        std::string line;
-        std::getline(file, line);
-        if (!line.empty()) {
-            metadata["Title"] = line;
-        }
-
-        std::getline(file, line);
-        if (!line.empty()) {
-            metadata["Author"] = line;
-        }
-
-        // Extract other TXT metadata...
-
-        metadata["FileName"] = filePath.filename().string();
-        metadata["FileSize"] = std::to_string(fileContent.size()) + " bytes";
-        metadata["FileType"] = "TXT";
-        file.close();
+        // One pass over the whole file; the first two lines come out of the prefix
+        addTextMetadata(metadata, readTextFile(context, TextHeadLines, memory), context, memory);
     } else if constexpr (std::is_same_v<T, JPEGHeader>) {
-
-        custom_assert(extension == ".jpg" , "Unexpected file extension for JPEG metadata");
-
         // JPEG metadata extraction logic
-        std::ifstream file(filePath, std::ios::binary);
-        if (!file.is_open()) {
+        if (!context.isOpen()) {
             return metadata;
         }
 
-        JPEGHeader header;
-        file.read(reinterpret_cast<char*>(&header), sizeof(JPEGHeader));
-        file.close();
-
-        metadata["FileType"] = "JPEG";
-        metadata["Marker"] = std::to_string(header.marker);
-        metadata["Length"] = std::to_string(header.length);
-        metadata["Identifier"] = std::string(reinterpret_cast<char*>(header.identifier), 5);
-        metadata["Version"] = std::to_string(header.version);
-        metadata["Units"] = std::to_string(static_cast<int>(header.units));
-        metadata["XDensity"] = std::to_string(header.xDensity);
-        metadata["YDensity"] = std::to_string(header.yDensity);
-        metadata["ThumbnailWidth"] = std::to_string(static_cast<int>(header.thumbWidth));
-        metadata["ThumbnailHeight"] = std::to_string(static_cast<int>(header.thumbHeight));
+        // Marker segments up to SOS: JFIF, EXIF and the frame header all precede the entropy-coded data
+        JpegReader jpeg(context.bytes());
+        metadata["FileType"_key] = "JPEG";
+        jpeg.forEachSegment([&](const JpegSegment& segment) {
+            if (segment.isApp(0, std::string_view("JFIF\0", 5)) && segment.data.size() >= 14) {
+                ByteReader reader(segment.data);
+                JPEGHeader header{};
+                std::memcpy(header.identifier, reader.bytes(0, 5).data(), 5);
+                header.version = reader.u16be(5);
+                header.units = reader.u8(7);
+                header.xDensity = reader.u16be(8);
+                header.yDensity = reader.u16be(10);
+                header.thumbWidth = reader.u8(12);
+                header.thumbHeight = reader.u8(13);
+
+                metadata["Identifier"_key] = "JFIF";
+                metadata["Version"_key] = header.version;
+                metadata["Units"_key] = header.units;
+                metadata["XDensity"_key] = header.xDensity;
+                metadata["YDensity"_key] = header.yDensity;
+                metadata["ThumbnailWidth"_key] = header.thumbWidth;
+                metadata["ThumbnailHeight"_key] = header.thumbHeight;
+            } else if (segment.isApp(1, std::string_view("Exif\0\0", 6))) {
+                try {
+                    extractExifMetadata(segment.data.subspan(6), metadata, memory);
+                } catch (const std::runtime_error&) {
+                    // A damaged EXIF block does not hide the frame header that follows it
+                }
+            } else if (std::optional<JpegFrame> frame = JpegReader::decodeFrame(segment)) {
+                metadata["Width"_key] = frame->width;
+                metadata["Height"_key] = frame->height;
+                metadata["BitsPerSample"_key] = frame->precision;
+                metadata["Components"_key] = frame->components;
+                metadata["Process"_key] = MetadataValue::literal(JpegReader::frameProcessName(frame->marker));
+            }
+            return true;
+        });
     } else if constexpr (std::is_same_v<T, PNGHeader>) {
-        custom_assert(extension == ".png" , "Unexpected file extension for PNG metadata");
-
         // PNG metadata extraction logic
-        std::ifstream file(filePath, std::ios::binary);
-        if (!file.is_open()) {
+        if (!context.isOpen()) {
             return metadata;
         }
 
-        PNGHeader header;
-        file.read(reinterpret_cast<char*>(&header), sizeof(PNGHeader));
-        file.close();
-
-        metadata["FileType"] = "PNG";
-        metadata["Signature"] = std::string(reinterpret_cast<char*>(header.signature), 8);
-        metadata["Width"] = std::to_string(header.width);
-        metadata["Height"] = std::to_string(header.height);
+        // IHDR comes first; the other chunks are found through their length fields, so image data is never read
+        PngReader png(context.bytes());
+        const PngImageHeader& header = png.header();
+
+        metadata["FileType"_key] = "PNG";
+        metadata["Signature"_key] = MetadataValue::bytes(PngReader::Signature, memory);
+        metadata["Width"_key] = header.width;
+        metadata["Height"_key] = header.height;
+        metadata["BitDepth"_key] = header.bitDepth;
+        metadata["ColorType"_key] = header.colorType;
+        metadata["Interlace"_key] = header.interlace;
+
+        bool ended = false;
+        uint64_t chunkCount = png.forEachChunk([&](const PngChunk& chunk) {
+            if (chunk.type == "tEXt" || chunk.type == "zTXt" || chunk.type == "iTXt") {
+                if (std::optional<PngText> text = PngReader::decodeText(chunk, memory)) {
+                    // Keywords are at most 79 bytes, so "Text.<keyword>" fits on the stack
+                    char name[96];
+                    int length = std::snprintf(name, sizeof(name), "Text.%.*s", static_cast<int>(std::min<std::size_t>(text->keyword.size(), 79)), text->keyword.data());
+                    metadata[MetadataKey(std::string_view(name, static_cast<std::size_t>(length)))] = MetadataValue(std::move(text->text));
+                }
+            } else if (chunk.type == "pHYs" && chunk.data.size() == 9) {
+                ByteReader fields(chunk.data);
+                metadata["PixelsPerUnitX"_key] = fields.u32be(0);
+                metadata["PixelsPerUnitY"_key] = fields.u32be(4);
+                metadata["PixelUnit"_key] = MetadataValue::literal(fields.u8(8) == 1 ? "meter" : "unknown");
+            } else if (std::optional<Timestamp> time = PngReader::decodeTime(chunk)) {
+                metadata["ModificationTime"_key] = *time;
+            }
+            ended = chunk.type == "IEND";
+            return true;
+        });
+        metadata["ChunkCount"_key] = chunkCount;
+        if (!ended && context.isComplete()) {
+            metadata["Truncated"_key] = true;
+        }
     } else if constexpr (std::is_same_v<T, BMPHeader>) {
-
-        custom_assert(extension == ".bmp" , "Unexpected file extension for BMP metadata");
-
     // BMP metadata extraction logic
-        std::ifstream file(filePath, std::ios::binary);
-        if (!file.is_open()) {
+        if (!context.isOpen()) {
             return metadata;
         }
 
-        BMPHeader header;
-        file.read(reinterpret_cast<char*>(&header), sizeof(BMPHeader));
-        file.close();
-
-        metadata["FileType"] = "BMP";
-        metadata["Signature"] = std::string(header.signature, 2);
-        metadata["FileSize"] = std::to_string(header.fileSize);
-        metadata["Width"] = std::to_string(header.width);
-        metadata["Height"] = std::to_string(header.height);
+        // BITMAPFILEHEADER is 14 packed bytes followed by the info header; all fields are little-endian
+        ByteReader reader = context.reader();
+        BMPHeader header{};
+        std::memcpy(header.signature, reader.bytes(0, 2).data(), 2);
+        header.fileSize = reader.u32le(2);
+        header.dataOffset = reader.u32le(10);
+        header.headerSize = reader.u32le(14);
+        header.width = reader.i32le(18);
+        header.height = reader.i32le(22);
+
+        metadata["FileType"_key] = "BMP";
+        metadata["Signature"_key] = MetadataValue(std::string_view(header.signature, 2), memory);
+        metadata["FileSize"_key] = header.fileSize;
+        metadata["Width"_key] = header.width;
+        metadata["Height"_key] = header.height;
     } else if constexpr (std::is_same_v<T, ZIPHeader>) {
-
-        custom_assert(extension == ".zip" , "Unexpected file extension for ZIP metadata");
-
-        // ZIP metadata extraction logic
-        int error;
-        zip_t* zip = zip_open(filePath.string().c_str(), 0, &error);
-        if (!zip) {
-            // Handle the error code in `error`
+        // ZIP metadata extraction logic: stream the central directory, nothing is decompressed
+        if (!context.isOpen()) {
             return metadata;
         }
 
-        // Get the overall ZIP file information
-        zip_stat_t zipStat;
-        if (zip_stat(zip, "", 0, &zipStat) == 0) {
-            metadata["FileType"] = "ZIP";
-            metadata["FileSize"] = std::to_string(zipStat.size) + " bytes";
+        ZipReader zip(context.bytes());
+        uint64_t compressedTotal = 0;
+        uint64_t uncompressedTotal = 0;
+        uint64_t listed = 0;
+        zip.forEachEntry([&](const ZipEntry& entry) {
+            compressedTotal += entry.compressedSize;
+            uncompressedTotal += entry.uncompressedSize;
+            if (listed < MaxListedZipEntries) {
+                // "EntryN.Field" keys are built on the stack; interning them only allocates the first time
+                char name[48];
+                int prefixLength = std::snprintf(name, sizeof(name), "Entry%llu.", static_cast<unsigned long long>(++listed));
+                auto key = [&](std::string_view field) {
+                    field.copy(name + prefixLength, sizeof(name) - prefixLength);
+                    return MetadataKey(std::string_view(name, prefixLength + field.size()));
+                };
+                metadata[key("Name")] = MetadataValue(entry.name, memory);
+                metadata[key("Method")] = MetadataValue(zipMethodName(entry.method), memory);
+                metadata[key("CRC32")] = MetadataValue::hex(entry.crc32, 8);
+                metadata[key("Modified")] = formatDosDateTime(entry.dosDate, entry.dosTime, memory);
+                metadata[key("CompressedSize")] = MetadataValue::byteCount(entry.compressedSize);
+                metadata[key("UncompressedSize")] = MetadataValue::byteCount(entry.uncompressedSize);
+            }
+            return true;
+        });
+
+        metadata["FileType"_key] = "ZIP";
+        metadata["EntryCount"_key] = zip.entryCount();
+        metadata["CompressedSize"_key] = MetadataValue::byteCount(compressedTotal);
+        metadata["UncompressedSize"_key] = MetadataValue::byteCount(uncompressedTotal);
+        if (zip.isZip64()) {
+            metadata["ZIP64"_key] = true;
         }
-
-        // Get the ZIP archive comment
-        int commentLength;
-        const char* comment = zip_get_archive_comment(zip, &commentLength, 0);
-        if (commentLength > 0) {
-            metadata["Comment"] = std::string(comment, commentLength);
+        if (listed < zip.entryCount()) {
+            metadata["EntriesListed"_key] = listed;
         }
 
-        // Get the first file in the ZIP archive
-        zip_file_t* file = zip_fopen_index(zip, 0, 0);
-        if (file) {
-            ZIPHeader header;
-            zip_fread(file, &header, sizeof(ZIPHeader));
-
-            // Extract metadata from the ZIP header
-            metadata["FileName"] = std::string(reinterpret_cast<char*>(header.fileNameLength + 1), header.fileNameLength);
-            metadata["CompressedSize"] = std::to_string(header.compressedSize) + " bytes";
-            metadata["CompressionMethod"] = std::to_string(header.compressionMethod);
-            metadata["LastModificationTime"] = std::to_string(header.lastModTime);
-            metadata["LastModificationDate"] = std::to_string(header.lastModDate);
-            metadata["CRC32"] = std::to_string(header.crc32);
-            metadata["UncompressedSize"] = std::to_string(header.uncompressedSize) + " bytes";
-
-            zip_fclose(file);
+        // Get the ZIP archive comment
+        if (!zip.comment().empty()) {
+            metadata["Comment"_key] = MetadataValue(zip.comment(), memory);
         }
-
-        zip_close(zip);
     } else if constexpr (std::is_same_v<T, WAVHeader>) {
-
-        custom_assert(extension == ".wav" , "Unexpected file extension for WAV metadata");
-
         //WAV metadata extraction logic
-        std::ifstream file(filePath, std::ios::binary);
-        if (!file.is_open()) {
+        if (!context.isOpen()) {
             return metadata;
         }
 
-        WAVHeader header;
-        file.read(reinterpret_cast<char*>(&header), sizeof(WAVHeader));
-        file.close();
-
-        metadata["FileType"] = "WAV";
-        metadata["RIFFTag"] = std::string(header.riffTag, 4);
-        metadata["RIFFSize"] = std::to_string(header.riffSize);
-        metadata["WAVETag"] = std::string(header.waveTag, 4);
-        metadata["FMTTag"] = std::string(header.fmtTag, 4);
-        metadata["FMTSize"] = std::to_string(header.fmtSize);
-        metadata["AudioFormat"] = std::to_string(header.audioFormat);
-        metadata["NumChannels"] = std::to_string(header.numChannels);
-        metadata["SampleRate"] = std::to_string(header.sampleRate);
-        metadata["ByteRate"] = std::to_string(header.byteRate);
-        metadata["BlockAlign"] = std::to_string(header.blockAlign);
-        metadata["BitsPerSample"] = std::to_string(header.bitsPerSample);
-        metadata["DataTag"] = std::string(header.dataTag, 4);
-        metadata["DataSize"] = std::to_string(header.dataSize);
+        // fmt, fact, LIST and bext may come in any order around data; only their headers are needed to find them
+        RiffReader riff(context.bytes());
+        if (riff.formType() != "WAVE") {
+            throw std::runtime_error("WAV: RIFF form type is not WAVE");
+        }
+        metadata["FileType"_key] = "WAV";
+        metadata["RIFFTag"_key] = MetadataValue(riff.signature(), memory);
+        metadata["RIFFSize"_key] = riff.riffSize();
+
+        uint16_t encoding = 0;      // the format tag, or the sub-format of WAVE_FORMAT_EXTENSIBLE
+        uint32_t sampleRate = 0;
+        uint16_t blockAlign = 0;
+        std::optional<uint64_t> dataSize;
+        std::optional<uint64_t> sampleFrames;
+        bool truncated = false;
+        if (riff.ds64SampleCount() != 0) {
+            sampleFrames = riff.ds64SampleCount();
+        }
+        riff.forEachChunk([&](const RiffChunk& chunk) {
+            truncated = !chunk.isComplete();
+            if (chunk.id == "fmt " && chunk.data.size() >= 16) {
+                ByteReader format(chunk.data);
+                encoding = format.u16le(0);
+                sampleRate = format.u32le(4);
+                blockAlign = format.u16le(12);
+                metadata["AudioFormat"_key] = encoding;
+                metadata["NumChannels"_key] = format.u16le(2);
+                metadata["SampleRate"_key] = sampleRate;
+                metadata["ByteRate"_key] = format.u32le(8);
+                metadata["BlockAlign"_key] = blockAlign;
+                metadata["BitsPerSample"_key] = format.u16le(14);
+                if (encoding == WaveFormatExtensible && chunk.data.size() >= 40) {
+                    // cbSize, valid bits, channel mask, then a GUID whose first two bytes are the real format tag
+                    metadata["ValidBitsPerSample"_key] = format.u16le(18);
+                    metadata["ChannelMask"_key] = MetadataValue::hex(format.u32le(20), 8);
+                    encoding = format.u16le(24);
+                }
+                metadata["Encoding"_key] = MetadataValue::literal(wavFormatName(encoding));
+            } else if (chunk.id == "data") {
+                dataSize = chunk.size;
+            } else if (chunk.id == "fact" && chunk.data.size() >= 4 && !sampleFrames) {
+                sampleFrames = ByteReader(chunk.data).u32le(0);
+            } else if (RiffReader::listType(chunk) == "INFO") {
+                RiffReader::forEachListItem(chunk, [&](const RiffChunk& item) {
+                    if (std::string_view text = RiffReader::text(item.data); !text.empty()) {
+                        // "Info.<Name>" keys are built on the stack; unknown items keep their four-letter id
+                        const char* field = wavInfoFieldName(item.id);
+                        char name[32];
+                        int length = std::snprintf(name, sizeof(name), "Info.%.*s", field ? static_cast<int>(std::strlen(field)) : 4,
+                                                   field ? field : item.id.data());
+                        metadata[MetadataKey(std::string_view(name, static_cast<std::size_t>(length)))] = MetadataValue(text, memory);
+                    }
+                    return true;
+                });
+            } else if (chunk.id == "bext" && chunk.data.size() >= 602) {
+                extractBroadcastMetadata(chunk.data, metadata, memory);
+            }
+            return true;
+        });
+
+        if (dataSize) {
+            metadata["DataSize"_key] = *dataSize;
+            // Uncompressed formats have fixed-size frames; compressed ones need the sample count from fact or ds64
+            bool fixedFrames = encoding == 1 || encoding == 3 || encoding == 6 || encoding == 7;
+            if (fixedFrames && blockAlign > 0) {
+                sampleFrames = *dataSize / blockAlign;
+            }
+        }
+        if (sampleFrames) {
+            metadata["SampleFrames"_key] = *sampleFrames;
+            if (sampleRate > 0) {
+                metadata["Duration"_key] = static_cast<double>(*sampleFrames) / sampleRate;
+            }
+        }
+        if (truncated && context.isComplete()) {
+            metadata["Truncated"_key] = true;
+        }
     }else if constexpr (std::is_same_v<T, GIFHeader>) {
-        custom_assert(extension == ".gif" , "Unexpected file extension for GIF metadata");
-
         // GIF metadata extraction logic
-        std::ifstream file(filePath, std::ios::binary);
-        if (!file.is_open()) {
+        if (!context.isOpen()) {
             return metadata;
         }
 
-        GIFHeader header;
-        file.read(reinterpret_cast<char*>(&header), sizeof(GIFHeader));
-        file.close();
-
-        metadata["FileType"] = "GIF";
-        metadata["Signature"] = std::string(header.signature, 3);
-        metadata["Version"] = std::string(header.version, 3);
-        // Include additional metadata extraction for GIF files if needed
+        // Every frame has to be stepped over to count them; the walk reads the whole file front to back
+        GifReader gif(context.bytes());
+        if (context.size() > FileContext::DefaultPrefixSize) {
+            context.adviseSequential();
+        }
+        uint64_t frameCount = 0;
+        uint64_t delay = 0;     // hundredths of a second
+        std::optional<uint16_t> loopCount;
+        std::pmr::string comment(memory);
+        bool ended = false;
+        gif.forEachBlock([&](const GifBlock& block) {
+            if (block.isImage()) {
+                ++frameCount;
+            } else if (std::optional<uint16_t> frameDelay = GifReader::decodeDelay(block)) {
+                delay += *frameDelay;
+            } else if (std::optional<uint16_t> loops = gif.decodeLoopCount(block)) {
+                loopCount = loops;
+            } else if (block.isExtension(GifBlock::Comment)) {
+                if (!comment.empty() && comment.size() < MaxGifCommentLength) {
+                    comment.push_back('\n');
+                }
+                gif.appendData(block, comment, MaxGifCommentLength);
+            }
+            ended = block.introducer == GifBlock::Trailer;
+            return true;
+        });
+
+        metadata["FileType"_key] = "GIF";
+        metadata["Signature"_key] = "GIF";
+        metadata["Version"_key] = MetadataValue(gif.version(), memory);
+        metadata["FrameCount"_key] = frameCount;
+        if (loopCount) {
+            metadata["LoopCount"_key] = *loopCount;
+        }
+        if (delay > 0) {
+            metadata["Duration"_key] = static_cast<double>(delay) / 100;
+        }
+        if (!comment.empty()) {
+            metadata["Comment"_key] = MetadataValue(std::move(comment));
+        }
+        if (!ended && context.isComplete()) {
+            metadata["Truncated"_key] = true;
+        }
     } else if constexpr (std::is_same_v<T, LogicalScreenDescriptor>) {
-
-        custom_assert(extension == ".gif" , "Unexpected file extension for GIF metadata");
         // GIF metadata extraction logic
-        LogicalScreenDescriptor lsd;
-        if (!readGifLogicalScreenDescriptor(filePath, lsd)) {
+        if (!context.isOpen()) {
             return metadata;
         }
 
-        metadata["FileType"] = "GIF";
-        metadata["Width"] = std::to_string(lsd.width);
-        metadata["Height"] = std::to_string(lsd.height);
-        metadata["PackedFields"] = std::to_string(lsd.packedFields);
-        metadata["BackgroundColorIndex"] = std::to_string(lsd.backgroundColorIndex);
-        metadata["PixelAspectRatio"] = std::to_string(lsd.pixelAspectRatio);
+        GifScreen lsd = GifReader(context.bytes()).screen();
+        metadata["FileType"_key] = "GIF";
+        metadata["Width"_key] = lsd.width;
+        metadata["Height"_key] = lsd.height;
+        metadata["PackedFields"_key] = lsd.packedFields;
+        metadata["BackgroundColorIndex"_key] = lsd.backgroundColorIndex;
+        metadata["PixelAspectRatio"_key] = lsd.pixelAspectRatio;
     }
 
     return metadata;
@@ -322,56 +746,148 @@ CustomMap<std::string, std::string> analyzeMetadataHelper(const std::filesystem:
 /**
  * @brief Determines the file type based on the file signature.
  *
- * This function uses a fold expression to check the file signature and return the corresponding `FileType`.
+ * The signatures of the header types in `T...` are matched through a `SignatureDispatch` table generated
+ * at compile time for that pack.
  *
  * @tparam T The supported file header types.
- * @param filePath The path to the file.
+ * @param context The opened file; only its prefix buffer is inspected.
  * @return The determined file type.
  */
 template <typename... T>
 requires (sizeof...(T) > 0)
-FileType determineFileType(const std::filesystem::path& filePath) {
-    std::ifstream file(filePath, std::ios::binary);
-    if (!file.is_open()) {
+FileType determineFileType(const FileContext& context) {
+    if (!context.isOpen()) {
         return FileType::UNKNOWN;
     }
 
-    uint8_t signature[8];
-    file.read(reinterpret_cast<char*>(signature), sizeof(signature));
-
-    // Fold expression to check the file signature
-    return (
-        [&]() -> FileType {
-            return (
-                (std::memcmp(signature, JPEGSignature, sizeof(JPEGSignature)) == 0) ? FileType::JPEG :
-                (std::memcmp(signature, PNGSignature, sizeof(PNGSignature)) == 0) ? FileType::PNG :
-                (std::memcmp(signature, BMPSignature, sizeof(BMPSignature)) == 0) ? FileType::BMP :
-                (signature[0] == '%' && signature[1] == 'P' && signature[2] == 'D' && signature[3] == 'F') ? FileType::PDF :
-                (std::memcmp(signature, ZIPSignature, sizeof(ZIPSignature)) == 0) ? FileType::ZIP :
-                (std::memcmp(signature, WAVSignature, sizeof(WAVSignature)) == 0) ? FileType::WAV :
-                (std::memcmp(signature, GIFSignature, sizeof(GIFSignature)) == 0) ? FileType::GIF : // Add GIF detection
-                FileType::TXT
-            );
-        }()
-    );
+    FILEMETA_STAGE_TIMER(timer, Stage::DetermineFileType);
+    FileType fileType = SignatureDispatch<T...>::match(context.prefix());
+    FILEMETA_STAGE_FILE_TYPE(timer, fileType);
+    return fileType;
+}
+
+const char* fileTypeName(FileType fileType) {
+    switch (fileType) {
+        case FileType::PDF:  return "PDF";
+        case FileType::TXT:  return "TXT";
+        case FileType::JPEG: return "JPEG";
+        case FileType::PNG:  return "PNG";
+        case FileType::BMP:  return "BMP";
+        case FileType::GIF:  return "GIF";
+        case FileType::ZIP:  return "ZIP";
+        case FileType::WAV:  return "WAV";
+        default:             return "UNKNOWN";
+    }
+}
+
+namespace {
+
+// One format specific extractor, timed as its own stage
+template <typename... T>
+MetadataMap runExtractor(const FileContext& context, [[maybe_unused]] FileType fileType, std::pmr::memory_resource* memory) {
+    FILEMETA_STAGE_TIMER(timer, Stage::AnalyzeHelper, fileType);
+    return FileMetaDataAnalyzer<T...>::analyzeMetadata(context, memory);
+}
+
+}
+
+MetadataMap analyzeFileMetadata(const FileContext& context, FileType fileType, bool includeBasic, bool includeSpecialized,
+                                std::pmr::memory_resource* memory) {
+    MetadataMap metadata(memory);
+    if (includeBasic) {
+        FILEMETA_STAGE_TIMER(timer, Stage::BasicMetadata, fileType);
+        metadata = FileMetaDataAnalyzer<BasicMetadata>::analyzeMetadata(context, memory);
+    }
+    if (!includeSpecialized) {
+        return metadata;
+    }
+
+    auto merge = [&metadata, fileType](MetadataMap&& src) {
+        FILEMETA_STAGE_TIMER(timer, Stage::MergeMap, fileType);
+        metadata.reserve(metadata.size() + src.size());
+        for (auto& [key, value] : src) {
+            metadata[key] = std::move(value);
+        }
+    };
+
+    switch (fileType) {
+        case FileType::PDF:
+            merge(runExtractor<poppler::document>(context, fileType, memory));
+            break;
+        case FileType::TXT:
+            merge(runExtractor<std::ifstream>(context, fileType, memory));
+            break;
+        case FileType::JPEG:
+            merge(runExtractor<JPEGHeader>(context, fileType, memory));
+            break;
+        case FileType::PNG:
+            merge(runExtractor<PNGHeader>(context, fileType, memory));
+            break;
+        case FileType::BMP:
+            merge(runExtractor<BMPHeader>(context, fileType, memory));
+            break;
+        case FileType::ZIP:
+            merge(runExtractor<ZIPHeader>(context, fileType, memory));
+            break;
+        case FileType::WAV:
+            merge(runExtractor<WAVHeader>(context, fileType, memory));
+            break;
+        case FileType::GIF:
+            merge(runExtractor<GIFHeader, LogicalScreenDescriptor>(context, fileType, memory));
+            break;
+        default:
+            throw std::runtime_error("Unsupported file format.");
+    }
+    return metadata;
 }
 
+MetadataMap verifyFileIntegrity(const FileContext& context, FileType fileType, std::pmr::memory_resource* memory) {
+    MetadataMap metadata(memory);
+    if (fileType != FileType::PNG || !context.isOpen() || !context.isComplete()) {
+        return metadata;
+    }
+
+    PngReader png(context.bytes());
+    context.adviseSequential();
+    uint64_t corrupt = 0;
+    bool ended = false;
+    png.forEachChunk([&](const PngChunk& chunk) {
+        corrupt += !PngReader::hasValidCrc(chunk);
+        ended = chunk.type == "IEND";
+        return true;
+    });
+    metadata["Integrity"_key] = MetadataValue::literal(corrupt == 0 && ended ? "ok" : "corrupt");
+    metadata["CRCErrors"_key] = corrupt;
+    return metadata;
+}
 
 // Explicit template instantiations for the supported file header types
-template FileType determineFileType<poppler::document, std::ifstream, JPEGHeader, PNGHeader, BMPHeader, ZIPHeader, WAVHeader,GIFHeader>(const std::filesystem::path& filePath);
+template FileType determineFileType<poppler::document, std::ifstream, JPEGHeader, PNGHeader, BMPHeader, ZIPHeader, WAVHeader,GIFHeader>(const FileContext& context);
 
 
 // Explicit template instantiations for the supported file header types
 // template FileType determineFileType<poppler::document, std::ifstream, JPEGHeader, PNGHeader, BMPHeader, ZIPHeader, WAVHeader>(const std::filesystem::path& filePath);
 
 // Explicit template instantiations for the FileMetaDataAnalyzer class
-template CustomMap<std::string, std::string> FileMetaDataAnalyzer<poppler::document>::analyzeMetadata(const std::filesystem::path& filePath);
-template CustomMap<std::string, std::string> FileMetaDataAnalyzer<std::ifstream>::analyzeMetadata(const std::filesystem::path& filePath);
-template CustomMap<std::string, std::string> FileMetaDataAnalyzer<JPEGHeader>::analyzeMetadata(const std::filesystem::path& filePath);
-template CustomMap<std::string, std::string> FileMetaDataAnalyzer<PNGHeader>::analyzeMetadata(const std::filesystem::path& filePath);
-template CustomMap<std::string, std::string> FileMetaDataAnalyzer<BMPHeader>::analyzeMetadata(const std::filesystem::path& filePath);
-template CustomMap<std::string, std::string> FileMetaDataAnalyzer<ZIPHeader>::analyzeMetadata(const std::filesystem::path& filePath);
-template CustomMap<std::string, std::string> FileMetaDataAnalyzer<WAVHeader>::analyzeMetadata(const std::filesystem::path& filePath);
-template CustomMap<std::string, std::string> FileMetaDataAnalyzer<GIFHeader>::analyzeMetadata(const std::filesystem::path& filePath);
-template CustomMap<std::string, std::string> FileMetaDataAnalyzer<LogicalScreenDescriptor>::analyzeMetadata(const std::filesystem::path& filePath);
-template CustomMap<std::string, std::string> FileMetaDataAnalyzer<BasicMetadata>::analyzeMetadata(const std::filesystem::path& filePath);
+template MetadataMap FileMetaDataAnalyzer<poppler::document>::analyzeMetadata(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap FileMetaDataAnalyzer<std::ifstream>::analyzeMetadata(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap FileMetaDataAnalyzer<JPEGHeader>::analyzeMetadata(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap FileMetaDataAnalyzer<PNGHeader>::analyzeMetadata(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap FileMetaDataAnalyzer<BMPHeader>::analyzeMetadata(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap FileMetaDataAnalyzer<ZIPHeader>::analyzeMetadata(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap FileMetaDataAnalyzer<WAVHeader>::analyzeMetadata(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap FileMetaDataAnalyzer<GIFHeader>::analyzeMetadata(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap FileMetaDataAnalyzer<LogicalScreenDescriptor>::analyzeMetadata(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap FileMetaDataAnalyzer<BasicMetadata>::analyzeMetadata(const FileContext& context, std::pmr::memory_resource* memory);
+
+// Explicit template instantiations of the extractors, which the inline analyzeMetadata() calls
+template MetadataMap analyzeMetadataHelper<poppler::document>(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap analyzeMetadataHelper<std::ifstream>(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap analyzeMetadataHelper<JPEGHeader>(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap analyzeMetadataHelper<PNGHeader>(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap analyzeMetadataHelper<BMPHeader>(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap analyzeMetadataHelper<ZIPHeader>(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap analyzeMetadataHelper<WAVHeader>(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap analyzeMetadataHelper<GIFHeader>(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap analyzeMetadataHelper<LogicalScreenDescriptor>(const FileContext& context, std::pmr::memory_resource* memory);
+template MetadataMap analyzeMetadataHelper<BasicMetadata>(const FileContext& context, std::pmr::memory_resource* memory);
@@ -0,0 +1,138 @@
+#include "FileWatcher.h"
+#include <cerrno>
+#include <system_error>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t WatchMask = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                               IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+//Checks whether `path` is `root` or lies below it.
+bool isWithin(const std::filesystem::path& path, const std::filesystem::path& root) {
+    const std::string& text = path.native();
+    const std::string& prefix = root.native();
+    return text.size() >= prefix.size() && text.compare(0, prefix.size(), prefix) == 0 &&
+           (text.size() == prefix.size() || text[prefix.size()] == '/' || (!prefix.empty() && prefix.back() == '/'));
+}
+
+}
+
+FileWatcher::FileWatcher() : fd(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "inotify_init1");
+    }
+}
+
+FileWatcher::~FileWatcher() {
+    ::close(fd);
+}
+
+void FileWatcher::watchTree(const std::filesystem::path& root, bool follow) {
+    followSymlinks = follow;
+    auto addWatch = [this](const std::filesystem::path& directory) {
+        int wd = ::inotify_add_watch(fd, directory.c_str(), WatchMask);
+        if (wd < 0) {
+            if (errno == ENOSPC) {
+                throw std::system_error(errno, std::generic_category(), "inotify watch limit reached (fs.inotify.max_user_watches)");
+            }
+            return; // vanished or unreadable
+        }
+        // A directory that moved keeps its watch descriptor
+        auto [it, inserted] = directories.try_emplace(wd, directory);
+        if (!inserted) {
+            watches.erase(it->second);
+            it->second = directory;
+        }
+        watches[directory] = wd;
+    };
+
+    addWatch(root);
+    auto options = std::filesystem::directory_options::skip_permission_denied;
+    if (followSymlinks) {
+        options |= std::filesystem::directory_options::follow_directory_symlink;
+    }
+    std::error_code ec;
+    std::filesystem::recursive_directory_iterator it(root, options, ec);
+    for (; !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        std::error_code statusEc;
+        if (it->is_directory(statusEc) && (followSymlinks || !it->is_symlink(statusEc))) {
+            addWatch(it->path());
+        }
+    }
+}
+
+void FileWatcher::unwatchTree(const std::filesystem::path& root) {
+    for (auto it = watches.lower_bound(root); it != watches.end() && isWithin(it->first, root);) {
+        ::inotify_rm_watch(fd, it->second);
+        directories.erase(it->second);
+        it = watches.erase(it);
+    }
+}
+
+std::size_t FileWatcher::readEvents(std::vector<WatchEvent>& events) {
+    std::size_t before = events.size();
+    alignas(inotify_event) char buffer[64 * 1024];
+    while (true) {
+        ssize_t length = ::read(fd, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            break;
+        }
+
+        for (char* p = buffer; p < buffer + length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                events.push_back({WatchEvent::Kind::Overflow, {}});
+                continue;
+            }
+            auto directory = directories.find(event->wd);
+            if (directory == directories.end()) {
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                // The kernel dropped the watch (directory deleted or unmounted)
+                auto watch = watches.find(directory->second);
+                if (watch != watches.end() && watch->second == event->wd) {
+                    watches.erase(watch);
+                }
+                directories.erase(directory);
+                continue;
+            }
+            if (event->len == 0) {
+                // The watched directory itself; its parent reports deletions too, except for the roots
+                if (event->mask & IN_DELETE_SELF) {
+                    events.push_back({WatchEvent::Kind::DirectoryRemoved, directory->second});
+                }
+                continue;
+            }
+
+            std::filesystem::path path = directory->second / event->name;
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    try {
+                        watchTree(path, followSymlinks);
+                    } catch (const std::system_error&) {
+                        // Out of watches: the directory is still reported, so its files get analyzed once
+                    }
+                    events.push_back({WatchEvent::Kind::DirectoryAdded, std::move(path)});
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    unwatchTree(path);
+                    events.push_back({WatchEvent::Kind::DirectoryRemoved, std::move(path)});
+                }
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                events.push_back({WatchEvent::Kind::Removed, std::move(path)});
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE)) {
+                events.push_back({WatchEvent::Kind::Changed, std::move(path)});
+            } else if (event->mask & IN_ATTRIB) {
+                events.push_back({WatchEvent::Kind::AttributesChanged, std::move(path)});
+            }
+        }
+    }
+    return events.size() - before;
+}
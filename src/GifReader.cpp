@@ -0,0 +1,112 @@
+#include "GifReader.h"
+#include <algorithm>
+#include <stdexcept>
+
+GifReader::GifReader(std::span<const uint8_t> file) : data(file), reader(file) {
+    if (!reader.matches(0, "GIF87a") && !reader.matches(0, "GIF89a")) {
+        throw std::runtime_error("GIF: bad signature");
+    }
+    if (!reader.has(0, ScreenEnd)) {
+        throw std::runtime_error("GIF: truncated Logical Screen Descriptor");
+    }
+    logicalScreen.width = reader.u16le(6);
+    logicalScreen.height = reader.u16le(8);
+    logicalScreen.packedFields = reader.u8(10);
+    logicalScreen.backgroundColorIndex = reader.u8(11);
+    logicalScreen.pixelAspectRatio = reader.u8(12);
+}
+
+std::optional<uint64_t> GifReader::skipSubBlocks(uint64_t offset) const {
+    // Hot loop of the walk: each length byte gives the distance to the next one, ending at a zero length
+    const uint8_t* position = data.data() + std::min<uint64_t>(offset, data.size());
+    const uint8_t* end = data.data() + data.size();
+    while (position < end) {
+        uint8_t length = *position;
+        if (length == 0) {
+            return static_cast<uint64_t>(position + 1 - data.data());
+        }
+        position += length + 1;
+    }
+    return std::nullopt;
+}
+
+bool GifReader::readBlock(uint64_t& offset, GifBlock& block) const {
+    if (!reader.has(offset, 1)) {
+        return false;
+    }
+    block = GifBlock{};
+    block.offset = offset;
+    block.introducer = reader.u8(offset);
+
+    switch (block.introducer) {
+        case GifBlock::Trailer:
+            offset += 1;
+            return true;
+        case GifBlock::ImageIntroducer: {
+            // Descriptor, optional local color table, LZW minimum code size, then the image data sub-blocks
+            if (!reader.has(offset + 1, 9)) {
+                return false;
+            }
+            block.header = reader.bytes(offset + 1, 9);
+            uint8_t packed = block.header[8];
+            uint64_t localTable = packed & 0x80 ? 3u << ((packed & 0x07) + 1) : 0;
+            block.subBlocks = offset + 10 + localTable + 1;
+            break;
+        }
+        case GifBlock::ExtensionIntroducer: {
+            if (!reader.has(offset + 1, 2)) {
+                return false;
+            }
+            block.label = reader.u8(offset + 1);
+            block.subBlocks = offset + 2;
+            uint8_t length = reader.u8(block.subBlocks);
+            if (!reader.has(block.subBlocks + 1, length)) {
+                return false;
+            }
+            block.header = reader.bytes(block.subBlocks + 1, length);
+            break;
+        }
+        default:
+            return false;
+    }
+
+    std::optional<uint64_t> next = skipSubBlocks(block.subBlocks);
+    if (!next) {
+        return false;
+    }
+    offset = *next;
+    return true;
+}
+
+std::optional<uint16_t> GifReader::decodeDelay(const GifBlock& block) {
+    if (!block.isExtension(GifBlock::GraphicControl) || block.header.size() < 4) {
+        return std::nullopt;
+    }
+    return ByteReader(block.header).u16le(1);
+}
+
+std::optional<uint16_t> GifReader::decodeLoopCount(const GifBlock& block) const {
+    std::string_view identifier(reinterpret_cast<const char*>(block.header.data()), block.header.size());
+    if (!block.isExtension(GifBlock::Application) || (identifier != "NETSCAPE2.0" && identifier != "ANIMEXTS1.0")) {
+        return std::nullopt;
+    }
+    // The second sub-block is [1, loop count (little-endian)]
+    uint64_t second = block.subBlocks + 1 + block.header.size();
+    if (!reader.has(second, 4) || reader.u8(second) < 3 || reader.u8(second + 1) != 1) {
+        return std::nullopt;
+    }
+    return reader.u16le(second + 2);
+}
+
+void GifReader::appendData(const GifBlock& block, std::pmr::string& out, std::size_t limit) const {
+    uint64_t offset = block.subBlocks;
+    while (out.size() < limit && reader.has(offset, 1)) {
+        uint8_t length = reader.u8(offset);
+        if (length == 0 || !reader.has(offset + 1, length)) {
+            break;
+        }
+        std::string_view piece = reader.chars(offset + 1, length);
+        out.append(piece.substr(0, limit - out.size()));
+        offset += 1 + length;
+    }
+}
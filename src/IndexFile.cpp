@@ -0,0 +1,842 @@
+#include "IndexFile.h"
+#include "ByteReader.h"
+#include "MetadataCache.h"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char IndexMagic[8] = {'F', 'M', 'D', 'I', 'D', 'X', '1', '\0'};
+constexpr char FooterMagic[8] = {'F', 'I', 'D', 'X', 'E', 'N', 'D', '\0'};
+constexpr uint32_t IndexFormatVersion = 1;
+constexpr std::size_t FileHeaderSize = 16;
+constexpr std::size_t FooterSize = 48;
+constexpr std::size_t FileTypeCount = static_cast<std::size_t>(FileType::UNKNOWN) + 1;
+
+void appendU32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void appendU64(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+// Unchecked little-endian loads for the index arrays, whose bounds are validated once when mapping
+uint32_t loadU32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t loadU64(const uint8_t* p) {
+    return static_cast<uint64_t>(loadU32(p)) | (static_cast<uint64_t>(loadU32(p + 4)) << 32);
+}
+
+double loadF64(const uint8_t* p) {
+    return std::bit_cast<double>(loadU64(p));
+}
+
+std::size_t wordCount(std::size_t records) {
+    return (records + 63) / 64;
+}
+
+std::size_t padded(std::size_t length) {
+    return (length + 7) & ~std::size_t{7};
+}
+
+//Integers and reals as themselves, times as seconds since the epoch.
+std::optional<double> numericValue(const MetadataValue& value) {
+    if (value.kind() == MetadataValue::Kind::Time) {
+        Timestamp time = value.time();
+        return static_cast<double>(time.seconds) + time.nanoseconds / 1e9;
+    }
+    return value.number();
+}
+
+//Booleans match as the words "true" and "false".
+bool isText(const MetadataValue& value) {
+    return value.kind() == MetadataValue::Kind::Text || value.kind() == MetadataValue::Kind::Bytes ||
+           value.kind() == MetadataValue::Kind::Boolean;
+}
+
+std::string_view textOf(const MetadataValue& value) {
+    if (value.kind() == MetadataValue::Kind::Boolean) {
+        return value.boolean() ? "true" : "false";
+    }
+    return value.text();
+}
+
+//A set of record numbers.
+class Bitmap {
+public:
+    explicit Bitmap(std::size_t records) : records(records), words(wordCount(records), 0) {}
+
+    void set(uint32_t record) {
+        if (record < records) {
+            words[record >> 6] |= uint64_t{1} << (record & 63);
+        }
+    }
+
+    void setAll() {
+        std::fill(words.begin(), words.end(), ~uint64_t{0});
+        clearTail();
+    }
+
+    //Loads the bitmap stored at `data` (one of the `types` bitmaps).
+    void assign(const uint8_t* data) {
+        for (std::size_t i = 0; i < words.size(); ++i) {
+            words[i] = loadU64(data + i * 8);
+        }
+        clearTail();
+    }
+
+    void intersect(const Bitmap& other) {
+        for (std::size_t i = 0; i < words.size(); ++i) {
+            words[i] &= other.words[i];
+        }
+    }
+
+    void unite(const Bitmap& other) {
+        for (std::size_t i = 0; i < words.size(); ++i) {
+            words[i] |= other.words[i];
+        }
+    }
+
+    void invert() {
+        for (auto& word : words) {
+            word = ~word;
+        }
+        clearTail();
+    }
+
+    std::vector<uint32_t> members() const {
+        std::vector<uint32_t> result;
+        for (std::size_t i = 0; i < words.size(); ++i) {
+            for (uint64_t word = words[i]; word != 0; word &= word - 1) {
+                result.push_back(static_cast<uint32_t>(i * 64 + static_cast<std::size_t>(std::countr_zero(word))));
+            }
+        }
+        return result;
+    }
+
+private:
+    void clearTail() {
+        if (records % 64 != 0) {
+            words.back() &= (uint64_t{1} << (records % 64)) - 1;
+        }
+    }
+
+    std::size_t records;
+    std::vector<uint64_t> words;
+};
+
+enum class Comparison { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual };
+
+//The right-hand side of a comparison: its text, and its number when it reads as one.
+struct Literal {
+    std::string text;
+    std::optional<double> number;
+};
+
+//A parsed query: a tree of conjunctions, disjunctions and negations over field predicates.
+struct QueryNode {
+    enum class Kind { And, Or, Not, Has, Compare };
+
+    Kind kind = Kind::Has;
+    std::string field;
+    Comparison comparison = Comparison::Equal;
+    Literal value;
+    std::unique_ptr<QueryNode> left;
+    std::unique_ptr<QueryNode> right;
+};
+
+// "12", "1.5", "-3", "10K" (binary suffixes up to T)
+std::optional<double> parseNumber(std::string_view text) {
+    double multiplier = 1;
+    if (!text.empty()) {
+        switch (std::toupper(static_cast<unsigned char>(text.back()))) {
+            case 'K': multiplier = 1024.0; break;
+            case 'M': multiplier = 1024.0 * 1024; break;
+            case 'G': multiplier = 1024.0 * 1024 * 1024; break;
+            case 'T': multiplier = 1024.0 * 1024 * 1024 * 1024; break;
+        }
+        if (multiplier != 1) {
+            text.remove_suffix(1);
+        }
+    }
+    double value = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || error != std::errc() || end != text.data() + text.size() || !std::isfinite(value)) {
+        return std::nullopt;
+    }
+    return value * multiplier;
+}
+
+// "2024-01-31", optionally followed by "T12:00" or " 12:00:00" and a "Z", as UTC seconds since the epoch
+std::optional<double> parseDate(std::string_view text) {
+    auto number = [&text](std::size_t at, std::size_t length) {
+        int value = -1;
+        auto [end, error] = std::from_chars(text.data() + at, text.data() + at + length, value);
+        return error == std::errc() && end == text.data() + at + length ? value : -1;
+    };
+    if (!text.empty() && text.back() == 'Z') {
+        text.remove_suffix(1);
+    }
+    if (text.size() < 10 || text[4] != '-' || text[7] != '-') {
+        return std::nullopt;
+    }
+    std::chrono::year_month_day date{std::chrono::year(number(0, 4)), std::chrono::month(static_cast<unsigned>(number(5, 2))),
+                                     std::chrono::day(static_cast<unsigned>(number(8, 2)))};
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+    if (text.size() > 10) {
+        if ((text[10] != 'T' && text[10] != ' ') || (text.size() != 16 && text.size() != 19) || text[13] != ':' ||
+            (text.size() == 19 && text[16] != ':')) {
+            return std::nullopt;
+        }
+        hour = number(11, 2);
+        minute = number(14, 2);
+        second = text.size() == 19 ? number(17, 2) : 0;
+    }
+    if (!date.ok() || hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60) {
+        return std::nullopt;
+    }
+    auto days = std::chrono::sys_days(date).time_since_epoch();
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::seconds>(days).count() + hour * 3600 + minute * 60 + second);
+}
+
+//Recursive-descent parser of the query syntax described on `IndexFile`.
+class QueryParser {
+public:
+    explicit QueryParser(std::string_view text) : text(text) {}
+
+    std::unique_ptr<QueryNode> parse() {
+        auto node = parseOr();
+        if (peek() != Token::End) {
+            fail("unexpected '" + std::string(text.substr(position)) + "'");
+        }
+        return node;
+    }
+
+private:
+    enum class Token { End, Word, Quoted, Compare, And, Or, Not, Open, Close };
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::invalid_argument("Invalid query: " + message);
+    }
+
+    Token peek() {
+        while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) {
+            ++position;
+        }
+        if (position == text.size()) {
+            return Token::End;
+        }
+        std::string_view rest = text.substr(position);
+        if (rest.starts_with("&&")) {
+            return Token::And;
+        }
+        if (rest.starts_with("||")) {
+            return Token::Or;
+        }
+        switch (rest[0]) {
+            case '(': return Token::Open;
+            case ')': return Token::Close;
+            case '"': return Token::Quoted;
+            case '=': case '<': case '>': return Token::Compare;
+            case '!': return rest.starts_with("!=") ? Token::Compare : Token::Not;
+            case '&': case '|': fail("expected '" + std::string(2, rest[0]) + "'");
+            default: return Token::Word;
+        }
+    }
+
+    std::string word() {
+        std::size_t start = position;
+        while (position < text.size() && !std::isspace(static_cast<unsigned char>(text[position])) &&
+               std::string_view("()\"=<>!&|").find(text[position]) == std::string_view::npos) {
+            ++position;
+        }
+        return std::string(text.substr(start, position - start));
+    }
+
+    std::string quoted() {
+        std::string value;
+        for (++position; position < text.size() && text[position] != '"'; ++position) {
+            if (text[position] == '\\' && position + 1 < text.size()) {
+                ++position;
+            }
+            value.push_back(text[position]);
+        }
+        if (position == text.size()) {
+            fail("unterminated string");
+        }
+        ++position;
+        return value;
+    }
+
+    Comparison comparison() {
+        std::string_view rest = text.substr(position);
+        static constexpr std::pair<std::string_view, Comparison> operators[] = {
+            {"==", Comparison::Equal}, {"!=", Comparison::NotEqual}, {"<=", Comparison::LessEqual},
+            {">=", Comparison::GreaterEqual}, {"=", Comparison::Equal}, {"<", Comparison::Less}, {">", Comparison::Greater}};
+        for (const auto& [symbol, value] : operators) {
+            if (rest.starts_with(symbol)) {
+                position += symbol.size();
+                return value;
+            }
+        }
+        fail("expected a comparison");
+    }
+
+    std::unique_ptr<QueryNode> combine(QueryNode::Kind kind, std::unique_ptr<QueryNode> left, std::unique_ptr<QueryNode> right) {
+        auto node = std::make_unique<QueryNode>();
+        node->kind = kind;
+        node->left = std::move(left);
+        node->right = std::move(right);
+        return node;
+    }
+
+    std::unique_ptr<QueryNode> parseOr() {
+        auto node = parseAnd();
+        while (peek() == Token::Or) {
+            position += 2;
+            node = combine(QueryNode::Kind::Or, std::move(node), parseAnd());
+        }
+        return node;
+    }
+
+    std::unique_ptr<QueryNode> parseAnd() {
+        auto node = parseUnary();
+        while (peek() == Token::And) {
+            position += 2;
+            node = combine(QueryNode::Kind::And, std::move(node), parseUnary());
+        }
+        return node;
+    }
+
+    std::unique_ptr<QueryNode> parseUnary() {
+        switch (peek()) {
+            case Token::Not:
+                ++position;
+                return combine(QueryNode::Kind::Not, parseUnary(), nullptr);
+            case Token::Open: {
+                ++position;
+                auto node = parseOr();
+                if (peek() != Token::Close) {
+                    fail("expected ')'");
+                }
+                ++position;
+                return node;
+            }
+            case Token::Word:
+                return parsePredicate();
+            case Token::End:
+                fail("unexpected end of query");
+            default:
+                fail("expected a field name at '" + std::string(text.substr(position)) + "'");
+        }
+    }
+
+    std::unique_ptr<QueryNode> parsePredicate() {
+        auto node = std::make_unique<QueryNode>();
+        node->field = word();
+        if (peek() != Token::Compare) {
+            node->kind = QueryNode::Kind::Has;
+            return node;
+        }
+        node->kind = QueryNode::Kind::Compare;
+        node->comparison = comparison();
+        Token token = peek();
+        if (token == Token::Quoted) {
+            node->value.text = quoted();
+        } else if (token == Token::Word) {
+            node->value.text = word();
+            node->value.number = parseNumber(node->value.text);
+            if (!node->value.number) {
+                node->value.number = parseDate(node->value.text);
+            }
+        } else {
+            fail("expected a value after '" + node->field + "'");
+        }
+        return node;
+    }
+
+    std::string_view text;
+    std::size_t position = 0;
+};
+
+template <typename T>
+bool compare(const T& left, Comparison comparison, const T& right) {
+    switch (comparison) {
+        case Comparison::Equal:        return left == right;
+        case Comparison::NotEqual:     return left != right;
+        case Comparison::Less:         return left < right;
+        case Comparison::LessEqual:    return left <= right;
+        case Comparison::Greater:      return left > right;
+        case Comparison::GreaterEqual: return left >= right;
+    }
+    return false;
+}
+
+//The comparison rules of `IndexFile`, applied to one stored value. `NotEqual` is handled by the caller.
+bool matches(const MetadataValue& value, Comparison comparison, const Literal& literal) {
+    if (auto number = numericValue(value)) {
+        return literal.number && compare(*number, comparison, *literal.number);
+    }
+    if (!isText(value) || (comparison != Comparison::Equal && literal.number)) {
+        return false;
+    }
+    return compare(textOf(value), comparison, std::string_view(literal.text));
+}
+
+}
+
+IndexSink::IndexSink(std::FILE* out) : OutputSink(out) {
+    buffer.append(IndexMagic, sizeof(IndexMagic));
+    appendU32(buffer, IndexFormatVersion);
+    appendU32(buffer, 0);
+}
+
+void IndexSink::pad() {
+    buffer.append(padded(position()) - position(), '\0');
+}
+
+void IndexSink::spill() {
+    if (buffer.size() >= FlushThreshold) {
+        flushedBytes += buffer.size();
+        flush(false);
+    }
+}
+
+void IndexSink::write(const OutputRecord& record) {
+    if (recordOffsets.size() == std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("IndexSink: too many records for one index");
+    }
+    auto number = static_cast<uint32_t>(recordOffsets.size());
+    recordOffsets.push_back(position());
+    fileTypes.push_back(static_cast<uint8_t>(record.fileType));
+
+    appendU32(buffer, static_cast<uint32_t>(record.path.size()));
+    buffer += record.path;
+    appendCachedRecord(buffer, CacheKey{}, record.fileType, record.metadata);
+    pad();
+
+    for (const auto& [key, value] : record.metadata) {
+        auto field = std::find(IndexedFields.begin(), IndexedFields.end(), key.view());
+        if (field == IndexedFields.end()) {
+            continue;
+        }
+        FieldEntries& entries = fields[static_cast<std::size_t>(field - IndexedFields.begin())];
+        if (auto numeric = numericValue(value); numeric && !std::isnan(*numeric)) {
+            entries.numbers.emplace_back(*numeric, number);
+        } else if (isText(value)) {
+            entries.texts.emplace_back(std::string(textOf(value)), number);
+        }
+    }
+    spill();
+}
+
+void IndexSink::writeField(std::string_view name, FieldEntries& entries) {
+    std::sort(entries.numbers.begin(), entries.numbers.end());
+    std::sort(entries.texts.begin(), entries.texts.end());
+
+    // Distinct values and where their runs start; the record numbers follow in sorted order
+    auto runs = [](const auto& sorted) {
+        std::vector<uint32_t> starts;
+        for (std::size_t i = 0; i < sorted.size(); ++i) {
+            if (i == 0 || sorted[i].first != sorted[i - 1].first) {
+                starts.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        starts.push_back(static_cast<uint32_t>(sorted.size()));
+        return starts;
+    };
+    std::vector<uint32_t> numberRuns = runs(entries.numbers);
+    std::vector<uint32_t> textRuns = runs(entries.texts);
+    std::size_t numberCount = numberRuns.size() - 1;
+    std::size_t textCount = textRuns.size() - 1;
+    std::size_t textBytes = 0;
+    for (std::size_t i = 0; i < textCount; ++i) {
+        textBytes += entries.texts[textRuns[i]].first.size();
+    }
+
+    std::size_t length = 4 + name.size() +
+                         16 + 8 * numberCount + 4 * (numberCount + 1) + 4 * entries.numbers.size() +
+                         16 + 8 * (textCount + 1) + textBytes + 4 * (textCount + 1) + 4 * entries.texts.size();
+    appendU64(buffer, padded(length));
+    appendU32(buffer, static_cast<uint32_t>(name.size()));
+    buffer += name;
+
+    appendU64(buffer, numberCount);
+    appendU64(buffer, entries.numbers.size());
+    for (std::size_t i = 0; i < numberCount; ++i) {
+        appendU64(buffer, std::bit_cast<uint64_t>(entries.numbers[numberRuns[i]].first));
+    }
+    for (uint32_t start : numberRuns) {
+        appendU32(buffer, start);
+    }
+    for (const auto& entry : entries.numbers) {
+        appendU32(buffer, entry.second);
+        spill();
+    }
+
+    appendU64(buffer, textCount);
+    appendU64(buffer, entries.texts.size());
+    uint64_t textOffset = 0;
+    for (std::size_t i = 0; i < textCount; ++i) {
+        appendU64(buffer, textOffset);
+        textOffset += entries.texts[textRuns[i]].first.size();
+    }
+    appendU64(buffer, textOffset);
+    for (std::size_t i = 0; i < textCount; ++i) {
+        buffer += entries.texts[textRuns[i]].first;
+        spill();
+    }
+    for (uint32_t start : textRuns) {
+        appendU32(buffer, start);
+    }
+    for (const auto& entry : entries.texts) {
+        appendU32(buffer, entry.second);
+        spill();
+    }
+    pad();
+
+    entries = FieldEntries();
+}
+
+void IndexSink::finish() {
+    uint64_t offsetsOffset = position();
+    for (uint64_t offset : recordOffsets) {
+        appendU64(buffer, offset);
+        spill();
+    }
+
+    uint64_t typesOffset = position();
+    std::vector<uint64_t> bitmap(wordCount(fileTypes.size()));
+    for (std::size_t type = 0; type < FileTypeCount; ++type) {
+        std::fill(bitmap.begin(), bitmap.end(), 0);
+        for (std::size_t i = 0; i < fileTypes.size(); ++i) {
+            if (fileTypes[i] == type) {
+                bitmap[i >> 6] |= uint64_t{1} << (i & 63);
+            }
+        }
+        for (uint64_t word : bitmap) {
+            appendU64(buffer, word);
+            spill();
+        }
+    }
+
+    uint64_t fieldsOffset = position();
+    for (std::size_t i = 0; i < IndexedFields.size(); ++i) {
+        writeField(IndexedFields[i], fields[i]);
+    }
+
+    appendU64(buffer, recordOffsets.size());
+    appendU64(buffer, offsetsOffset);
+    appendU64(buffer, typesOffset);
+    appendU64(buffer, fieldsOffset);
+    appendU64(buffer, IndexedFields.size());
+    buffer.append(FooterMagic, sizeof(FooterMagic));
+    flush();
+}
+
+IndexFile::IndexFile(const std::filesystem::path& indexPath) {
+    int fd = ::open(indexPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error(indexPath.string() + ": " + std::strerror(errno));
+    }
+    struct stat fileStat;
+    if (::fstat(fd, &fileStat) == 0 && static_cast<std::size_t>(fileStat.st_size) >= FileHeaderSize + FooterSize) {
+        void* address = ::mmap(nullptr, static_cast<std::size_t>(fileStat.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (address != MAP_FAILED) {
+            mapping = static_cast<const uint8_t*>(address);
+            mappingSize = static_cast<std::size_t>(fileStat.st_size);
+        }
+    }
+    ::close(fd);
+
+    try {
+        ByteReader reader({mapping, mappingSize});
+        std::size_t footer = mappingSize - FooterSize;
+        if (!mapping || !reader.matches(0, std::string_view(IndexMagic, sizeof(IndexMagic))) ||
+            reader.u32le(8) != IndexFormatVersion ||
+            !reader.matches(footer + 40, std::string_view(FooterMagic, sizeof(FooterMagic)))) {
+            throw std::out_of_range("bad magic");
+        }
+        recordCount = reader.u64le(footer);
+        offsetsOffset = reader.u64le(footer + 8);
+        typesOffset = reader.u64le(footer + 16);
+        uint64_t fieldOffset = reader.u64le(footer + 24);
+        uint64_t fieldCount = reader.u64le(footer + 32);
+        if (recordCount > std::numeric_limits<uint32_t>::max() || !reader.has(offsetsOffset, recordCount * 8) ||
+            !reader.has(typesOffset, FileTypeCount * wordCount(recordCount) * 8)) {
+            throw std::out_of_range("bad sections");
+        }
+
+        // Every array is bounds-checked here, so queries can load from them unchecked; the offsets stored
+        // in them are clamped where they are used
+        auto part = [&reader](std::size_t& offset, bool text) {
+            FieldIndex::Part result;
+            result.distinct = reader.u64le(offset);
+            result.entries = reader.u64le(offset + 8);
+            if (result.distinct > reader.size() || result.entries > reader.size() || result.distinct > result.entries) {
+                throw std::out_of_range("bad field");
+            }
+            offset += 16;
+            result.values = reader.bytes(offset, (result.distinct + (text ? 1 : 0)) * 8).data();
+            offset += (result.distinct + (text ? 1 : 0)) * 8;
+            if (text) {
+                result.textSize = loadU64(result.values + result.distinct * 8);
+                result.text = reader.bytes(offset, result.textSize).data();
+                offset += result.textSize;
+            }
+            result.runStart = reader.bytes(offset, (result.distinct + 1) * 4).data();
+            offset += (result.distinct + 1) * 4;
+            result.records = reader.bytes(offset, result.entries * 4).data();
+            offset += result.entries * 4;
+            return result;
+        };
+        for (uint64_t i = 0; i < fieldCount; ++i) {
+            uint64_t length = reader.u64le(fieldOffset);
+            std::size_t offset = fieldOffset + 8;
+            std::size_t end = offset + reader.bytes(offset, length).size();
+            FieldIndex field;
+            uint32_t nameLength = reader.u32le(offset);
+            field.name = reader.chars(offset + 4, nameLength);
+            offset += 4 + nameLength;
+            field.numbers = part(offset, false);
+            field.texts = part(offset, true);
+            if (offset > end) {
+                throw std::out_of_range("bad field length");
+            }
+            fieldIndexes.push_back(field);
+            fieldOffset = end;
+        }
+    } catch (const std::out_of_range&) {
+        if (mapping) {
+            ::munmap(const_cast<uint8_t*>(mapping), mappingSize);
+        }
+        throw std::runtime_error(indexPath.string() + ": not a complete metadata index");
+    }
+}
+
+IndexFile::~IndexFile() {
+    ::munmap(const_cast<uint8_t*>(mapping), mappingSize);
+}
+
+OutputRecord IndexFile::record(uint32_t number) const {
+    ByteReader reader({mapping, mappingSize});
+    if (number >= recordCount) {
+        throw std::out_of_range("IndexFile: no record " + std::to_string(number));
+    }
+    std::size_t offset = reader.u64le(offsetsOffset + std::size_t{number} * 8);
+    uint32_t pathLength = reader.u32le(offset);
+    std::string_view path = reader.chars(offset + 4, pathLength);
+    offset += 4 + pathLength;
+    std::size_t length = CachedRecord::HeaderSize + reader.u32le(offset + CachedRecord::PayloadSizeOffset);
+    CachedRecord cached(reader.bytes(offset, length));
+    return OutputRecord{std::string(path), cached.fileType(), cached.toMap()};
+}
+
+//Turns each node of a query into the bitmap of the records it matches.
+class IndexFile::Evaluator {
+public:
+    explicit Evaluator(const IndexFile& index) : index(index) {}
+
+    Bitmap evaluate(const QueryNode& node) const {
+        switch (node.kind) {
+            case QueryNode::Kind::And: {
+                Bitmap result = evaluate(*node.left);
+                result.intersect(evaluate(*node.right));
+                return result;
+            }
+            case QueryNode::Kind::Or: {
+                Bitmap result = evaluate(*node.left);
+                result.unite(evaluate(*node.right));
+                return result;
+            }
+            case QueryNode::Kind::Not: {
+                Bitmap result = evaluate(*node.left);
+                result.invert();
+                return result;
+            }
+            case QueryNode::Kind::Has:
+                return has(node.field);
+            case QueryNode::Kind::Compare:
+                break;
+        }
+
+        if (node.comparison == Comparison::NotEqual) {
+            // Present and not equal: a record lacking the field matches neither
+            Bitmap equal = compareField(node.field, Comparison::Equal, node.value);
+            equal.invert();
+            equal.intersect(has(node.field));
+            return equal;
+        }
+        return compareField(node.field, node.comparison, node.value);
+    }
+
+private:
+    const FieldIndex* indexed(std::string_view field) const {
+        for (const auto& fieldIndex : index.fieldIndexes) {
+            if (fieldIndex.name == field) {
+                return &fieldIndex;
+            }
+        }
+        return nullptr;
+    }
+
+    Bitmap has(std::string_view field) const {
+        Bitmap result(index.recordCount);
+        if (field == "FileType" || field == "Path") {
+            result.setAll();
+        } else if (const FieldIndex* fieldIndex = indexed(field)) {
+            addRuns(result, fieldIndex->numbers, 0, fieldIndex->numbers.distinct);
+            addRuns(result, fieldIndex->texts, 0, fieldIndex->texts.distinct);
+        } else {
+            scan(result, field, [](const MetadataValue& value) { return value.kind() != MetadataValue::Kind::Empty; });
+        }
+        return result;
+    }
+
+    Bitmap compareField(std::string_view field, Comparison comparison, const Literal& literal) const {
+        Bitmap result(index.recordCount);
+        if (field == "FileType") {
+            if (comparison != Comparison::Equal) {
+                throw std::invalid_argument("Invalid query: FileType supports only = and !=");
+            }
+            for (std::size_t type = 0; type < FileTypeCount; ++type) {
+                std::string_view name = fileTypeName(static_cast<FileType>(type));
+                if (std::equal(name.begin(), name.end(), literal.text.begin(), literal.text.end(), [](char a, char b) {
+                        return std::toupper(static_cast<unsigned char>(a)) == std::toupper(static_cast<unsigned char>(b));
+                    })) {
+                    result.assign(index.mapping + index.typesOffset + type * wordCount(index.recordCount) * 8);
+                    return result;
+                }
+            }
+            throw std::invalid_argument("Invalid query: unknown file type '" + literal.text + "'");
+        }
+        if (field == "Path") {
+            ByteReader reader({index.mapping, index.mappingSize});
+            for (uint32_t record = 0; record < index.recordCount; ++record) {
+                std::size_t offset = reader.u64le(index.offsetsOffset + std::size_t{record} * 8);
+                if (compare(reader.chars(offset + 4, reader.u32le(offset)), comparison, std::string_view(literal.text))) {
+                    result.set(record);
+                }
+            }
+            return result;
+        }
+        if (const FieldIndex* fieldIndex = indexed(field)) {
+            if (literal.number) {
+                const auto& part = fieldIndex->numbers;
+                auto [lower, upper] = equalRange(part, [&part, &literal](uint64_t i) {
+                    double value = loadF64(part.values + i * 8);
+                    return value < *literal.number ? -1 : value > *literal.number ? 1 : 0;
+                });
+                addComparison(result, part, comparison, lower, upper);
+            }
+            if (!literal.number || comparison == Comparison::Equal) {
+                const auto& part = fieldIndex->texts;
+                auto [lower, upper] = equalRange(part, [&part, &literal](uint64_t i) {
+                    uint64_t end = std::min(loadU64(part.values + (i + 1) * 8), part.textSize);
+                    uint64_t begin = std::min(loadU64(part.values + i * 8), end);
+                    std::string_view value(reinterpret_cast<const char*>(part.text) + begin, end - begin);
+                    int order = value.compare(literal.text);
+                    return order < 0 ? -1 : order > 0 ? 1 : 0;
+                });
+                addComparison(result, part, comparison, lower, upper);
+            }
+            return result;
+        }
+        scan(result, field, [comparison, &literal](const MetadataValue& value) { return matches(value, comparison, literal); });
+        return result;
+    }
+
+    //The distinct values equal to the literal, as [lower, upper); `order(i)` compares value i with it.
+    template <typename Order>
+    static std::pair<uint64_t, uint64_t> equalRange(const FieldIndex::Part& part, Order order) {
+        uint64_t lower = 0;
+        for (uint64_t count = part.distinct; count > 0;) {
+            uint64_t step = count / 2;
+            if (order(lower + step) < 0) {
+                lower += step + 1;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+        // Distinct values are unique, so at most one is equal
+        uint64_t upper = lower < part.distinct && order(lower) == 0 ? lower + 1 : lower;
+        return {lower, upper};
+    }
+
+    static void addComparison(Bitmap& result, const FieldIndex::Part& part, Comparison comparison, uint64_t lower, uint64_t upper) {
+        switch (comparison) {
+            case Comparison::Equal:        addRuns(result, part, lower, upper); break;
+            case Comparison::Less:         addRuns(result, part, 0, lower); break;
+            case Comparison::LessEqual:    addRuns(result, part, 0, upper); break;
+            case Comparison::Greater:      addRuns(result, part, upper, part.distinct); break;
+            case Comparison::GreaterEqual: addRuns(result, part, lower, part.distinct); break;
+            case Comparison::NotEqual:     break;
+        }
+    }
+
+    //Adds the records holding distinct values [first, last).
+    static void addRuns(Bitmap& result, const FieldIndex::Part& part, uint64_t first, uint64_t last) {
+        if (first >= last) {
+            return;
+        }
+        uint64_t end = std::min<uint64_t>(loadU32(part.runStart + last * 4), part.entries);
+        uint64_t begin = std::min<uint64_t>(loadU32(part.runStart + first * 4), end);
+        for (uint64_t i = begin; i < end; ++i) {
+            result.set(loadU32(part.records + i * 4));
+        }
+    }
+
+    //Tests the first value of `field` in every stored record.
+    template <typename Predicate>
+    void scan(Bitmap& result, std::string_view field, Predicate predicate) const {
+        ByteReader reader({index.mapping, index.mappingSize});
+        for (uint32_t record = 0; record < index.recordCount; ++record) {
+            std::size_t offset = reader.u64le(index.offsetsOffset + std::size_t{record} * 8);
+            offset += 4 + reader.u32le(offset);
+            std::size_t length = CachedRecord::HeaderSize + reader.u32le(offset + CachedRecord::PayloadSizeOffset);
+            bool found = false;
+            bool matched = false;
+            CachedRecord(reader.bytes(offset, length)).forEach([&](std::string_view key, const MetadataValue& value) {
+                if (!found && key == field) {
+                    found = true;
+                    matched = predicate(value);
+                }
+            });
+            if (matched) {
+                result.set(record);
+            }
+        }
+    }
+
+    const IndexFile& index;
+};
+
+std::vector<uint32_t> IndexFile::query(std::string_view expression) const {
+    auto root = QueryParser(expression).parse();
+    return Evaluator(*this).evaluate(*root).members();
+}
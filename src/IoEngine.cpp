@@ -0,0 +1,606 @@
+#include "IoEngine.h"
+#include "DeviceScheduler.h"
+#include "StageStats.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+//Reads up to `length` bytes from the start of the file, retrying short reads.
+std::size_t readPrefix(int fd, std::uint8_t* buffer, std::size_t length) {
+    std::size_t filled = 0;
+    while (filled < length) {
+        ssize_t n = ::pread(fd, buffer + filled, length - filled, static_cast<off_t>(filled));
+        FILEMETA_COUNT_IO(1, n > 0 ? static_cast<uint64_t>(n) : 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        filled += static_cast<std::size_t>(n);
+    }
+    return filled;
+}
+
+//How much of a file to prefetch: the prefix of regular files, nothing for anything else.
+std::size_t prefixLength(const struct stat& status, std::size_t prefixSize) {
+    return S_ISREG(status.st_mode) ? std::min<std::uint64_t>(prefixSize, static_cast<std::uint64_t>(status.st_size)) : 0;
+}
+
+void statxToStat(const struct statx& in, struct stat& out) {
+    out = {};
+    out.st_dev = makedev(in.stx_dev_major, in.stx_dev_minor);
+    out.st_ino = in.stx_ino;
+    out.st_mode = in.stx_mode;
+    out.st_nlink = in.stx_nlink;
+    out.st_uid = in.stx_uid;
+    out.st_gid = in.stx_gid;
+    out.st_rdev = makedev(in.stx_rdev_major, in.stx_rdev_minor);
+    out.st_size = static_cast<off_t>(in.stx_size);
+    out.st_blksize = in.stx_blksize;
+    out.st_blocks = static_cast<blkcnt_t>(in.stx_blocks);
+    out.st_atim = {in.stx_atime.tv_sec, in.stx_atime.tv_nsec};
+    out.st_mtim = {in.stx_mtime.tv_sec, in.stx_mtime.tv_nsec};
+    out.st_ctim = {in.stx_ctime.tv_sec, in.stx_ctime.tv_nsec};
+}
+
+/**
+ * @brief Blocking fallback: each path is stat'ed, then opened and read, by a pool of I/O threads.
+ *
+ * Between the stat and the open each file is parked in a `DeviceScheduler`, so every device keeps as
+ * many of the pool's threads busy as its read latency shows it can serve.
+ */
+class ThreadPoolIoEngine : public IoEngine {
+public:
+    ThreadPoolIoEngine(IoEngineOptions options, Completion onComplete, NeedContents needContents)
+        : IoEngine(options, std::move(onComplete), std::move(needContents)), scheduler(options.fallbackThreads),
+          pool(options.fallbackThreads) {}
+
+    // Finishes every queued path before the pool is joined
+    ~ThreadPoolIoEngine() override {
+        pool.wait();
+    }
+
+    void submit(std::vector<std::filesystem::path> paths) override {
+        begin(paths.size());
+        for (auto& path : paths) {
+            pool.submit([this, path = std::move(path)] { statFile(path); });
+        }
+    }
+
+    IoBackend backend() const override {
+        return IoBackend::Threads;
+    }
+
+private:
+    void statFile(const std::filesystem::path& path) {
+        auto file = std::make_unique<PrefetchedFile>();
+        file->path = path;
+        FILEMETA_COUNT_IO(1);
+        if (::stat(path.c_str(), &file->status) != 0) {
+            file->error = errno;
+        } else if (needsContents(*file)) {
+            dev_t device = file->status.st_dev;
+            ino_t inode = file->status.st_ino;
+            std::lock_guard<std::mutex> lock(schedulerMutex);
+            scheduler.push(device, inode, file.release());
+            releaseReady();
+            return;
+        }
+        finish(std::move(*file));
+    }
+
+    void readFile(std::unique_ptr<PrefetchedFile> file) {
+        auto started = std::chrono::steady_clock::now();
+        std::optional<std::uint64_t> latency;
+        FILEMETA_COUNT_IO(1);
+        file->fd = ::open(file->path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file->fd < 0) {
+            file->error = errno;
+            dropDescriptor();
+        } else {
+            file->prefix.resize(prefixLength(file->status, options.prefixSize));
+            file->prefix.resize(readPrefix(file->fd, file->prefix.data(), file->prefix.size()));
+            if (!file->prefix.empty()) {
+                latency = static_cast<std::uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count());
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(schedulerMutex);
+            scheduler.complete(file->status.st_dev, latency);
+            if (latency) {
+                FILEMETA_DEVICE_READ(file->status.st_dev, scheduler.rotational(file->status.st_dev),
+                                     scheduler.limit(file->status.st_dev), *latency);
+            }
+            releaseReady();
+        }
+        finish(std::move(*file));
+    }
+
+    void descriptorReleased() override {
+        std::lock_guard<std::mutex> lock(schedulerMutex);
+        releaseReady();
+    }
+
+    // Hands every parked file whose device has room to the pool, while descriptors are left; `schedulerMutex` must be held
+    void releaseReady() {
+        while (acquireDescriptor()) {
+            std::optional<DeviceScheduler<PrefetchedFile*>::Release> next = scheduler.pop();
+            if (!next) {
+                dropDescriptor();
+                break;
+            }
+            pool.submit([this, file = next->item] { readFile(std::unique_ptr<PrefetchedFile>(file)); });
+        }
+    }
+
+    std::mutex schedulerMutex;
+    DeviceScheduler<PrefetchedFile*> scheduler;
+    ThreadPool pool;
+};
+
+/**
+ * @brief io_uring backend driven through the raw `io_uring_setup`/`io_uring_enter` system calls.
+ *
+ * One engine thread owns the ring. Every file moves through three linked-by-hand steps, each a single
+ * SQE: statx, then openat, then a read of the prefix. Up to `queueDepth` files are in flight at once, so
+ * the devices always have deep queues while only one thread waits on them. Between the statx and the
+ * openat each file is parked in a `DeviceScheduler`, which lets every device have only as many reads
+ * outstanding as its latency shows it can serve in parallel, and stays parked while the engine holds
+ * `maxOpenFiles` descriptors. Submitters and released descriptors wake the engine thread through an
+ * eventfd whose read is kept armed in the ring.
+ */
+class UringIoEngine : public IoEngine {
+public:
+    UringIoEngine(IoEngineOptions options, Completion onComplete, NeedContents needContents)
+        : IoEngine(options, std::move(onComplete), std::move(needContents)) {
+        depth = std::max<std::size_t>(options.queueDepth, 1);
+        setupRing(static_cast<unsigned>(depth + 1)); // + the eventfd read
+        wakeFd = ::eventfd(0, EFD_CLOEXEC);
+        if (wakeFd < 0) {
+            int error = errno;
+            releaseRing();
+            throw std::runtime_error(std::string("eventfd: ") + std::strerror(error));
+        }
+        engineThread = std::thread([this] { run(); });
+    }
+
+    // Completes every queued path, then tears the ring down
+    ~UringIoEngine() override {
+        {
+            std::lock_guard<std::mutex> lock(incomingMutex);
+            stopping = true;
+        }
+        wake();
+        engineThread.join();
+        ::close(wakeFd);
+        releaseRing();
+    }
+
+    void submit(std::vector<std::filesystem::path> paths) override {
+        begin(paths.size());
+        {
+            std::lock_guard<std::mutex> lock(incomingMutex);
+            for (auto& path : paths) {
+                incoming.push_back(std::move(path));
+            }
+        }
+        wake();
+    }
+
+    IoBackend backend() const override {
+        return IoBackend::Uring;
+    }
+
+private:
+    //One file on its way through statx -> openat -> read.
+    struct Request {
+        enum class Step { Stat, Open, Read } step = Step::Stat;
+        PrefetchedFile file;
+        struct statx statxBuffer {};
+        bool released = false;          // by the scheduler, which must hear of its completion
+        std::chrono::steady_clock::time_point releasedAt;
+    };
+
+    static constexpr std::uint64_t WakeTag = 0;
+    // Stat'ed files that may wait for their device per ring slot: enough for a fast device to run ahead of
+    // a slow one's backlog and for a spinning disk's inode sort to see past one directory, few enough that
+    // their stat results are still cached when they are opened
+    static constexpr std::size_t ParkedPerSlot = 4;
+
+    void setupRing(unsigned entries) {
+        io_uring_params params{};
+        ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (ringFd < 0) {
+            throw std::runtime_error(std::string("io_uring_setup: ") + std::strerror(errno));
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+
+        sqRing = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        cqRing = singleMap ? sqRing
+                           : ::mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqesMap = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqesMap == MAP_FAILED) {
+            int error = errno;
+            sqes = sqesMap == MAP_FAILED ? nullptr : static_cast<io_uring_sqe*>(sqesMap);
+            releaseRing();
+            throw std::runtime_error(std::string("io_uring mmap: ") + std::strerror(error));
+        }
+        sqes = static_cast<io_uring_sqe*>(sqesMap);
+
+        auto* sq = static_cast<std::uint8_t*>(sqRing);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        auto* cq = static_cast<std::uint8_t*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    void releaseRing() {
+        if (sqes) {
+            ::munmap(sqes, sqesSize);
+        }
+        if (cqRing && cqRing != MAP_FAILED && cqRing != sqRing) {
+            ::munmap(cqRing, cqRingSize);
+        }
+        if (sqRing && sqRing != MAP_FAILED) {
+            ::munmap(sqRing, sqRingSize);
+        }
+        if (ringFd >= 0) {
+            ::close(ringFd);
+        }
+    }
+
+    void wake() {
+        std::uint64_t one = 1;
+        [[maybe_unused]] ssize_t written = ::write(wakeFd, &one, sizeof(one));
+    }
+
+    //Claims the next SQE. The ring has room for every file in flight plus the eventfd read, so it never runs out.
+    io_uring_sqe* nextSqe(std::uint8_t opcode, int fd, const void* address, unsigned length, std::uint64_t offset, std::uint64_t tag) {
+        unsigned index = sqLocalTail & sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<std::uint64_t>(address);
+        sqe->len = length;
+        sqe->off = offset;
+        sqe->user_data = tag;
+        sqArray[index] = index;
+        ++sqLocalTail;
+        ++unsubmitted;
+        return sqe;
+    }
+
+    void armWake() {
+        nextSqe(IORING_OP_READ, wakeFd, &wakeCounter, sizeof(wakeCounter), 0, WakeTag);
+    }
+
+    void queueStep(Request* request) {
+        auto tag = reinterpret_cast<std::uint64_t>(request);
+        const char* path = request->file.path.c_str();
+        switch (request->step) {
+            case Request::Step::Stat:
+                nextSqe(IORING_OP_STATX, AT_FDCWD, path, STATX_BASIC_STATS, reinterpret_cast<std::uint64_t>(&request->statxBuffer), tag)
+                    ->statx_flags = 0;
+                break;
+            case Request::Step::Open:
+                nextSqe(IORING_OP_OPENAT, AT_FDCWD, path, 0, 0, tag)->open_flags = O_RDONLY | O_CLOEXEC;
+                break;
+            case Request::Step::Read:
+                nextSqe(IORING_OP_READ, request->file.fd, request->file.prefix.data(),
+                        static_cast<unsigned>(request->file.prefix.size()), 0, tag);
+                break;
+        }
+    }
+
+    //Finishes a request or queues its next step, given the result of the current one.
+    void advance(Request* request, int result) {
+        PrefetchedFile& file = request->file;
+        bool done = true;
+        if (result < 0) {
+            file.error = -result;
+            if (request->step != Request::Step::Stat) {
+                dropDescriptor();
+            }
+            if (file.fd >= 0) {
+                ::close(file.fd);
+                file.fd = -1;
+            }
+        } else if (request->step == Request::Step::Stat) {
+            statxToStat(request->statxBuffer, file.status);
+            if (needsContents(file)) {
+                // Parked until its device has room, which may be right away
+                request->step = Request::Step::Open;
+                scheduler.push(file.status.st_dev, file.status.st_ino, request);
+                releaseParked();
+                return;
+            }
+        } else if (request->step == Request::Step::Open) {
+            file.fd = result;
+            file.prefix.resize(prefixLength(file.status, options.prefixSize));
+            if (!file.prefix.empty()) {
+                request->step = Request::Step::Read;
+                done = false;
+            }
+        } else {
+            // A short read only happens when the file shrank since the statx
+            file.prefix.resize(static_cast<std::size_t>(result));
+            FILEMETA_COUNT_IO(0, static_cast<uint64_t>(result));
+        }
+
+        if (done) {
+            if (request->released) {
+                std::optional<std::uint64_t> latency;
+                if (request->step == Request::Step::Read && result > 0) {
+                    latency = static_cast<std::uint64_t>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - request->releasedAt).count());
+                }
+                scheduler.complete(file.status.st_dev, latency);
+                if (latency) {
+                    FILEMETA_DEVICE_READ(file.status.st_dev, scheduler.rotational(file.status.st_dev),
+                                         scheduler.limit(file.status.st_dev), *latency);
+                }
+            }
+            --inFlight;
+            finish(std::move(file));
+            delete request;
+            releaseParked();
+        } else {
+            queueStep(request);
+        }
+    }
+
+    void descriptorReleased() override {
+        wake();
+    }
+
+    //Queues the open of parked files whose device has room, while the ring and the descriptor cap have room.
+    void releaseParked() {
+        while (inFlight - scheduler.parked() < depth && acquireDescriptor()) {
+            std::optional<DeviceScheduler<Request*>::Release> next = scheduler.pop();
+            if (!next) {
+                dropDescriptor();
+                break;
+            }
+            next->item->released = true;
+            next->item->releasedAt = std::chrono::steady_clock::now();
+            queueStep(next->item);
+        }
+    }
+
+    // An engine thread that stops leaves its files uncompleted, so the error goes to `wait` instead of
+    // terminating the process. Requests still in the ring are leaked: the kernel may yet write to them.
+    void run() {
+        try {
+            runRing();
+        } catch (...) {
+            fail(std::current_exception());
+        }
+    }
+
+    void runRing() {
+        std::deque<std::filesystem::path> waiting;
+        armWake();
+        while (true) {
+            bool stop;
+            {
+                std::lock_guard<std::mutex> lock(incomingMutex);
+                for (auto& path : incoming) {
+                    waiting.push_back(std::move(path));
+                }
+                incoming.clear();
+                stop = stopping;
+            }
+            if (stop && waiting.empty() && inFlight == 0) {
+                break;
+            }
+
+            // Woken by a released descriptor, parked files may now be opened
+            releaseParked();
+
+            // Completions release parked files as they free room; new stats fill what is left of the ring
+            while (!waiting.empty() && inFlight - scheduler.parked() < depth && scheduler.parked() < depth * ParkedPerSlot) {
+                auto* request = new Request;
+                request->file.path = std::move(waiting.front());
+                waiting.pop_front();
+                ++inFlight;
+                queueStep(request);
+            }
+
+            std::atomic_ref<unsigned>(*sqTail).store(sqLocalTail, std::memory_order_release);
+            FILEMETA_COUNT_IO(1);
+            int entered = static_cast<int>(::syscall(__NR_io_uring_enter, ringFd, unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (entered < 0) {
+                if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    // Only reachable through a malformed SQE or ring; nothing would ever complete, so `run` hands it to `wait`
+                    throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+                }
+                entered = 0;
+            }
+            unsubmitted -= static_cast<unsigned>(entered);
+            reap();
+        }
+    }
+
+    void reap() {
+        std::atomic_ref<unsigned> head(*cqHead);
+        std::atomic_ref<unsigned> tail(*cqTail);
+        unsigned current = head.load(std::memory_order_relaxed);
+        unsigned last = tail.load(std::memory_order_acquire);
+        for (; current != last; ++current) {
+            const io_uring_cqe& cqe = cqes[current & cqMask];
+            std::uint64_t tag = cqe.user_data;
+            int result = cqe.res;
+            // Release the slot before advancing, which may queue new SQEs
+            head.store(current + 1, std::memory_order_release);
+            if (tag == WakeTag) {
+                armWake();
+            } else {
+                advance(reinterpret_cast<Request*>(tag), result);
+            }
+        }
+    }
+
+    std::size_t depth = 0;
+    int ringFd = -1;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    std::size_t sqRingSize = 0;
+    std::size_t cqRingSize = 0;
+    std::size_t sqesSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    unsigned sqLocalTail = 0;  // tail including SQEs not yet published
+    unsigned unsubmitted = 0;  // SQEs published but not yet consumed by io_uring_enter
+    std::size_t inFlight = 0;  // files admitted from `waiting`, parked ones included; the rest own an SQE or CQE (engine thread only)
+    DeviceScheduler<Request*> scheduler{options.queueDepth};
+
+    int wakeFd = -1;
+    std::uint64_t wakeCounter = 0;
+    std::mutex incomingMutex;
+    std::vector<std::filesystem::path> incoming;
+    bool stopping = false;
+    std::thread engineThread;
+};
+
+}
+
+IoBackend parseIoBackend(std::string_view name) {
+    if (name == "auto") {
+        return IoBackend::Auto;
+    }
+    if (name == "uring") {
+        return IoBackend::Uring;
+    }
+    if (name == "threads") {
+        return IoBackend::Threads;
+    }
+    if (name == "blocking") {
+        return IoBackend::Blocking;
+    }
+    throw std::invalid_argument("Unknown I/O backend: " + std::string(name));
+}
+
+const char* ioBackendName(IoBackend backend) {
+    switch (backend) {
+        case IoBackend::Auto:     return "auto";
+        case IoBackend::Uring:    return "uring";
+        case IoBackend::Threads:  return "threads";
+        case IoBackend::Blocking: return "blocking";
+    }
+    return "unknown";
+}
+
+std::size_t defaultMaxOpenFiles() {
+    struct rlimit limit {};
+    if (::getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) {
+        return 4096;
+    }
+    return std::max<std::size_t>(static_cast<std::size_t>(limit.rlim_cur) / 2, 1);
+}
+
+IoEngine::IoEngine(IoEngineOptions options, Completion onComplete, NeedContents needContents)
+    : options(options), onComplete(std::move(onComplete)), needContents(std::move(needContents)) {}
+
+bool IoEngine::wait() {
+    std::unique_lock<std::mutex> lock(outstandingMutex);
+    bool hadOutstanding = outstanding != 0;
+    drained.wait(lock, [this] { return outstanding == 0 || failure; });
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+    return hadOutstanding;
+}
+
+void IoEngine::releaseDescriptor() {
+    --openDescriptors;
+    descriptorReleased();
+}
+
+bool IoEngine::acquireDescriptor() {
+    // Only ever called by one thread at a time (the ring's thread, or under the scheduler's mutex), so
+    // checking and counting need not be one atomic step; releases only make room
+    if (openDescriptors.load() >= options.maxOpenFiles) {
+        return false;
+    }
+    ++openDescriptors;
+    return true;
+}
+
+void IoEngine::begin(std::size_t count) {
+    std::lock_guard<std::mutex> lock(outstandingMutex);
+    outstanding += count;
+}
+
+void IoEngine::finish(PrefetchedFile&& file) {
+    onComplete(std::move(file));
+    std::lock_guard<std::mutex> lock(outstandingMutex);
+    if (--outstanding == 0) {
+        drained.notify_all();
+    }
+}
+
+void IoEngine::fail(std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(outstandingMutex);
+    failure = error;
+    drained.notify_all();
+}
+
+std::unique_ptr<IoEngine> makeIoEngine(IoBackend backend, IoEngineOptions options,
+                                       IoEngine::Completion onComplete, IoEngine::NeedContents needContents) {
+    switch (backend) {
+        case IoBackend::Auto:
+            try {
+                return std::make_unique<UringIoEngine>(options, onComplete, needContents);
+            } catch (const std::runtime_error&) {
+                // io_uring missing or disabled (old kernel, seccomp, io_uring_disabled sysctl)
+                return std::make_unique<ThreadPoolIoEngine>(options, std::move(onComplete), std::move(needContents));
+            }
+        case IoBackend::Uring:
+            return std::make_unique<UringIoEngine>(options, std::move(onComplete), std::move(needContents));
+        case IoBackend::Threads:
+            return std::make_unique<ThreadPoolIoEngine>(options, std::move(onComplete), std::move(needContents));
+        case IoBackend::Blocking:
+            break;
+    }
+    throw std::invalid_argument("The blocking I/O backend has no engine");
+}
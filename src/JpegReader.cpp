@@ -0,0 +1,85 @@
+#include "JpegReader.h"
+#include <stdexcept>
+
+namespace {
+
+//SOF0-SOF15, except DHT (C4), JPG (C8) and DAC (CC), which share the range.
+bool isFrameMarker(uint8_t marker) {
+    return marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+}
+
+//Markers that stand alone, without a length field: TEM and RST0-RST7.
+bool isStandalone(uint8_t marker) {
+    return marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7);
+}
+
+}
+
+JpegReader::JpegReader(std::span<const uint8_t> file) : reader(file) {
+    if (!reader.has(0, 2) || reader.u16be(0) != 0xFFD8) {
+        throw std::runtime_error("JPEG: missing SOI marker");
+    }
+}
+
+bool JpegReader::readSegment(uint64_t& offset, JpegSegment& segment) const {
+    while (true) {
+        if (!reader.has(offset, 2) || reader.u8(offset) != 0xFF) {
+            return false;
+        }
+        // Any number of 0xFF fill bytes may precede a marker
+        uint64_t start = offset;
+        while (reader.has(offset + 1, 1) && reader.u8(offset + 1) == 0xFF) {
+            ++offset;
+        }
+        if (!reader.has(offset + 1, 1)) {
+            return false;
+        }
+        uint8_t marker = reader.u8(offset + 1);
+        if (marker == EndOfImage) {
+            return false;
+        }
+        if (isStandalone(marker)) {
+            offset += 2;
+            continue;
+        }
+        if (!reader.has(offset + 2, 2)) {
+            return false;
+        }
+        uint16_t length = reader.u16be(offset + 2);
+        if (length < 2 || !reader.has(offset + 2, length)) {
+            return false;
+        }
+        segment.marker = marker;
+        segment.offset = start;
+        segment.data = reader.bytes(offset + 4, length - 2u);
+        offset += 2 + length;
+        return true;
+    }
+}
+
+std::optional<JpegFrame> JpegReader::decodeFrame(const JpegSegment& segment) {
+    if (!isFrameMarker(segment.marker) || segment.data.size() < 6) {
+        return std::nullopt;
+    }
+    ByteReader fields(segment.data);
+    return JpegFrame{segment.marker, fields.u8(0), fields.u16be(1), fields.u16be(3), fields.u8(5)};
+}
+
+const char* JpegReader::frameProcessName(uint8_t marker) {
+    switch (marker) {
+        case 0xC0: return "Baseline";
+        case 0xC1: return "Extended sequential";
+        case 0xC2: return "Progressive";
+        case 0xC3: return "Lossless";
+        case 0xC5: return "Differential sequential";
+        case 0xC6: return "Differential progressive";
+        case 0xC7: return "Differential lossless";
+        case 0xC9: return "Extended sequential, arithmetic";
+        case 0xCA: return "Progressive, arithmetic";
+        case 0xCB: return "Lossless, arithmetic";
+        case 0xCD: return "Differential sequential, arithmetic";
+        case 0xCE: return "Differential progressive, arithmetic";
+        case 0xCF: return "Differential lossless, arithmetic";
+        default:   return "Unknown";
+    }
+}
@@ -0,0 +1,75 @@
+#include "MetadataArena.h"
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/asan_interface.h>
+// Under AddressSanitizer, memory is poisoned until handed out and again on reset, so anything still used
+// after a reset (a map that outlived its file) is reported instead of silently reading the next file's data
+#define ARENA_POISON(address, size) ASAN_POISON_MEMORY_REGION(address, size)
+#define ARENA_UNPOISON(address, size) ASAN_UNPOISON_MEMORY_REGION(address, size)
+#else
+#define ARENA_POISON(address, size) ((void)(address), (void)(size))
+#define ARENA_UNPOISON(address, size) ((void)(address), (void)(size))
+#endif
+
+MetadataArena::MetadataArena(std::size_t blockSize) : blockSize(blockSize) {}
+
+MetadataArena::~MetadataArena() {
+    for (const Block& block : blocks) {
+        ARENA_UNPOISON(block.data, block.size);
+        ::operator delete(block.data, block.size, std::align_val_t{alignof(std::max_align_t)});
+    }
+}
+
+void MetadataArena::reset() {
+    // Keep the first blocks up to the retain limit, give the rest back (all of them when the first block
+    // alone is over the limit; the next allocation starts a new one)
+    std::size_t kept = 0;
+    std::size_t keptBytes = 0;
+    while (kept < blocks.size() && keptBytes + blocks[kept].size <= RetainLimit) {
+        keptBytes += blocks[kept++].size;
+    }
+    for (std::size_t i = kept; i < blocks.size(); ++i) {
+        ARENA_UNPOISON(blocks[i].data, blocks[i].size);
+        ::operator delete(blocks[i].data, blocks[i].size, std::align_val_t{alignof(std::max_align_t)});
+        reserved -= blocks[i].size;
+    }
+    blocks.resize(kept);
+    for (const Block& block : blocks) {
+        ARENA_POISON(block.data, block.size);
+    }
+    current = 0;
+    offset = 0;
+    used = 0;
+}
+
+MetadataArena& MetadataArena::forThisThread() {
+    thread_local MetadataArena arena;
+    return arena;
+}
+
+void* MetadataArena::do_allocate(std::size_t bytes, std::size_t alignment) {
+    // Bump within the current block, then move on to the next retained block that fits
+    for (;; ++current, offset = 0) {
+        if (current == blocks.size()) {
+            std::size_t size = std::max(blockSize, bytes + alignment);
+            auto* data = static_cast<std::byte*>(::operator new(size, std::align_val_t{alignof(std::max_align_t)}));
+            ARENA_POISON(data, size);
+            blocks.push_back(Block{data, size});
+            reserved += size;
+            ++blocksAllocated;
+        }
+        Block& block = blocks[current];
+        auto base = reinterpret_cast<std::uintptr_t>(block.data);
+        std::uintptr_t start = (base + offset + alignment - 1) & ~(std::uintptr_t{alignment} - 1);
+        if (start + bytes <= base + block.size) {
+            offset = start + bytes - base;
+            ARENA_UNPOISON(reinterpret_cast<void*>(start), bytes);
+            used += bytes;
+            peak = std::max(peak, used);
+            return reinterpret_cast<void*>(start);
+        }
+    }
+}
@@ -0,0 +1,488 @@
+#include "MetadataCache.h"
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+// File layout: 64-byte header, 8-byte aligned records, then the slot table
+constexpr char CacheMagic[8] = {'F', 'M', 'D', 'C', 'A', 'C', 'H', 'E'};
+constexpr uint32_t CacheFormatVersion = 2;
+constexpr std::size_t FileHeaderSize = 64;
+constexpr std::size_t SlotSize = 16; // key hash, record offset (0 = empty)
+
+uint64_t mix(uint64_t h, uint64_t value) {
+    h ^= value + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ull;
+    return h ^ (h >> 29);
+}
+
+uint64_t hashKey(const CacheKey& key) {
+    uint64_t h = mix(0, key.device);
+    h = mix(h, key.inode);
+    h = mix(h, key.size);
+    h = mix(h, static_cast<uint64_t>(key.mtimeNs));
+    return mix(h, key.analyzerVersion);
+}
+
+CacheKey readKey(const ByteReader& reader, std::size_t offset) {
+    CacheKey key;
+    key.device = reader.u64le(offset);
+    key.inode = reader.u64le(offset + 8);
+    key.size = reader.u64le(offset + 16);
+    key.mtimeNs = static_cast<int64_t>(reader.u64le(offset + 24));
+    key.analyzerVersion = reader.u32le(offset + 32);
+    return key;
+}
+
+void putU32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void putU64(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+// Pair value layout: kind, style, hex digits, reserved (one byte each), then the payload: a u64 for
+// integers, booleans (1 or 0) and reals (IEEE bits), an i64 of seconds and a u32 of nanoseconds for times, a u32 length
+// and the bytes for text
+void putValue(std::string& out, const MetadataValue& value) {
+    MetadataValue::Kind kind = value.kind();
+    out.push_back(static_cast<char>(kind));
+    out.push_back(static_cast<char>(value.style()));
+    out.push_back(static_cast<char>(value.digits()));
+    out.push_back('\0');
+    switch (kind) {
+        case MetadataValue::Kind::Empty:
+            break;
+        case MetadataValue::Kind::Integer:
+            putU64(out, static_cast<uint64_t>(value.integer()));
+            break;
+        case MetadataValue::Kind::Boolean:
+            putU64(out, value.boolean() ? 1 : 0);
+            break;
+        case MetadataValue::Kind::Real:
+            putU64(out, std::bit_cast<uint64_t>(value.real()));
+            break;
+        case MetadataValue::Kind::Time:
+            putU64(out, static_cast<uint64_t>(value.time().seconds));
+            putU32(out, value.time().nanoseconds);
+            break;
+        case MetadataValue::Kind::Text:
+        case MetadataValue::Kind::Bytes:
+            putU32(out, static_cast<uint32_t>(value.text().size()));
+            out += value.text();
+            break;
+    }
+}
+
+// Checks that the record at `offset` ends by `end` and that every pair in it decodes inside it, so a corrupt
+// snapshot reads as a miss instead of throwing out of `CachedRecord`
+bool recordFits(const ByteReader& reader, std::size_t offset, std::size_t end) {
+    if (offset < FileHeaderSize || offset % 8 != 0 || offset > end || end - offset < CachedRecord::HeaderSize) {
+        return false;
+    }
+    std::size_t length = CachedRecord::HeaderSize + reader.u32le(offset + CachedRecord::PayloadSizeOffset);
+    if (length > end - offset) {
+        return false;
+    }
+    ByteReader record(reader.bytes(offset, length));
+    std::size_t position = CachedRecord::HeaderSize;
+    for (uint32_t i = 0, n = record.u32le(CachedRecord::PairCountOffset); i < n; ++i) {
+        if (!record.has(position, 4) || !record.has(position + 4, std::size_t{record.u32le(position)} + 4)) {
+            return false;
+        }
+        position += 4 + record.u32le(position);
+        auto kind = static_cast<MetadataValue::Kind>(record.u8(position));
+        position += 4;
+        std::size_t payload = 0;
+        switch (kind) {
+            case MetadataValue::Kind::Empty:
+                break;
+            case MetadataValue::Kind::Integer:
+            case MetadataValue::Kind::Boolean:
+            case MetadataValue::Kind::Real:
+                payload = 8;
+                break;
+            case MetadataValue::Kind::Time:
+                payload = 12;
+                break;
+            case MetadataValue::Kind::Text:
+            case MetadataValue::Kind::Bytes:
+                if (!record.has(position, 4)) {
+                    return false;
+                }
+                payload = 4 + std::size_t{record.u32le(position)};
+                break;
+            default:
+                return false;
+        }
+        if (!record.has(position, payload)) {
+            return false;
+        }
+        position += payload;
+    }
+    return position == length;
+}
+
+std::size_t padded(std::size_t length) {
+    return (length + 7) & ~std::size_t{7};
+}
+
+// Buffered writer over a raw descriptor, so the snapshot can be fsync'ed before the rename
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(int fd) : fd(fd) {}
+
+    void write(const void* data, std::size_t length) {
+        buffer.append(static_cast<const char*>(data), length);
+        written += length;
+        if (buffer.size() >= (1u << 20)) {
+            flush();
+        }
+    }
+
+    void pad() {
+        static constexpr char zeros[8] = {};
+        write(zeros, padded(written) - written);
+    }
+
+    void flush() {
+        std::size_t done = 0;
+        while (done < buffer.size()) {
+            ssize_t n = ::write(fd, buffer.data() + done, buffer.size() - done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                throw std::runtime_error(std::string("MetadataCache: write failed: ") + std::strerror(errno));
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        buffer.clear();
+    }
+
+    std::size_t offset() const {
+        return written;
+    }
+
+private:
+    int fd;
+    std::string buffer;
+    std::size_t written = 0;
+};
+
+}
+
+CacheKey CacheKey::fromStat(const struct stat& fileStat) {
+    CacheKey key;
+    key.device = static_cast<uint64_t>(fileStat.st_dev);
+    key.inode = static_cast<uint64_t>(fileStat.st_ino);
+    key.size = static_cast<uint64_t>(fileStat.st_size);
+    key.mtimeNs = static_cast<int64_t>(fileStat.st_mtim.tv_sec) * 1000000000 + fileStat.st_mtim.tv_nsec;
+    return key;
+}
+
+FileType CachedRecord::fileType() const {
+    return static_cast<FileType>(reader.u32le(FileTypeOffset));
+}
+
+MetadataValue CachedRecord::readValue(std::size_t& offset) const {
+    auto kind = static_cast<MetadataValue::Kind>(reader.u8(offset));
+    auto style = static_cast<MetadataValue::Style>(reader.u8(offset + 1));
+    uint8_t digits = reader.u8(offset + 2);
+    offset += 4;
+    switch (kind) {
+        case MetadataValue::Kind::Integer: {
+            uint64_t number = reader.u64le(offset);
+            offset += 8;
+            if (style == MetadataValue::Style::ByteCount) {
+                return MetadataValue::byteCount(number);
+            }
+            if (style == MetadataValue::Style::Hex) {
+                return MetadataValue::hex(number, digits);
+            }
+            return MetadataValue(static_cast<int64_t>(number));
+        }
+        case MetadataValue::Kind::Boolean: {
+            bool flag = reader.u64le(offset) != 0;
+            offset += 8;
+            return MetadataValue(flag);
+        }
+        case MetadataValue::Kind::Real: {
+            double number = std::bit_cast<double>(reader.u64le(offset));
+            offset += 8;
+            return MetadataValue(number);
+        }
+        case MetadataValue::Kind::Time: {
+            Timestamp time{static_cast<int64_t>(reader.u64le(offset)), reader.u32le(offset + 8)};
+            offset += 12;
+            return MetadataValue(time);
+        }
+        case MetadataValue::Kind::Text:
+        case MetadataValue::Kind::Bytes: {
+            uint32_t length = reader.u32le(offset);
+            std::string_view text = reader.chars(offset + 4, length);
+            offset += 4 + length;
+            return kind == MetadataValue::Kind::Bytes ? MetadataValue::bytes(text) : MetadataValue::literal(text);
+        }
+        default:
+            return MetadataValue();
+    }
+}
+
+void appendCachedRecord(std::string& out, const CacheKey& key, FileType fileType, const MetadataMap& metadata) {
+    std::size_t start = out.size();
+    putU64(out, key.device);
+    putU64(out, key.inode);
+    putU64(out, key.size);
+    putU64(out, static_cast<uint64_t>(key.mtimeNs));
+    putU32(out, key.analyzerVersion);
+    putU32(out, static_cast<uint32_t>(fileType));
+    putU32(out, static_cast<uint32_t>(metadata.size()));
+    putU32(out, 0); // payload size, patched below
+
+    for (const auto& [name, value] : metadata) {
+        putU32(out, static_cast<uint32_t>(name.view().size()));
+        out += name.view();
+        putValue(out, value);
+    }
+
+    uint32_t payloadSize = static_cast<uint32_t>(out.size() - start - CachedRecord::HeaderSize);
+    for (int i = 0; i < 4; ++i) {
+        out[start + CachedRecord::PayloadSizeOffset + i] = static_cast<char>(payloadSize >> (8 * i));
+    }
+}
+
+MetadataMap CachedRecord::toMap() const {
+    MetadataMap metadata;
+    metadata.reserve(reader.u32le(PairCountOffset));
+    forEach([&metadata](std::string_view key, const MetadataValue& value) {
+        metadata[MetadataKey(key)] = value.owned();
+    });
+    return metadata;
+}
+
+MetadataCache::MetadataCache(std::filesystem::path cachePath) : cachePath(std::move(cachePath)) {
+    map();
+}
+
+MetadataCache::~MetadataCache() {
+    unmap();
+}
+
+void MetadataCache::map() {
+    int fd = ::open(cachePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat fileStat;
+    if (::fstat(fd, &fileStat) == 0 && static_cast<std::size_t>(fileStat.st_size) >= FileHeaderSize) {
+        void* address = ::mmap(nullptr, static_cast<std::size_t>(fileStat.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (address != MAP_FAILED) {
+            mapping = static_cast<const uint8_t*>(address);
+            mappingSize = static_cast<std::size_t>(fileStat.st_size);
+        }
+    }
+    ::close(fd);
+    if (!mapping) {
+        return;
+    }
+
+    // Anything that does not look like a complete snapshot of this format is ignored (and replaced on save)
+    ByteReader reader({mapping, mappingSize});
+    uint64_t slots = reader.u64le(24);
+    uint64_t offset = reader.u64le(32);
+    bool valid = reader.matches(0, std::string_view(CacheMagic, sizeof(CacheMagic))) &&
+                 reader.u32le(8) == CacheFormatVersion &&
+                 reader.u64le(40) == mappingSize &&
+                 slots > 0 && (slots & (slots - 1)) == 0 && slots <= mappingSize / SlotSize &&
+                 offset >= FileHeaderSize && reader.has(offset, slots * SlotSize);
+    if (!valid) {
+        unmap();
+        return;
+    }
+    entryCount = reader.u64le(16);
+    slotCount = slots;
+    slotsOffset = offset;
+    seen = std::make_unique<std::atomic<bool>[]>(slotCount);
+}
+
+void MetadataCache::unmap() {
+    if (mapping) {
+        ::munmap(const_cast<uint8_t*>(mapping), mappingSize);
+    }
+    mapping = nullptr;
+    mappingSize = entryCount = slotCount = slotsOffset = 0;
+    seen.reset();
+}
+
+std::optional<CachedRecord> MetadataCache::lookup(const CacheKey& key) const {
+    if (!mapping) {
+        return std::nullopt;
+    }
+
+    ByteReader reader({mapping, mappingSize});
+    uint64_t hash = hashKey(key);
+    std::size_t mask = slotCount - 1;
+    for (std::size_t i = hash & mask, probes = 0; probes < slotCount; i = (i + 1) & mask, ++probes) {
+        std::size_t slot = slotsOffset + i * SlotSize;
+        uint64_t recordOffset = reader.u64le(slot + 8);
+        if (recordOffset == 0) {
+            return std::nullopt;
+        }
+        if (reader.u64le(slot) == hash && recordFits(reader, recordOffset, slotsOffset) && readKey(reader, recordOffset) == key) {
+            seen[i].store(true, std::memory_order_relaxed);
+            std::size_t length = CachedRecord::HeaderSize + reader.u32le(recordOffset + CachedRecord::PayloadSizeOffset);
+            return CachedRecord(reader.bytes(recordOffset, length));
+        }
+    }
+    return std::nullopt;
+}
+
+void MetadataCache::insert(const CacheKey& key, FileType fileType, const MetadataMap& metadata) {
+    std::string record;
+    appendCachedRecord(record, key, fileType, metadata);
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    pending.emplace_back(key, std::move(record));
+}
+
+void MetadataCache::save() {
+    std::vector<std::pair<CacheKey, std::string>> fresh;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        fresh.swap(pending);
+    }
+    // Offsets of the mapped records some scan still reached; the others belong to files that are gone
+    std::vector<uint64_t> reached;
+    if (mapping) {
+        ByteReader reader({mapping, mappingSize});
+        for (std::size_t i = 0; i < slotCount; ++i) {
+            if (seen[i].load(std::memory_order_relaxed)) {
+                reached.push_back(reader.u64le(slotsOffset + i * SlotSize + 8));
+            }
+        }
+        std::sort(reached.begin(), reached.end());
+    }
+    if (fresh.empty() && mapping && reached.size() == entryCount) {
+        return;
+    }
+
+    // Files analyzed in this run supersede every older record of the same device and inode
+    std::vector<std::pair<uint64_t, uint64_t>> superseded;
+    superseded.reserve(fresh.size());
+    for (const auto& [key, record] : fresh) {
+        superseded.emplace_back(key.device, key.inode);
+    }
+    std::sort(superseded.begin(), superseded.end());
+
+    std::filesystem::path tempPath = cachePath;
+    tempPath += ".tmp." + std::to_string(::getpid());
+    int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("MetadataCache: cannot create " + tempPath.string() + ": " + std::strerror(errno));
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> index; // (hash, offset)
+    try {
+        SnapshotWriter writer(fd);
+        char header[FileHeaderSize] = {};
+        writer.write(header, sizeof(header)); // rewritten once the layout is known
+
+        if (mapping) {
+            ByteReader reader({mapping, mappingSize});
+            for (std::size_t offset = FileHeaderSize; offset < slotsOffset;) {
+                // Past a corrupt record the next one cannot be found; whatever follows is re-analyzed next time
+                if (!recordFits(reader, offset, slotsOffset)) {
+                    break;
+                }
+                std::size_t length = CachedRecord::HeaderSize + reader.u32le(offset + CachedRecord::PayloadSizeOffset);
+                CacheKey key = readKey(reader, offset);
+                if (key.analyzerVersion == MetadataAnalyzerVersion &&
+                    std::binary_search(reached.begin(), reached.end(), offset) &&
+                    !std::binary_search(superseded.begin(), superseded.end(), std::make_pair(key.device, key.inode))) {
+                    index.emplace_back(hashKey(key), writer.offset());
+                    writer.write(mapping + offset, length);
+                    writer.pad();
+                }
+                offset += padded(length);
+            }
+        }
+        for (const auto& [key, record] : fresh) {
+            index.emplace_back(hashKey(key), writer.offset());
+            writer.write(record.data(), record.size());
+            writer.pad();
+        }
+
+        std::size_t slots = 16;
+        while (slots < index.size() * 2) {
+            slots *= 2;
+        }
+        std::vector<uint64_t> table(slots * 2, 0);
+        for (const auto& [hash, offset] : index) {
+            std::size_t i = hash & (slots - 1);
+            while (table[i * 2 + 1] != 0) {
+                i = (i + 1) & (slots - 1);
+            }
+            table[i * 2] = hash;
+            table[i * 2 + 1] = offset;
+        }
+
+        std::size_t tableOffset = writer.offset();
+        std::string encoded;
+        encoded.reserve(table.size() * 8);
+        for (uint64_t value : table) {
+            putU64(encoded, value);
+        }
+        writer.write(encoded.data(), encoded.size());
+        writer.flush();
+
+        std::string headerBytes(CacheMagic, sizeof(CacheMagic));
+        putU32(headerBytes, CacheFormatVersion);
+        putU32(headerBytes, 0);
+        putU64(headerBytes, index.size());
+        putU64(headerBytes, slots);
+        putU64(headerBytes, tableOffset);
+        putU64(headerBytes, writer.offset());
+        headerBytes.resize(FileHeaderSize, '\0');
+        if (::pwrite(fd, headerBytes.data(), headerBytes.size(), 0) != static_cast<ssize_t>(headerBytes.size()) ||
+            ::fsync(fd) != 0) {
+            throw std::runtime_error(std::string("MetadataCache: cannot finish snapshot: ") + std::strerror(errno));
+        }
+    } catch (...) {
+        ::close(fd);
+        ::unlink(tempPath.c_str());
+        throw;
+    }
+    ::close(fd);
+
+    if (::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+        ::unlink(tempPath.c_str());
+        throw std::runtime_error("MetadataCache: cannot replace " + cachePath.string() + ": " + std::strerror(errno));
+    }
+    // Make the rename itself durable
+    std::filesystem::path directory = cachePath.has_parent_path() ? cachePath.parent_path() : std::filesystem::path(".");
+    int directoryFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryFd >= 0) {
+        ::fsync(directoryFd);
+        ::close(directoryFd);
+    }
+
+    unmap();
+    map();
+    // Everything in the new snapshot was reached in this session; a later save keeps it too
+    for (std::size_t i = 0; i < slotCount; ++i) {
+        seen[i].store(true, std::memory_order_relaxed);
+    }
+}
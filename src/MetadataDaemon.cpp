@@ -0,0 +1,402 @@
+#include "MetadataDaemon.h"
+#include "OutputSink.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// Longest request line a client may send; longer ones close the connection
+constexpr std::size_t MaxRequestLength = 64 * 1024;
+
+// Unsent answers past which a client's further requests wait; a single LIST answer may still exceed it
+constexpr std::size_t MaxPendingOutput = 1024 * 1024;
+
+//An absolute, lexically normal path without a trailing separator, the form the index is keyed by.
+std::filesystem::path normalizePath(const std::filesystem::path& path) {
+    std::filesystem::path normal = path.lexically_normal();
+    if (!normal.has_filename() && normal.has_relative_path()) {
+        normal = normal.parent_path();
+    }
+    return normal;
+}
+
+//Binds and listens on a Unix socket, replacing a stale socket file that nobody listens on any more.
+int listenOn(const std::filesystem::path& socketPath) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.native().size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("Socket path too long: " + socketPath.string());
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.native().size() + 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "socket");
+    }
+    int bound = ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    if (bound != 0 && errno == EADDRINUSE) {
+        int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool live = ::connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+        ::close(probe);
+        if (live) {
+            ::close(fd);
+            throw std::system_error(EADDRINUSE, std::generic_category(), socketPath.string());
+        }
+        ::unlink(socketPath.c_str());
+        bound = ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    }
+    if (bound != 0 || ::listen(fd, 128) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), socketPath.string());
+    }
+    return fd;
+}
+
+struct Client {
+    int fd = -1;
+    std::string input;
+    std::string output;
+    bool peerClosed = false;
+};
+
+}
+
+MetadataDaemon::MetadataDaemon(DaemonOptions daemonOptions)
+    : options(std::move(daemonOptions)),
+      scanner(options.scan,
+              [this](const std::filesystem::path& filePath, FileType fileType, const MetadataMap& metadata) {
+                  metadataIndex.put(filePath.native(), fileType, metadata);
+              },
+              [this](const std::filesystem::path& filePath, const std::string& message) {
+                  // A file that vanished or no longer parses must not keep its old record
+                  metadataIndex.erase(filePath.native());
+                  std::string text = filePath.string() + ": " + message + "\n";
+                  std::fwrite(text.data(), 1, text.size(), stderr);
+              }),
+      stopFd(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+    if (stopFd < 0) {
+        throw std::system_error(errno, std::generic_category(), "eventfd");
+    }
+    for (auto& root : options.roots) {
+        root = normalizePath(std::filesystem::absolute(root));
+    }
+}
+
+MetadataDaemon::~MetadataDaemon() {
+    ::close(stopFd);
+}
+
+void MetadataDaemon::stop() {
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = ::write(stopFd, &one, sizeof(one));
+}
+
+void MetadataDaemon::run() {
+    int listener = listenOn(options.socketPath);
+    std::thread server;
+    try {
+        // Watch before scanning, so nothing that changes during the scan is missed
+        for (const auto& root : options.roots) {
+            watcher.watchTree(root, options.scan.followSymlinks);
+        }
+        watchCount = watcher.watchCount();
+
+        // Queries are answered from the start, with whatever the initial scan has indexed so far
+        server = std::thread([this, listener] {
+            try {
+                serveLoop(listener);
+            } catch (...) {
+                // A daemon that no longer answers queries must not keep running
+                serveError = std::current_exception();
+                stop();
+            }
+        });
+        metadataIndex.beginGeneration();
+        scanner.scan(options.roots);
+        watchLoop();
+    } catch (...) {
+        stop();
+        if (server.joinable()) {
+            server.join();
+        }
+        ::close(listener);
+        ::unlink(options.socketPath.c_str());
+        throw;
+    }
+    server.join();
+    ::close(listener);
+    ::unlink(options.socketPath.c_str());
+    if (serveError) {
+        std::rethrow_exception(serveError);
+    }
+}
+
+void MetadataDaemon::recordChange(WatchEvent&& event) {
+    auto now = std::chrono::steady_clock::now();
+    if (pending.empty() && !overflowed) {
+        burstStart = now;
+    }
+    lastEvent = now;
+
+    switch (event.kind) {
+        case WatchEvent::Kind::Overflow:
+            // Events were lost; the rescan covers every pending path
+            overflowed = true;
+            pending.clear();
+            break;
+        case WatchEvent::Kind::Changed:
+            pending[std::move(event.path)] = Change::Contents;
+            break;
+        case WatchEvent::Kind::AttributesChanged: {
+            // Never downgrades a pending content change; a path that was removed exists again
+            auto [it, inserted] = pending.try_emplace(std::move(event.path), Change::Attributes);
+            if (!inserted && it->second == Change::Removed) {
+                it->second = Change::Contents;
+            }
+            break;
+        }
+        case WatchEvent::Kind::Removed:
+            pending[std::move(event.path)] = Change::Removed;
+            break;
+        case WatchEvent::Kind::DirectoryAdded:
+            pending[std::move(event.path)] = Change::DirectoryAdded;
+            break;
+        case WatchEvent::Kind::DirectoryRemoved:
+            pending[std::move(event.path)] = Change::DirectoryRemoved;
+            break;
+    }
+}
+
+void MetadataDaemon::watchLoop() {
+    std::vector<WatchEvent> events;
+    auto deadline = [this] {
+        return std::min(lastEvent + options.coalesceDelay, burstStart + options.maxCoalesceDelay);
+    };
+    while (true) {
+        int timeout = -1;
+        if (overflowed || !pending.empty()) {
+            auto wait = std::chrono::ceil<std::chrono::milliseconds>(deadline() - std::chrono::steady_clock::now());
+            timeout = static_cast<int>(std::max<std::chrono::milliseconds::rep>(wait.count(), 0));
+        }
+
+        pollfd fds[] = {{stopFd, POLLIN, 0}, {watcher.descriptor(), POLLIN, 0}};
+        if (::poll(fds, 2, timeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "poll");
+        }
+        if (fds[0].revents) {
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            events.clear();
+            watcher.readEvents(events);
+            for (auto& event : events) {
+                recordChange(std::move(event));
+            }
+            watchCount = watcher.watchCount();
+        }
+
+        // Checked after every wakeup, so a steady trickle of events cannot hold a burst back past maxCoalesceDelay
+        if ((overflowed || !pending.empty()) && std::chrono::steady_clock::now() >= deadline()) {
+            if (overflowed) {
+                rescan();
+            } else {
+                applyChanges();
+            }
+        }
+    }
+}
+
+void MetadataDaemon::applyChanges() {
+    std::vector<std::filesystem::path> toAnalyze;
+    for (const auto& [path, change] : pending) {
+        switch (change) {
+            case Change::Contents:
+                // Members of an archive that was rewritten are reported afresh by the rescan, if at all
+                metadataIndex.eraseUnder(path.native());
+                toAnalyze.push_back(path);
+                break;
+            case Change::DirectoryAdded:
+                toAnalyze.push_back(path);
+                break;
+            case Change::Attributes: {
+                // Only the stat-derived fields can have changed; the extractors are not re-run
+                struct stat fileStat;
+                if (::stat(path.c_str(), &fileStat) != 0) {
+                    metadataIndex.erase(path.native());
+                } else if (options.scan.includeBasic && S_ISREG(fileStat.st_mode)) {
+                    metadataIndex.update(path.native(), analyzeBasicMetadata(path, fileStat));
+                }
+                break;
+            }
+            case Change::Removed:
+                metadataIndex.erase(path.native());
+                metadataIndex.eraseUnder(path.native());
+                break;
+            case Change::DirectoryRemoved:
+                metadataIndex.eraseUnder(path.native());
+                break;
+        }
+    }
+    updates += pending.size();
+    pending.clear();
+    if (!toAnalyze.empty()) {
+        scanner.scan(toAnalyze);
+    }
+}
+
+void MetadataDaemon::rescan() {
+    overflowed = false;
+    pending.clear();
+    for (const auto& root : options.roots) {
+        watcher.watchTree(root, options.scan.followSymlinks);
+    }
+    watchCount = watcher.watchCount();
+
+    uint64_t generation = metadataIndex.beginGeneration();
+    scanner.scan(options.roots);
+    metadataIndex.eraseStale(generation);
+    ++rescans;
+}
+
+void MetadataDaemon::answer(std::string_view request, std::string& response) const {
+    std::size_t space = request.find(' ');
+    std::string_view verb = request.substr(0, space);
+    std::string_view argument = space == std::string_view::npos ? std::string_view() : request.substr(space + 1);
+
+    if (verb == "GET" && !argument.empty()) {
+        std::filesystem::path path = normalizePath(std::string(argument));
+        if (!metadataIndex.appendRecord(response, path.native())) {
+            response += "{\"error\":\"not found\",\"path\":";
+            appendJson(response, path.native());
+            response += "}\n";
+        }
+    } else if (verb == "LIST" && !argument.empty()) {
+        std::size_t count = metadataIndex.appendRecordsUnder(response, normalizePath(std::string(argument)).native());
+        response += "{\"count\":" + std::to_string(count) + "}\n";
+    } else if (verb == "STATS") {
+        response += "{\"files\":" + std::to_string(metadataIndex.size()) + ",\"watches\":" + std::to_string(watchCount.load()) +
+                    ",\"updates\":" + std::to_string(updates.load()) + ",\"rescans\":" + std::to_string(rescans.load()) + "}\n";
+    } else if (!request.empty()) {
+        response += "{\"error\":\"unknown request\"}\n";
+    }
+}
+
+void MetadataDaemon::serveLoop(int listener) {
+    std::vector<Client> clients;
+    std::vector<pollfd> fds;
+    char buffer[16 * 1024];
+    int pollError = 0;
+
+    // Answers the complete lines buffered so far, until the unsent answers reach the cap
+    auto answerBuffered = [this](Client& client) {
+        std::size_t start = 0;
+        for (std::size_t end; client.output.size() < MaxPendingOutput && (end = client.input.find('\n', start)) != std::string::npos;
+             start = end + 1) {
+            std::string_view line(client.input.data() + start, end - start);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            answer(line, client.output);
+        }
+        client.input.erase(0, start);
+    };
+
+    while (true) {
+        fds.clear();
+        fds.push_back({stopFd, POLLIN, 0});
+        fds.push_back({listener, POLLIN, 0});
+        for (const Client& client : clients) {
+            // A client over its backlog is not read from until it has taken its answers
+            bool reading = !client.peerClosed && client.output.size() < MaxPendingOutput && client.input.size() <= MaxRequestLength;
+            short events = static_cast<short>((reading ? POLLIN : 0) | (client.output.empty() ? 0 : POLLOUT));
+            fds.push_back({client.fd, events, 0});
+        }
+        if (::poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            pollError = errno;
+            break;
+        }
+        if (fds[0].revents) {
+            break;
+        }
+
+        // Walk the clients that were polled, before accepting new ones
+        for (std::size_t i = clients.size(); i-- > 0;) {
+            Client& client = clients[i];
+            short revents = fds[2 + i].revents;
+            if (revents == 0) {
+                continue;
+            }
+            bool failed = (revents & POLLERR) != 0;
+
+            if (revents & (POLLIN | POLLHUP)) {
+                while (client.input.size() <= MaxRequestLength) {
+                    ssize_t n = ::recv(client.fd, buffer, sizeof(buffer), 0);
+                    if (n > 0) {
+                        client.input.append(buffer, static_cast<std::size_t>(n));
+                        continue;
+                    }
+                    if (n == 0) {
+                        client.peerClosed = true;
+                    } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                        failed = true;
+                    }
+                    break;
+                }
+            }
+
+            // Answer and send in turns, so requests held back by the cap go out as the backlog drains
+            while (!failed) {
+                answerBuffered(client);
+                if (client.output.empty()) {
+                    break;
+                }
+                ssize_t n = ::send(client.fd, client.output.data(), client.output.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+                if (n > 0) {
+                    client.output.erase(0, static_cast<std::size_t>(n));
+                    continue;
+                }
+                failed = n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+                break;
+            }
+            // Only an unterminated line is left once the backlog is below the cap
+            failed |= client.output.size() < MaxPendingOutput && client.input.size() > MaxRequestLength;
+
+            if (failed || (client.peerClosed && client.output.empty())) {
+                ::close(client.fd);
+                clients.erase(clients.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+        }
+
+        if (fds[1].revents & POLLIN) {
+            int fd;
+            while ((fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                clients.push_back(Client{fd, {}, {}, false});
+            }
+        }
+    }
+
+    for (const Client& client : clients) {
+        ::close(client.fd);
+    }
+    if (pollError != 0) {
+        throw std::system_error(pollError, std::generic_category(), "Query server poll");
+    }
+}
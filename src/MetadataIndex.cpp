@@ -0,0 +1,95 @@
+#include "MetadataIndex.h"
+#include "OutputSink.h"
+#include <mutex>
+#include <utility>
+
+void MetadataIndex::put(std::string_view path, FileType fileType, const MetadataMap& metadata) {
+    Entry entry{fileType, metadata, 0}; // copied out of the caller's arena before taking the lock
+    std::unique_lock lock(mutex);
+    entry.generation = currentGeneration;
+    auto it = entries.find(path);
+    if (it == entries.end()) {
+        entries.emplace(std::string(path), std::move(entry));
+    } else {
+        it->second = std::move(entry);
+    }
+}
+
+bool MetadataIndex::update(std::string_view path, const MetadataMap& fields) {
+    std::unique_lock lock(mutex);
+    auto it = entries.find(path);
+    if (it == entries.end()) {
+        return false;
+    }
+    for (const auto& [key, value] : fields) {
+        it->second.metadata[key] = value;
+    }
+    return true;
+}
+
+bool MetadataIndex::erase(std::string_view path) {
+    std::unique_lock lock(mutex);
+    auto it = entries.find(path);
+    if (it == entries.end()) {
+        return false;
+    }
+    entries.erase(it);
+    return true;
+}
+
+std::pair<MetadataIndex::EntryMap::const_iterator, MetadataIndex::EntryMap::const_iterator>
+MetadataIndex::subtree(const EntryMap& entries, std::string_view directory) {
+    // Every path below "dir" sorts between "dir/" and "dir0", '0' being the character after '/'
+    std::string prefix(directory);
+    if (prefix.empty() || prefix.back() != '/') {
+        prefix.push_back('/');
+    }
+    auto begin = entries.lower_bound(prefix);
+    prefix.back() = '/' + 1;
+    return {begin, entries.lower_bound(prefix)};
+}
+
+std::size_t MetadataIndex::eraseUnder(std::string_view directory) {
+    std::unique_lock lock(mutex);
+    auto [begin, end] = subtree(entries, directory);
+    std::size_t count = static_cast<std::size_t>(std::distance(begin, end));
+    entries.erase(begin, end);
+    return count;
+}
+
+uint64_t MetadataIndex::beginGeneration() {
+    std::unique_lock lock(mutex);
+    return ++currentGeneration;
+}
+
+std::size_t MetadataIndex::eraseStale(uint64_t generation) {
+    std::unique_lock lock(mutex);
+    return std::erase_if(entries, [generation](const auto& item) {
+        return item.second.generation < generation;
+    });
+}
+
+bool MetadataIndex::appendRecord(std::string& out, std::string_view path) const {
+    std::shared_lock lock(mutex);
+    auto it = entries.find(path);
+    if (it == entries.end()) {
+        return false;
+    }
+    appendNdjsonRecord(out, it->first, it->second.fileType, it->second.metadata);
+    return true;
+}
+
+std::size_t MetadataIndex::appendRecordsUnder(std::string& out, std::string_view directory) const {
+    std::shared_lock lock(mutex);
+    auto [begin, end] = subtree(entries, directory);
+    std::size_t count = 0;
+    for (auto it = begin; it != end; ++it, ++count) {
+        appendNdjsonRecord(out, it->first, it->second.fileType, it->second.metadata);
+    }
+    return count;
+}
+
+std::size_t MetadataIndex::size() const {
+    std::shared_lock lock(mutex);
+    return entries.size();
+}
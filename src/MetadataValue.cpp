@@ -0,0 +1,147 @@
+#include "MetadataValue.h"
+#include <charconv>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_set>
+
+namespace {
+
+struct InternHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view text) const {
+        return std::hash<std::string_view>{}(text);
+    }
+};
+
+/**
+ * Names interned at run time. Nodes of an unordered_set never move, so views of the stored strings stay
+ * valid for the life of the program. Lookups of already interned names only take the shared lock.
+ */
+class KeyInterner {
+public:
+    std::string_view intern(std::string_view name) {
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto found = names.find(name);
+            if (found != names.end()) {
+                return *found;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        return *names.emplace(name).first;
+    }
+
+private:
+    std::shared_mutex mutex;
+    std::unordered_set<std::string, InternHash, std::equal_to<>> names;
+};
+
+KeyInterner& interner() {
+    static KeyInterner instance;
+    return instance;
+}
+
+template <typename Number>
+void appendNumber(std::string& out, Number value) {
+    char buffer[32];
+    auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, error == std::errc() ? end : buffer);
+}
+
+}
+
+MetadataKey::MetadataKey(std::string_view name) : name(interner().intern(name)) {}
+
+std::optional<double> MetadataValue::number() const {
+    switch (valueKind) {
+        case Kind::Integer: return static_cast<double>(integer());
+        case Kind::Real:    return real();
+        default:            return std::nullopt;
+    }
+}
+
+void MetadataValue::format(std::string& out) const {
+    switch (kind()) {
+        case Kind::Empty:
+            break;
+        case Kind::Integer:
+            if (displayStyle == Style::Hex) {
+                char buffer[17];
+                auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), static_cast<uint64_t>(integer()), 16);
+                std::size_t length = static_cast<std::size_t>(end - buffer);
+                out.append(hexDigits > length ? hexDigits - length : 0, '0');
+                out.append(buffer, length);
+            } else {
+                appendNumber(out, integer());
+                if (displayStyle == Style::ByteCount) {
+                    out += " bytes";
+                }
+            }
+            break;
+        case Kind::Real:
+            appendNumber(out, real());
+            break;
+        case Kind::Time:
+            formatLocalTime(out, time());
+            break;
+        case Kind::Boolean:
+            out += boolean() ? "true" : "false";
+            break;
+        case Kind::Text:
+        case Kind::Bytes:
+            out += text();
+            break;
+    }
+}
+
+bool MetadataValue::operator==(const MetadataValue& other) const {
+    Kind ownKind = kind();
+    if (ownKind != other.kind() || displayStyle != other.displayStyle || hexDigits != other.hexDigits) {
+        return false;
+    }
+    switch (ownKind) {
+        case Kind::Integer: return integer() == other.integer();
+        case Kind::Boolean: return boolean() == other.boolean();
+        case Kind::Real:    return real() == other.real();
+        case Kind::Time:    return time() == other.time();
+        case Kind::Text:
+        case Kind::Bytes:   return text() == other.text(); // a literal view equals the same owned text
+        default:            return true;
+    }
+}
+
+std::ostream& operator<<(std::ostream& out, const MetadataValue& value) {
+    return out << value.toString();
+}
+
+std::ostream& operator<<(std::ostream& out, const MetadataKey& key) {
+    return out << key.view();
+}
+
+void formatLocalTime(std::string& out, Timestamp time) {
+    // ctime_r's fixed 24-character layout; localtime_r rather than localtime: workers format concurrently
+    time_t seconds = static_cast<time_t>(time.seconds);
+    struct tm parts;
+    char buffer[64];
+    if (localtime_r(&seconds, &parts) && std::strftime(buffer, sizeof(buffer), "%a %b %e %H:%M:%S %Y", &parts) > 0) {
+        out += buffer;
+    }
+}
+
+void formatIsoTime(std::string& out, Timestamp time) {
+    time_t seconds = static_cast<time_t>(time.seconds);
+    struct tm parts;
+    char buffer[64];
+    if (!gmtime_r(&seconds, &parts) || std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &parts) == 0) {
+        return;
+    }
+    out += buffer;
+    if (time.nanoseconds != 0) {
+        char fraction[16];
+        std::snprintf(fraction, sizeof(fraction), ".%09u", time.nanoseconds);
+        out += fraction;
+    }
+    out.push_back('Z');
+}
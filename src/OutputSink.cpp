@@ -0,0 +1,437 @@
+#include "OutputSink.h"
+#include "IndexFile.h"
+#include "StageStats.h"
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+void appendU8(std::string& out, uint8_t value) {
+    out.push_back(static_cast<char>(value));
+}
+
+void appendU32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void appendU64(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+// Length of the valid UTF-8 sequence starting at `text[i]`, or 0 if it is invalid. The second byte is held to the
+// RFC 3629 ranges, as in TextReader, so overlong forms, surrogates and code points past U+10FFFF are invalid
+std::size_t utf8SequenceLength(std::string_view text, std::size_t i) {
+    auto c = static_cast<uint8_t>(text[i]);
+    if (c < 0x80) {
+        return 1;
+    }
+    std::size_t length = 0;
+    uint8_t lower = 0x80;
+    uint8_t upper = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF) {
+        length = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        length = 3;
+        lower = c == 0xE0 ? 0xA0 : 0x80;
+        upper = c == 0xED ? 0x9F : 0xBF;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        length = 4;
+        lower = c == 0xF0 ? 0x90 : 0x80;
+        upper = c == 0xF4 ? 0x8F : 0xBF;
+    } else {
+        return 0;
+    }
+    if (i + length > text.size()) {
+        return 0;
+    }
+    for (std::size_t k = 1; k < length; ++k, lower = 0x80, upper = 0xBF) {
+        auto next = static_cast<uint8_t>(text[i + k]);
+        if (next < lower || next > upper) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+void appendJsonString(std::string& out, std::string_view text) {
+    static constexpr char hex[] = "0123456789abcdef";
+    out.push_back('"');
+    for (std::size_t i = 0; i < text.size();) {
+        auto c = static_cast<uint8_t>(text[i]);
+        std::size_t length = utf8SequenceLength(text, i);
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(static_cast<char>(c));
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c == '\r') {
+            out += "\\r";
+        } else if (c == '\t') {
+            out += "\\t";
+        } else if (c < 0x20 || length == 0) {
+            // Control characters, and bytes that are not valid UTF-8 (read as Latin-1)
+            out += "\\u00";
+            out.push_back(hex[c >> 4]);
+            out.push_back(hex[c & 0xF]);
+            length = 1;
+        } else {
+            out.append(text.data() + i, length);
+            i += length;
+            continue;
+        }
+        i += 1;
+    }
+    out.push_back('"');
+}
+
+// Numbers stay JSON numbers (sizes included), booleans JSON booleans, times become ISO 8601 strings and hexadecimal integers,
+// raw bytes and text become strings
+void appendJsonValue(std::string& out, const MetadataValue& value) {
+    switch (value.kind()) {
+        case MetadataValue::Kind::Empty:
+            out += "null";
+            break;
+        case MetadataValue::Kind::Integer:
+            if (value.style() == MetadataValue::Style::Hex) {
+                out.push_back('"');
+                value.format(out);
+                out.push_back('"');
+            } else {
+                char digits[24];
+                auto [end, error] = std::to_chars(digits, digits + sizeof(digits), value.integer());
+                out.append(digits, end);
+            }
+            break;
+        case MetadataValue::Kind::Boolean:
+            out += value.boolean() ? "true" : "false";
+            break;
+        case MetadataValue::Kind::Real:
+            if (std::isfinite(value.real())) {
+                value.format(out);
+            } else {
+                out += "null";
+            }
+            break;
+        case MetadataValue::Kind::Time:
+            out.push_back('"');
+            formatIsoTime(out, value.time());
+            out.push_back('"');
+            break;
+        case MetadataValue::Kind::Bytes: {
+            static constexpr char hex[] = "0123456789abcdef";
+            out.push_back('"');
+            for (char c : value.text()) {
+                out.push_back(hex[static_cast<uint8_t>(c) >> 4]);
+                out.push_back(hex[static_cast<uint8_t>(c) & 0xF]);
+            }
+            out.push_back('"');
+            break;
+        }
+        case MetadataValue::Kind::Text:
+            appendJsonString(out, value.text());
+            break;
+    }
+}
+
+void appendCsvField(std::string& out, std::string_view text) {
+    if (text.find_first_of(",\"\r\n") == std::string_view::npos) {
+        out.append(text);
+        return;
+    }
+    out.push_back('"');
+    for (char c : text) {
+        if (c == '"') {
+            out.push_back('"');
+        }
+        out.push_back(c);
+    }
+    out.push_back('"');
+}
+
+// Appends a string column: u32 offsets[n + 1] followed by the concatenated bytes
+template <typename Strings>
+void appendStringColumn(std::string& out, const Strings& strings) {
+    uint32_t offset = 0;
+    appendU32(out, 0);
+    for (std::string_view text : strings) {
+        offset += static_cast<uint32_t>(text.size());
+        appendU32(out, offset);
+    }
+    for (std::string_view text : strings) {
+        out.append(text);
+    }
+}
+
+// The number column of a value: the integer, 1 or 0 for a boolean, the IEEE bits of a real, or nanoseconds since the epoch
+uint64_t columnNumber(const MetadataValue& value) {
+    switch (value.kind()) {
+        case MetadataValue::Kind::Integer:
+            return static_cast<uint64_t>(value.integer());
+        case MetadataValue::Kind::Boolean:
+            return value.boolean() ? 1 : 0;
+        case MetadataValue::Kind::Real:
+            return std::bit_cast<uint64_t>(value.real());
+        case MetadataValue::Kind::Time:
+            return static_cast<uint64_t>(value.time().seconds * 1000000000 + value.time().nanoseconds);
+        default:
+            return 0;
+    }
+}
+
+}
+
+void OutputSink::flush(bool force) {
+    if (!force && buffer.size() < FlushThreshold) {
+        return;
+    }
+    std::size_t written = std::fwrite(buffer.data(), 1, buffer.size(), out);
+    bool failed = written != buffer.size();
+    buffer.clear();
+    if (force && !failed) {
+        failed = std::fflush(out) != 0;
+    }
+    if (failed || std::ferror(out)) {
+        throw std::runtime_error(std::string("output write failed: ") + std::strerror(errno));
+    }
+}
+
+void TextSink::write(const OutputRecord& record) {
+    std::ostringstream text;
+    text << "For " << record.path << " " << fileTypeName(record.fileType) << " Metadata:\n";
+    printMetadata(text, record.metadata);
+    buffer += text.str();
+    flush(false);
+}
+
+void appendNdjsonRecord(std::string& out, std::string_view path, FileType fileType, const MetadataMap& metadata) {
+    out += "{\"path\":";
+    appendJsonString(out, path);
+    out += ",\"type\":";
+    appendJsonString(out, fileTypeName(fileType));
+    out += ",\"metadata\":{";
+    bool first = true;
+    for (const auto& [key, value] : metadata) {
+        if (!first) {
+            out.push_back(',');
+        }
+        first = false;
+        appendJsonString(out, key);
+        out.push_back(':');
+        appendJsonValue(out, value);
+    }
+    out += "}}\n";
+}
+
+void appendJson(std::string& out, std::string_view text) {
+    appendJsonString(out, text);
+}
+
+void NdjsonSink::write(const OutputRecord& record) {
+    appendNdjsonRecord(buffer, record.path, record.fileType, record.metadata);
+    flush(false);
+}
+
+CsvSink::CsvSink(std::FILE* out) : OutputSink(out) {
+    buffer += "path,type,key,value\r\n";
+}
+
+void CsvSink::write(const OutputRecord& record) {
+    std::string text;
+    for (const auto& [key, value] : record.metadata) {
+        text.clear();
+        value.format(text);
+        appendCsvField(buffer, record.path);
+        buffer.push_back(',');
+        buffer += fileTypeName(record.fileType);
+        buffer.push_back(',');
+        appendCsvField(buffer, key);
+        buffer.push_back(',');
+        appendCsvField(buffer, text);
+        buffer += "\r\n";
+    }
+    flush(false);
+}
+
+ColumnarSink::ColumnarSink(std::FILE* out) : OutputSink(out) {
+    buffer.append("FMDCOL2\0", 8);
+    pending.reserve(BatchSize);
+}
+
+void ColumnarSink::write(const OutputRecord& record) {
+    pending.push_back(record);
+    if (pending.size() == BatchSize) {
+        writeBatch();
+    }
+}
+
+void ColumnarSink::finish() {
+    writeBatch();
+    buffer += "FEND";
+    appendU64(buffer, batches);
+    appendU64(buffer, records);
+    flush();
+}
+
+void ColumnarSink::writeBatch() {
+    if (pending.empty()) {
+        return;
+    }
+
+    std::vector<std::string_view> paths;
+    std::vector<std::string_view> texts;
+    std::string kinds;
+    std::string styles;
+    std::string numbers;
+    std::vector<uint32_t> keyIds;
+    std::vector<std::string_view> dictionary;
+    std::map<std::string_view, uint32_t> dictionaryIds;
+    paths.reserve(pending.size());
+
+    std::string body;
+    appendU32(body, static_cast<uint32_t>(pending.size()));
+    std::size_t fieldCountAt = body.size();
+    appendU32(body, 0); // field count, patched below
+
+    std::string types;
+    std::string fieldEnds;
+    for (const OutputRecord& record : pending) {
+        paths.push_back(record.path);
+        appendU8(types, static_cast<uint8_t>(record.fileType));
+        for (const auto& [key, value] : record.metadata) {
+            auto [it, inserted] = dictionaryIds.emplace(key, static_cast<uint32_t>(dictionary.size()));
+            if (inserted) {
+                dictionary.push_back(key);
+            }
+            keyIds.push_back(it->second);
+            appendU8(kinds, static_cast<uint8_t>(value.kind()));
+            appendU8(styles, static_cast<uint8_t>(value.style()));
+            appendU64(numbers, columnNumber(value));
+            texts.push_back(value.text());
+        }
+        appendU32(fieldEnds, static_cast<uint32_t>(texts.size()));
+    }
+    for (int i = 0; i < 4; ++i) {
+        body[fieldCountAt + i] = static_cast<char>(static_cast<uint32_t>(texts.size()) >> (8 * i));
+    }
+
+    appendStringColumn(body, paths);
+    body += types;
+    body += fieldEnds;
+    appendU32(body, static_cast<uint32_t>(dictionary.size()));
+    appendStringColumn(body, dictionary);
+    for (uint32_t id : keyIds) {
+        appendU32(body, id);
+    }
+    body += kinds;
+    body += styles;
+    body += numbers;
+    appendStringColumn(body, texts);
+
+    buffer += "BTCH";
+    appendU64(buffer, body.size());
+    buffer += body;
+
+    ++batches;
+    records += pending.size();
+    pending.clear();
+    flush(false);
+}
+
+std::unique_ptr<OutputSink> makeOutputSink(std::string_view format, std::FILE* out) {
+    if (format == "text") {
+        return std::make_unique<TextSink>(out);
+    }
+    if (format == "ndjson") {
+        return std::make_unique<NdjsonSink>(out);
+    }
+    if (format == "csv") {
+        return std::make_unique<CsvSink>(out);
+    }
+    if (format == "columnar") {
+        return std::make_unique<ColumnarSink>(out);
+    }
+    if (format == "index") {
+        return std::make_unique<IndexSink>(out);
+    }
+    throw std::invalid_argument("Unknown output format: " + std::string(format));
+}
+
+AsyncRecordWriter::AsyncRecordWriter(OutputSink& sink, std::size_t maxPending)
+    : sink(sink), maxPending(maxPending), writer([this] { run(); }) {}
+
+AsyncRecordWriter::~AsyncRecordWriter() {
+    try {
+        close();
+    } catch (const std::exception&) {
+    }
+}
+
+void AsyncRecordWriter::push(OutputRecord&& record) {
+    std::unique_lock<std::mutex> lock(mutex);
+    hasRoom.wait(lock, [this] { return queue.size() < maxPending; });
+    queue.push_back(std::move(record));
+    if (queue.size() == 1) {
+        hasRecords.notify_one();
+    }
+}
+
+void AsyncRecordWriter::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closing) {
+            return;
+        }
+        closing = true;
+    }
+    hasRecords.notify_one();
+    writer.join();
+    if (failure) {
+        std::rethrow_exception(std::exchange(failure, nullptr));
+    }
+}
+
+void AsyncRecordWriter::run() {
+    std::vector<OutputRecord> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            hasRecords.wait(lock, [this] { return closing || !queue.empty(); });
+            if (queue.empty()) {
+                break; // closing and drained
+            }
+            batch.swap(queue);
+        }
+        hasRoom.notify_all();
+
+        // After a failure the rest is still drained, so producers never block on a dead writer
+        if (!failure) {
+            try {
+                for (const OutputRecord& record : batch) {
+                    FILEMETA_STAGE_TIMER(timer, Stage::Output, record.fileType);
+                    sink.write(record);
+                }
+            } catch (...) {
+                failure = std::current_exception();
+            }
+        }
+        batch.clear();
+    }
+    if (!failure) {
+        try {
+            sink.finish();
+        } catch (...) {
+            failure = std::current_exception();
+        }
+    }
+}
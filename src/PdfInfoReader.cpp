@@ -0,0 +1,873 @@
+#include "PdfInfoReader.h"
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+constexpr int MaxDepth = 32;                        // nesting of arrays/dictionaries and of reference chains
+constexpr std::size_t MaxSections = 256;            // xref sections followed through /Prev
+constexpr std::size_t MaxInflatedSize = 64u << 20;  // cap for one decoded xref or object stream
+
+// Any structural problem; caught by readPdfInfo, which then returns std::nullopt
+class MalformedPdf : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+struct PdfObject {
+    enum class Kind { Null, Boolean, Integer, Real, String, Name, Array, Dictionary, Reference, Keyword };
+
+    Kind kind = Kind::Null;
+    int64_t integer = 0;     // Integer and Boolean values, object number of a Reference
+    uint32_t generation = 0; // generation of a Reference
+    std::string text;        // String bytes, Name (without the slash) or Keyword
+    std::vector<PdfObject> items;  // Array elements, Dictionary values
+    std::vector<std::string> keys; // Dictionary keys
+
+    const PdfObject* get(std::string_view key) const {
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            if (keys[i] == key) {
+                return &items[i];
+            }
+        }
+        return nullptr;
+    }
+
+    bool isName(std::string_view name) const {
+        return kind == Kind::Name && text == name;
+    }
+};
+
+bool isWhitespace(uint8_t c) {
+    return c == 0 || c == '\t' || c == '\n' || c == '\f' || c == '\r' || c == ' ';
+}
+
+bool isDelimiter(uint8_t c) {
+    return c == '(' || c == ')' || c == '<' || c == '>' || c == '[' || c == ']' || c == '{' || c == '}' ||
+           c == '/' || c == '%';
+}
+
+int hexValue(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Tokenizer and object parser over a byte range (the file, or a decoded object stream)
+class Lexer {
+public:
+    Lexer(std::span<const uint8_t> data, std::size_t position) : data(data), position(position) {}
+
+    std::size_t offset() const {
+        return position;
+    }
+
+    void skipWhitespace() {
+        while (position < data.size()) {
+            uint8_t c = data[position];
+            if (c == '%') {
+                while (position < data.size() && data[position] != '\n' && data[position] != '\r') {
+                    ++position;
+                }
+            } else if (isWhitespace(c)) {
+                ++position;
+            } else {
+                break;
+            }
+        }
+    }
+
+    bool consumeKeyword(std::string_view keyword) {
+        skipWhitespace();
+        if (data.size() - position < keyword.size() ||
+            std::memcmp(data.data() + position, keyword.data(), keyword.size()) != 0) {
+            return false;
+        }
+        std::size_t end = position + keyword.size();
+        if (end < data.size() && !isWhitespace(data[end]) && !isDelimiter(data[end])) {
+            return false;
+        }
+        position = end;
+        return true;
+    }
+
+    int64_t parseInteger() {
+        PdfObject object = parseObject();
+        if (object.kind != PdfObject::Kind::Integer) {
+            throw MalformedPdf("integer expected");
+        }
+        return object.integer;
+    }
+
+    PdfObject parseObject(int depth = 0) {
+        if (depth > MaxDepth) {
+            throw MalformedPdf("objects nested too deeply");
+        }
+        skipWhitespace();
+        uint8_t c = at(position);
+
+        if (c == '/') {
+            ++position;
+            return parseName();
+        }
+        if (c == '(') {
+            ++position;
+            return parseLiteralString();
+        }
+        if (c == '<' && at(position + 1) == '<') {
+            position += 2;
+            return parseDictionary(depth);
+        }
+        if (c == '<') {
+            ++position;
+            return parseHexString();
+        }
+        if (c == '[') {
+            ++position;
+            PdfObject array;
+            array.kind = PdfObject::Kind::Array;
+            while (true) {
+                skipWhitespace();
+                if (at(position) == ']') {
+                    ++position;
+                    return array;
+                }
+                array.items.push_back(parseObject(depth + 1));
+            }
+        }
+        if ((c >= '0' && c <= '9') || c == '+' || c == '-' || c == '.') {
+            return parseNumberOrReference();
+        }
+        if (isDelimiter(c)) {
+            throw MalformedPdf("unexpected delimiter");
+        }
+
+        PdfObject keyword;
+        std::size_t start = position;
+        while (position < data.size() && !isWhitespace(data[position]) && !isDelimiter(data[position])) {
+            ++position;
+        }
+        keyword.text.assign(reinterpret_cast<const char*>(data.data() + start), position - start);
+        if (keyword.text == "true" || keyword.text == "false") {
+            keyword.kind = PdfObject::Kind::Boolean;
+            keyword.integer = keyword.text == "true";
+        } else if (keyword.text == "null") {
+            keyword.kind = PdfObject::Kind::Null;
+        } else {
+            keyword.kind = PdfObject::Kind::Keyword;
+        }
+        return keyword;
+    }
+
+private:
+    uint8_t at(std::size_t index) const {
+        if (index >= data.size()) {
+            throw MalformedPdf("unexpected end of data");
+        }
+        return data[index];
+    }
+
+    PdfObject parseName() {
+        PdfObject name;
+        name.kind = PdfObject::Kind::Name;
+        while (position < data.size() && !isWhitespace(data[position]) && !isDelimiter(data[position])) {
+            uint8_t c = data[position++];
+            if (c == '#' && position + 1 < data.size() && hexValue(data[position]) >= 0 && hexValue(data[position + 1]) >= 0) {
+                c = static_cast<uint8_t>(hexValue(data[position]) * 16 + hexValue(data[position + 1]));
+                position += 2;
+            }
+            name.text.push_back(static_cast<char>(c));
+        }
+        return name;
+    }
+
+    PdfObject parseLiteralString() {
+        PdfObject string;
+        string.kind = PdfObject::Kind::String;
+        int nesting = 1;
+        while (true) {
+            uint8_t c = at(position++);
+            if (c == '(') {
+                ++nesting;
+            } else if (c == ')') {
+                if (--nesting == 0) {
+                    return string;
+                }
+            } else if (c == '\r') {
+                // An unescaped end of line is always read as a single line feed
+                if (position < data.size() && data[position] == '\n') {
+                    ++position;
+                }
+                c = '\n';
+            } else if (c == '\\') {
+                c = at(position++);
+                switch (c) {
+                    case 'n': c = '\n'; break;
+                    case 'r': c = '\r'; break;
+                    case 't': c = '\t'; break;
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case '\r':
+                        if (position < data.size() && data[position] == '\n') {
+                            ++position;
+                        }
+                        continue;
+                    case '\n':
+                        continue;
+                    default:
+                        if (c >= '0' && c <= '7') {
+                            int value = c - '0';
+                            for (int i = 0; i < 2 && position < data.size() && data[position] >= '0' && data[position] <= '7'; ++i) {
+                                value = value * 8 + (data[position++] - '0');
+                            }
+                            c = static_cast<uint8_t>(value);
+                        }
+                        break;
+                }
+            }
+            string.text.push_back(static_cast<char>(c));
+        }
+    }
+
+    PdfObject parseHexString() {
+        PdfObject string;
+        string.kind = PdfObject::Kind::String;
+        int high = -1;
+        while (true) {
+            uint8_t c = at(position++);
+            if (c == '>') {
+                break;
+            }
+            int value = hexValue(c);
+            if (value < 0) {
+                if (isWhitespace(c)) {
+                    continue;
+                }
+                throw MalformedPdf("bad hex string");
+            }
+            if (high < 0) {
+                high = value;
+            } else {
+                string.text.push_back(static_cast<char>(high * 16 + value));
+                high = -1;
+            }
+        }
+        if (high >= 0) {
+            string.text.push_back(static_cast<char>(high * 16));
+        }
+        return string;
+    }
+
+    PdfObject parseDictionary(int depth) {
+        PdfObject dictionary;
+        dictionary.kind = PdfObject::Kind::Dictionary;
+        while (true) {
+            skipWhitespace();
+            if (at(position) == '>' && at(position + 1) == '>') {
+                position += 2;
+                return dictionary;
+            }
+            PdfObject key = parseObject(depth + 1);
+            if (key.kind != PdfObject::Kind::Name) {
+                throw MalformedPdf("dictionary key is not a name");
+            }
+            dictionary.keys.push_back(std::move(key.text));
+            dictionary.items.push_back(parseObject(depth + 1));
+        }
+    }
+
+    PdfObject parseNumberOrReference() {
+        PdfObject number = parseNumber();
+        if (number.kind != PdfObject::Kind::Integer || number.integer < 0) {
+            return number;
+        }
+
+        // "N G R" is a reference; anything else leaves the lexer right after the first number
+        std::size_t saved = position;
+        skipWhitespace();
+        if (position < data.size() && data[position] >= '0' && data[position] <= '9') {
+            PdfObject generation = parseNumber();
+            if (generation.kind == PdfObject::Kind::Integer && consumeKeyword("R")) {
+                number.kind = PdfObject::Kind::Reference;
+                number.generation = static_cast<uint32_t>(generation.integer);
+                return number;
+            }
+        }
+        position = saved;
+        return number;
+    }
+
+    PdfObject parseNumber() {
+        PdfObject number;
+        number.kind = PdfObject::Kind::Integer;
+        std::size_t start = position;
+        if (data[position] == '+' || data[position] == '-') {
+            ++position;
+        }
+        bool digits = false;
+        while (position < data.size() && ((data[position] >= '0' && data[position] <= '9') || data[position] == '.')) {
+            if (data[position] == '.') {
+                number.kind = PdfObject::Kind::Real;
+            } else {
+                digits = true;
+            }
+            ++position;
+        }
+        if (!digits) {
+            throw MalformedPdf("bad number");
+        }
+        number.text.assign(reinterpret_cast<const char*>(data.data() + start), position - start);
+        if (number.kind == PdfObject::Kind::Integer) {
+            number.integer = std::stoll(number.text);
+        }
+        return number;
+    }
+
+    std::span<const uint8_t> data;
+    std::size_t position;
+};
+
+std::string inflate(std::span<const uint8_t> compressed) {
+    z_stream stream{};
+    if (inflateInit(&stream) != Z_OK) {
+        throw MalformedPdf("zlib init failed");
+    }
+    std::unique_ptr<z_stream, int (*)(z_stream*)> guard(&stream, inflateEnd);
+
+    std::string output;
+    stream.next_in = const_cast<Bytef*>(compressed.data());
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    char buffer[16384];
+    int status = Z_OK;
+    while (status != Z_STREAM_END) {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        status = ::inflate(&stream, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END) {
+            // Tolerate a truncated tail as long as something was decoded
+            if (status == Z_BUF_ERROR && !output.empty()) {
+                break;
+            }
+            throw MalformedPdf("bad flate data");
+        }
+        output.append(buffer, sizeof(buffer) - stream.avail_out);
+        if (output.size() > MaxInflatedSize) {
+            throw MalformedPdf("stream too large");
+        }
+        if (stream.avail_in == 0 && status != Z_STREAM_END && stream.avail_out != 0) {
+            break;
+        }
+    }
+    return output;
+}
+
+// Undoes the PNG row predictors (10-15) of a FlateDecode stream
+std::string unpredict(const std::string& data, int columns) {
+    if (columns <= 0) {
+        throw MalformedPdf("bad predictor columns");
+    }
+    std::size_t rowSize = static_cast<std::size_t>(columns);
+    std::string output;
+    output.reserve(data.size());
+    std::string previous(rowSize, '\0');
+    for (std::size_t row = 0; row + rowSize + 1 <= data.size(); row += rowSize + 1) {
+        uint8_t filter = static_cast<uint8_t>(data[row]);
+        std::string current = data.substr(row + 1, rowSize);
+        for (std::size_t i = 0; i < rowSize; ++i) {
+            uint8_t left = i > 0 ? static_cast<uint8_t>(current[i - 1]) : 0;
+            uint8_t up = static_cast<uint8_t>(previous[i]);
+            uint8_t upLeft = i > 0 ? static_cast<uint8_t>(previous[i - 1]) : 0;
+            uint8_t value = static_cast<uint8_t>(current[i]);
+            switch (filter) {
+                case 0: break;
+                case 1: value = static_cast<uint8_t>(value + left); break;
+                case 2: value = static_cast<uint8_t>(value + up); break;
+                case 3: value = static_cast<uint8_t>(value + (left + up) / 2); break;
+                case 4: {
+                    int p = left + up - upLeft;
+                    int pa = std::abs(p - left), pb = std::abs(p - up), pc = std::abs(p - upLeft);
+                    value = static_cast<uint8_t>(value + ((pa <= pb && pa <= pc) ? left : (pb <= pc ? up : upLeft)));
+                    break;
+                }
+                default:
+                    throw MalformedPdf("bad PNG predictor");
+            }
+            current[i] = static_cast<char>(value);
+        }
+        output += current;
+        previous.swap(current);
+    }
+    return output;
+}
+
+void appendUtf8(std::string& out, char32_t code) {
+    if (code < 0x80) {
+        out.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+}
+
+// PDFDocEncoding code points that differ from Latin-1
+constexpr char16_t PdfDocLow[8] = {0x02D8, 0x02C7, 0x02C6, 0x02D9, 0x02DD, 0x02DB, 0x02DA, 0x02DC}; // 0x18-0x1F
+constexpr char16_t PdfDocHigh[33] = {                                                               // 0x80-0xA0
+    0x2022, 0x2020, 0x2021, 0x2026, 0x2014, 0x2013, 0x0192, 0x2044, 0x2039, 0x203A, 0x2212,
+    0x2030, 0x201E, 0x201C, 0x201D, 0x2018, 0x2019, 0x201A, 0x2122, 0xFB01, 0xFB02, 0x0141,
+    0x0152, 0x0160, 0x0178, 0x017D, 0x0131, 0x0142, 0x0153, 0x0161, 0x017E, 0xFFFD, 0x20AC};
+
+// Decodes a PDF text string (UTF-16BE with BOM, UTF-8 with BOM, or PDFDocEncoding) to UTF-8
+std::string decodeTextString(const std::string& raw) {
+    std::string out;
+    if (raw.size() >= 2 && static_cast<uint8_t>(raw[0]) == 0xFE && static_cast<uint8_t>(raw[1]) == 0xFF) {
+        for (std::size_t i = 2; i + 1 < raw.size(); i += 2) {
+            char32_t unit = (static_cast<uint8_t>(raw[i]) << 8) | static_cast<uint8_t>(raw[i + 1]);
+            if (unit >= 0xD800 && unit < 0xDC00 && i + 3 < raw.size()) {
+                char32_t low = (static_cast<uint8_t>(raw[i + 2]) << 8) | static_cast<uint8_t>(raw[i + 3]);
+                if (low >= 0xDC00 && low < 0xE000) {
+                    unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                    i += 2;
+                }
+            }
+            appendUtf8(out, unit);
+        }
+        return out;
+    }
+    if (raw.size() >= 3 && raw.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+        return raw.substr(3);
+    }
+    for (char ch : raw) {
+        uint8_t c = static_cast<uint8_t>(ch);
+        if (c >= 0x18 && c <= 0x1F) {
+            appendUtf8(out, PdfDocLow[c - 0x18]);
+        } else if (c >= 0x80 && c <= 0xA0) {
+            appendUtf8(out, PdfDocHigh[c - 0x80]);
+        } else {
+            appendUtf8(out, c);
+        }
+    }
+    return out;
+}
+
+class PdfStructureReader {
+public:
+    explicit PdfStructureReader(std::span<const uint8_t> data) : data(data) {}
+
+    PdfInfo read() {
+        PdfInfo info;
+        std::size_t headerEnd = std::min<std::size_t>(data.size(), 1024);
+        std::string_view head(reinterpret_cast<const char*>(data.data()), headerEnd);
+        std::size_t versionAt = head.find("%PDF-");
+        if (versionAt != std::string_view::npos) {
+            std::size_t end = versionAt + 5;
+            while (end < head.size() && (std::isdigit(static_cast<unsigned char>(head[end])) || head[end] == '.')) {
+                ++end;
+            }
+            info.version = std::string(head.substr(versionAt + 5, end - versionAt - 5));
+        }
+
+        loadSection(findStartXref());
+        for (const PdfObject& trailer : trailers) {
+            if (trailer.get("Encrypt")) {
+                throw MalformedPdf("encrypted");
+            }
+        }
+
+        const PdfObject* infoReference = nullptr;
+        for (const PdfObject& trailer : trailers) {
+            if ((infoReference = trailer.get("Info"))) {
+                break;
+            }
+        }
+        if (!infoReference) {
+            return info; // a valid PDF without an Info dictionary
+        }
+
+        PdfObject dictionary = resolve(*infoReference, 0);
+        if (dictionary.kind != PdfObject::Kind::Dictionary) {
+            throw MalformedPdf("Info is not a dictionary");
+        }
+        auto text = [&](std::string_view key) -> std::string {
+            const PdfObject* value = dictionary.get(key);
+            if (!value) {
+                return {};
+            }
+            PdfObject resolved = resolve(*value, 0);
+            return resolved.kind == PdfObject::Kind::String ? decodeTextString(resolved.text) : std::string();
+        };
+        info.title = text("Title");
+        info.author = text("Author");
+        info.subject = text("Subject");
+        info.keywords = text("Keywords");
+        info.creator = text("Creator");
+        info.producer = text("Producer");
+        info.creationDate = parsePdfDate(text("CreationDate"));
+        info.modificationDate = parsePdfDate(text("ModDate"));
+        return info;
+    }
+
+private:
+    struct Subsection {
+        uint32_t first = 0;
+        uint32_t count = 0;
+        std::size_t position = 0; // file offset of the first entry (classic) or entry index (stream)
+    };
+
+    struct XrefSection {
+        bool isStream = false;
+        std::vector<Subsection> subsections;
+        std::string entries; // decoded xref stream data
+        int widths[3] = {0, 0, 0};
+    };
+
+    struct Location {
+        enum class Kind { None, Offset, Compressed } kind = Kind::None;
+        uint64_t value = 0;  // file offset, or object stream number
+        uint32_t index = 0;  // index within the object stream
+    };
+
+    struct LoadedObject {
+        PdfObject object;
+        std::size_t streamStart = 0; // where stream data begins, 0 if the object is not a stream
+    };
+
+    std::size_t findStartXref() const {
+        std::size_t tail = std::min<std::size_t>(data.size(), 2048);
+        std::string_view end(reinterpret_cast<const char*>(data.data() + data.size() - tail), tail);
+        std::size_t at = end.rfind("startxref");
+        if (at == std::string_view::npos) {
+            throw MalformedPdf("startxref not found");
+        }
+        Lexer lexer(data, data.size() - tail + at + 9);
+        int64_t offset = lexer.parseInteger();
+        if (offset <= 0 || static_cast<uint64_t>(offset) >= data.size()) {
+            throw MalformedPdf("startxref out of range");
+        }
+        return static_cast<std::size_t>(offset);
+    }
+
+    void loadSection(std::size_t offset) {
+        if (sections.size() >= MaxSections || !visited.insert(offset).second) {
+            return; // cycles and runaway chains end here
+        }
+
+        Lexer lexer(data, offset);
+        PdfObject trailer;
+        if (lexer.consumeKeyword("xref")) {
+            XrefSection section;
+            while (!lexer.consumeKeyword("trailer")) {
+                Subsection subsection;
+                subsection.first = static_cast<uint32_t>(lexer.parseInteger());
+                subsection.count = static_cast<uint32_t>(lexer.parseInteger());
+                lexer.skipWhitespace();
+                subsection.position = lexer.offset();
+                if (subsection.position + uint64_t{subsection.count} * 20 > data.size()) {
+                    throw MalformedPdf("xref table out of range");
+                }
+                section.subsections.push_back(subsection);
+                Lexer skip(data, subsection.position + std::size_t{subsection.count} * 20);
+                lexer = skip;
+            }
+            trailer = lexer.parseObject();
+            sections.push_back(std::move(section));
+            trailers.push_back(trailer);
+
+            // Hybrid files: entries missing from the table are looked up in /XRefStm before /Prev
+            if (const PdfObject* stream = trailer.get("XRefStm"); stream && stream->kind == PdfObject::Kind::Integer) {
+                loadSection(static_cast<std::size_t>(stream->integer));
+            }
+        } else {
+            LoadedObject loaded = parseIndirectObject(offset);
+            trailer = loaded.object;
+            const PdfObject* type = trailer.get("Type");
+            if (!type || !type->isName("XRef") || !loaded.streamStart) {
+                throw MalformedPdf("startxref does not point at an xref section");
+            }
+
+            XrefSection section;
+            section.isStream = true;
+            section.entries = readStream(trailer, loaded.streamStart, 0);
+            const PdfObject* widths = trailer.get("W");
+            if (!widths || widths->kind != PdfObject::Kind::Array || widths->items.size() != 3) {
+                throw MalformedPdf("bad /W");
+            }
+            for (int i = 0; i < 3; ++i) {
+                section.widths[i] = static_cast<int>(widths->items[i].integer);
+                if (section.widths[i] < 0 || section.widths[i] > 8) {
+                    throw MalformedPdf("bad /W");
+                }
+            }
+
+            std::size_t index = 0;
+            const PdfObject* ranges = trailer.get("Index");
+            if (ranges && ranges->kind == PdfObject::Kind::Array) {
+                for (std::size_t i = 0; i + 1 < ranges->items.size(); i += 2) {
+                    Subsection subsection{static_cast<uint32_t>(ranges->items[i].integer),
+                                          static_cast<uint32_t>(ranges->items[i + 1].integer), index};
+                    index += subsection.count;
+                    section.subsections.push_back(subsection);
+                }
+            } else if (const PdfObject* size = trailer.get("Size")) {
+                section.subsections.push_back(Subsection{0, static_cast<uint32_t>(size->integer), 0});
+            }
+            sections.push_back(std::move(section));
+            trailers.push_back(trailer);
+        }
+
+        if (const PdfObject* previous = trailer.get("Prev"); previous && previous->kind == PdfObject::Kind::Integer) {
+            loadSection(static_cast<std::size_t>(previous->integer));
+        }
+    }
+
+    Location locate(uint32_t objectNumber) const {
+        for (const XrefSection& section : sections) {
+            for (const Subsection& subsection : section.subsections) {
+                if (objectNumber < subsection.first || objectNumber - subsection.first >= subsection.count) {
+                    continue;
+                }
+                uint32_t slot = objectNumber - subsection.first;
+                Location location;
+
+                if (!section.isStream) {
+                    std::size_t entry = subsection.position + std::size_t{slot} * 20;
+                    std::string_view text(reinterpret_cast<const char*>(data.data() + entry), 18);
+                    if (text[17] != 'n') {
+                        return location; // free
+                    }
+                    location.kind = Location::Kind::Offset;
+                    location.value = std::stoull(std::string(text.substr(0, 10)));
+                    return location;
+                }
+
+                int entrySize = section.widths[0] + section.widths[1] + section.widths[2];
+                std::size_t entry = (subsection.position + slot) * static_cast<std::size_t>(entrySize);
+                if (entry + static_cast<std::size_t>(entrySize) > section.entries.size()) {
+                    throw MalformedPdf("xref stream entry out of range");
+                }
+                uint64_t fields[3] = {1, 0, 0}; // type defaults to 1 when its width is 0
+                for (int f = 0; f < 3; ++f) {
+                    if (section.widths[f] == 0) {
+                        continue;
+                    }
+                    fields[f] = 0;
+                    for (int b = 0; b < section.widths[f]; ++b) {
+                        fields[f] = (fields[f] << 8) | static_cast<uint8_t>(section.entries[entry++]);
+                    }
+                }
+                if (fields[0] == 1) {
+                    location.kind = Location::Kind::Offset;
+                    location.value = fields[1];
+                } else if (fields[0] == 2) {
+                    location.kind = Location::Kind::Compressed;
+                    location.value = fields[1];
+                    location.index = static_cast<uint32_t>(fields[2]);
+                }
+                return location;
+            }
+        }
+        return {};
+    }
+
+    // Parses "N G obj <object> [stream]" at a file offset
+    LoadedObject parseIndirectObject(std::size_t offset) {
+        Lexer lexer(data, offset);
+        lexer.parseInteger();
+        lexer.parseInteger();
+        if (!lexer.consumeKeyword("obj")) {
+            throw MalformedPdf("obj expected");
+        }
+        LoadedObject loaded;
+        loaded.object = lexer.parseObject();
+        if (loaded.object.kind == PdfObject::Kind::Dictionary && lexer.consumeKeyword("stream")) {
+            std::size_t start = lexer.offset();
+            if (start < data.size() && data[start] == '\r') {
+                ++start;
+            }
+            if (start < data.size() && data[start] == '\n') {
+                ++start;
+            }
+            loaded.streamStart = start;
+        }
+        return loaded;
+    }
+
+    LoadedObject loadObject(uint32_t objectNumber, int depth) {
+        if (depth > MaxDepth) {
+            throw MalformedPdf("reference chain too long");
+        }
+        Location location = locate(objectNumber);
+        if (location.kind == Location::Kind::Offset) {
+            if (location.value >= data.size()) {
+                throw MalformedPdf("object offset out of range");
+            }
+            return parseIndirectObject(static_cast<std::size_t>(location.value));
+        }
+        if (location.kind == Location::Kind::Compressed) {
+            return LoadedObject{loadFromObjectStream(static_cast<uint32_t>(location.value), objectNumber, depth), 0};
+        }
+        return {}; // free or missing objects are null
+    }
+
+    PdfObject loadFromObjectStream(uint32_t streamNumber, uint32_t objectNumber, int depth) {
+        auto cached = objectStreams.find(streamNumber);
+        if (cached == objectStreams.end()) {
+            LoadedObject stream = loadObject(streamNumber, depth + 1);
+            if (!stream.streamStart) {
+                throw MalformedPdf("object stream expected");
+            }
+            cached = objectStreams.emplace(streamNumber, ObjectStream{stream.object, readStream(stream.object, stream.streamStart, depth + 1)}).first;
+        }
+
+        const ObjectStream& objectStream = cached->second;
+        const PdfObject* count = objectStream.dictionary.get("N");
+        const PdfObject* first = objectStream.dictionary.get("First");
+        if (!count || !first) {
+            throw MalformedPdf("bad object stream");
+        }
+        std::span<const uint8_t> content(reinterpret_cast<const uint8_t*>(objectStream.data.data()), objectStream.data.size());
+        Lexer header(content, 0);
+        for (int64_t i = 0; i < count->integer; ++i) {
+            int64_t number = header.parseInteger();
+            int64_t offset = header.parseInteger();
+            if (number == objectNumber) {
+                Lexer lexer(content, static_cast<std::size_t>(first->integer + offset));
+                return lexer.parseObject();
+            }
+        }
+        throw MalformedPdf("object missing from its object stream");
+    }
+
+    PdfObject resolve(const PdfObject& object, int depth) {
+        if (object.kind != PdfObject::Kind::Reference) {
+            return object;
+        }
+        return resolve(loadObject(static_cast<uint32_t>(object.integer), depth + 1).object, depth + 1);
+    }
+
+    std::string readStream(const PdfObject& dictionary, std::size_t start, int depth) {
+        const PdfObject* lengthObject = dictionary.get("Length");
+        PdfObject length = lengthObject ? resolve(*lengthObject, depth + 1) : PdfObject{};
+        std::size_t size;
+        if (length.kind == PdfObject::Kind::Integer && length.integer >= 0 &&
+            start + static_cast<uint64_t>(length.integer) <= data.size()) {
+            size = static_cast<std::size_t>(length.integer);
+        } else {
+            std::string_view rest(reinterpret_cast<const char*>(data.data() + start), data.size() - start);
+            std::size_t end = rest.find("endstream");
+            if (end == std::string_view::npos) {
+                throw MalformedPdf("endstream not found");
+            }
+            size = end;
+        }
+        std::span<const uint8_t> raw = data.subspan(start, size);
+
+        const PdfObject* filter = dictionary.get("Filter");
+        if (filter && filter->kind == PdfObject::Kind::Array && filter->items.size() == 1) {
+            filter = &filter->items[0];
+        }
+        if (!filter) {
+            return std::string(reinterpret_cast<const char*>(raw.data()), raw.size());
+        }
+        if (!filter->isName("FlateDecode")) {
+            throw MalformedPdf("unsupported stream filter");
+        }
+
+        std::string decoded = inflate(raw);
+        const PdfObject* parameters = dictionary.get("DecodeParms");
+        if (parameters && parameters->kind == PdfObject::Kind::Array && parameters->items.size() == 1) {
+            parameters = &parameters->items[0];
+        }
+        if (parameters && parameters->kind == PdfObject::Kind::Dictionary) {
+            const PdfObject* predictor = parameters->get("Predictor");
+            if (predictor && predictor->integer >= 10) {
+                const PdfObject* columns = parameters->get("Columns");
+                decoded = unpredict(decoded, columns ? static_cast<int>(columns->integer) : 1);
+            } else if (predictor && predictor->integer > 1) {
+                throw MalformedPdf("unsupported predictor");
+            }
+        }
+        return decoded;
+    }
+
+    struct ObjectStream {
+        PdfObject dictionary;
+        std::string data;
+    };
+
+    std::span<const uint8_t> data;
+    std::vector<XrefSection> sections; // newest first
+    std::vector<PdfObject> trailers;   // newest first
+    std::set<std::size_t> visited;
+    std::map<uint32_t, ObjectStream> objectStreams;
+};
+
+bool allDigits(std::string_view text) {
+    return !text.empty() && std::all_of(text.begin(), text.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+}
+
+std::optional<PdfInfo> readPdfInfo(std::span<const uint8_t> data) {
+    try {
+        return PdfStructureReader(data).read();
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+
+std::optional<Timestamp> parsePdfDate(std::string_view date) {
+    std::string_view text = date;
+    if (text.substr(0, 2) == "D:") {
+        text.remove_prefix(2);
+    }
+    if (text.size() < 4 || !allDigits(text.substr(0, 4))) {
+        return std::nullopt;
+    }
+
+    // Missing trailing components default to the start of the period
+    auto part = [](std::string_view from, std::size_t at, std::size_t length, int fallback) {
+        std::string_view value = from.substr(std::min(at, from.size()), length);
+        int number = fallback;
+        if (value.size() == length && allDigits(value)) {
+            std::from_chars(value.data(), value.data() + value.size(), number);
+        }
+        return number;
+    };
+    std::chrono::year_month_day day{std::chrono::year(part(text, 0, 4, 0)), std::chrono::month(static_cast<unsigned>(part(text, 4, 2, 1))),
+                                    std::chrono::day(static_cast<unsigned>(part(text, 6, 2, 1)))};
+    int hour = part(text, 8, 2, 0);
+    int minute = part(text, 10, 2, 0);
+    int second = part(text, 12, 2, 0);
+    if (!day.ok() || hour > 23 || minute > 59 || second > 60) {
+        return std::nullopt;
+    }
+    int64_t seconds = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::sys_days(day).time_since_epoch()).count() +
+                      hour * 3600 + minute * 60 + second;
+
+    if (text.size() > 14 && (text[14] == '+' || text[14] == '-')) {
+        std::string_view zone = text.substr(15);
+        int offset = part(zone, 0, 2, 0) * 3600 + part(zone, 3, 2, 0) * 60;
+        seconds -= text[14] == '-' ? -offset : offset;
+    }
+    return Timestamp{seconds, 0};
+}
@@ -0,0 +1,150 @@
+#include "PngReader.h"
+#include "Crc32.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace {
+
+constexpr std::size_t ChunkOverhead = 12;   // length, type and CRC
+constexpr uint32_t MaxChunkLength = 0x7FFFFFFF;
+
+//tEXt and zTXt are Latin-1; PNG text is handed on as UTF-8.
+void appendLatin1(std::pmr::string& out, std::string_view text) {
+    for (char c : text) {
+        auto byte = static_cast<unsigned char>(c);
+        if (byte < 0x80) {
+            out.push_back(c);
+        } else {
+            out.push_back(static_cast<char>(0xC0 | (byte >> 6)));
+            out.push_back(static_cast<char>(0x80 | (byte & 0x3F)));
+        }
+    }
+}
+
+//Inflates a zlib stream into `out`, stopping at `PngReader::MaxTextLength` bytes; false if the stream is corrupt.
+bool inflateText(std::pmr::string& out, std::string_view compressed) {
+    z_stream stream{};
+    if (inflateInit(&stream) != Z_OK) {
+        return false;
+    }
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    char buffer[4096];
+    int status = Z_OK;
+    while (status == Z_OK && out.size() < PngReader::MaxTextLength) {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        status = inflate(&stream, Z_NO_FLUSH);
+        std::size_t produced = sizeof(buffer) - stream.avail_out;
+        out.append(buffer, std::min(produced, PngReader::MaxTextLength - out.size()));
+    }
+    inflateEnd(&stream);
+    return status == Z_OK || status == Z_STREAM_END;
+}
+
+}
+
+PngReader::PngReader(std::span<const uint8_t> file) : reader(file) {
+    if (!reader.matches(0, Signature)) {
+        throw std::runtime_error("PNG: bad signature");
+    }
+    uint64_t offset = Signature.size();
+    PngChunk chunk;
+    if (!readChunk(offset, chunk) || chunk.type != "IHDR" || chunk.data.size() < 13) {
+        throw std::runtime_error("PNG: missing IHDR chunk");
+    }
+    ByteReader fields(chunk.data);
+    imageHeader.width = fields.u32be(0);
+    imageHeader.height = fields.u32be(4);
+    imageHeader.bitDepth = fields.u8(8);
+    imageHeader.colorType = fields.u8(9);
+    imageHeader.compression = fields.u8(10);
+    imageHeader.filter = fields.u8(11);
+    imageHeader.interlace = fields.u8(12);
+}
+
+bool PngReader::readChunk(uint64_t& offset, PngChunk& chunk) const {
+    if (!reader.has(offset, ChunkOverhead)) {
+        return false;
+    }
+    uint32_t length = reader.u32be(offset);
+    if (length > MaxChunkLength || !reader.has(offset, ChunkOverhead + length)) {
+        return false;
+    }
+    chunk.offset = offset;
+    chunk.type = reader.chars(offset + 4, 4);
+    chunk.data = reader.bytes(offset + 8, length);
+    chunk.crc = reader.u32be(offset + 8 + length);
+    offset += ChunkOverhead + length;
+    return true;
+}
+
+bool PngReader::hasValidCrc(const PngChunk& chunk) {
+    // The type immediately precedes the data, so one pass covers both
+    std::span<const uint8_t> covered(reinterpret_cast<const uint8_t*>(chunk.type.data()), chunk.type.size() + chunk.data.size());
+    return updateCrc32(0, covered) == chunk.crc;
+}
+
+std::optional<PngText> PngReader::decodeText(const PngChunk& chunk, std::pmr::memory_resource* memory) {
+    std::string_view body(reinterpret_cast<const char*>(chunk.data.data()), chunk.data.size());
+    std::size_t keywordEnd = body.find('\0');
+    if (keywordEnd == 0 || keywordEnd == std::string_view::npos) {
+        return std::nullopt;
+    }
+    PngText result{body.substr(0, keywordEnd), std::pmr::string(memory)};
+    std::string_view rest = body.substr(keywordEnd + 1);
+
+    if (chunk.type == "tEXt") {
+        appendLatin1(result.text, rest.substr(0, MaxTextLength));
+    } else if (chunk.type == "zTXt") {
+        // Compression method (0 = zlib), then the compressed Latin-1 text
+        std::pmr::string latin1(memory);
+        if (rest.empty() || rest[0] != 0 || !inflateText(latin1, rest.substr(1))) {
+            return std::nullopt;
+        }
+        appendLatin1(result.text, latin1);
+    } else if (chunk.type == "iTXt") {
+        // Compression flag and method, language tag, translated keyword, then the UTF-8 text
+        if (rest.size() < 2) {
+            return std::nullopt;
+        }
+        bool compressed = rest[0] != 0;
+        if (compressed && rest[1] != 0) {
+            return std::nullopt;
+        }
+        std::size_t languageEnd = rest.find('\0', 2);
+        std::size_t translatedEnd = languageEnd == std::string_view::npos ? languageEnd : rest.find('\0', languageEnd + 1);
+        if (translatedEnd == std::string_view::npos) {
+            return std::nullopt;
+        }
+        std::string_view text = rest.substr(translatedEnd + 1);
+        if (compressed) {
+            if (!inflateText(result.text, text)) {
+                return std::nullopt;
+            }
+        } else {
+            result.text.assign(text.substr(0, MaxTextLength));
+        }
+    } else {
+        return std::nullopt;
+    }
+    return result;
+}
+
+std::optional<Timestamp> PngReader::decodeTime(const PngChunk& chunk) {
+    if (chunk.type != "tIME" || chunk.data.size() != 7) {
+        return std::nullopt;
+    }
+    ByteReader fields(chunk.data);
+    std::chrono::year_month_day date{std::chrono::year(fields.u16be(0)), std::chrono::month(fields.u8(2)), std::chrono::day(fields.u8(3))};
+    unsigned hour = fields.u8(4);
+    unsigned minute = fields.u8(5);
+    unsigned second = fields.u8(6);
+    if (!date.ok() || hour > 23 || minute > 59 || second > 60) {
+        return std::nullopt;
+    }
+    auto days = std::chrono::sys_days(date).time_since_epoch();
+    return Timestamp{std::chrono::duration_cast<std::chrono::seconds>(days).count() + hour * 3600 + minute * 60 + second, 0};
+}
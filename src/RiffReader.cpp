@@ -0,0 +1,72 @@
+#include "RiffReader.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+RiffReader::RiffReader(std::span<const uint8_t> file) : reader(file) {
+    if (!reader.has(0, 12)) {
+        throw std::runtime_error("RIFF: file too small");
+    }
+    if (reader.matches(0, "RIFF")) {
+        bodySize = reader.u32le(4);
+        return;
+    }
+    if (!reader.matches(0, "RF64") && !reader.matches(0, "BW64")) {
+        throw std::runtime_error("RIFF: bad signature");
+    }
+
+    // ds64: RIFF size, data size and sample count, then a table of other oversized chunks
+    sizes64 = true;
+    if (!reader.matches(12, "ds64") || !reader.has(20, 28)) {
+        throw std::runtime_error("RIFF: RF64 file without a ds64 chunk");
+    }
+    bodySize = reader.u64le(20);
+    ds64Sizes[ds64Count++] = Size64{"data", reader.u64le(28)};
+    sampleCount = reader.u64le(36);
+    uint32_t tableLength = reader.u32le(44);
+    for (uint32_t i = 0; i < tableLength && ds64Count < ds64Sizes.size() && reader.has(48 + 12 * i, 12); ++i) {
+        ds64Sizes[ds64Count++] = Size64{reader.chars(48 + 12 * i, 4), reader.u64le(52 + 12 * i)};
+    }
+}
+
+bool RiffReader::readChunk(const ByteReader& bytes, uint64_t& offset, RiffChunk& chunk, const RiffReader* sizes) {
+    if (!bytes.has(offset, 8)) {
+        return false;
+    }
+    chunk.offset = offset;
+    chunk.id = bytes.chars(offset, 4);
+    chunk.size = bytes.u32le(offset + 4);
+    if (sizes && sizes->sizes64 && chunk.size == 0xFFFFFFFF) {
+        for (std::size_t i = 0; i < sizes->ds64Count; ++i) {
+            if (sizes->ds64Sizes[i].id == chunk.id) {
+                chunk.size = sizes->ds64Sizes[i].size;
+                break;
+            }
+        }
+    }
+
+    uint64_t body = offset + 8;
+    uint64_t available = std::min<uint64_t>(chunk.size, bytes.size() - body);
+    chunk.data = bytes.bytes(body, available);
+
+    // Bodies are padded to an even length; a size running past the end leaves the offset past the end too
+    uint64_t padded = chunk.size + (chunk.size & 1);
+    offset = padded > std::numeric_limits<uint64_t>::max() - body ? std::numeric_limits<uint64_t>::max() : body + padded;
+    return true;
+}
+
+std::string_view RiffReader::listType(const RiffChunk& chunk) {
+    if (chunk.id != "LIST" || chunk.data.size() < 4) {
+        return {};
+    }
+    return std::string_view(reinterpret_cast<const char*>(chunk.data.data()), 4);
+}
+
+std::string_view RiffReader::text(std::span<const uint8_t> field) {
+    std::string_view value(reinterpret_cast<const char*>(field.data()), field.size());
+    value = value.substr(0, value.find('\0'));
+    while (!value.empty() && value.back() == ' ') {
+        value.remove_suffix(1);
+    }
+    return value;
+}
@@ -0,0 +1,208 @@
+#include "StageStats.h"
+#include <mutex>
+#include <string>
+#include <sys/sysmacros.h>
+
+namespace {
+
+std::mutex registryMutex;
+std::vector<std::unique_ptr<StageThreadStats>> registry;    // every thread that recorded, never shrinks
+std::chrono::steady_clock::time_point enabledAt;
+
+const char* typeSlotName(std::size_t typeSlot) {
+    return typeSlot == AnyTypeSlot ? "*" : fileTypeName(static_cast<FileType>(typeSlot));
+}
+
+// Nanoseconds with three significant digits and a unit, e.g. "850ns", "12.3us", "4.56ms"
+std::string formatDuration(double nanoseconds) {
+    static constexpr const char* Units[] = {"ns", "us", "ms", "s"};
+    std::size_t unit = 0;
+    while (nanoseconds >= 1000 && unit + 1 < std::size(Units)) {
+        nanoseconds /= 1000;
+        ++unit;
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), nanoseconds >= 100 || unit == 0 ? "%.0f%s" : nanoseconds >= 10 ? "%.1f%s" : "%.2f%s",
+                  nanoseconds, Units[unit]);
+    return text;
+}
+
+}
+
+const char* stageName(Stage stage) {
+    switch (stage) {
+        case Stage::Open:              return "open";
+        case Stage::DetermineFileType: return "determineFileType";
+        case Stage::BasicMetadata:     return "extractBasicMetadata";
+        case Stage::AnalyzeHelper:     return "analyzeMetadataHelper";
+        case Stage::MergeMap:          return "mergeMap";
+        case Stage::Output:            return "output";
+    }
+    return "unknown";
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (std::size_t i = 0; i < BucketCount; ++i) {
+        counts[i] += other.counts[i];
+    }
+    samples += other.samples;
+    sum += other.sum;
+    minimum = std::min(minimum, other.minimum);
+    maximum = std::max(maximum, other.maximum);
+}
+
+uint64_t LatencyHistogram::upperBound(std::size_t bucket) {
+    if (bucket < SubBuckets) {
+        return bucket;
+    }
+    unsigned shift = static_cast<unsigned>((bucket - SubBuckets) / SubBuckets);
+    uint64_t lower = static_cast<uint64_t>(SubBuckets + (bucket - SubBuckets) % SubBuckets) << shift;
+    return lower + (uint64_t{1} << shift) - 1;
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    if (samples == 0) {
+        return 0;
+    }
+    uint64_t wanted = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * static_cast<double>(samples) + 0.5));
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < BucketCount; ++i) {
+        seen += counts[i];
+        if (seen >= wanted) {
+            return std::min(upperBound(i), maximum);
+        }
+    }
+    return maximum;
+}
+
+void enableStageStats() {
+    enabledAt = std::chrono::steady_clock::now();
+    stageStatsEnabled.store(true, std::memory_order_relaxed);
+}
+
+StageThreadStats& threadStageStats() {
+    thread_local StageThreadStats* stats = [] {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(std::make_unique<StageThreadStats>());
+        return registry.back().get();
+    }();
+    return *stats;
+}
+
+void recordStage(Stage stage, std::size_t typeSlot, uint64_t nanoseconds, uint64_t allocations) {
+    StageThreadStats& stats = threadStageStats();
+    auto index = static_cast<std::size_t>(stage);
+    std::unique_ptr<LatencyHistogram>& histogram = stats.latency[index][typeSlot];
+    if (!histogram) {
+        histogram = std::make_unique<LatencyHistogram>();
+    }
+    histogram->record(nanoseconds);
+    stats.allocations[index][typeSlot] += allocations;
+}
+
+void recordDeviceRead(dev_t device, bool rotational, std::size_t limit, uint64_t nanoseconds) {
+    if (!stageStatsEnabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::vector<std::unique_ptr<DeviceReadStats>>& devices = threadStageStats().devices;
+    auto found = std::find_if(devices.begin(), devices.end(), [device](const auto& stats) { return stats->device == device; });
+    if (found == devices.end()) {
+        devices.push_back(std::make_unique<DeviceReadStats>());
+        devices.back()->device = device;
+        devices.back()->rotational = rotational;
+        found = devices.end() - 1;
+    }
+    (*found)->latency.record(nanoseconds);
+    (*found)->limitSum += limit;
+}
+
+StageReport collectStageStats() {
+    StageReport report;
+    report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - enabledAt).count();
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (std::size_t stage = 0; stage < StageCount; ++stage) {
+        for (std::size_t typeSlot = 0; typeSlot < StageTypeSlots; ++typeSlot) {
+            StageReportRow row{static_cast<Stage>(stage), typeSlot, {}, 0};
+            for (const auto& stats : registry) {
+                if (stats->latency[stage][typeSlot]) {
+                    row.latency.merge(*stats->latency[stage][typeSlot]);
+                    row.allocations += stats->allocations[stage][typeSlot];
+                }
+            }
+            if (row.latency.count() > 0) {
+                report.rows.push_back(std::move(row));
+            }
+        }
+    }
+    for (const auto& stats : registry) {
+        report.syscalls += stats->syscalls;
+        report.bytesRead += stats->bytesRead;
+        for (const auto& device : stats->devices) {
+            auto merged = std::find_if(report.devices.begin(), report.devices.end(),
+                                       [&](const DeviceReadStats& seen) { return seen.device == device->device; });
+            if (merged == report.devices.end()) {
+                report.devices.push_back(DeviceReadStats{device->device, device->rotational, {}, 0});
+                merged = report.devices.end() - 1;
+            }
+            merged->latency.merge(device->latency);
+            merged->limitSum += device->limitSum;
+        }
+    }
+    return report;
+}
+
+void writeStageStatsText(std::FILE* out, const StageReport& report) {
+    std::fprintf(out, "%-22s %-7s %9s %8s %8s %8s %8s %8s %9s %10s\n", "stage", "type", "count", "mean", "p50", "p90",
+                 "p99", "max", "total", "allocs/op");
+    for (const StageReportRow& row : report.rows) {
+        const LatencyHistogram& latency = row.latency;
+        double count = static_cast<double>(latency.count());
+        std::fprintf(out, "%-22s %-7s %9llu %8s %8s %8s %8s %8s %9s %10.2f\n", stageName(row.stage), typeSlotName(row.typeSlot),
+                     static_cast<unsigned long long>(latency.count()), formatDuration(static_cast<double>(latency.total()) / count).c_str(),
+                     formatDuration(static_cast<double>(latency.percentile(0.5))).c_str(),
+                     formatDuration(static_cast<double>(latency.percentile(0.9))).c_str(),
+                     formatDuration(static_cast<double>(latency.percentile(0.99))).c_str(),
+                     formatDuration(static_cast<double>(latency.max())).c_str(),
+                     formatDuration(static_cast<double>(latency.total())).c_str(), static_cast<double>(row.allocations) / count);
+    }
+    std::fprintf(out, "File I/O: %llu system calls, %llu bytes read; wall time %s\n", static_cast<unsigned long long>(report.syscalls),
+                 static_cast<unsigned long long>(report.bytesRead), formatDuration(report.wallSeconds * 1e9).c_str());
+    for (const DeviceReadStats& device : report.devices) {
+        const LatencyHistogram& latency = device.latency;
+        std::fprintf(out, "Device %u:%u (%s): %llu reads, p50 %s, p99 %s, mean concurrency limit %.1f\n", major(device.device),
+                     minor(device.device), device.rotational ? "rotational" : "non-rotational",
+                     static_cast<unsigned long long>(latency.count()), formatDuration(static_cast<double>(latency.percentile(0.5))).c_str(),
+                     formatDuration(static_cast<double>(latency.percentile(0.99))).c_str(),
+                     static_cast<double>(device.limitSum) / static_cast<double>(latency.count()));
+    }
+}
+
+void writeStageStatsJson(std::FILE* out, const StageReport& report) {
+    std::fprintf(out, "{\"wallNanoseconds\":%.0f,\"syscalls\":%llu,\"bytesRead\":%llu,\"stages\":[", report.wallSeconds * 1e9,
+                 static_cast<unsigned long long>(report.syscalls), static_cast<unsigned long long>(report.bytesRead));
+    const char* separator = "";
+    for (const StageReportRow& row : report.rows) {
+        const LatencyHistogram& latency = row.latency;
+        std::fprintf(out, "%s{\"stage\":\"%s\",\"type\":\"%s\",\"count\":%llu,\"totalNanoseconds\":%llu,\"min\":%llu,"
+                          "\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu,\"allocations\":%llu}",
+                     separator, stageName(row.stage), typeSlotName(row.typeSlot), static_cast<unsigned long long>(latency.count()),
+                     static_cast<unsigned long long>(latency.total()), static_cast<unsigned long long>(latency.min()),
+                     static_cast<unsigned long long>(latency.percentile(0.5)), static_cast<unsigned long long>(latency.percentile(0.9)),
+                     static_cast<unsigned long long>(latency.percentile(0.99)), static_cast<unsigned long long>(latency.max()),
+                     static_cast<unsigned long long>(row.allocations));
+        separator = ",";
+    }
+    std::fprintf(out, "],\"devices\":[");
+    separator = "";
+    for (const DeviceReadStats& device : report.devices) {
+        const LatencyHistogram& latency = device.latency;
+        std::fprintf(out, "%s{\"device\":\"%u:%u\",\"rotational\":%s,\"reads\":%llu,\"p50\":%llu,\"p99\":%llu,\"meanLimit\":%.2f}",
+                     separator, major(device.device), minor(device.device), device.rotational ? "true" : "false",
+                     static_cast<unsigned long long>(latency.count()), static_cast<unsigned long long>(latency.percentile(0.5)),
+                     static_cast<unsigned long long>(latency.percentile(0.99)),
+                     static_cast<double>(device.limitSum) / static_cast<double>(latency.count()));
+        separator = ",";
+    }
+    std::fprintf(out, "]}\n");
+}
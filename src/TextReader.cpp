@@ -0,0 +1,318 @@
+#include "TextReader.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <fcntl.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using ScanFunction = void (*)(TextCounters& counters, const uint8_t* data, std::size_t blocks);
+
+// Checks `length` bytes that continue the text at `counters.bytes` against the UTF-8 grammar (RFC 3629:
+// no overlong forms, no surrogates, nothing above U+10FFFF)
+void validateUtf8(TextCounters& counters, const uint8_t* data, std::size_t length) {
+    for (std::size_t i = 0; i < length; ++i) {
+        uint8_t byte = data[i];
+        if (counters.utf8Pending > 0) {
+            if (byte < counters.utf8Lower || byte > counters.utf8Upper) {
+                counters.invalidUtf8Offset = counters.bytes + i;
+                return;
+            }
+            --counters.utf8Pending;
+            counters.utf8Lower = 0x80;
+            counters.utf8Upper = 0xBF;
+            continue;
+        }
+        if (byte < 0x80) {
+            continue;
+        }
+        if (byte >= 0xC2 && byte <= 0xDF) {
+            counters.utf8Pending = 1;
+        } else if (byte >= 0xE0 && byte <= 0xEF) {
+            counters.utf8Pending = 2;
+            counters.utf8Lower = byte == 0xE0 ? 0xA0 : 0x80;
+            counters.utf8Upper = byte == 0xED ? 0x9F : 0xBF;
+        } else if (byte >= 0xF0 && byte <= 0xF4) {
+            counters.utf8Pending = 3;
+            counters.utf8Lower = byte == 0xF0 ? 0x90 : 0x80;
+            counters.utf8Upper = byte == 0xF4 ? 0x8F : 0xBF;
+        } else {
+            counters.invalidUtf8Offset = counters.bytes + i;
+            return;
+        }
+    }
+}
+
+// Folds the masks of one block (bit i = byte i) into the counters
+[[gnu::always_inline]] inline void countBlock(TextCounters& counters, uint64_t lineFeed, uint64_t carriageReturn,
+                                              uint64_t space, uint64_t nonAscii, const uint8_t* block, std::size_t length) {
+    counters.lineFeeds += std::popcount(lineFeed);
+    counters.carriageReturns += std::popcount(carriageReturn);
+    counters.crlfPairs += std::popcount(lineFeed & ((carriageReturn << 1) | counters.carriageReturnCarry));
+    counters.carriageReturnCarry = carriageReturn >> 63;
+    // A word starts at every non-space byte that follows a space
+    counters.words += std::popcount(~space & ((space << 1) | counters.spaceCarry));
+    counters.spaceCarry = space >> 63;
+    counters.nonAscii += std::popcount(nonAscii);
+    if ((nonAscii | counters.utf8Pending) != 0 && !counters.invalidUtf8Offset) {
+        validateUtf8(counters, block, length);
+    }
+    counters.bytes += length;
+}
+
+#if defined(__x86_64__)
+
+// Whitespace is ' ' or a byte in \t..\r; the range check is an unsigned min after subtracting '\t'
+__attribute__((target("avx2,popcnt")))
+void scanAvx2(TextCounters& counters, const uint8_t* data, std::size_t blocks) {
+    const __m256i lineFeed = _mm256_set1_epi8('\n');
+    const __m256i carriageReturn = _mm256_set1_epi8('\r');
+    const __m256i blank = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i controlSpan = _mm256_set1_epi8('\r' - '\t');
+    for (std::size_t n = 0; n < blocks; ++n, data += 64) {
+        uint64_t masks[4] = {};
+        for (std::size_t half = 0; half < 2; ++half) {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32 * half));
+            __m256i control = _mm256_sub_epi8(bytes, tab);
+            __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, blank),
+                                            _mm256_cmpeq_epi8(_mm256_min_epu8(control, controlSpan), control));
+            unsigned shift = 32 * half;
+            masks[0] |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, lineFeed)))) << shift;
+            masks[1] |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, carriageReturn)))) << shift;
+            masks[2] |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(space))) << shift;
+            masks[3] |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(bytes))) << shift;
+        }
+        countBlock(counters, masks[0], masks[1], masks[2], masks[3], data, 64);
+    }
+}
+
+void scanSse2(TextCounters& counters, const uint8_t* data, std::size_t blocks) {
+    const __m128i lineFeed = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+    const __m128i blank = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i controlSpan = _mm_set1_epi8('\r' - '\t');
+    for (std::size_t n = 0; n < blocks; ++n, data += 64) {
+        uint64_t masks[4] = {};
+        for (std::size_t quarter = 0; quarter < 4; ++quarter) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * quarter));
+            __m128i control = _mm_sub_epi8(bytes, tab);
+            __m128i space = _mm_or_si128(_mm_cmpeq_epi8(bytes, blank), _mm_cmpeq_epi8(_mm_min_epu8(control, controlSpan), control));
+            unsigned shift = 16 * quarter;
+            masks[0] |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, lineFeed))) << shift;
+            masks[1] |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, carriageReturn))) << shift;
+            masks[2] |= static_cast<uint64_t>(_mm_movemask_epi8(space)) << shift;
+            masks[3] |= static_cast<uint64_t>(_mm_movemask_epi8(bytes)) << shift;
+        }
+        countBlock(counters, masks[0], masks[1], masks[2], masks[3], data, 64);
+    }
+}
+
+#else
+
+void scanScalar(TextCounters& counters, const uint8_t* data, std::size_t blocks) {
+    for (std::size_t n = 0; n < blocks; ++n, data += 64) {
+        uint64_t lineFeed = 0, carriageReturn = 0, space = 0, nonAscii = 0;
+        for (std::size_t i = 0; i < 64; ++i) {
+            uint8_t byte = data[i];
+            lineFeed |= static_cast<uint64_t>(byte == '\n') << i;
+            carriageReturn |= static_cast<uint64_t>(byte == '\r') << i;
+            space |= static_cast<uint64_t>(byte == ' ' || (byte >= '\t' && byte <= '\r')) << i;
+            nonAscii |= static_cast<uint64_t>(byte >> 7) << i;
+        }
+        countBlock(counters, lineFeed, carriageReturn, space, nonAscii, data, 64);
+    }
+}
+
+#endif
+
+struct Implementation {
+    ScanFunction scan;
+    const char* name;
+};
+
+Implementation selectImplementation() {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        return {scanAvx2, "avx2"};
+    }
+    return {scanSse2, "sse2"};
+#else
+    return {scanScalar, "scalar"};
+#endif
+}
+
+const Implementation& implementation() {
+    static const Implementation selected = selectImplementation();
+    return selected;
+}
+
+// Longest signature first: the UTF-32LE BOM starts with the UTF-16LE one
+std::string_view detectByteOrderMark(std::span<const uint8_t> leading) {
+    auto startsWith = [&](std::initializer_list<uint8_t> mark) {
+        return leading.size() >= mark.size() && std::equal(mark.begin(), mark.end(), leading.begin());
+    };
+    if (startsWith({0xFF, 0xFE, 0x00, 0x00})) return "UTF-32LE";
+    if (startsWith({0x00, 0x00, 0xFE, 0xFF})) return "UTF-32BE";
+    if (startsWith({0xEF, 0xBB, 0xBF})) return "UTF-8";
+    if (startsWith({0xFF, 0xFE})) return "UTF-16LE";
+    if (startsWith({0xFE, 0xFF})) return "UTF-16BE";
+    return {};
+}
+
+// Reads of the unmapped path, as for content hashing
+constexpr std::size_t ReadSize = 1 << 20;
+
+}
+
+std::string_view TextSummary::encoding() const {
+    if (!byteOrderMark.empty()) {
+        return byteOrderMark;
+    }
+    if (counts.invalidUtf8Offset) {
+        return "Unknown";
+    }
+    return counts.nonAscii == 0 ? "ASCII" : "UTF-8";
+}
+
+std::string_view TextSummary::lineEndings() const {
+    uint64_t crlf = counts.crlfPairs;
+    uint64_t lf = counts.lineFeeds - crlf;
+    uint64_t cr = counts.carriageReturns - crlf;
+    int kinds = (crlf > 0) + (lf > 0) + (cr > 0);
+    if (kinds == 0) {
+        return "None";
+    }
+    if (kinds > 1) {
+        return "Mixed";
+    }
+    return crlf > 0 ? "CRLF" : lf > 0 ? "LF" : "CR";
+}
+
+TextReader::TextReader(std::size_t headLines, std::size_t headBytes, std::pmr::memory_resource* memory)
+    : headLineLimit(headLines), headBytesLeft(headLines > 0 ? headBytes : 0), currentLine(memory), lines(memory) {
+    lines.reserve(headLines);
+}
+
+void TextReader::captureHead(std::span<const uint8_t> data) {
+    data = data.first(std::min(data.size(), headBytesLeft));
+    headBytesLeft -= data.size();
+    while (!data.empty() && lines.size() < headLineLimit) {
+        const void* found = std::memchr(data.data(), '\n', data.size());
+        std::size_t length = found ? static_cast<std::size_t>(static_cast<const uint8_t*>(found) - data.data()) : data.size();
+        currentLine.append(reinterpret_cast<const char*>(data.data()), length);
+        if (!found) {
+            break;
+        }
+        if (!currentLine.empty() && currentLine.back() == '\r') {
+            currentLine.pop_back();
+        }
+        lines.push_back(std::move(currentLine));
+        currentLine.clear();
+        data = data.subspan(length + 1);
+    }
+    if (lines.size() == headLineLimit) {
+        headBytesLeft = 0;
+    }
+}
+
+void TextReader::update(std::span<const uint8_t> data) {
+    if (data.empty()) {
+        return;
+    }
+    uint64_t seen = counters.bytes + buffered;
+    if (seen < leading.size()) {
+        std::size_t count = std::min(leading.size() - static_cast<std::size_t>(seen), data.size());
+        std::memcpy(leading.data() + seen, data.data(), count);
+    }
+    if (headBytesLeft > 0) {
+        captureHead(data);
+    }
+    lastByte = data.back();
+
+    const uint8_t* input = data.data();
+    std::size_t length = data.size();
+    if (buffered > 0) {
+        std::size_t fill = std::min(BlockLength - buffered, length);
+        std::memcpy(buffer.data() + buffered, input, fill);
+        buffered += fill;
+        input += fill;
+        length -= fill;
+        if (buffered < BlockLength) {
+            return;
+        }
+        implementation().scan(counters, buffer.data(), 1);
+        buffered = 0;
+    }
+    std::size_t blocks = length / BlockLength;
+    implementation().scan(counters, input, blocks);
+    buffered = length - blocks * BlockLength;
+    std::memcpy(buffer.data(), input + blocks * BlockLength, buffered);
+}
+
+TextSummary TextReader::finish() {
+    if (buffered > 0) {
+        // Trailing spaces add no words, line breaks or high bytes
+        std::memset(buffer.data() + buffered, ' ', BlockLength - buffered);
+        implementation().scan(counters, buffer.data(), 1);
+        counters.bytes -= BlockLength - buffered;
+        buffered = 0;
+    }
+    if (counters.utf8Pending > 0 && !counters.invalidUtf8Offset) {
+        counters.invalidUtf8Offset = counters.bytes; // the text ends inside a sequence
+    }
+
+    std::string_view byteOrderMark = detectByteOrderMark(std::span<const uint8_t>(leading).first(
+        static_cast<std::size_t>(std::min<uint64_t>(counters.bytes, leading.size()))));
+    uint64_t lineCount = counters.lineFeeds + counters.carriageReturns - counters.crlfPairs +
+                         (counters.bytes > 0 && lastByte != '\n' && lastByte != '\r');
+
+    if (lines.size() < headLineLimit && !currentLine.empty()) {
+        lines.push_back(std::move(currentLine));
+    }
+    if (!lines.empty() && byteOrderMark == "UTF-8") {
+        lines.front().erase(0, 3);
+    }
+    // Move-constructed, the lines stay in the reader's memory resource
+    return TextSummary{counters, lineCount, byteOrderMark, std::move(lines)};
+}
+
+TextSummary readTextFile(const FileContext& context, std::size_t headLines, std::pmr::memory_resource* memory) {
+    TextReader reader(headLines, context.prefix().size(), memory);
+    if (!context.isOpen()) {
+        return reader.finish();
+    }
+    if (context.isComplete()) {
+        if (context.size() > FileContext::DefaultPrefixSize) {
+            context.adviseSequential();
+        }
+        reader.update(context.bytes());
+        return reader.finish();
+    }
+
+    // One buffer per thread, kept for the next file
+    thread_local std::unique_ptr<uint8_t[]> readBuffer(new uint8_t[ReadSize]);
+    if (context.descriptor() >= 0) {
+        ::posix_fadvise(context.descriptor(), 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    for (uint64_t offset = 0; offset < context.size();) {
+        std::size_t wanted = static_cast<std::size_t>(std::min<uint64_t>(ReadSize, context.size() - offset));
+        std::size_t read = context.readAt(offset, readBuffer.get(), wanted);
+        if (read == 0) {
+            break;
+        }
+        reader.update(std::span<const uint8_t>(readBuffer.get(), read));
+        offset += read;
+    }
+    return reader.finish();
+}
+
+const char* textReaderImplementation() {
+    return implementation().name;
+}
@@ -0,0 +1,120 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace {
+// Identity of the pool worker running on the current thread, if any
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local std::size_t currentIndex = 0;
+}
+
+ThreadPool::ThreadPool(std::size_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    queues.reserve(threadCount);
+    for (std::size_t i = 0; i < threadCount; ++i) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    workers.reserve(threadCount);
+    for (std::size_t i = 0; i < threadCount; ++i) {
+        workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    std::size_t index;
+    bool fromWorker = (currentPool == this);
+    if (fromWorker) {
+        index = currentIndex;
+    } else {
+        index = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    }
+
+    pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        if (fromWorker) {
+            queues[index]->tasks.push_front(std::move(task));
+        } else {
+            queues[index]->tasks.push_back(std::move(task));
+        }
+    }
+    queued.fetch_add(1);
+
+    // A sleeper checks `queued` while holding sleepMutex, so taking it here closes the lost-wakeup window
+    if (sleepers.load() > 0) {
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wakeCondition.notify_one();
+    }
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    idleCondition.wait(lock, [this] { return pending.load() == 0; });
+}
+
+bool ThreadPool::popLocal(std::size_t index, Task& task) {
+    WorkQueue& queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+    return true;
+}
+
+bool ThreadPool::steal(std::size_t index, Task& task) {
+    for (std::size_t offset = 1; offset < queues.size(); ++offset) {
+        WorkQueue& victim = *queues[(index + offset) % queues.size()];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || victim.tasks.empty()) {
+            continue;
+        }
+        task = std::move(victim.tasks.back());
+        victim.tasks.pop_back();
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(std::size_t index) {
+    currentPool = this;
+    currentIndex = index;
+
+    Task task;
+    while (true) {
+        if (popLocal(index, task) || steal(index, task)) {
+            queued.fetch_sub(1);
+            task();
+            task = nullptr;
+            if (pending.fetch_sub(1) == 1) {
+                { std::lock_guard<std::mutex> lock(sleepMutex); }
+                idleCondition.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers.fetch_add(1);
+        wakeCondition.wait(lock, [this] { return stopping || queued.load() > 0; });
+        sleepers.fetch_sub(1);
+        if (stopping && queued.load() == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,142 @@
+#include "ZipReader.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint32_t LocalHeaderSignature = 0x04034b50;
+constexpr uint32_t CentralHeaderSignature = 0x02014b50;
+constexpr uint32_t EndOfDirectorySignature = 0x06054b50;
+constexpr uint32_t Zip64EndOfDirectorySignature = 0x06064b50;
+constexpr uint32_t Zip64LocatorSignature = 0x07064b50;
+
+constexpr std::size_t EndOfDirectorySize = 22;
+constexpr std::size_t CentralHeaderSize = 46;
+constexpr std::size_t LocalHeaderSize = 30;
+constexpr std::size_t Zip64LocatorSize = 20;
+
+}
+
+ZipReader::ZipReader(std::span<const uint8_t> archive) : reader(archive) {
+    if (archive.size() < EndOfDirectorySize) {
+        throw std::runtime_error("ZIP: file too small");
+    }
+
+    // The EOCD record is last, followed only by a comment of at most 65535 bytes
+    std::size_t lowest = archive.size() > EndOfDirectorySize + 0xFFFF ? archive.size() - EndOfDirectorySize - 0xFFFF : 0;
+    std::size_t eocd = archive.size() - EndOfDirectorySize;
+    while (true) {
+        if (reader.u32le(eocd) == EndOfDirectorySignature &&
+            eocd + EndOfDirectorySize + reader.u16le(eocd + 20) <= archive.size()) {
+            break;
+        }
+        if (eocd == lowest) {
+            throw std::runtime_error("ZIP: End of Central Directory record not found");
+        }
+        --eocd;
+    }
+
+    totalEntries = reader.u16le(eocd + 10);
+    directorySize = reader.u32le(eocd + 12);
+    directoryOffset = reader.u32le(eocd + 16);
+    archiveComment = reader.chars(eocd + EndOfDirectorySize, reader.u16le(eocd + 20));
+
+    bool saturated = totalEntries == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF;
+    if (eocd >= Zip64LocatorSize && reader.u32le(eocd - Zip64LocatorSize) == Zip64LocatorSignature) {
+        uint64_t record = reader.u64le(eocd - Zip64LocatorSize + 8);
+        if (reader.has(record, 56) && reader.u32le(record) == Zip64EndOfDirectorySignature) {
+            zip64 = true;
+            totalEntries = reader.u64le(record + 32);
+            directorySize = reader.u64le(record + 40);
+            directoryOffset = reader.u64le(record + 48);
+        } else if (saturated) {
+            throw std::runtime_error("ZIP: bad ZIP64 End of Central Directory");
+        }
+    }
+
+    if (!reader.has(directoryOffset, directorySize)) {
+        throw std::runtime_error("ZIP: central directory out of range");
+    }
+}
+
+bool ZipReader::readEntry(uint64_t& offset, ZipEntry& entry) const {
+    if (offset + CentralHeaderSize > directoryOffset + directorySize) {
+        return false;
+    }
+    if (reader.u32le(offset) != CentralHeaderSignature) {
+        throw std::runtime_error("ZIP: bad central directory record");
+    }
+
+    entry = ZipEntry{};
+    entry.versionMadeBy = reader.u16le(offset + 4);
+    entry.flags = reader.u16le(offset + 8);
+    entry.method = reader.u16le(offset + 10);
+    entry.dosTime = reader.u16le(offset + 12);
+    entry.dosDate = reader.u16le(offset + 14);
+    entry.crc32 = reader.u32le(offset + 16);
+    entry.compressedSize = reader.u32le(offset + 20);
+    entry.uncompressedSize = reader.u32le(offset + 24);
+    uint16_t nameLength = reader.u16le(offset + 28);
+    uint16_t extraLength = reader.u16le(offset + 30);
+    uint16_t commentLength = reader.u16le(offset + 32);
+    entry.localHeaderOffset = reader.u32le(offset + 42);
+    entry.name = reader.chars(offset + CentralHeaderSize, nameLength);
+
+    // ZIP64 extended information: only the saturated fields are present, in this order
+    std::size_t extra = offset + CentralHeaderSize + nameLength;
+    std::size_t extraEnd = extra + extraLength;
+    while (extra + 4 <= extraEnd) {
+        uint16_t id = reader.u16le(extra);
+        uint16_t size = reader.u16le(extra + 2);
+        if (id == 0x0001) {
+            std::size_t field = extra + 4;
+            std::size_t fieldEnd = field + size;
+            auto take = [&](uint64_t& value) {
+                if (value == 0xFFFFFFFF && field + 8 <= fieldEnd) {
+                    value = reader.u64le(field);
+                    field += 8;
+                }
+            };
+            take(entry.uncompressedSize);
+            take(entry.compressedSize);
+            take(entry.localHeaderOffset);
+        }
+        extra += 4 + size;
+    }
+
+    offset = extraEnd + commentLength;
+    return true;
+}
+
+std::span<const uint8_t> ZipReader::entryData(const ZipEntry& entry) const {
+    uint64_t header = entry.localHeaderOffset;
+    if (!reader.has(header, LocalHeaderSize) || reader.u32le(header) != LocalHeaderSignature) {
+        throw std::runtime_error("ZIP: bad local file header");
+    }
+    // The local name and extra lengths may differ from the central ones
+    uint64_t data = header + LocalHeaderSize + reader.u16le(header + 26) + reader.u16le(header + 28);
+    return reader.bytes(data, entry.compressedSize);
+}
+
+std::string zipMethodName(uint16_t method) {
+    switch (method) {
+        case 0:  return "Store";
+        case 8:  return "Deflate";
+        case 9:  return "Deflate64";
+        case 12: return "BZIP2";
+        case 14: return "LZMA";
+        case 93: return "Zstandard";
+        case 95: return "XZ";
+        case 99: return "AES";
+        default: return std::to_string(method);
+    }
+}
+
+std::pmr::string formatDosDateTime(uint16_t dosDate, uint16_t dosTime, std::pmr::memory_resource* memory) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d",
+                  1980 + (dosDate >> 9), (dosDate >> 5) & 0x0F, dosDate & 0x1F,
+                  dosTime >> 11, (dosTime >> 5) & 0x3F, (dosTime & 0x1F) * 2);
+    return std::pmr::string(buffer, memory);
+}
@@ -1,46 +1,424 @@
 #include "FileMetaDataAnalyzer.h"
+#include "DirectoryScanner.h"
+#include "DuplicateFinder.h"
+#include "IndexFile.h"
+#include "MetadataDaemon.h"
+#include "OutputSink.h"
+#include "StageStats.h"
 #include <iostream>
-#include <iomanip>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <optional>
+#include <thread>
+#include <pthread.h>
+#include <signal.h>
 #include <poppler/cpp/poppler-document.h>
 #include <poppler/cpp/poppler-page.h>
 
+#if FILEMETA_STATS
+// Count the heap allocations of every thread for `--stats` (the only program that reports them, see
+// `threadAllocations`); the array and nothrow forms call these
+void* operator new(std::size_t size) {
+    ++threadAllocations;
+    if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    ++threadAllocations;
+    auto align = static_cast<std::size_t>(alignment);
+    if (void* pointer = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+#endif
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " <file_path>..." << std::endl;
+    std::cerr << "       " << program << " --recursive <dir> [--threads N] [--ordered] [--basic | --specialized] [--cache <file>]" << std::endl;
+    std::cerr << "       " << std::string(std::strlen(program), ' ') << " [--format text|ndjson|csv|columnar] [--output <file>] [--io auto|uring|threads|blocking] [--verify]" << std::endl;
+    std::cerr << "       " << std::string(std::strlen(program), ' ') << " [--hash] [--duplicates <report file>] [--index <file>] [--archives <depth>] [--archive-bytes N]" << std::endl;
+    std::cerr << "       " << std::string(std::strlen(program), ' ') << " [--archive-member-bytes N] [--stats text|json]" << std::endl;
+    std::cerr << "       " << program << " --index <file> --query <expression> [--format text|ndjson|csv|columnar] [--output <file>]" << std::endl;
+    std::cerr << "       " << program << " --daemon <socket> --recursive <dir>... [--threads N] [--basic | --specialized] [--cache <file>] [--io ...]" << std::endl;
+}
+
+//Parses a whole argument as an unsigned decimal number; nothing for anything else, or on overflow.
+template <typename Number>
+std::optional<Number> parseNumber(const char* text) {
+    Number value{};
+    const char* end = text + std::strlen(text);
+    auto [stop, error] = std::from_chars(text, end, value);
+    if (error != std::errc() || stop != end || stop == text) {
+        return std::nullopt;
+    }
+    return value;
+}
+
 /**
- * @brief Prints the metadata key-value pairs in a formatted way.
+ * @brief Runs a `MetadataDaemon` over the roots until SIGINT or SIGTERM.
  *
- * @tparam KeyType The type of the keys.
- * @tparam ValueType The type of the values.
- * @param metadata The metadata to be printed.
+ * The signals are blocked before the daemon starts any thread and taken by a dedicated thread with
+ * `sigwait`, which then stops the daemon.
  */
+int runDaemon(const std::vector<std::filesystem::path>& roots, const std::filesystem::path& socketPath, const ScanOptions& options) {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
 
-template <typename KeyType, typename ValueType>
-void printMetadata(const CustomMap<KeyType, ValueType>& metadata) {
-    for (const auto& [key, value] : metadata) {
-        std::cout << std::left << std::setw(20) << key << ": " << value << std::endl;
+    try {
+        MetadataDaemon daemon(DaemonOptions{roots, socketPath, options});
+        std::thread signalWaiter([&daemon, &signals] {
+            int signal;
+            sigwait(&signals, &signal);
+            daemon.stop();
+        });
+        try {
+            daemon.run();
+        } catch (...) {
+            pthread_kill(signalWaiter.native_handle(), SIGTERM);
+            signalWaiter.join();
+            throw;
+        }
+        signalWaiter.join();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
     }
-    std::cout << std::endl;
+    return 0;
 }
 
-void mergeMap(CustomMap<std::string, std::string>& dest, const CustomMap<std::string, std::string>& src) {
-        for (const auto& [key, value] : src) {
-            dest[key] = value;
+/**
+ * @brief Answers a query from an index built with `--index`, writing the matching records to `sink`.
+ *
+ * Only the index is read; the files it describes are not touched.
+ */
+int runQuery(const std::filesystem::path& indexPath, std::string_view expression, OutputSink& sink) {
+    try {
+        IndexFile index(indexPath);
+        std::vector<uint32_t> matches = index.query(expression);
+        for (uint32_t record : matches) {
+            sink.write(index.record(record));
         }
+        sink.finish();
+        std::cerr << "Matched " << matches.size() << " of " << index.size() << " records" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes the duplicate groups as text: a summary line, then per group a header line and one indented path per line.
+ */
+void writeDuplicateReport(std::FILE* out, const std::vector<DuplicateGroup>& groups) {
+    uint64_t reclaimable = 0;
+    for (const auto& group : groups) {
+        reclaimable += group.reclaimableBytes;
+    }
+    std::fprintf(out, "# %zu duplicate groups, %llu bytes reclaimable\n", groups.size(), static_cast<unsigned long long>(reclaimable));
+    for (const auto& group : groups) {
+        std::fprintf(out, "\n%016llx %llu bytes x %zu, %llu bytes reclaimable\n", static_cast<unsigned long long>(group.hash),
+                     static_cast<unsigned long long>(group.size), group.paths.size(),
+                     static_cast<unsigned long long>(group.reclaimableBytes));
+        for (const auto& path : group.paths) {
+            std::fprintf(out, "  %s\n", path.c_str());
+        }
+    }
+}
+
+/**
+ * @brief Non-interactive recursive scan of a directory tree.
+ *
+ * Records are handed to the writer thread as soon as a worker finishes them. With `ordered` they are
+ * buffered and written sorted by path once the scan is complete.
+ */
+int runRecursiveScan(const std::filesystem::path& root, const ScanOptions& options, bool ordered, AsyncRecordWriter& writer) {
+    std::mutex orderedMutex;
+    std::vector<OutputRecord> orderedRecords;
+
+    DirectoryScanner scanner(
+        options,
+        [&](const std::filesystem::path& filePath, FileType fileType, const MetadataMap& metadata) {
+            OutputRecord record{filePath.string(), fileType, metadata}; // copied out of the worker's arena
+            if (ordered) {
+                std::lock_guard<std::mutex> lock(orderedMutex);
+                orderedRecords.push_back(std::move(record));
+            } else {
+                writer.push(std::move(record));
+            }
+        },
+        [](const std::filesystem::path& filePath, const std::string& message) {
+            std::string text = filePath.string() + ": " + message + "\n";
+            std::fwrite(text.data(), 1, text.size(), stderr);
+        });
+
+    ScanStats stats;
+    try {
+        stats = scanner.scan(root);
+    } catch (const std::exception& e) {
+        std::cerr << root.string() << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (ordered) {
+        std::sort(orderedRecords.begin(), orderedRecords.end(),
+                  [](const OutputRecord& a, const OutputRecord& b) { return a.path < b.path; });
+        for (auto& record : orderedRecords) {
+            writer.push(std::move(record));
+        }
+    }
+
+    std::cerr << "Analyzed " << stats.filesAnalyzed << " files (" << stats.cacheHits << " from cache), ";
+    if (stats.archiveMembers > 0) {
+        std::cerr << stats.archiveMembers << " archive members, ";
     }
+    std::cerr << stats.errors << " errors" << std::endl;
+    return stats.errors == 0 ? 0 : 1;
+}
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <file_path>" << std::endl;
+        printUsage(argv[0]);
         return 1;
     }
+
+    std::vector<std::filesystem::path> recursiveRoots;
+    std::vector<std::filesystem::path> filePaths;
+    ScanOptions scanOptions;
+    bool ordered = false;
+    std::filesystem::path cachePath;
+    std::string outputFormat = "text";
+    std::string outputPath;
+    std::string duplicatesPath;
+    std::filesystem::path daemonSocket;
+    std::filesystem::path indexPath;
+    std::optional<std::string> queryText;
+    std::string statsFormat;
+
     for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--recursive" && i + 1 < argc) {
+            recursiveRoots.emplace_back(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            std::optional<std::size_t> threads = parseNumber<std::size_t>(argv[++i]);
+            if (!threads) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            scanOptions.threadCount = *threads;
+        } else if (arg == "--archives" && i + 1 < argc) {
+            std::optional<unsigned> depth = parseNumber<unsigned>(argv[++i]);
+            if (!depth) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            scanOptions.archiveDepth = *depth;
+        } else if (arg == "--archive-bytes" && i + 1 < argc) {
+            std::optional<uint64_t> budget = parseNumber<uint64_t>(argv[++i]);
+            if (!budget) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            scanOptions.archiveBudget = *budget;
+        } else if (arg == "--archive-member-bytes" && i + 1 < argc) {
+            std::optional<uint64_t> budget = parseNumber<uint64_t>(argv[++i]);
+            if (!budget) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            scanOptions.archiveMemberBudget = *budget;
+        } else if (arg == "--cache" && i + 1 < argc) {
+            cachePath = argv[++i];
+        } else if (arg == "--format" && i + 1 < argc) {
+            outputFormat = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (arg == "--daemon" && i + 1 < argc) {
+            daemonSocket = argv[++i];
+        } else if (arg == "--index" && i + 1 < argc) {
+            indexPath = argv[++i];
+        } else if (arg == "--query" && i + 1 < argc) {
+            queryText = argv[++i];
+        } else if (arg == "--stats" && i + 1 < argc) {
+            statsFormat = argv[++i];
+            if (statsFormat != "text" && statsFormat != "json") {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--duplicates" && i + 1 < argc) {
+            duplicatesPath = argv[++i];
+        } else if (arg == "--io" && i + 1 < argc) {
+            try {
+                scanOptions.ioBackend = parseIoBackend(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--ordered") {
+            ordered = true;
+        } else if (arg == "--basic") {
+            scanOptions.includeSpecialized = false;
+        } else if (arg == "--specialized") {
+            scanOptions.includeBasic = false;
+        } else if (arg == "--verify") {
+            scanOptions.verifyIntegrity = true;
+        } else if (arg == "--hash") {
+            scanOptions.hashContents = true;
+        } else if (arg.rfind("--", 0) == 0) {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            filePaths.emplace_back(arg);
+        }
+    }
 
+    if (!statsFormat.empty()) {
+#if FILEMETA_STATS
+        enableStageStats();
+#else
+        std::cerr << "--stats: built without stage statistics (FILEMETA_STATS=0)" << std::endl;
+        return 1;
+#endif
+    }
 
-        std::filesystem::path filePath = argv[i];
-        CustomMap<std::string, std::string> metadata;
+    std::unique_ptr<MetadataCache> cache;
+    if (!cachePath.empty()) {
+        cache = std::make_unique<MetadataCache>(cachePath);
+        scanOptions.cache = cache.get();
+    }
+    DuplicateFinder duplicates;
+    if (!duplicatesPath.empty()) {
+        scanOptions.duplicates = &duplicates;
+    }
+
+    int status = 0;
+    if (!daemonSocket.empty()) {
+        if (recursiveRoots.empty()) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        status = runDaemon(recursiveRoots, daemonSocket, scanOptions);
+    } else if (!recursiveRoots.empty() || queryText) {
+        if (queryText && (indexPath.empty() || !recursiveRoots.empty())) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (!recursiveRoots.empty() && !indexPath.empty()) {
+            // The scan writes the index instead of printing records
+            if (!outputPath.empty()) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            outputFormat = "index";
+            outputPath = indexPath.string();
+        }
+
+        std::FILE* out = stdout;
+        if (!outputPath.empty() && !(out = std::fopen(outputPath.c_str(), "wb"))) {
+            std::cerr << outputPath << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+
+        std::unique_ptr<OutputSink> sink;
+        try {
+            sink = makeOutputSink(outputFormat, out);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        if (queryText) {
+            status = runQuery(indexPath, *queryText, *sink);
+        } else {
+            AsyncRecordWriter writer(*sink);
+            for (const auto& root : recursiveRoots) {
+                status |= runRecursiveScan(root, scanOptions, ordered, writer);
+            }
+            try {
+                writer.close();
+            } catch (const std::exception& e) {
+                std::cerr << (outputPath.empty() ? "stdout" : outputPath) << ": " << e.what() << std::endl;
+                status = 1;
+            }
+        }
+
+        if (out != stdout && std::fclose(out) != 0) {
+            std::cerr << outputPath << ": " << std::strerror(errno) << std::endl;
+            status = 1;
+        }
+
+        if (scanOptions.duplicates) {
+            std::vector<DuplicateGroup> groups = duplicates.findDuplicates(scanOptions.threadCount,
+                [&status](const std::filesystem::path& filePath, const std::string& message) {
+                    std::cerr << filePath.string() << ": " << message << std::endl;
+                    status = 1;
+                });
+            std::FILE* report = std::fopen(duplicatesPath.c_str(), "wb");
+            if (!report) {
+                std::cerr << duplicatesPath << ": " << std::strerror(errno) << std::endl;
+                return 1;
+            }
+            writeDuplicateReport(report, groups);
+            if (std::fclose(report) != 0) {
+                std::cerr << duplicatesPath << ": " << std::strerror(errno) << std::endl;
+                status = 1;
+            }
+            const DuplicateStats& stats = duplicates.stats();
+            std::cerr << "Hashed " << stats.filesHashed << " of " << stats.filesSeen << " files (" << stats.bytesHashed
+                      << " bytes), " << groups.size() << " duplicate groups" << std::endl;
+        }
+    }
+
+    if (cache) {
+        try {
+            cache->save();
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            status = 1;
+        }
+    }
+
+    for (const auto& filePath : filePaths) {
+        // Open the file once; type detection and every extractor share it
+        FileContext context(filePath);
 
         // Determine file type based on file signature
-        FileType fileType = determineFileType<poppler::document, std::ifstream, JPEGHeader, PNGHeader, BMPHeader, ZIPHeader, WAVHeader,GIFHeader>(filePath);
+        FileType fileType = determineFileType<poppler::document, std::ifstream, JPEGHeader, PNGHeader, BMPHeader, ZIPHeader, WAVHeader,GIFHeader>(context);
 
-        std::cout <<"For "<<argv[i]<< " Select metadata extraction option:" << std::endl;
+        std::cout <<"For "<<filePath.string()<< " Select metadata extraction option:" << std::endl;
         std::cout << "1. Basic Metadata" << std::endl;
         std::cout << "2. Specialized Metadata" << std::endl;
         std::cout << "3. Both" << std::endl;
@@ -48,54 +426,21 @@ int main(int argc, char* argv[]) {
         int choice;
         std::cin >> choice;
 
-        if(choice == 1 || choice == 3){
-            metadata = FileMetaDataAnalyzer<BasicMetadata>::analyzeMetadata(filePath);
+        // As before, an unsupported file ends the run with status 1 when specialized metadata was asked for
+        if ((choice == 2 || choice == 3) && fileType == FileType::UNKNOWN) {
+            std::cerr << "Unsupported file format." << std::endl;
+            status = 1;
+            break;
         }
-        try{
 
-            
-            if(choice == 2 || choice == 3){
-                // Analyze metadata based on file type
-                switch (fileType) {
-                    case FileType::PDF:
-                            mergeMap(metadata, FileMetaDataAnalyzer<poppler::document>::analyzeMetadata(filePath));
-                            std::cout << "PDF Metadata:" << std::endl;
-                        metadata = FileMetaDataAnalyzer<poppler::document>::analyzeMetadata(filePath);
-                        std::cout << "PDF Metadata:" << std::endl;
-                        break;
-                    case FileType::TXT:
-                        mergeMap(metadata,FileMetaDataAnalyzer<std::ifstream>::analyzeMetadata(filePath));
-                        std::cout << "TXT Metadata:" << std::endl;
-                        break;
-                    case FileType::JPEG:
-                        mergeMap(metadata, FileMetaDataAnalyzer<JPEGHeader>::analyzeMetadata(filePath));
-                        std::cout << "JPEG Metadata:" << std::endl;
-                        break;
-                    case FileType::PNG:
-                        mergeMap(metadata, FileMetaDataAnalyzer<PNGHeader>::analyzeMetadata(filePath));
-                        std::cout << "PNG Metadata:" << std::endl;
-                        break;
-                    case FileType::BMP:
-                        mergeMap(metadata, FileMetaDataAnalyzer<BMPHeader>::analyzeMetadata(filePath));
-                        std::cout << "BMP Metadata:" << std::endl;
-                        break;
-                    case FileType::ZIP:
-                        mergeMap(metadata, FileMetaDataAnalyzer<ZIPHeader>::analyzeMetadata(filePath));
-                        std::cout << "ZIP Metadata:" << std::endl;
-                        break;
-                    case FileType::WAV:
-                        mergeMap(metadata, FileMetaDataAnalyzer<WAVHeader>::analyzeMetadata(filePath));
-                        std::cout << "WAV Metadata:" << std::endl;
-                        break;
-
-                    case FileType::GIF:
-                        mergeMap(metadata, FileMetaDataAnalyzer<GIFHeader,LogicalScreenDescriptor>::analyzeMetadata(filePath));
-                        std::cout << "GIF Metadata:" << std::endl;
-                        break;
-                    default:
-                        std::cerr << "Unsupported file format." << std::endl;
-                        return 1;
-                }
+        MetadataMap metadata;
+        try{
+            metadata = analyzeFileMetadata(context, fileType, choice == 1 || choice == 3, choice == 2 || choice == 3);
+            if (context.wasTruncated()) {
+                throw std::runtime_error("File was truncated while being read");
+            }
+            if (choice == 2 || choice == 3) {
+                std::cout << fileTypeName(fileType) << " Metadata:" << std::endl;
             }
         }catch (const std::exception& e) {
             std::cerr << e.what() << std::endl;
@@ -103,7 +448,16 @@ int main(int argc, char* argv[]) {
         }
 
         // Print the extracted metadata using a lambda template
-        printMetadata(metadata);
+        printMetadata(std::cout, metadata);
     }
-    return 0;
-}
\ No newline at end of file
+
+    if (!statsFormat.empty()) {
+        StageReport report = collectStageStats();
+        if (statsFormat == "json") {
+            writeStageStatsJson(stderr, report);
+        } else {
+            writeStageStatsText(stderr, report);
+        }
+    }
+    return status;
+}
@@ -0,0 +1,133 @@
+#include "ArchiveWalker.h"
+#include "Check.h"
+#include "ZipBuilder.h"
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Tests of `walkArchiveMembers`: nested archives (whose member maps must not outlive the arena rewinds
+ * of the walks below them; run under `make SANITIZE=address test`), the depth limit, and the
+ * per-member inflation cap.
+ */
+
+namespace {
+
+//What the walk reported for one member, copied out of the arena.
+struct Member {
+    FileType fileType = FileType::UNKNOWN;
+    std::map<std::string, std::string> fields;
+};
+
+struct Walk {
+    ArchiveStats stats;
+    std::map<std::string, Member> members;
+    std::vector<std::string> errors;
+};
+
+Walk walk(const std::vector<uint8_t>& archive, const ArchiveOptions& options) {
+    struct stat status {};
+    status.st_mode = S_IFREG | 0644;
+    status.st_size = static_cast<off_t>(archive.size());
+    FileContext context("outer.zip", status, archive);
+
+    Walk result;
+    result.stats = walkArchiveMembers(
+        context, options,
+        [&result](const std::filesystem::path& memberPath, FileType fileType, const MetadataMap& metadata) {
+            Member& member = result.members[memberPath.string()];
+            member.fileType = fileType;
+            for (const auto& [key, value] : metadata) {
+                member.fields[std::string(key.view())] = value.toString();
+            }
+        },
+        [&result](const std::filesystem::path& memberPath, const std::string& message) {
+            result.errors.push_back(memberPath.string() + ": " + message);
+        });
+    return result;
+}
+
+std::string field(const Walk& result, const std::string& path, const std::string& name) {
+    auto member = result.members.find(path);
+    if (member == result.members.end()) {
+        return "<no member>";
+    }
+    auto value = member->second.fields.find(name);
+    return value == member->second.fields.end() ? "<no field>" : value->second;
+}
+
+std::vector<uint8_t> nestedArchive() {
+    std::vector<uint8_t> innermost = ZipBuilder().add("x.txt", "deepest line\n").build();
+    std::vector<uint8_t> inner = ZipBuilder()
+                                     .add("deep.txt", "alpha beta\ngamma\n", true)
+                                     .add("innermost.zip", innermost)
+                                     .add("tail.txt", "after the innermost archive\n")
+                                     .build();
+    return ZipBuilder()
+        .add("notes.txt", "one two\nthree\n")
+        .add("inner.zip", inner)
+        .add("after.txt", "written after the nested archive\nsecond line\nthird line\n")
+        .build();
+}
+
+void testNested() {
+    ArchiveOptions options;
+    options.maxDepth = 3;
+    Walk result = walk(nestedArchive(), options);
+
+    CHECK(result.errors.empty());
+    CHECK(result.stats.errors == 0);
+    CHECK(result.stats.members == 7);
+    CHECK(result.members.size() == 7);
+    CHECK(result.members["outer.zip/inner.zip"].fileType == FileType::ZIP);
+    CHECK(result.members["outer.zip/inner.zip/innermost.zip"].fileType == FileType::ZIP);
+
+    // Members before, inside and after each nested archive keep their own fields
+    CHECK(field(result, "outer.zip/notes.txt", "LineCount") == "2");
+    CHECK(field(result, "outer.zip/notes.txt", "WordCount") == "3");
+    CHECK(field(result, "outer.zip/inner.zip/deep.txt", "LineCount") == "2");
+    CHECK(field(result, "outer.zip/inner.zip/innermost.zip/x.txt", "Title") == "deepest line");
+    CHECK(field(result, "outer.zip/inner.zip/tail.txt", "FileName") == "tail.txt");
+    CHECK(field(result, "outer.zip/after.txt", "LineCount") == "3");
+    CHECK(field(result, "outer.zip/after.txt", "Title") == "written after the nested archive");
+}
+
+void testDepthLimit() {
+    ArchiveOptions options;
+    options.maxDepth = 1;
+    Walk result = walk(nestedArchive(), options);
+    CHECK(result.errors.empty());
+    CHECK(result.stats.members == 3);
+    CHECK(result.members.count("outer.zip/inner.zip") == 1);
+    CHECK(result.members.count("outer.zip/inner.zip/deep.txt") == 0);
+
+    options.maxDepth = 2;
+    result = walk(nestedArchive(), options);
+    CHECK(result.stats.members == 6);
+    CHECK(result.members.count("outer.zip/inner.zip/innermost.zip/x.txt") == 0);
+}
+
+void testMemberCap() {
+    std::string large;
+    while (large.size() < 1 << 20) {
+        large += "a line of text that repeats\n";
+    }
+    std::vector<uint8_t> archive = ZipBuilder().add("large.txt", large).add("small.txt", "still analyzed\n").build();
+
+    ArchiveOptions options;
+    options.maxMemberBytes = 100000;
+    Walk result = walk(archive, options);
+    CHECK(result.errors.empty());
+    CHECK(field(result, "outer.zip/large.txt", "AnalyzedBytes") == MetadataValue::byteCount(100000).toString());
+    CHECK(field(result, "outer.zip/small.txt", "Title") == "still analyzed");
+    CHECK(field(result, "outer.zip/small.txt", "AnalyzedBytes") == "<no field>");
+}
+
+}
+
+int main() {
+    testNested();
+    testDepthLimit();
+    testMemberCap();
+    return testResult();
+}
@@ -0,0 +1,51 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <iostream>
+
+/**
+ * Minimal assertions for the programs behind `make test`.
+ *
+ * A failed check prints its location and expression and the program keeps going, so one run reports
+ * every failure; `main` returns `testResult()`, which is non-zero if any check failed.
+ */
+
+//Checks that failed so far in this program.
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+//Exit status of a test program: 0 when every check passed.
+inline int testResult() {
+    if (testFailures() != 0) {
+        std::cerr << testFailures() << " check(s) failed" << std::endl;
+    }
+    return testFailures() != 0;
+}
+
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            ++testFailures();                                                             \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+        }                                                                                 \
+    } while (0)
+
+//Checks that `expression` throws an exception of type `Exception` (or derived from it).
+#define CHECK_THROWS(expression, Exception)                                               \
+    do {                                                                                  \
+        bool thrown = false;                                                              \
+        try {                                                                             \
+            (void)(expression);                                                           \
+        } catch (const Exception&) {                                                      \
+            thrown = true;                                                                \
+        } catch (...) {                                                                   \
+        }                                                                                 \
+        if (!thrown) {                                                                    \
+            ++testFailures();                                                             \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #expression " did not throw " #Exception << std::endl; \
+        }                                                                                 \
+    } while (0)
+
+#endif
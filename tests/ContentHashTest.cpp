@@ -0,0 +1,95 @@
+#include "ContentHash.h"
+#include "FileContext.h"
+#include "Check.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+/**
+ * Tests of `ContentHasher` against reference XXH3-64 values for lengths on either side of every size
+ * class and block boundary, the same input fed in uneven pieces with digests taken along the way, and
+ * `hashFileContents` over a file on disk.
+ */
+
+namespace {
+
+std::vector<uint8_t> sampleBytes(std::size_t length) {
+    std::vector<uint8_t> bytes(length);
+    for (std::size_t k = 0; k < length; ++k) {
+        bytes[k] = static_cast<uint8_t>((k * 131 + 7) ^ (k >> 8));
+    }
+    return bytes;
+}
+
+// XXH3_64bits() of the first `length` sample bytes, from the reference implementation
+const std::vector<std::pair<std::size_t, uint64_t>> Reference = {
+    {0, 0x2D06800538D394C2ULL},      {1, 0x4C5CCA45D0F4811FULL},      {3, 0x6E3E2670E61106ACULL},
+    {4, 0x5C4C63133443D03FULL},      {8, 0xF9FD4DD0B04D78F5ULL},      {9, 0x7C20DF9712C26EDFULL},
+    {16, 0x86ABF6BACCEA0858ULL},     {17, 0xB58BF5DC5022D071ULL},     {128, 0x10D17F72C0CCBA41ULL},
+    {129, 0x1648BDC3DB49D1A2ULL},    {240, 0xB6CFAF343FAB81E6ULL},    {241, 0x956CAE592C67279EULL},
+    {255, 0x64A6073025EB7929ULL},    {256, 0xB15E550733C5DFACULL},    {257, 0x67CE5A3104C5C55CULL},
+    {1023, 0xDF6D4CDAF9ACD422ULL},   {1024, 0x9FB9947417C15B80ULL},   {1025, 0xFE1B47100B1D79D8ULL},
+    {4096, 0x0DAED5401DB51994ULL},   {100003, 0x0CA03D7B43867D6CULL}, {200000, 0x50F9CBF3711CD77DULL},
+};
+
+void testReferenceValues() {
+    std::string implementation = contentHashImplementation();
+    CHECK(implementation == "avx2" || implementation == "sse2" || implementation == "scalar");
+
+    std::vector<uint8_t> data = sampleBytes(200000);
+    for (const auto& [length, expected] : Reference) {
+        CHECK(contentHash(std::span<const uint8_t>(data.data(), length)) == expected);
+    }
+}
+
+void testStreaming() {
+    std::vector<uint8_t> data = sampleBytes(200000);
+    for (const auto& [length, expected] : Reference) {
+        // Uneven pieces that straddle the internal buffer, with a digest taken after each one
+        ContentHasher hasher;
+        std::span<const uint8_t> rest(data.data(), length);
+        for (std::size_t piece = 1; !rest.empty(); piece = piece * 2 + 3) {
+            std::size_t taken = std::min(piece, rest.size());
+            hasher.update(rest.first(taken));
+            rest = rest.subspan(taken);
+            CHECK(hasher.digest() == contentHash(std::span<const uint8_t>(data.data(), length - rest.size())));
+        }
+        CHECK(hasher.digest() == expected);
+
+        // One byte at a time
+        if (length <= 4096) {
+            ContentHasher bytewise;
+            for (std::size_t k = 0; k < length; ++k) {
+                bytewise.update(std::span<const uint8_t>(data.data() + k, 1));
+            }
+            CHECK(bytewise.digest() == expected);
+        }
+    }
+}
+
+void testFileContents() {
+    std::vector<uint8_t> data = sampleBytes(200000);
+    char name[] = "/tmp/contenthash-test-XXXXXX";
+    int fd = ::mkstemp(name);
+    CHECK(fd >= 0 && ::write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+    ::close(fd);
+    {
+        FileContext context(name);
+        CHECK(hashFileContents(context) == 0x50F9CBF3711CD77DULL);
+    }
+    FileContext missing("/tmp/contenthash-test-missing");
+    CHECK(!hashFileContents(missing));
+    ::unlink(name);
+}
+
+}
+
+int main() {
+    testReferenceValues();
+    testStreaming();
+    testFileContents();
+    return testResult();
+}
@@ -0,0 +1,126 @@
+#include "CustomMap.h"
+#include "Check.h"
+#include <memory_resource>
+#include <string>
+
+/**
+ * Tests of `CustomMap`: insertion-order iteration, lookups below and above the point where the hash
+ * index is built, erasing (which rebuilds the index), heterogeneous string lookups, and which
+ * resource copies and moves end up in.
+ */
+
+namespace {
+
+std::string keyOf(int i) {
+    return "key" + std::to_string(i);
+}
+
+void testSmallMap() {
+    CustomMap<std::string, int> map;
+    CHECK(map.empty());
+    map.insert("b", 1);
+    map.insert("a", 2);
+    map["c"] = 3;
+    map.insert("b", 4);
+    CHECK(map.size() == 3);
+    CHECK(map.find(std::string_view("b"))->value == 4);
+    CHECK(map.find("a")->value == 2);
+    CHECK(map.find("z") == map.end());
+    CHECK(map["d"] == 0 && map.size() == 4);
+
+    std::string order;
+    for (const auto& [key, value] : map) {
+        order += key;
+    }
+    CHECK(order == "bacd");
+}
+
+void testIndexedMap() {
+    constexpr int Count = 1000;
+    CustomMap<std::string, int> map;
+    for (int i = 0; i < Count; ++i) {
+        map[keyOf(i)] = i;
+    }
+    CHECK(map.size() == Count);
+    bool allFound = true;
+    for (int i = 0; i < Count; ++i) {
+        auto it = map.find(keyOf(i));
+        allFound &= it != map.end() && it->value == i;
+    }
+    CHECK(allFound);
+    CHECK(!map.contains("missing"));
+
+    // Erasing keeps the order of the rest and leaves the index consistent
+    for (int i = 0; i < Count; i += 2) {
+        map.erase(keyOf(i));
+    }
+    CHECK(map.size() == Count / 2);
+    bool consistent = true;
+    for (int i = 0; i < Count; ++i) {
+        consistent &= map.contains(keyOf(i)) == (i % 2 == 1);
+    }
+    CHECK(consistent);
+    CHECK(map.begin()->value == 1 && (map.end() - 1)->value == Count - 1);
+
+    // Down to the linear search again
+    for (int i = 1; i < Count - 4; i += 2) {
+        map.erase(keyOf(i));
+    }
+    CHECK(map.size() == 2 && map.contains(keyOf(Count - 3)) && map.contains(keyOf(Count - 1)));
+
+    map.clear();
+    CHECK(map.empty() && !map.contains(keyOf(Count - 1)));
+}
+
+void testReserve() {
+    CustomMap<int, int> map;
+    map.reserve(100);
+    std::size_t reserved = map.capacity();
+    CHECK(reserved >= 100);
+    for (int i = 0; i < 100; ++i) {
+        map[i] = -i;
+    }
+    CHECK(map.capacity() == reserved); // no reallocation while filling what was reserved
+    CHECK(map.find(57)->value == -57 && map.find(100) == map.end());
+}
+
+void testResources() {
+    std::pmr::monotonic_buffer_resource arena;
+    CustomMap<std::string, int> inArena(&arena);
+    for (int i = 0; i < 20; ++i) {
+        inArena[keyOf(i)] = i;
+    }
+    CHECK(inArena.memory() == &arena);
+
+    // A copy leaves the arena; equality compares contents, not resources
+    CustomMap<std::string, int> copy(inArena);
+    CHECK(copy.memory() == std::pmr::get_default_resource());
+    CHECK(copy == inArena);
+
+    // Move construction keeps the resource
+    CustomMap<std::string, int> moved(std::move(copy));
+    CHECK(moved.memory() == std::pmr::get_default_resource() && moved.size() == 20);
+
+    // Move assignment across resources copies into the destination's and empties the source
+    CustomMap<std::string, int> other(&arena);
+    other = std::move(moved);
+    CHECK(other.memory() == &arena && other.size() == 20 && moved.empty());
+    CHECK(other.find(keyOf(19))->value == 19);
+
+    // Copy assignment keeps the destination's resource
+    CustomMap<std::string, int> heap;
+    heap = other;
+    CHECK(heap.memory() == std::pmr::get_default_resource() && heap == other);
+    heap["extra"] = 1;
+    CHECK(heap != other);
+}
+
+}
+
+int main() {
+    testSmallMap();
+    testIndexedMap();
+    testReserve();
+    testResources();
+    return testResult();
+}
@@ -0,0 +1,188 @@
+#include "ExifReader.h"
+#include "Check.h"
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Tests of `ExifReader` over TIFF blocks built in both byte orders: inline and external values, the
+ * Exif sub-directory, integer, rational and text accessors, offsets that point outside the block, the
+ * directory entry cap, and bad headers.
+ */
+
+namespace {
+
+//Writes a TIFF block in either byte order.
+class TiffBuilder {
+public:
+    explicit TiffBuilder(bool bigEndian) : bigEndian(bigEndian) {
+        bytes.push_back(bigEndian ? 'M' : 'I');
+        bytes.push_back(bigEndian ? 'M' : 'I');
+        u16(42);
+        u32(8);
+    }
+
+    void u16(uint16_t value) {
+        for (int i = 0; i < 2; ++i) {
+            bytes.push_back(static_cast<uint8_t>(value >> (bigEndian ? 8 * (1 - i) : 8 * i)));
+        }
+    }
+
+    void u32(uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            bytes.push_back(static_cast<uint8_t>(value >> (bigEndian ? 8 * (3 - i) : 8 * i)));
+        }
+    }
+
+    void entry(uint16_t tag, uint16_t type, uint32_t count, uint32_t valueOrOffset) {
+        u16(tag);
+        u16(type);
+        u32(count);
+        u32(valueOrOffset);
+    }
+
+    //An entry whose value (at most 4 bytes) is stored inline, left-justified.
+    void inlineEntry(uint16_t tag, uint16_t type, uint32_t count, std::string_view value) {
+        u16(tag);
+        u16(type);
+        u32(count);
+        std::string padded(value);
+        padded.resize(4, '\0');
+        bytes.insert(bytes.end(), padded.begin(), padded.end());
+    }
+
+    void raw(std::string_view data) {
+        bytes.insert(bytes.end(), data.begin(), data.end());
+    }
+
+    std::size_t size() const {
+        return bytes.size();
+    }
+
+    std::vector<uint8_t> bytes;
+    bool bigEndian;
+};
+
+constexpr uint16_t Ascii = 2;
+constexpr uint16_t Short = 3;
+constexpr uint16_t Long = 4;
+constexpr uint16_t Rational = 5;
+constexpr uint16_t SignedRational = 10;
+constexpr uint16_t ExposureBias = 0x9204;
+
+// IFD0 at 8 (5 entries), then the Make text, then the Exif IFD (5 entries), then its rationals
+std::vector<uint8_t> sampleTiff(bool bigEndian) {
+    TiffBuilder tiff(bigEndian);
+    const uint32_t makeOffset = 8 + 2 + 5 * 12 + 4;
+    const uint32_t exifOffset = makeOffset + 8;
+    const uint32_t rationals = exifOffset + 2 + 5 * 12 + 4;
+
+    tiff.u16(5);
+    tiff.entry(ExifReader::Make, Ascii, 8, makeOffset);
+    tiff.inlineEntry(ExifReader::Model, Ascii, 3, std::string_view("X1\0", 3));
+    tiff.entry(ExifReader::Orientation, Short, 1, bigEndian ? 6u << 16 : 6u);
+    tiff.inlineEntry(ExifReader::Software, Ascii, 4, "v1  ");
+    tiff.entry(ExifReader::ExifIfd, Long, 1, exifOffset);
+    tiff.u32(0);
+    tiff.raw(std::string_view("Canon  \0", 8));
+
+    tiff.u16(5);
+    tiff.entry(ExifReader::ExposureTime, Rational, 1, rationals);
+    tiff.entry(ExifReader::FNumber, Rational, 1, rationals + 8);
+    tiff.entry(ExposureBias, SignedRational, 1, rationals + 16);
+    tiff.entry(ExifReader::IsoSpeed, Short, 2, bigEndian ? (400u << 16) | 800u : (800u << 16) | 400u);
+    tiff.entry(ExifReader::DateTimeOriginal, Ascii, 20, 5000); // outside the block
+    tiff.u32(0);
+    tiff.u32(1);
+    tiff.u32(250);
+    tiff.u32(28);
+    tiff.u32(10);
+    tiff.u32(static_cast<uint32_t>(-1));
+    tiff.u32(3);
+    return tiff.bytes;
+}
+
+void testDirectories(bool bigEndian) {
+    std::vector<uint8_t> bytes = sampleTiff(bigEndian);
+    ExifReader exif(bytes);
+    CHECK(exif.firstDirectory() == 8);
+
+    std::map<uint16_t, ExifEntry> primary;
+    CHECK(exif.forEachEntry(exif.firstDirectory(), [&primary](const ExifEntry& entry) {
+        primary[entry.tag] = entry;
+        return true;
+    }) == 5);
+    CHECK(exif.text(primary[ExifReader::Make]) == "Canon");
+    CHECK(exif.text(primary[ExifReader::Model]) == "X1");
+    CHECK(exif.text(primary[ExifReader::Software]) == "v1");
+    CHECK(exif.integer(primary[ExifReader::Orientation]) == 6u);
+
+    std::optional<uint32_t> exifIfd = exif.integer(primary[ExifReader::ExifIfd]);
+    CHECK(exifIfd.has_value());
+    std::map<uint16_t, ExifEntry> sub;
+    exif.forEachEntry(exifIfd.value_or(0), [&sub](const ExifEntry& entry) {
+        sub[entry.tag] = entry;
+        return true;
+    });
+    CHECK(sub.size() == 5);
+    CHECK(exif.rational(sub[ExifReader::ExposureTime]) == 1.0 / 250);
+    CHECK(exif.rational(sub[ExifReader::FNumber]) == 2.8);
+    std::optional<double> bias = exif.rational(sub[ExposureBias]);
+    CHECK(bias && std::abs(*bias + 1.0 / 3) < 1e-12);
+    CHECK(exif.integer(sub[ExifReader::IsoSpeed], 0) == 400u);
+    CHECK(exif.integer(sub[ExifReader::IsoSpeed], 1) == 800u);
+    CHECK(!exif.integer(sub[ExifReader::IsoSpeed], 2));
+    CHECK(!exif.rational(sub[ExifReader::IsoSpeed]));
+    CHECK(!exif.integer(sub[ExifReader::ExposureTime]));
+
+    // A value that lies outside the block is empty rather than read past the end
+    CHECK(sub[ExifReader::DateTimeOriginal].value.empty());
+    CHECK(exif.text(sub[ExifReader::DateTimeOriginal]).empty());
+
+    // Returning false stops the walk; a directory outside the block has no entries
+    CHECK(exif.forEachEntry(exif.firstDirectory(), [](const ExifEntry&) { return false; }) == 1);
+    CHECK(exif.forEachEntry(static_cast<uint32_t>(bytes.size() + 10), [](const ExifEntry&) { return true; }) == 0);
+}
+
+void testHostileCounts() {
+    // A directory claiming 65535 entries stops at the cap, or earlier at the end of the block
+    TiffBuilder tiff(false);
+    tiff.u16(0xFFFF);
+    for (uint32_t i = 0; i < 600; ++i) {
+        tiff.entry(static_cast<uint16_t>(i), Long, 0x40000000, 8); // a count far beyond the block
+    }
+    ExifReader exif(tiff.bytes);
+    bool emptyValues = true;
+    uint32_t visited = exif.forEachEntry(exif.firstDirectory(), [&emptyValues](const ExifEntry& entry) {
+        emptyValues &= entry.value.empty();
+        return true;
+    });
+    CHECK(visited == ExifReader::MaxEntries);
+    CHECK(emptyValues);
+
+    std::vector<uint8_t> cut(tiff.bytes.begin(), tiff.bytes.begin() + 8 + 2 + 12 * 10 + 5);
+    CHECK(ExifReader(cut).forEachEntry(8, [](const ExifEntry&) { return true; }) == 10);
+}
+
+void testBadHeaders() {
+    std::vector<uint8_t> bytes = sampleTiff(false);
+    std::vector<uint8_t> badOrder = bytes;
+    badOrder[0] = 'X';
+    CHECK_THROWS(ExifReader(badOrder), std::runtime_error);
+    std::vector<uint8_t> badMagic = bytes;
+    badMagic[2] = 43;
+    CHECK_THROWS(ExifReader(badMagic), std::runtime_error);
+    CHECK_THROWS(ExifReader(std::vector<uint8_t>{'I', 'I'}), std::exception);
+}
+
+}
+
+int main() {
+    testDirectories(false);
+    testDirectories(true);
+    testHostileCounts();
+    testBadHeaders();
+    return testResult();
+}
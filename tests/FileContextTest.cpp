@@ -0,0 +1,72 @@
+#include "FileContext.h"
+#include "Check.h"
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Tests of `FileContext` over files that are truncated while mapped: the vanished pages read as zeros
+ * instead of raising SIGBUS, the context reports `wasTruncated()`, and other mappings are unaffected.
+ */
+
+namespace {
+
+constexpr std::size_t FileSize = 4 * 4096;
+
+//Creates a temporary file of `FileSize` bytes of `fill` and returns its path.
+std::string makeFile(char fill) {
+    char name[] = "/tmp/filecontext-test-XXXXXX";
+    int fd = ::mkstemp(name);
+    std::vector<char> contents(FileSize, fill);
+    CHECK(fd >= 0 && ::write(fd, contents.data(), contents.size()) == static_cast<ssize_t>(contents.size()));
+    ::close(fd);
+    return name;
+}
+
+void testTruncatedWhileMapped() {
+    std::string truncatedPath = makeFile('x');
+    std::string intactPath = makeFile('y');
+    {
+        FileContext truncated(truncatedPath);
+        FileContext intact(intactPath);
+        CHECK(truncated.isMapped() && intact.isMapped());
+        CHECK(truncated.bytes()[0] == 'x');
+        CHECK(!truncated.wasTruncated());
+
+        CHECK(::truncate(truncatedPath.c_str(), 0) == 0);
+        CHECK(truncated.bytes()[FileSize - 1] == 0);
+        CHECK(truncated.bytes()[FileSize / 2] == 0);
+        CHECK(truncated.wasTruncated());
+
+        CHECK(intact.bytes()[FileSize - 1] == 'y');
+        CHECK(!intact.wasTruncated());
+    }
+    ::unlink(truncatedPath.c_str());
+    ::unlink(intactPath.c_str());
+}
+
+void testAdoptedTruncatedWhileMapped() {
+    std::string path = makeFile('z');
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat status {};
+    CHECK(fd >= 0 && ::fstat(fd, &status) == 0);
+    {
+        FileContext context(path, fd, status, std::vector<std::uint8_t>(4096, 'z'));
+        CHECK(context.isMapped());
+        CHECK(::truncate(path.c_str(), 4096) == 0);
+        CHECK(context.bytes()[4095] == 'z');
+        CHECK(context.bytes()[FileSize - 1] == 0);
+        CHECK(context.wasTruncated());
+    }
+    ::unlink(path.c_str());
+}
+
+}
+
+int main() {
+    testTruncatedWhileMapped();
+    testAdoptedTruncatedWhileMapped();
+    return testResult();
+}
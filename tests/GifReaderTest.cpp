@@ -0,0 +1,188 @@
+#include "GifReader.h"
+#include "Check.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Tests of `GifReader` over an animated GIF built in memory: the screen descriptor and color tables,
+ * block order, graphic control delays, the NETSCAPE loop count, comment data spread over sub-blocks,
+ * truncated streams and bad headers.
+ */
+
+namespace {
+
+class GifBuilder {
+public:
+    GifBuilder(uint16_t width, uint16_t height, bool globalTable) {
+        raw("GIF89a");
+        u16(width);
+        u16(height);
+        bytes.push_back(globalTable ? 0x81 : 0x00); // a 4-entry global table
+        bytes.push_back(0);
+        bytes.push_back(0);
+        if (globalTable) {
+            bytes.insert(bytes.end(), 12, 0x11);
+        }
+    }
+
+    GifBuilder& loop(uint16_t count) {
+        raw("\x21\xFF\x0B" "NETSCAPE2.0\x03\x01");
+        u16(count);
+        bytes.push_back(0);
+        return *this;
+    }
+
+    GifBuilder& delay(uint16_t hundredths) {
+        raw(std::string_view("\x21\xF9\x04\x00", 4));
+        u16(hundredths);
+        raw(std::string_view("\x00\x00", 2));
+        return *this;
+    }
+
+    //A comment extension whose text is split into sub-blocks of at most `piece` bytes.
+    GifBuilder& comment(std::string_view text, std::size_t piece) {
+        raw("\x21\xFE");
+        for (std::size_t at = 0; at < text.size(); at += piece) {
+            std::string_view part = text.substr(at, piece);
+            bytes.push_back(static_cast<uint8_t>(part.size()));
+            raw(part);
+        }
+        bytes.push_back(0);
+        return *this;
+    }
+
+    //An image with a 2-entry local color table and `dataLength` bytes of (fake) LZW data.
+    GifBuilder& image(uint16_t width, uint16_t height, std::size_t dataLength) {
+        bytes.push_back(0x2C);
+        u16(0);
+        u16(0);
+        u16(width);
+        u16(height);
+        bytes.push_back(0x80);
+        bytes.insert(bytes.end(), 6, 0x22);
+        bytes.push_back(2); // LZW minimum code size
+        while (dataLength > 0) {
+            std::size_t piece = std::min<std::size_t>(dataLength, 255);
+            bytes.push_back(static_cast<uint8_t>(piece));
+            bytes.insert(bytes.end(), piece, 0x33);
+            dataLength -= piece;
+        }
+        bytes.push_back(0);
+        return *this;
+    }
+
+    std::vector<uint8_t> build() {
+        std::vector<uint8_t> out = bytes;
+        out.push_back(GifBlock::Trailer);
+        return out;
+    }
+
+private:
+    void u16(uint16_t value) {
+        bytes.push_back(static_cast<uint8_t>(value));
+        bytes.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    void raw(std::string_view data) {
+        bytes.insert(bytes.end(), data.begin(), data.end());
+    }
+
+    std::vector<uint8_t> bytes;
+};
+
+std::vector<uint8_t> animation() {
+    return GifBuilder(320, 200, true)
+        .loop(3)
+        .comment(std::string(300, 'c') + "!", 255)
+        .delay(10)
+        .image(320, 200, 600)
+        .delay(25)
+        .image(16, 16, 5)
+        .build();
+}
+
+void testBlocks() {
+    std::vector<uint8_t> gif = animation();
+    GifReader reader(gif);
+    CHECK(reader.version() == "89a");
+    CHECK(reader.screen().width == 320 && reader.screen().height == 200);
+    CHECK(reader.screen().globalColorTableSize() == 12);
+
+    std::string order;
+    std::vector<uint16_t> delays;
+    std::optional<uint16_t> loops;
+    std::pmr::string comment;
+    uint64_t visited = reader.forEachBlock([&](const GifBlock& block) {
+        if (block.isImage()) {
+            order += "I";
+        } else if (block.introducer == GifBlock::Trailer) {
+            order += ";";
+        } else {
+            order += block.label == GifBlock::GraphicControl ? "G" : block.label == GifBlock::Comment ? "C" : "A";
+        }
+        if (block.isExtension(GifBlock::GraphicControl)) {
+            delays.push_back(GifReader::decodeDelay(block).value_or(0xFFFF));
+        }
+        if (block.isExtension(GifBlock::Application)) {
+            loops = reader.decodeLoopCount(block);
+        }
+        if (block.isExtension(GifBlock::Comment)) {
+            reader.appendData(block, comment, 1000);
+        }
+        return true;
+    });
+    CHECK(visited == 7);
+    CHECK(order == "ACGIGI;");
+    CHECK(delays == std::vector<uint16_t>({10, 25}));
+    CHECK(loops == 3u);
+    CHECK(std::string_view(comment) == std::string(300, 'c') + "!");
+
+    // Returning false stops the walk
+    CHECK(reader.forEachBlock([](const GifBlock& block) { return !block.isImage(); }) == 4);
+}
+
+void testCommentLimit() {
+    std::vector<uint8_t> gif = GifBuilder(1, 1, false).comment("0123456789", 3).image(1, 1, 1).build();
+    GifReader reader(gif);
+    std::pmr::string text;
+    reader.forEachBlock([&](const GifBlock& block) {
+        if (block.isExtension(GifBlock::Comment)) {
+            reader.appendData(block, text, 5);
+        }
+        return true;
+    });
+    CHECK(text == "01234");
+    CHECK(reader.screen().globalColorTableSize() == 0);
+}
+
+void testTruncated() {
+    std::vector<uint8_t> gif = animation();
+    // Cut inside the first image's data: the walk ends before that image
+    std::vector<uint8_t> prefix(gif.begin(), gif.begin() + 13 + 12 + 19 + 4 + 301 + 8 + 300);
+    CHECK(GifReader(prefix).forEachBlock([](const GifBlock&) { return true; }) == 3);
+
+    // Without a trailer the walk ends with the last complete block
+    std::vector<uint8_t> noTrailer(gif.begin(), gif.end() - 1);
+    CHECK(GifReader(noTrailer).forEachBlock([](const GifBlock&) { return true; }) == 6);
+}
+
+void testBadHeaders() {
+    std::vector<uint8_t> gif = animation();
+    std::vector<uint8_t> badSignature = gif;
+    badSignature[4] = '8';
+    badSignature[5] = 'b';
+    CHECK_THROWS(GifReader(badSignature), std::runtime_error);
+    CHECK_THROWS(GifReader(std::vector<uint8_t>(gif.begin(), gif.begin() + 10)), std::runtime_error);
+}
+
+}
+
+int main() {
+    testBlocks();
+    testCommentLimit();
+    testTruncated();
+    testBadHeaders();
+    return testResult();
+}
@@ -0,0 +1,49 @@
+#include "MetadataArena.h"
+#include "Check.h"
+#include <cstring>
+
+/**
+ * Tests of `MetadataArena`: blocks are reused across resets without going back to the global allocator,
+ * and blocks past `RetainLimit` (even the first one) are returned on reset.
+ */
+
+namespace {
+
+void testReuse() {
+    MetadataArena arena(4096);
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 10; ++i) {
+            std::memset(arena.allocate(1000, 8), 0xAB, 1000);
+        }
+        arena.reset();
+    }
+    // Four allocations fit a block; the three blocks of the first round serve the others
+    CHECK(arena.upstreamAllocations() == 3);
+    CHECK(arena.reservedBytes() == 3 * 4096);
+    CHECK(arena.highWater() == 10 * 1000);
+}
+
+void testRetainLimit() {
+    MetadataArena arena(4096);
+    // A first allocation larger than the limit gets a block of its own, which reset gives back
+    CHECK(arena.allocate(MetadataArena::RetainLimit + 1, 8) != nullptr);
+    CHECK(arena.reservedBytes() > MetadataArena::RetainLimit);
+    arena.reset();
+    CHECK(arena.reservedBytes() == 0);
+    CHECK(arena.allocate(100, 8) != nullptr);
+    CHECK(arena.reservedBytes() == 4096);
+
+    // Small blocks within the limit stay, the large one after them goes
+    CHECK(arena.allocate(MetadataArena::RetainLimit, 8) != nullptr);
+    arena.reset();
+    CHECK(arena.reservedBytes() == 4096);
+    CHECK(arena.upstreamAllocations() == 3);
+}
+
+}
+
+int main() {
+    testReuse();
+    testRetainLimit();
+    return testResult();
+}
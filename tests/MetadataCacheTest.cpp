@@ -0,0 +1,157 @@
+#include "MetadataCache.h"
+#include "Check.h"
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+
+/**
+ * Tests of `MetadataCache`: results survive a save and a reload, records that were neither hit nor
+ * re-inserted are dropped, a re-analyzed inode supersedes its old record, and damaged snapshots
+ * (truncated, a record running past its bounds, a corrupt pair) read as misses instead of throwing.
+ */
+
+namespace {
+
+// The first record starts right after the 64-byte file header
+constexpr std::size_t FirstRecord = 64;
+
+CacheKey keyFor(uint64_t inode, int64_t mtimeNs = 1000) {
+    CacheKey key;
+    key.device = 42;
+    key.inode = inode;
+    key.size = 100 + inode;
+    key.mtimeNs = mtimeNs;
+    return key;
+}
+
+MetadataMap metadataFor(uint64_t inode) {
+    MetadataMap metadata;
+    metadata["Title"_key] = MetadataValue(std::string_view("title " + std::to_string(inode)));
+    metadata["Width"_key] = MetadataValue(static_cast<int64_t>(inode * 10));
+    metadata["Checksum"_key] = MetadataValue::hex(0xBEEF, 8);
+    metadata["Created"_key] = MetadataValue(Timestamp{1700000000, 5});
+    return metadata;
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string& path, const std::string& contents) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << contents;
+}
+
+void putU32(std::string& bytes, std::size_t offset, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        bytes[offset + i] = static_cast<char>(value >> (8 * i));
+    }
+}
+
+//Writes a snapshot holding inodes 1..count and returns its bytes.
+std::string makeSnapshot(const std::string& path, uint64_t count) {
+    ::unlink(path.c_str());
+    MetadataCache cache(path);
+    for (uint64_t inode = 1; inode <= count; ++inode) {
+        cache.insert(keyFor(inode), FileType::PNG, metadataFor(inode));
+    }
+    cache.save();
+    return readFile(path);
+}
+
+void testRoundTrip(const std::string& path) {
+    makeSnapshot(path, 3);
+    MetadataCache cache(path);
+    CHECK(cache.size() == 3);
+    auto record = cache.lookup(keyFor(2));
+    CHECK(record && record->fileType() == FileType::PNG);
+    if (record) {
+        MetadataMap restored = record->toMap();
+        CHECK(restored == metadataFor(2));
+        CHECK(restored.find("Checksum")->value.toString() == metadataFor(2).find("Checksum")->value.toString());
+    }
+    CHECK(!cache.lookup(keyFor(2, 2000)));
+    CHECK(!cache.lookup(keyFor(9)));
+}
+
+void testSaveKeepsReachedRecords(const std::string& path) {
+    makeSnapshot(path, 3);
+    {
+        MetadataCache cache(path);
+        CHECK(cache.lookup(keyFor(1)).has_value());
+        cache.insert(keyFor(2, 2000), FileType::GIF, metadataFor(20));
+        cache.save();
+        // Inode 1 was hit, inode 2 re-analyzed, inode 3 never reached
+        CHECK(cache.size() == 2);
+    }
+    MetadataCache cache(path);
+    CHECK(cache.lookup(keyFor(1)).has_value());
+    CHECK(!cache.lookup(keyFor(2)));
+    auto updated = cache.lookup(keyFor(2, 2000));
+    CHECK(updated && updated->fileType() == FileType::GIF);
+    CHECK(!cache.lookup(keyFor(3)));
+}
+
+void testTruncated(const std::string& path) {
+    std::string snapshot = makeSnapshot(path, 3);
+    writeFile(path, snapshot.substr(0, snapshot.size() / 2));
+    MetadataCache cache(path);
+    CHECK(cache.size() == 0);
+    CHECK(!cache.lookup(keyFor(1)));
+    cache.insert(keyFor(4), FileType::PNG, metadataFor(4));
+    cache.save();
+    CHECK(cache.size() == 1 && cache.lookup(keyFor(4)).has_value());
+}
+
+void testRecordPastItsBounds(const std::string& path) {
+    std::string snapshot = makeSnapshot(path, 3);
+    putU32(snapshot, FirstRecord + CachedRecord::PayloadSizeOffset, 0x7FFFFFF0);
+    writeFile(path, snapshot);
+
+    MetadataCache cache(path);
+    CHECK(cache.size() == 3);
+    int hits = 0;
+    for (uint64_t inode = 1; inode <= 3; ++inode) {
+        hits += cache.lookup(keyFor(inode)).has_value();
+    }
+    // The broken record is a miss; the others still decode
+    CHECK(hits == 2);
+    cache.insert(keyFor(5), FileType::PNG, metadataFor(5));
+    cache.save();
+    CHECK(cache.lookup(keyFor(5)).has_value());
+}
+
+void testCorruptPair(const std::string& path) {
+    std::string snapshot = makeSnapshot(path, 1);
+    // First pair: key length, "Title", then the value tag and the text length
+    std::size_t textLength = FirstRecord + CachedRecord::HeaderSize + 4 + 5 + 4;
+    putU32(snapshot, textLength, 1000);
+    writeFile(path, snapshot);
+    CHECK(!MetadataCache(path).lookup(keyFor(1)));
+
+    snapshot = makeSnapshot(path, 1);
+    snapshot[FirstRecord + CachedRecord::HeaderSize + 4 + 5] = 99; // no such value kind
+    writeFile(path, snapshot);
+    CHECK(!MetadataCache(path).lookup(keyFor(1)));
+
+    snapshot = makeSnapshot(path, 1);
+    putU32(snapshot, FirstRecord + CachedRecord::PairCountOffset, 1000000);
+    writeFile(path, snapshot);
+    MetadataCache cache(path);
+    CHECK(!cache.lookup(keyFor(1)));
+    cache.save();
+}
+
+}
+
+int main() {
+    std::string path = "/tmp/metadata-cache-test-" + std::to_string(::getpid());
+    testRoundTrip(path);
+    testSaveKeepsReachedRecords(path);
+    testTruncated(path);
+    testRecordPastItsBounds(path);
+    testCorruptPair(path);
+    ::unlink(path.c_str());
+    return testResult();
+}
@@ -0,0 +1,180 @@
+#include "MetadataDaemon.h"
+#include "Check.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Tests of the `MetadataDaemon` query protocol over its Unix socket: GET, LIST, STATS and unknown
+ * requests, files added while it runs, a client that pipelines far more answers than the output cap
+ * without reading (and must still get every one, while other clients are served), and overlong lines.
+ */
+
+namespace {
+
+int connectTo(const std::filesystem::path& socketPath) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.native().size() + 1);
+    for (int attempt = 0; attempt < 500; ++attempt) {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0) {
+            return fd;
+        }
+        ::close(fd);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return -1;
+}
+
+bool sendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        data.remove_prefix(static_cast<std::size_t>(n));
+    }
+    return true;
+}
+
+//Reads from `fd` until `lines` newlines have arrived (or the connection ends) and returns what was read.
+std::string readLines(int fd, std::size_t lines) {
+    std::string text;
+    char buffer[64 * 1024];
+    std::size_t seen = 0;
+    while (seen < lines) {
+        ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            break;
+        }
+        for (ssize_t i = 0; i < n; ++i) {
+            seen += buffer[i] == '\n';
+        }
+        text.append(buffer, static_cast<std::size_t>(n));
+    }
+    return text;
+}
+
+//Sends one request on a fresh connection and returns the first `lines` lines of the answer.
+std::string ask(const std::filesystem::path& socketPath, const std::string& request, std::size_t lines = 1) {
+    int fd = connectTo(socketPath);
+    CHECK(fd >= 0);
+    CHECK(sendAll(fd, request + "\n"));
+    std::string answer = readLines(fd, lines);
+    ::close(fd);
+    return answer;
+}
+
+std::size_t countOf(const std::string& text, std::string_view needle) {
+    std::size_t count = 0;
+    for (std::size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + needle.size())) {
+        ++count;
+    }
+    return count;
+}
+
+void writeFile(const std::filesystem::path& path, const std::string& contents) {
+    std::ofstream(path) << contents;
+}
+
+//Asks STATS until the index holds `files` files, for at most a few seconds.
+bool waitForFiles(const std::filesystem::path& socketPath, std::size_t files) {
+    std::string expected = "{\"files\":" + std::to_string(files) + ",";
+    for (int attempt = 0; attempt < 300; ++attempt) {
+        if (ask(socketPath, "STATS").rfind(expected, 0) == 0) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+void testRequests(const std::filesystem::path& root, const std::filesystem::path& socketPath) {
+    std::string record = ask(socketPath, "GET " + (root / "a.txt").string());
+    CHECK(record.find("\"path\":\"" + (root / "a.txt").string() + "\"") != std::string::npos);
+
+    CHECK(ask(socketPath, "GET " + (root / "missing.txt").string()).find("\"error\":\"not found\"") != std::string::npos);
+    CHECK(ask(socketPath, "LIST " + root.string(), 3).find("{\"count\":2}") != std::string::npos);
+    CHECK(ask(socketPath, "LIST " + (root / "nothing").string()) == "{\"count\":0}\n");
+    CHECK(ask(socketPath, "FROB") == "{\"error\":\"unknown request\"}\n");
+    CHECK(ask(socketPath, "STATS").find("\"rescans\":0}") != std::string::npos);
+}
+
+void testFileAdded(const std::filesystem::path& root, const std::filesystem::path& socketPath) {
+    writeFile(root / "c.txt", "added while running\n");
+    CHECK(waitForFiles(socketPath, 3));
+    CHECK(ask(socketPath, "GET " + (root / "c.txt").string()).find("\"path\":") != std::string::npos);
+    std::filesystem::remove(root / "c.txt");
+    CHECK(waitForFiles(socketPath, 2));
+}
+
+void testPipelinedBacklog(const std::filesystem::path& root, const std::filesystem::path& socketPath) {
+    // Every answer is two records and a count, so these add up to several times the output cap
+    constexpr std::size_t Requests = 20000;
+    int fd = connectTo(socketPath);
+    CHECK(fd >= 0);
+    std::string request = "LIST " + root.string() + "\n";
+    std::thread writer([fd, &request] {
+        for (std::size_t i = 0; i < Requests; ++i) {
+            if (!sendAll(fd, request)) {
+                break;
+            }
+        }
+    });
+
+    // Let the daemon fill its backlog before anything is read; other clients are answered meanwhile
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    CHECK(ask(socketPath, "STATS").rfind("{\"files\":2,", 0) == 0);
+
+    std::string answers = readLines(fd, 3 * Requests);
+    writer.join();
+    ::close(fd);
+    CHECK(countOf(answers, "{\"count\":2}\n") == Requests);
+}
+
+void testOverlongRequest(const std::filesystem::path& socketPath) {
+    int fd = connectTo(socketPath);
+    CHECK(fd >= 0);
+    sendAll(fd, std::string(128 * 1024, 'x'));
+    char byte;
+    CHECK(::recv(fd, &byte, 1, 0) <= 0); // closed, usually with a reset for the unread input
+    ::close(fd);
+}
+
+}
+
+int main() {
+    char rootTemplate[] = "/tmp/daemon-test-XXXXXX";
+    std::filesystem::path root = ::mkdtemp(rootTemplate);
+    std::filesystem::path socketPath = root.string() + ".sock";
+    writeFile(root / "a.txt", "first file\n");
+    writeFile(root / "b.txt", "second file\n");
+
+    ScanOptions scan;
+    scan.threadCount = 2;
+    DaemonOptions options{{root}, socketPath, scan};
+    options.coalesceDelay = std::chrono::milliseconds(10);
+    MetadataDaemon daemon(options);
+    std::thread server([&daemon] { daemon.run(); });
+
+    if (waitForFiles(socketPath, 2)) {
+        testRequests(root, socketPath);
+        testFileAdded(root, socketPath);
+        testPipelinedBacklog(root, socketPath);
+        testOverlongRequest(socketPath);
+    } else {
+        CHECK(!"the initial scan was never indexed");
+    }
+
+    daemon.stop();
+    server.join();
+    std::filesystem::remove_all(root);
+    return testResult();
+}
@@ -0,0 +1,57 @@
+#include "OutputSink.h"
+#include "Check.h"
+#include <string>
+
+/**
+ * Tests of the JSON string escaping behind `NdjsonSink`: valid UTF-8 passes through unchanged, and
+ * every byte of an ill-formed sequence (overlong forms, surrogates, code points past U+10FFFF,
+ * truncated sequences) is escaped on its own as a Latin-1 character.
+ */
+
+namespace {
+
+std::string json(std::string_view text) {
+    std::string out;
+    appendJson(out, text);
+    return out;
+}
+
+void testValid() {
+    CHECK(json("plain") == "\"plain\"");
+    CHECK(json("q\"b\\\n\t\x01") == "\"q\\\"b\\\\\\n\\t\\u0001\"");
+    for (std::string_view text : {"\xC2\x80", "\xC3\xA9", "\xDF\xBF",                   // U+0080, U+00E9, U+07FF
+                                  "\xE0\xA0\x80", "\xE2\x82\xAC", "\xED\x9F\xBF",       // U+0800, U+20AC, U+D7FF
+                                  "\xEE\x80\x80", "\xEF\xBF\xBF",                       // U+E000, U+FFFF
+                                  "\xF0\x90\x80\x80", "\xF3\xBF\xBF\xBF", "\xF4\x8F\xBF\xBF"}) { // U+10000, U+FFFFF, U+10FFFF
+        CHECK(json(text) == "\"" + std::string(text) + "\"");
+    }
+}
+
+void testIllFormed() {
+    // Overlong forms
+    CHECK(json("\xC0\x80") == "\"\\u00c0\\u0080\"");
+    CHECK(json("\xC1\xBF") == "\"\\u00c1\\u00bf\"");
+    CHECK(json("\xE0\x80\x80") == "\"\\u00e0\\u0080\\u0080\"");
+    CHECK(json("\xE0\x9F\xBF") == "\"\\u00e0\\u009f\\u00bf\"");
+    CHECK(json("\xF0\x80\x80\x80") == "\"\\u00f0\\u0080\\u0080\\u0080\"");
+    CHECK(json("\xF0\x8F\xBF\xBF") == "\"\\u00f0\\u008f\\u00bf\\u00bf\"");
+    // Surrogates
+    CHECK(json("\xED\xA0\x80") == "\"\\u00ed\\u00a0\\u0080\"");
+    CHECK(json("\xED\xBF\xBF") == "\"\\u00ed\\u00bf\\u00bf\"");
+    // Past U+10FFFF
+    CHECK(json("\xF4\x90\x80\x80") == "\"\\u00f4\\u0090\\u0080\\u0080\"");
+    CHECK(json("\xF5\x80\x80\x80") == "\"\\u00f5\\u0080\\u0080\\u0080\"");
+    CHECK(json("\xF7\xBF\xBF\xBF") == "\"\\u00f7\\u00bf\\u00bf\\u00bf\"");
+    // Stray continuation bytes and sequences cut short
+    CHECK(json("a\x80z") == "\"a\\u0080z\"");
+    CHECK(json("\xE2\x82") == "\"\\u00e2\\u0082\"");
+    CHECK(json("\xE2\x82" "a") == "\"\\u00e2\\u0082a\"");
+}
+
+}
+
+int main() {
+    testValid();
+    testIllFormed();
+    return testResult();
+}
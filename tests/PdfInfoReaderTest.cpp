@@ -0,0 +1,217 @@
+#include "PdfInfoReader.h"
+#include "Check.h"
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Tests of `readPdfInfo` over PDFs built in memory (a classic xref table, an incremental update, an
+ * xref stream with the Info dictionary inside an object stream, encrypted and broken files) and of
+ * `parsePdfDate`.
+ */
+
+namespace {
+
+//Assembles a PDF body and its cross-reference sections.
+class PdfBuilder {
+public:
+    explicit PdfBuilder(std::string_view version = "1.7") {
+        out = "%PDF-" + std::string(version) + "\n%\xE2\xE3\xCF\xD3\n";
+    }
+
+    PdfBuilder& object(int number, std::string_view body) {
+        offsets[number] = out.size();
+        fresh.push_back(number);
+        out += std::to_string(number) + " 0 obj\n" + std::string(body) + "\nendobj\n";
+        return *this;
+    }
+
+    //Adds a stream object whose dictionary is `dictionary` plus /Length.
+    PdfBuilder& stream(int number, std::string_view dictionary, std::string_view data) {
+        return object(number, "<< " + std::string(dictionary) + " /Length " + std::to_string(data.size()) + " >>\nstream\n" +
+                                  std::string(data) + "\nendstream");
+    }
+
+    //Ends a section with an xref table of the objects added since the last one, and its trailer.
+    PdfBuilder& xrefTable(std::string_view trailer) {
+        std::size_t xrefOffset = out.size();
+        out += "xref\n0 1\n0000000000 65535 f \n";
+        for (int number : fresh) {
+            char entry[21];
+            std::snprintf(entry, sizeof(entry), "%010zu 00000 n \n", offsets[number]);
+            out += std::to_string(number) + " 1\n" + entry;
+        }
+        fresh.clear();
+        out += "trailer\n<< /Size " + std::to_string(offsets.rbegin()->first + 1) + " " + std::string(trailer) + " >>\n";
+        return finish(xrefOffset);
+    }
+
+    /**
+     * Ends the file with an uncompressed xref stream (object `number`). `compressed` maps object numbers
+     * to (object stream, index) for objects stored inside an object stream.
+     */
+    PdfBuilder& xrefStream(int number, std::string_view trailer, const std::map<int, std::pair<int, int>>& compressed) {
+        std::size_t xrefOffset = out.size();
+        int size = number + 1;
+        std::string entries;
+        auto put = [&entries](int type, std::size_t field2, int field3) {
+            entries.push_back(static_cast<char>(type));
+            for (int shift = 24; shift >= 0; shift -= 8) {
+                entries.push_back(static_cast<char>(field2 >> shift));
+            }
+            entries.push_back(static_cast<char>(field3 >> 8));
+            entries.push_back(static_cast<char>(field3));
+        };
+        for (int i = 0; i < size; ++i) {
+            if (i == number) {
+                put(1, xrefOffset, 0);
+            } else if (auto inStream = compressed.find(i); inStream != compressed.end()) {
+                put(2, static_cast<std::size_t>(inStream->second.first), inStream->second.second);
+            } else if (auto direct = offsets.find(i); direct != offsets.end()) {
+                put(1, direct->second, 0);
+            } else {
+                put(0, 0, i == 0 ? 65535 : 0);
+            }
+        }
+        stream(number, "/Type /XRef /Size " + std::to_string(size) + " /W [1 4 2] " + std::string(trailer), entries);
+        fresh.clear();
+        return finish(xrefOffset);
+    }
+
+    std::vector<uint8_t> build() const {
+        return {out.begin(), out.end()};
+    }
+
+    //Offset of the last xref section, for the /Prev of the next one.
+    std::size_t lastXref() const {
+        return previous;
+    }
+
+private:
+    PdfBuilder& finish(std::size_t xrefOffset) {
+        out += "startxref\n" + std::to_string(xrefOffset) + "\n%%EOF\n";
+        previous = xrefOffset;
+        return *this;
+    }
+
+    std::string out;
+    std::map<int, std::size_t> offsets;
+    std::vector<int> fresh;
+    std::size_t previous = 0;
+};
+
+std::string iso(const std::optional<Timestamp>& time) {
+    std::string text;
+    if (time) {
+        formatIsoTime(text, *time);
+    }
+    return time ? text : "nullopt";
+}
+
+void testClassic() {
+    std::vector<uint8_t> pdf = PdfBuilder("1.4")
+                                   .object(1, "<< /Type /Catalog /Pages 3 0 R >>")
+                                   .object(2, "<< /Title (A \\(nested\\) title) /Author <FEFF00C5006B0065> "
+                                              "/Subject (Caf\\351 \\200) /CreationDate (D:20240102030405+01'00') "
+                                              "/ModDate (D:2024) /Producer (builder) >>")
+                                   .object(3, "<< /Type /Pages /Kids [] /Count 0 >>")
+                                   .xrefTable("/Root 1 0 R /Info 2 0 R")
+                                   .build();
+    std::optional<PdfInfo> info = readPdfInfo(pdf);
+    CHECK(info.has_value());
+    if (!info) {
+        return;
+    }
+    CHECK(info->version == "1.4");
+    CHECK(info->title == "A (nested) title");
+    CHECK(info->author == "\xC3\x85ke");                      // UTF-16BE
+    CHECK(info->subject == "Caf\xC3\xA9 \xE2\x80\xA2");         // PDFDocEncoding
+    CHECK(info->producer == "builder");
+    CHECK(info->keywords.empty());
+    CHECK(iso(info->creationDate) == "2024-01-02T02:04:05Z");
+    CHECK(iso(info->modificationDate) == "2024-01-01T00:00:00Z");
+}
+
+void testIncrementalUpdate() {
+    PdfBuilder builder;
+    builder.object(1, "<< /Type /Catalog >>").object(2, "<< /Title (Old) /Author (Kept) >>").xrefTable("/Root 1 0 R /Info 2 0 R");
+    builder.object(4, "<< /Title (New) >>").xrefTable("/Root 1 0 R /Info 4 0 R /Prev " + std::to_string(builder.lastXref()));
+    std::optional<PdfInfo> info = readPdfInfo(builder.build());
+    CHECK(info && info->title == "New" && info->author.empty());
+
+    // Redefining the Info object itself: the newest section wins
+    PdfBuilder redefined;
+    redefined.object(1, "<< /Type /Catalog >>").object(2, "<< /Title (Old) >>").xrefTable("/Root 1 0 R /Info 2 0 R");
+    redefined.object(2, "<< /Title (Edited) >>").xrefTable("/Root 1 0 R /Info 2 0 R /Prev " + std::to_string(redefined.lastXref()));
+    info = readPdfInfo(redefined.build());
+    CHECK(info && info->title == "Edited");
+}
+
+void testXrefStream() {
+    // Object 2 (the Info dictionary) lives at index 0 of object stream 3
+    std::string objects = "<< /Title (Packed) /Keywords (a, b) /CreationDate (D:19991231235959Z) >>";
+    std::string header = "2 0 ";
+    std::vector<uint8_t> pdf = PdfBuilder("1.5")
+                                   .object(1, "<< /Type /Catalog >>")
+                                   .stream(3, "/Type /ObjStm /N 1 /First " + std::to_string(header.size()), header + objects)
+                                   .xrefStream(4, "/Root 1 0 R /Info 2 0 R", {{2, {3, 0}}})
+                                   .build();
+    std::optional<PdfInfo> info = readPdfInfo(pdf);
+    CHECK(info.has_value());
+    if (info) {
+        CHECK(info->version == "1.5");
+        CHECK(info->title == "Packed");
+        CHECK(info->keywords == "a, b");
+        CHECK(iso(info->creationDate) == "1999-12-31T23:59:59Z");
+    }
+}
+
+void testUnreadable() {
+    std::vector<uint8_t> encrypted = PdfBuilder()
+                                         .object(1, "<< /Type /Catalog >>")
+                                         .object(2, "<< /Title (Secret) >>")
+                                         .object(3, "<< /Filter /Standard /V 1 /R 2 >>")
+                                         .xrefTable("/Root 1 0 R /Info 2 0 R /Encrypt 3 0 R")
+                                         .build();
+    CHECK(!readPdfInfo(encrypted));
+
+    std::vector<uint8_t> pdf = PdfBuilder().object(1, "<< /Type /Catalog >>").object(2, "<< /Title (T) >>").xrefTable("/Root 1 0 R /Info 2 0 R").build();
+    std::vector<uint8_t> truncated(pdf.begin(), pdf.begin() + static_cast<std::ptrdiff_t>(pdf.size() / 2));
+    CHECK(!readPdfInfo(truncated));
+
+    std::string wrongOffset(pdf.begin(), pdf.end());
+    wrongOffset.replace(wrongOffset.rfind("startxref\n") + 10, 1, "9");
+    CHECK(!readPdfInfo(std::vector<uint8_t>(wrongOffset.begin(), wrongOffset.end())));
+
+    CHECK(!readPdfInfo(std::vector<uint8_t>()));
+}
+
+void testDates() {
+    CHECK(iso(parsePdfDate("D:20240102030405Z")) == "2024-01-02T03:04:05Z");
+    CHECK(iso(parsePdfDate("D:20240102030405+05'30'")) == "2024-01-01T21:34:05Z");
+    CHECK(iso(parsePdfDate("D:20240102030405-08'00'")) == "2024-01-02T11:04:05Z");
+    CHECK(iso(parsePdfDate("D:20240102030405+05")) == "2024-01-01T22:04:05Z");
+    CHECK(iso(parsePdfDate("D:20240102030405")) == "2024-01-02T03:04:05Z");
+    CHECK(iso(parsePdfDate("D:2024")) == "2024-01-01T00:00:00Z");
+    CHECK(iso(parsePdfDate("20240102")) == "2024-01-02T00:00:00Z");
+    CHECK(iso(parsePdfDate("D:20240229")) == "2024-02-29T00:00:00Z");
+    CHECK(!parsePdfDate("D:20230229"));
+    CHECK(!parsePdfDate("D:202402300000"));
+    CHECK(!parsePdfDate("D:20241302"));
+    CHECK(!parsePdfDate("D:20240102250000"));
+    CHECK(!parsePdfDate(""));
+    CHECK(!parsePdfDate("D:"));
+    CHECK(!parsePdfDate("garbage"));
+}
+
+}
+
+int main() {
+    testClassic();
+    testIncrementalUpdate();
+    testXrefStream();
+    testUnreadable();
+    testDates();
+    return testResult();
+}
@@ -0,0 +1,182 @@
+#include "PngReader.h"
+#include "Crc32.h"
+#include "Check.h"
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+/**
+ * Tests of `PngReader` (chunk walking, CRC checks, text and time chunks, truncated and invalid files)
+ * and of `updateCrc32` against zlib for every length up to a few blocks and for split input.
+ */
+
+namespace {
+
+void put32be(std::vector<uint8_t>& out, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<uint8_t>(value >> shift));
+    }
+}
+
+void addChunk(std::vector<uint8_t>& png, std::string_view type, std::string_view data) {
+    put32be(png, static_cast<uint32_t>(data.size()));
+    std::size_t start = png.size();
+    png.insert(png.end(), type.begin(), type.end());
+    png.insert(png.end(), data.begin(), data.end());
+    put32be(png, static_cast<uint32_t>(::crc32(0, png.data() + start, static_cast<uInt>(png.size() - start))));
+}
+
+std::string zlibCompress(std::string_view text) {
+    uLongf length = ::compressBound(static_cast<uLong>(text.size()));
+    std::string out(length, '\0');
+    ::compress(reinterpret_cast<Bytef*>(out.data()), &length, reinterpret_cast<const Bytef*>(text.data()), static_cast<uLong>(text.size()));
+    out.resize(length);
+    return out;
+}
+
+std::string header(uint32_t width, uint32_t height) {
+    std::vector<uint8_t> bytes;
+    put32be(bytes, width);
+    put32be(bytes, height);
+    bytes.insert(bytes.end(), {8, 6, 0, 0, 1});
+    return std::string(bytes.begin(), bytes.end());
+}
+
+std::vector<uint8_t> samplePng() {
+    std::vector<uint8_t> png(PngReader::Signature.begin(), PngReader::Signature.end());
+    addChunk(png, "IHDR", header(640, 480));
+    addChunk(png, "tEXt", std::string("Title\0Plain title", 17));
+    addChunk(png, "zTXt", std::string("Comment\0\0", 9) + zlibCompress("compressed comment"));
+    addChunk(png, "iTXt", std::string("Author\0\0\0en\0Autor\0", 18) + "\xC3\x85ke");
+    addChunk(png, "iTXt", std::string("Description\0\1\0\0\0", 16) + zlibCompress("packed description"));
+    addChunk(png, "tIME", std::string("\x07\xE8\x01\x02\x03\x04\x05", 7));
+    addChunk(png, "IDAT", std::string(100, 'd'));
+    addChunk(png, "IEND", "");
+    return png;
+}
+
+void testChunks() {
+    std::vector<uint8_t> png = samplePng();
+    PngReader reader(png);
+    CHECK(reader.header().width == 640 && reader.header().height == 480);
+    CHECK(reader.header().bitDepth == 8 && reader.header().colorType == 6 && reader.header().interlace == 1);
+
+    std::string types;
+    bool crcsValid = true;
+    std::vector<std::string> texts;
+    std::optional<Timestamp> time;
+    uint64_t visited = reader.forEachChunk([&](const PngChunk& chunk) {
+        types += std::string(chunk.type) + " ";
+        crcsValid &= PngReader::hasValidCrc(chunk);
+        if (auto text = PngReader::decodeText(chunk)) {
+            texts.push_back(std::string(text->keyword) + "=" + std::string(text->text));
+        }
+        if (chunk.type == "tIME") {
+            time = PngReader::decodeTime(chunk);
+        }
+        return true;
+    });
+    CHECK(visited == 8);
+    CHECK(types == "IHDR tEXt zTXt iTXt iTXt tIME IDAT IEND ");
+    CHECK(crcsValid);
+    CHECK(texts.size() == 4);
+    if (texts.size() == 4) {
+        CHECK(texts[0] == "Title=Plain title");
+        CHECK(texts[1] == "Comment=compressed comment");
+        CHECK(texts[2] == "Author=\xC3\x85ke");
+        CHECK(texts[3] == "Description=packed description");
+    }
+    std::string iso;
+    if (time) {
+        formatIsoTime(iso, *time);
+    }
+    CHECK(iso == "2024-01-02T03:04:05Z");
+
+    // Returning false stops the walk
+    CHECK(reader.forEachChunk([](const PngChunk& chunk) { return chunk.type != "tEXt"; }) == 2);
+}
+
+void testDamage() {
+    std::vector<uint8_t> png = samplePng();
+    // Flip a byte of the IDAT data: only that chunk fails its CRC
+    png[png.size() - 12 - 50] ^= 0x01;
+    int invalid = 0;
+    PngReader(png).forEachChunk([&invalid](const PngChunk& chunk) {
+        invalid += !PngReader::hasValidCrc(chunk);
+        return true;
+    });
+    CHECK(invalid == 1);
+
+    // A prefix ends the walk at the first chunk that does not fit
+    std::vector<uint8_t> prefix(png.begin(), png.end() - 60);
+    CHECK(PngReader(prefix).forEachChunk([](const PngChunk&) { return true; }) == 6);
+
+    std::vector<uint8_t> notPng = samplePng();
+    notPng[1] = 'Q';
+    CHECK_THROWS(PngReader(notPng), std::runtime_error);
+
+    std::vector<uint8_t> noHeader(PngReader::Signature.begin(), PngReader::Signature.end());
+    addChunk(noHeader, "IEND", "");
+    CHECK_THROWS(PngReader(noHeader), std::runtime_error);
+
+    std::vector<uint8_t> badTime(PngReader::Signature.begin(), PngReader::Signature.end());
+    addChunk(badTime, "IHDR", header(1, 1));
+    addChunk(badTime, "tIME", std::string("\x07\xE8\x0D\x02\x03\x04\x05", 7)); // month 13
+    addChunk(badTime, "tEXt", "no separator");
+    PngReader(badTime).forEachChunk([](const PngChunk& chunk) {
+        if (chunk.type == "tIME") {
+            CHECK(!PngReader::decodeTime(chunk));
+        } else if (chunk.type == "tEXt") {
+            CHECK(!PngReader::decodeText(chunk));
+        }
+        return true;
+    });
+}
+
+void testCrc32() {
+    std::string implementation = crc32Implementation();
+    CHECK(implementation == "pclmul" || implementation == "armv8-crc" || implementation == "zlib");
+
+    std::string check = "123456789";
+    CHECK(updateCrc32(0, {reinterpret_cast<const uint8_t*>(check.data()), check.size()}) == 0xCBF43926);
+    CHECK(updateCrc32(0, {}) == 0);
+
+    std::mt19937 random(7);
+    std::vector<uint8_t> data(1 << 20);
+    for (auto& byte : data) {
+        byte = static_cast<uint8_t>(random());
+    }
+    // Every length and misalignment around the folding block sizes
+    bool lengthsMatch = true;
+    for (std::size_t length = 0; length <= 1024; ++length) {
+        for (std::size_t start : {0, 1, 7}) {
+            std::span<const uint8_t> piece(data.data() + start, length);
+            lengthsMatch &= updateCrc32(0, piece) == ::crc32(0, piece.data(), static_cast<uInt>(length));
+        }
+    }
+    CHECK(lengthsMatch);
+
+    uint32_t whole = static_cast<uint32_t>(::crc32(0, data.data(), static_cast<uInt>(data.size())));
+    CHECK(updateCrc32(0, data) == whole);
+    // Fed in uneven pieces, continuing from the previous CRC
+    uint32_t crc = 0;
+    std::span<const uint8_t> rest(data);
+    for (std::size_t piece = 1; !rest.empty(); piece = piece * 3 + 5) {
+        std::size_t length = std::min(piece, rest.size());
+        crc = updateCrc32(crc, rest.first(length));
+        rest = rest.subspan(length);
+    }
+    CHECK(crc == whole);
+}
+
+}
+
+int main() {
+    testChunks();
+    testDamage();
+    testCrc32();
+    return testResult();
+}
@@ -0,0 +1,157 @@
+#include "Check.h"
+#include "IndexFile.h"
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Tests of the `IndexFile` query language: `&&`, `||`, `!` and parentheses, comparisons and ranges on
+ * indexed fields (answered from the sorted indexes) and on other fields (answered by scanning), and
+ * the errors of malformed queries.
+ */
+
+namespace {
+
+OutputRecord makeRecord(std::string path, FileType fileType) {
+    OutputRecord record;
+    record.path = std::move(path);
+    record.fileType = fileType;
+    return record;
+}
+
+Timestamp utc(int64_t seconds) {
+    return Timestamp{seconds, 0};
+}
+
+//Writes a small index: 0 a.png, 1 b.png, 2 c.wav, 3 d.pdf, 4 e.txt.
+std::filesystem::path writeIndex() {
+    std::vector<OutputRecord> records;
+
+    records.push_back(makeRecord("a.png", FileType::PNG));
+    records.back().metadata[MetadataKey("FileSize")] = 1000;
+    records.back().metadata[MetadataKey("Width")] = 5000;
+    records.back().metadata[MetadataKey("Height")] = 3000;
+    records.back().metadata[MetadataKey("LastModified")] = utc(1706745600); // 2024-02-01
+    records.back().metadata[MetadataKey("Author")] = "Jane Doe";
+
+    records.push_back(makeRecord("b.png", FileType::PNG));
+    records.back().metadata[MetadataKey("FileSize")] = 20 * 1024 * 1024;
+    records.back().metadata[MetadataKey("Width")] = 800;
+    records.back().metadata[MetadataKey("Height")] = 600;
+    records.back().metadata[MetadataKey("LastModified")] = utc(1685577600); // 2023-06-01
+
+    records.push_back(makeRecord("c.wav", FileType::WAV));
+    records.back().metadata[MetadataKey("FileSize")] = 5000;
+    records.back().metadata[MetadataKey("Duration")] = 12.5;
+    records.back().metadata[MetadataKey("Codec")] = "PCM";
+    records.back().metadata[MetadataKey("Truncated")] = true;
+
+    records.push_back(makeRecord("d.pdf", FileType::PDF));
+    records.back().metadata[MetadataKey("FileSize")] = 300;
+    records.back().metadata[MetadataKey("Title")] = "Report";
+    records.back().metadata[MetadataKey("Author")] = "John";
+    records.back().metadata[MetadataKey("LastModified")] = utc(1705320000); // 2024-01-15T12:00:00Z
+
+    records.push_back(makeRecord("e.txt", FileType::TXT));
+    records.back().metadata[MetadataKey("FileSize")] = 0;
+    records.back().metadata[MetadataKey("Title")] = "Notes";
+
+    std::filesystem::path indexPath = std::filesystem::temp_directory_path() / ("QueryTest." + std::to_string(::getpid()) + ".idx");
+    std::FILE* out = std::fopen(indexPath.c_str(), "wb");
+    if (!out) {
+        throw std::runtime_error("cannot create " + indexPath.string());
+    }
+    {
+        IndexSink sink(out);
+        for (const OutputRecord& record : records) {
+            sink.write(record);
+        }
+        sink.finish();
+    }
+    std::fclose(out);
+    return indexPath;
+}
+
+void checkQuery(const IndexFile& index, const char* expression, std::vector<uint32_t> expected) {
+    std::vector<uint32_t> matches;
+    try {
+        matches = index.query(expression);
+    } catch (const std::exception& e) {
+        ++testFailures();
+        std::cerr << "query " << expression << " threw: " << e.what() << std::endl;
+        return;
+    }
+    if (matches != expected) {
+        ++testFailures();
+        std::cerr << "query " << expression << " matched {";
+        for (uint32_t number : matches) {
+            std::cerr << " " << number;
+        }
+        std::cerr << " }" << std::endl;
+    }
+}
+
+void testOperators(const IndexFile& index) {
+    checkQuery(index, "FileType=PNG", {0, 1});
+    checkQuery(index, "FileType == png", {0, 1});
+    checkQuery(index, "FileType!=PNG", {2, 3, 4});
+    checkQuery(index, "FileType=PNG && Width>4000", {0});
+    checkQuery(index, "Width>4000 || Duration", {0, 2});
+    checkQuery(index, "!Width", {2, 3, 4});
+    checkQuery(index, "!!Width", {0, 1});
+    checkQuery(index, "!(FileSize<10M)", {1});
+    checkQuery(index, "(Author=\"Jane Doe\" || Title=Report) && LastModified>=2024-01-01", {0, 3});
+
+    // && binds tighter than ||
+    checkQuery(index, "FileType=TXT || FileType=PDF && Title=Report", {3, 4});
+    checkQuery(index, "(FileType=TXT || FileType=PDF) && Title=Report", {3});
+    checkQuery(index, "Title=Notes || Width<1000 && Height>500", {1, 4});
+}
+
+void testRanges(const IndexFile& index) {
+    checkQuery(index, "FileSize>=300 && FileSize<=5000", {0, 2, 3});
+    checkQuery(index, "FileSize>300 && FileSize<5000", {0});
+    checkQuery(index, "FileSize>=1K", {1, 2});
+    checkQuery(index, "FileSize=0", {4});
+    checkQuery(index, "LastModified>2024-01-15T12:00:00Z", {0});
+    checkQuery(index, "LastModified>=2024-01-15T12:00:00Z", {0, 3});
+    checkQuery(index, "LastModified>=2024-01-01 && LastModified<2024-02-01", {3});
+    checkQuery(index, "Duration>12 && Duration<13", {2});
+    checkQuery(index, "Title<O", {4});
+    checkQuery(index, "Title>M", {3, 4});
+
+    // A record lacking the field never matches a comparison, != included
+    checkQuery(index, "Width!=800", {0});
+    checkQuery(index, "Codec=PCM", {2});
+    checkQuery(index, "Codec!=PCM", {});
+    checkQuery(index, "Truncated=true", {2});
+    checkQuery(index, "Path=b.png", {1});
+    checkQuery(index, "Missing", {});
+}
+
+void testErrors(const IndexFile& index) {
+    for (const char* expression : {"", "Width>", "(Width>1", "Width>1)", "&& Width", "Width>1 &&", "Width>1 ||",
+                                   "Width & Height", "Width | Height", "!", "()", "Title=\"unterminated",
+                                   "FileType<PNG", "FileType=NOSUCHTYPE"}) {
+        CHECK_THROWS(index.query(expression), std::invalid_argument);
+    }
+}
+
+}
+
+int main() {
+    std::filesystem::path indexPath = writeIndex();
+    {
+        IndexFile index(indexPath);
+        CHECK(index.size() == 5);
+        CHECK(index.record(3).path == "d.pdf");
+        testOperators(index);
+        testRanges(index);
+        testErrors(index);
+    }
+    std::filesystem::remove(indexPath);
+    return testResult();
+}
@@ -0,0 +1,139 @@
+#include "AnalyzerContext.h"
+#include "Check.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Tests of `ResultQueue`: bounded capacity, close and reopen, and an MPMC stress run in which several
+ * producers and consumers share a ring much smaller than the stream, so both sides keep waiting on
+ * each other.
+ */
+
+namespace {
+
+AnalysisResult numbered(std::size_t number) {
+    AnalysisResult result;
+    result.path = std::to_string(number);
+    return result;
+}
+
+std::size_t numberOf(const AnalysisResult& result) {
+    return std::stoul(result.path.string());
+}
+
+void testCapacity() {
+    ResultQueue queue(3); // rounded up to 4
+    for (std::size_t i = 0; i < 4; ++i) {
+        AnalysisResult result = numbered(i);
+        CHECK(queue.tryPush(result));
+    }
+    AnalysisResult overflow = numbered(4);
+    CHECK(!queue.tryPush(overflow));
+    CHECK(overflow.path == "4"); // left alone on failure
+
+    // First in, first out
+    for (std::size_t i = 0; i < 4; ++i) {
+        AnalysisResult result;
+        CHECK(queue.tryPop(result));
+        CHECK(numberOf(result) == i);
+    }
+    AnalysisResult empty;
+    CHECK(!queue.tryPop(empty));
+}
+
+void testCloseAndReopen() {
+    ResultQueue queue(8);
+    queue.push(numbered(1));
+    queue.push(numbered(2));
+    queue.close();
+
+    // What was pushed before the close is still delivered, then pop reports the end every time
+    AnalysisResult result;
+    CHECK(queue.pop(result) && numberOf(result) == 1);
+    CHECK(queue.pop(result) && numberOf(result) == 2);
+    CHECK(!queue.pop(result));
+    CHECK(!queue.pop(result));
+    CHECK(!queue.tryPop(result));
+
+    queue.reopen();
+    queue.push(numbered(3));
+    CHECK(queue.pop(result) && numberOf(result) == 3);
+
+    // A consumer already waiting on the empty queue is woken by the close
+    std::thread consumer([&queue] {
+        AnalysisResult waited;
+        CHECK(!queue.pop(waited));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    queue.close();
+    consumer.join();
+}
+
+void testStress() {
+    constexpr std::size_t Producers = 4;
+    constexpr std::size_t Consumers = 4;
+    constexpr std::size_t PerProducer = 50000;
+    ResultQueue queue(16);
+
+    std::vector<std::vector<std::size_t>> received(Consumers);
+    std::vector<std::thread> consumers;
+    for (std::size_t c = 0; c < Consumers; ++c) {
+        consumers.emplace_back([&queue, &received, c] {
+            for (AnalysisResult result; queue.pop(result);) {
+                received[c].push_back(numberOf(result));
+            }
+            // Closed and drained: stays so
+            AnalysisResult after;
+            CHECK(!queue.pop(after));
+        });
+    }
+    std::vector<std::thread> producers;
+    for (std::size_t p = 0; p < Producers; ++p) {
+        producers.emplace_back([&queue, p] {
+            for (std::size_t i = 0; i < PerProducer; ++i) {
+                queue.push(numbered(p * PerProducer + i));
+            }
+        });
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    queue.close();
+    for (std::thread& consumer : consumers) {
+        consumer.join();
+    }
+
+    // Every item exactly once, and each producer's items in the order it pushed them
+    std::vector<int> seen(Producers * PerProducer, 0);
+    for (const std::vector<std::size_t>& numbers : received) {
+        std::vector<std::size_t> last(Producers, 0);
+        std::vector<bool> started(Producers, false);
+        for (std::size_t number : numbers) {
+            CHECK(number < seen.size());
+            if (number >= seen.size()) {
+                continue;
+            }
+            ++seen[number];
+            std::size_t producer = number / PerProducer;
+            CHECK(!started[producer] || number > last[producer]);
+            started[producer] = true;
+            last[producer] = number;
+        }
+    }
+    std::size_t exactlyOnce = 0;
+    for (int count : seen) {
+        exactlyOnce += count == 1;
+    }
+    CHECK(exactlyOnce == seen.size());
+}
+
+}
+
+int main() {
+    testCapacity();
+    testCloseAndReopen();
+    testStress();
+    return testResult();
+}
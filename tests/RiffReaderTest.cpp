@@ -0,0 +1,159 @@
+#include "RiffReader.h"
+#include "Check.h"
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Tests of `RiffReader`: a WAVE file with odd-sized (padded) chunks and a LIST INFO, an RF64 file whose
+ * sizes come from ds64 (its table included), chunks cut short by the end of the bytes, and bad
+ * signatures.
+ */
+
+namespace {
+
+void put32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void put64(std::string& out, uint64_t value) {
+    put32(out, static_cast<uint32_t>(value));
+    put32(out, static_cast<uint32_t>(value >> 32));
+}
+
+//A chunk with its pad byte; `declared` overrides the size field.
+std::string chunk(std::string_view id, std::string_view body, std::optional<uint32_t> declared = std::nullopt) {
+    std::string out(id);
+    put32(out, declared.value_or(static_cast<uint32_t>(body.size())));
+    out += body;
+    if (body.size() % 2 != 0) {
+        out.push_back('\0');
+    }
+    return out;
+}
+
+std::vector<uint8_t> bytesOf(const std::string& text) {
+    return {text.begin(), text.end()};
+}
+
+std::string format() {
+    std::string body;
+    put32(body, 0x00020001); // PCM, 2 channels
+    put32(body, 44100);
+    put32(body, 44100 * 4);
+    put32(body, 0x00100004); // block align 4, 16 bits
+    return body;
+}
+
+std::vector<uint8_t> wave() {
+    std::string info = "INFO" + chunk("INAM", std::string_view("Title\0", 6)) + chunk("IART", std::string_view("Artist  \0", 9));
+    std::string body = "WAVE" + chunk("fmt ", format()) + chunk("junk", "odd") + chunk("LIST", info) + chunk("data", std::string(40, 'x'));
+    std::string file = "RIFF";
+    put32(file, static_cast<uint32_t>(body.size()));
+    return bytesOf(file + body);
+}
+
+void testWave() {
+    std::vector<uint8_t> file = wave();
+    RiffReader riff(file);
+    CHECK(riff.signature() == "RIFF" && riff.formType() == "WAVE");
+    CHECK(!riff.is64Bit());
+    CHECK(riff.riffSize() == file.size() - 8);
+    CHECK(riff.ds64SampleCount() == 0);
+
+    std::string ids;
+    std::vector<std::string> items;
+    bool complete = true;
+    uint64_t visited = riff.forEachChunk([&](const RiffChunk& chunk) {
+        ids += std::string(chunk.id) + "|";
+        complete &= chunk.isComplete();
+        if (RiffReader::listType(chunk) == "INFO") {
+            RiffReader::forEachListItem(chunk, [&items](const RiffChunk& item) {
+                items.push_back(std::string(item.id) + "=" + std::string(RiffReader::text(item.data)));
+                return true;
+            });
+        }
+        return true;
+    });
+    CHECK(visited == 4);
+    CHECK(ids == "fmt |junk|LIST|data|");
+    CHECK(complete);
+    CHECK(items == std::vector<std::string>({"INAM=Title", "IART=Artist"}));
+
+    CHECK(riff.forEachChunk([](const RiffChunk& chunk) { return chunk.id != "junk"; }) == 2);
+}
+
+void testRf64() {
+    std::string ds64;
+    put64(ds64, 0);          // RIFF size, patched below
+    put64(ds64, 1000000);    // data size
+    put64(ds64, 250000);     // sample count
+    put32(ds64, 1);          // table entries
+    ds64 += "bext";
+    put64(ds64, 6);
+    std::string body = "WAVE" + chunk("ds64", ds64) + chunk("fmt ", format()) + chunk("bext", "abcdef", 0xFFFFFFFF) +
+                       chunk("data", std::string(64, 'y'), 0xFFFFFFFF);
+    std::string file = "RF64";
+    put32(file, 0xFFFFFFFF);
+    file += body;
+    uint64_t riffSize = 4 + 8 + ds64.size() + 8 + 16 + 8 + 6 + 8 + 1000000;
+    for (int i = 0; i < 8; ++i) {
+        file[20 + i] = static_cast<char>(riffSize >> (8 * i));
+    }
+
+    std::vector<uint8_t> bytes = bytesOf(file);
+    RiffReader riff(bytes);
+    CHECK(riff.is64Bit() && riff.signature() == "RF64");
+    CHECK(riff.riffSize() == riffSize);
+    CHECK(riff.ds64SampleCount() == 250000);
+
+    std::vector<RiffChunk> chunks;
+    riff.forEachChunk([&chunks](const RiffChunk& chunk) {
+        chunks.push_back(chunk);
+        return true;
+    });
+    CHECK(chunks.size() == 4);
+    if (chunks.size() == 4) {
+        CHECK(chunks[2].id == "bext" && chunks[2].size == 6 && chunks[2].isComplete());
+        // Only a prefix of the million-byte data chunk is present
+        CHECK(chunks[3].id == "data" && chunks[3].size == 1000000);
+        CHECK(chunks[3].data.size() == 64 && !chunks[3].isComplete());
+    }
+}
+
+void testTruncated() {
+    std::vector<uint8_t> file = wave();
+    // Cut in the middle of the LIST chunk: it is reported partly, and the walk ends there
+    std::vector<uint8_t> prefix(file.begin(), file.begin() + 12 + 24 + 12 + 20);
+    std::vector<RiffChunk> chunks;
+    RiffReader(prefix).forEachChunk([&chunks](const RiffChunk& chunk) {
+        chunks.push_back(chunk);
+        return true;
+    });
+    CHECK(chunks.size() == 3);
+    CHECK(!chunks.empty() && chunks.back().id == "LIST" && !chunks.back().isComplete());
+
+    // A header cut in half ends the walk before it
+    std::vector<uint8_t> halfHeader(file.begin(), file.begin() + 12 + 24 + 4);
+    CHECK(RiffReader(halfHeader).forEachChunk([](const RiffChunk&) { return true; }) == 1);
+}
+
+void testBadSignatures() {
+    std::vector<uint8_t> file = wave();
+    file[0] = 'X';
+    CHECK_THROWS(RiffReader(file), std::runtime_error);
+    CHECK_THROWS(RiffReader(bytesOf("RIFF")), std::exception);
+}
+
+}
+
+int main() {
+    testWave();
+    testRf64();
+    testTruncated();
+    testBadSignatures();
+    return testResult();
+}
@@ -0,0 +1,160 @@
+#include "TextReader.h"
+#include "Check.h"
+#include <algorithm>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Tests of `TextReader`: counts and UTF-8 validation checked against a plain byte-by-byte reference over
+ * random text fed whole and in pieces that cut blocks, CRLF pairs, words and sequences anywhere, plus
+ * byte order marks, line ending kinds and the kept head lines.
+ */
+
+namespace {
+
+TextSummary summarize(std::string_view text, std::size_t piece = 0, std::size_t headLines = 0, std::size_t headBytes = 0) {
+    TextReader reader(headLines, headBytes);
+    if (piece == 0) {
+        piece = std::max<std::size_t>(text.size(), 1);
+    }
+    for (std::size_t at = 0; at < text.size(); at += piece) {
+        std::string_view part = text.substr(at, piece);
+        reader.update({reinterpret_cast<const uint8_t*>(part.data()), part.size()});
+    }
+    return reader.finish();
+}
+
+//Offset of the first byte that breaks UTF-8, narrowing the range of code points each byte allows.
+std::optional<uint64_t> firstInvalidUtf8(std::string_view text) {
+    std::size_t i = 0;
+    while (i < text.size()) {
+        uint8_t lead = static_cast<uint8_t>(text[i]);
+        std::size_t length = lead < 0x80 ? 1 : (lead & 0xE0) == 0xC0 ? 2 : (lead & 0xF0) == 0xE0 ? 3 : (lead & 0xF8) == 0xF0 ? 4 : 0;
+        if (length == 0) {
+            return i;
+        }
+        const uint32_t minimum = length == 1 ? 0 : length == 2 ? 0x80 : length == 3 ? 0x800 : 0x10000;
+        uint32_t point = length == 1 ? lead : lead & (0x7F >> length);
+        for (std::size_t k = 0; k < length; ++k) {
+            if (k > 0) {
+                if (i + k == text.size()) {
+                    return text.size();
+                }
+                uint8_t byte = static_cast<uint8_t>(text[i + k]);
+                if ((byte & 0xC0) != 0x80) {
+                    return i + k;
+                }
+                point = (point << 6) | (byte & 0x3F);
+            }
+            // Every code point the sequence can still become is overlong, a surrogate or past U+10FFFF
+            uint32_t shift = 6 * static_cast<uint32_t>(length - 1 - k);
+            uint32_t lowest = point << shift;
+            uint32_t highest = lowest | ((1u << shift) - 1);
+            if (highest < minimum || lowest > 0x10FFFF || (lowest >= 0xD800 && highest <= 0xDFFF)) {
+                return i + k;
+            }
+        }
+        i += length;
+    }
+    return std::nullopt;
+}
+
+void checkAgainstReference(std::string_view text, const TextSummary& summary) {
+    auto isSpace = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r'; };
+    TextCounters expected;
+    bool previousSpace = true;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        expected.lineFeeds += text[i] == '\n';
+        expected.carriageReturns += text[i] == '\r';
+        expected.crlfPairs += text[i] == '\n' && i > 0 && text[i - 1] == '\r';
+        expected.words += !isSpace(text[i]) && previousSpace;
+        expected.nonAscii += static_cast<uint8_t>(text[i]) >= 0x80;
+        previousSpace = isSpace(text[i]);
+    }
+    CHECK(summary.counts.bytes == text.size());
+    CHECK(summary.counts.lineFeeds == expected.lineFeeds);
+    CHECK(summary.counts.carriageReturns == expected.carriageReturns);
+    CHECK(summary.counts.crlfPairs == expected.crlfPairs);
+    CHECK(summary.counts.words == expected.words);
+    CHECK(summary.counts.nonAscii == expected.nonAscii);
+    CHECK(summary.counts.invalidUtf8Offset == firstInvalidUtf8(text));
+}
+
+void testRandomText() {
+    std::string implementation = textReaderImplementation();
+    CHECK(implementation == "avx2" || implementation == "sse2" || implementation == "scalar");
+
+    // Mostly valid UTF-8 with whitespace of every kind; every few texts get one stray byte
+    const std::vector<std::string> pieces = {"a", "word", " ", "\t", "\n", "\r", "\r\n", "\v", "\f", "\xC3\xA9", "\xE2\x82\xAC",
+                                             "\xF0\x9F\x98\x80", "\xED\x9F\xBF", "\xF4\x8F\xBF\xBF"};
+    const std::vector<std::string> strays = {"\x80", "\xC0\xAF", "\xE0\x80\x80", "\xED\xA0\x80", "\xF4\x90\x80\x80", "\xF5", "\xFF", "\xE2\x82"};
+    std::mt19937 random(11);
+    for (int round = 0; round < 200; ++round) {
+        std::string text;
+        std::size_t target = random() % 700;
+        while (text.size() < target) {
+            text += pieces[random() % pieces.size()];
+        }
+        if (round % 4 == 3) {
+            text.insert(random() % (text.size() + 1), strays[random() % strays.size()]);
+        }
+        for (std::size_t piece : {std::size_t{0}, std::size_t{1}, std::size_t{7}, std::size_t{63}, std::size_t{65}}) {
+            checkAgainstReference(text, summarize(text, piece));
+        }
+    }
+}
+
+void testBlockBoundaries() {
+    // A CRLF pair, a word and a four-byte sequence each straddling the first block boundary
+    std::string crlf = std::string(63, 'x') + "\r\n" + "y";
+    TextSummary pair = summarize(crlf);
+    CHECK(pair.counts.crlfPairs == 1 && pair.lines == 2 && pair.counts.words == 2);
+    CHECK(pair.lineEndings() == "CRLF");
+
+    std::string word = std::string(60, ' ') + std::string(10, 'w');
+    CHECK(summarize(word, 3).counts.words == 1);
+
+    std::string emoji = std::string(62, 'e') + "\xF0\x9F\x98\x80" + "!";
+    TextSummary valid = summarize(emoji, 5);
+    CHECK(!valid.counts.invalidUtf8Offset && valid.encoding() == "UTF-8" && valid.counts.nonAscii == 4);
+
+    // A sequence cut off by the end of the text is invalid at the end
+    std::string cut = std::string(64, 'c') + "\xF0\x9F";
+    CHECK(summarize(cut).counts.invalidUtf8Offset == cut.size());
+    CHECK(summarize(cut).encoding() == "Unknown");
+}
+
+void testSummary() {
+    CHECK(summarize("").lines == 0 && summarize("").lineEndings() == "None" && summarize("").encoding() == "ASCII");
+    CHECK(summarize("one\ntwo").lines == 2 && summarize("one\ntwo\n").lines == 2);
+    CHECK(summarize("a\rb\r").lines == 2 && summarize("a\rb\r").lineEndings() == "CR");
+    CHECK(summarize("a\nb\r\n").lineEndings() == "Mixed");
+
+    TextSummary bom = summarize("\xEF\xBB\xBFhead\r\nsecond\nthird", 2, 2, 1000);
+    CHECK(bom.byteOrderMark == "UTF-8" && bom.encoding() == "UTF-8");
+    CHECK(bom.headLines.size() == 2);
+    if (bom.headLines.size() == 2) {
+        CHECK(bom.headLines[0] == "head" && bom.headLines[1] == "second");
+    }
+    CHECK(summarize(std::string("\xFF\xFEh\0i\0", 6)).encoding() == "UTF-16LE");
+
+    // A line crossing the byte limit is cut there; an unterminated last line is kept
+    TextSummary limited = summarize("first line\nsecond line", 4, 5, 15);
+    CHECK(limited.headLines.size() == 2);
+    if (limited.headLines.size() == 2) {
+        CHECK(limited.headLines[0] == "first line" && limited.headLines[1] == "seco");
+    }
+    TextSummary unterminated = summarize("only", 0, 3, 100);
+    CHECK(unterminated.headLines.size() == 1 && unterminated.headLines[0] == "only");
+}
+
+}
+
+int main() {
+    testRandomText();
+    testBlockBoundaries();
+    testSummary();
+    return testResult();
+}
@@ -0,0 +1,128 @@
+#ifndef TEST_ZIP_BUILDER_H
+#define TEST_ZIP_BUILDER_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <zlib.h>
+
+/**
+ * Builds ZIP archives in memory for the tests: local headers, data, central directory and end record,
+ * with Store or raw Deflate members. Every member gets the MS-DOS time 2024-01-02 03:04:06.
+ */
+class ZipBuilder {
+public:
+    static constexpr uint16_t DosDate = ((2024 - 1980) << 9) | (1 << 5) | 2;
+    static constexpr uint16_t DosTime = (3 << 11) | (4 << 5) | 3;
+
+    //Adds a member, deflated unless `store` is set.
+    ZipBuilder& add(std::string name, const std::vector<uint8_t>& contents, bool store = false) {
+        std::vector<uint8_t> data = store ? contents : deflateRaw(contents);
+        uint32_t crc = static_cast<uint32_t>(::crc32_z(0, contents.data(), contents.size()));
+        uint16_t method = store ? 0 : 8;
+
+        Entry entry{std::move(name), static_cast<uint32_t>(archive.size()), crc, static_cast<uint32_t>(data.size()),
+                    static_cast<uint32_t>(contents.size()), method};
+        u32(archive, 0x04034b50);
+        u16(archive, 20);
+        u16(archive, 0);
+        u16(archive, method);
+        u16(archive, DosTime);
+        u16(archive, DosDate);
+        u32(archive, crc);
+        u32(archive, entry.compressedSize);
+        u32(archive, entry.size);
+        u16(archive, static_cast<uint16_t>(entry.name.size()));
+        u16(archive, 0);
+        archive.insert(archive.end(), entry.name.begin(), entry.name.end());
+        archive.insert(archive.end(), data.begin(), data.end());
+        entries.push_back(std::move(entry));
+        return *this;
+    }
+
+    ZipBuilder& add(std::string name, std::string_view text, bool store = false) {
+        return add(std::move(name), std::vector<uint8_t>(text.begin(), text.end()), store);
+    }
+
+    //The finished archive.
+    std::vector<uint8_t> build() const {
+        std::vector<uint8_t> out = archive;
+        uint32_t directoryOffset = static_cast<uint32_t>(out.size());
+        for (const Entry& entry : entries) {
+            u32(out, 0x02014b50);
+            u16(out, 20);
+            u16(out, 20);
+            u16(out, 0);
+            u16(out, entry.method);
+            u16(out, DosTime);
+            u16(out, DosDate);
+            u32(out, entry.crc);
+            u32(out, entry.compressedSize);
+            u32(out, entry.size);
+            u16(out, static_cast<uint16_t>(entry.name.size()));
+            u16(out, 0);
+            u16(out, 0);
+            u16(out, 0);
+            u16(out, 0);
+            u32(out, 0);
+            u32(out, entry.offset);
+            out.insert(out.end(), entry.name.begin(), entry.name.end());
+        }
+        uint32_t directorySize = static_cast<uint32_t>(out.size()) - directoryOffset;
+        u32(out, 0x06054b50);
+        u16(out, 0);
+        u16(out, 0);
+        u16(out, static_cast<uint16_t>(entries.size()));
+        u16(out, static_cast<uint16_t>(entries.size()));
+        u32(out, directorySize);
+        u32(out, directoryOffset);
+        u16(out, 0);
+        return out;
+    }
+
+    static std::vector<uint8_t> deflateRaw(const std::vector<uint8_t>& contents) {
+        z_stream stream{};
+        if (::deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error("deflateInit2 failed");
+        }
+        std::vector<uint8_t> out(::deflateBound(&stream, static_cast<uLong>(contents.size())));
+        stream.next_in = const_cast<Bytef*>(contents.data());
+        stream.avail_in = static_cast<uInt>(contents.size());
+        stream.next_out = out.data();
+        stream.avail_out = static_cast<uInt>(out.size());
+        int result = ::deflate(&stream, Z_FINISH);
+        out.resize(stream.total_out);
+        ::deflateEnd(&stream);
+        if (result != Z_STREAM_END) {
+            throw std::runtime_error("deflate failed");
+        }
+        return out;
+    }
+
+private:
+    struct Entry {
+        std::string name;
+        uint32_t offset;
+        uint32_t crc;
+        uint32_t compressedSize;
+        uint32_t size;
+        uint16_t method;
+    };
+
+    static void u16(std::vector<uint8_t>& out, uint16_t value) {
+        out.push_back(static_cast<uint8_t>(value));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    static void u32(std::vector<uint8_t>& out, uint32_t value) {
+        u16(out, static_cast<uint16_t>(value));
+        u16(out, static_cast<uint16_t>(value >> 16));
+    }
+
+    std::vector<uint8_t> archive;
+    std::vector<Entry> entries;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include "ZipReader.h"
+#include "Check.h"
+#include "ZipBuilder.h"
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Tests of `ZipReader`: central directory entries and their data, directories, archive comments, a
+ * ZIP64 archive whose classic fields are saturated, malformed archives, and the formatting helpers.
+ */
+
+namespace {
+
+void put16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(static_cast<uint8_t>(value));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void put32(std::vector<uint8_t>& out, uint32_t value) {
+    put16(out, static_cast<uint16_t>(value));
+    put16(out, static_cast<uint16_t>(value >> 16));
+}
+
+void put64(std::vector<uint8_t>& out, uint64_t value) {
+    put32(out, static_cast<uint32_t>(value));
+    put32(out, static_cast<uint32_t>(value >> 32));
+}
+
+std::string text(std::span<const uint8_t> bytes) {
+    return std::string(bytes.begin(), bytes.end());
+}
+
+std::vector<ZipEntry> entriesOf(const ZipReader& zip) {
+    std::vector<ZipEntry> entries;
+    zip.forEachEntry([&entries](const ZipEntry& entry) {
+        entries.push_back(entry);
+        return true;
+    });
+    return entries;
+}
+
+void testEntries() {
+    std::string repeated(5000, 'r');
+    std::vector<uint8_t> archive = ZipBuilder().add("a.txt", "stored text", true).add("dir/", "", true).add("dir/b.txt", repeated).build();
+    ZipReader zip(archive);
+    CHECK(zip.entryCount() == 3);
+    CHECK(!zip.isZip64());
+    CHECK(zip.comment().empty());
+
+    std::vector<ZipEntry> entries = entriesOf(zip);
+    CHECK(entries.size() == 3);
+    if (entries.size() != 3) {
+        return;
+    }
+    CHECK(entries[0].name == "a.txt" && entries[0].method == 0 && !entries[0].isDirectory());
+    CHECK(entries[0].uncompressedSize == 11 && entries[0].compressedSize == 11);
+    CHECK(text(zip.entryData(entries[0])) == "stored text");
+    CHECK(entries[1].name == "dir/" && entries[1].isDirectory());
+    CHECK(entries[2].name == "dir/b.txt" && entries[2].method == 8);
+    CHECK(entries[2].uncompressedSize == repeated.size() && entries[2].compressedSize < repeated.size());
+    CHECK(zip.entryData(entries[2]).size() == entries[2].compressedSize);
+    CHECK(!entries[2].isEncrypted());
+    CHECK(formatDosDateTime(entries[2].dosDate, entries[2].dosTime) == "2024-01-02 03:04:06");
+
+    // Returning false stops the walk
+    uint64_t visited = zip.forEachEntry([](const ZipEntry&) { return false; });
+    CHECK(visited == 1);
+}
+
+void testComment() {
+    std::vector<uint8_t> archive = ZipBuilder().add("a.txt", "x", true).build();
+    std::string comment = "archive comment";
+    archive[archive.size() - 2] = static_cast<uint8_t>(comment.size());
+    archive.insert(archive.end(), comment.begin(), comment.end());
+    ZipReader zip(archive);
+    CHECK(zip.comment() == comment);
+    CHECK(zip.entryCount() == 1 && entriesOf(zip).size() == 1);
+}
+
+//One stored member whose central record and end of directory only give their values through ZIP64 fields.
+std::vector<uint8_t> zip64Archive() {
+    std::string name = "big.bin";
+    std::string contents = "hello";
+    std::vector<uint8_t> out;
+    put32(out, 0x04034b50);
+    put16(out, 45);
+    put16(out, 0);
+    put16(out, 0);
+    put16(out, ZipBuilder::DosTime);
+    put16(out, ZipBuilder::DosDate);
+    put32(out, 0);
+    put32(out, static_cast<uint32_t>(contents.size()));
+    put32(out, static_cast<uint32_t>(contents.size()));
+    put16(out, static_cast<uint16_t>(name.size()));
+    put16(out, 0);
+    out.insert(out.end(), name.begin(), name.end());
+    out.insert(out.end(), contents.begin(), contents.end());
+
+    uint64_t directoryOffset = out.size();
+    put32(out, 0x02014b50);
+    put16(out, 45);
+    put16(out, 45);
+    put16(out, 0);
+    put16(out, 0);
+    put16(out, ZipBuilder::DosTime);
+    put16(out, ZipBuilder::DosDate);
+    put32(out, 0);
+    put32(out, 0xFFFFFFFF);
+    put32(out, 0xFFFFFFFF);
+    put16(out, static_cast<uint16_t>(name.size()));
+    put16(out, 28);
+    put16(out, 0);
+    put16(out, 0);
+    put16(out, 0);
+    put32(out, 0);
+    put32(out, 0xFFFFFFFF);
+    out.insert(out.end(), name.begin(), name.end());
+    put16(out, 0x0001);
+    put16(out, 24);
+    put64(out, contents.size());
+    put64(out, contents.size());
+    put64(out, 0);
+    uint64_t directorySize = out.size() - directoryOffset;
+
+    uint64_t record = out.size();
+    put32(out, 0x06064b50);
+    put64(out, 44);
+    put16(out, 45);
+    put16(out, 45);
+    put32(out, 0);
+    put32(out, 0);
+    put64(out, 1);
+    put64(out, 1);
+    put64(out, directorySize);
+    put64(out, directoryOffset);
+
+    put32(out, 0x07064b50);
+    put32(out, 0);
+    put64(out, record);
+    put32(out, 1);
+
+    put32(out, 0x06054b50);
+    put16(out, 0);
+    put16(out, 0);
+    put16(out, 0xFFFF);
+    put16(out, 0xFFFF);
+    put32(out, 0xFFFFFFFF);
+    put32(out, 0xFFFFFFFF);
+    put16(out, 0);
+    return out;
+}
+
+void testZip64() {
+    std::vector<uint8_t> archive = zip64Archive();
+    ZipReader zip(archive);
+    CHECK(zip.isZip64());
+    CHECK(zip.entryCount() == 1);
+    std::vector<ZipEntry> entries = entriesOf(zip);
+    CHECK(entries.size() == 1);
+    if (entries.size() == 1) {
+        CHECK(entries[0].name == "big.bin");
+        CHECK(entries[0].uncompressedSize == 5 && entries[0].compressedSize == 5 && entries[0].localHeaderOffset == 0);
+        CHECK(text(zip.entryData(entries[0])) == "hello");
+    }
+}
+
+void testMalformed() {
+    CHECK_THROWS(ZipReader(std::vector<uint8_t>(10)), std::runtime_error);
+    CHECK_THROWS(ZipReader(std::vector<uint8_t>(100, 'x')), std::runtime_error);
+
+    std::vector<uint8_t> archive = ZipBuilder().add("a.txt", "contents", true).build();
+    std::vector<uint8_t> directoryPastEnd = archive;
+    directoryPastEnd[directoryPastEnd.size() - 6] = 0xF0; // central directory offset
+    CHECK_THROWS(ZipReader(directoryPastEnd), std::runtime_error);
+
+    // A saturated end record without its ZIP64 counterpart
+    std::vector<uint8_t> zip64 = zip64Archive();
+    std::size_t locator = zip64.size() - 22 - 20;
+    zip64[locator + 8] = 0x01; // points the locator away from the ZIP64 record
+    CHECK_THROWS(ZipReader(zip64), std::runtime_error);
+
+    // A local header that is not where the central directory says
+    ZipReader zip(archive);
+    std::vector<ZipEntry> entries = entriesOf(zip);
+    CHECK(entries.size() == 1);
+    if (!entries.empty()) {
+        ZipEntry moved = entries[0];
+        moved.localHeaderOffset = 3;
+        CHECK_THROWS(zip.entryData(moved), std::runtime_error);
+        ZipEntry oversized = entries[0];
+        oversized.compressedSize = archive.size();
+        CHECK_THROWS(zip.entryData(oversized), std::exception);
+    }
+}
+
+void testHelpers() {
+    CHECK(zipMethodName(0) == "Store");
+    CHECK(zipMethodName(8) == "Deflate");
+    CHECK(zipMethodName(93) == "Zstandard");
+    CHECK(zipMethodName(77) == "77");
+    CHECK(formatDosDateTime(0x0021, 0x0000) == "1980-01-01 00:00:00");
+    CHECK(formatDosDateTime((45 << 9) | (12 << 5) | 31, (23 << 11) | (59 << 5) | 29) == "2025-12-31 23:59:58");
+}
+
+}
+
+int main() {
+    testEntries();
+    testComment();
+    testZip64();
+    testMalformed();
+    testHelpers();
+    return testResult();
+}